@@ -40,7 +40,7 @@ typedef bool lto_bool_t;
  * @{
  */
 
-#define LTO_API_VERSION 15
+#define LTO_API_VERSION 16
 
 /**
  * \since prior to LTO_API_VERSION=3
@@ -524,6 +524,35 @@ lto_codegen_optimize(lto_code_gen_t cg);
 extern const void*
 lto_codegen_compile_optimized(lto_code_gen_t cg, size_t* length);
 
+/**
+ * Sets the number of native object files
+ * lto_codegen_compile_optimized_to_files() produces. The optimized merged
+ * module is split into that many partitions, each of which is code generated
+ * on its own thread. The default is 1.
+ *
+ * \since LTO_API_VERSION=16
+ */
+extern void
+lto_codegen_set_parallelism(lto_code_gen_t cg, unsigned int parallelism);
+
+/**
+ * Generates code for the optimized merged module into as many native object
+ * files as set by lto_codegen_set_parallelism(). It will not run any IR
+ * optimizations on the merged module. Linking all of the object files is
+ * equivalent to linking the single object file lto_codegen_compile_optimized()
+ * would produce.
+ *
+ * The names of the files are written to names, and their number to
+ * num_files. The array is owned by the lto_code_gen_t and stays valid until
+ * lto_codegen_dispose() is called, or this function is called again. It is up
+ * to the linker to remove the files. Returns true on error.
+ *
+ * \since LTO_API_VERSION=16
+ */
+extern lto_bool_t
+lto_codegen_compile_optimized_to_files(lto_code_gen_t cg, const char ***names,
+                                       unsigned int *num_files);
+
 /**
  * Returns the runtime API version.
  *
@@ -104,6 +104,19 @@ public:
   /// \brief Retrieve the current position in the stream, in bits.
   uint64_t GetCurrentBitNo() const { return GetBufferOffset() * 8 + CurBit; }
 
+  /// \brief Backpatch a 32-bit word that starts at bit \p BitNo, which need
+  /// not be byte aligned.  The bits must already have been flushed.
+  void BackpatchWordAtBit(uint64_t BitNo, unsigned NewWord) {
+    assert(BitNo + 32 <= Out.size() * 8 && "Backpatching unflushed bits");
+    for (unsigned i = 0; i != 32; ++i, ++BitNo) {
+      unsigned char Mask = 1 << (BitNo & 7);
+      if (NewWord & (1U << i))
+        Out[BitNo / 8] |= Mask;
+      else
+        Out[BitNo / 8] &= ~Mask;
+    }
+  }
+
   //===--------------------------------------------------------------------===//
   // Basic Primitives for emitting bits to the stream.
   //===--------------------------------------------------------------------===//
@@ -22,7 +22,8 @@
 
 namespace llvm {
 namespace bitc {
-  // The only top-level block type defined is for a module.
+  // The top-level block types are the module and, for combined function
+  // indexes, the module path string table and the function summaries.
   enum BlockIDs {
     // Blocks
     MODULE_BLOCK_ID          = FIRST_APPLICATION_BLOCKID,
@@ -42,7 +43,10 @@ namespace bitc {
 
     TYPE_BLOCK_ID_NEW,
 
-    USELIST_BLOCK_ID
+    USELIST_BLOCK_ID,
+
+    MODULE_STRTAB_BLOCK_ID,
+    FUNCTION_SUMMARY_BLOCK_ID
   };
 
 
@@ -135,6 +139,22 @@ namespace bitc {
     VST_CODE_BBENTRY = 2   // VST_BBENTRY: [bbid, namechar x N]
   };
 
+  // The module path string table only has one code (MST_CODE_ENTRY).
+  enum ModulePathSymtabCodes {
+    MST_CODE_ENTRY   = 1   // MST_ENTRY: [modid, namechar x N]
+  };
+
+  // The function summary block describes the functions of a module or, in a
+  // combined index, of several modules. Every FS_CODE_NAME record defines the
+  // next name id, starting from zero.
+  enum FunctionSummaryCodes {
+    FS_CODE_NAME     = 1,  // NAME: [namechar x N]
+    // ENTRY: [modid, nameid, linkage, instcount, entrycount, numcalls,
+    //         numcalls x (nameid, islocal, callsitecount),
+    //         n x (nameid, islocal)]
+    FS_CODE_ENTRY    = 2
+  };
+
   enum MetadataCodes {
     METADATA_STRING        = 1,   // MDSTRING:      [values]
     METADATA_VALUE         = 2,   // VALUE:         [type num, value num]
@@ -167,6 +187,9 @@ namespace bitc {
     METADATA_EXPRESSION    = 29,  // [distinct, n x element]
     METADATA_OBJC_PROPERTY = 30,  // [distinct, name, file, line, ...]
     METADATA_IMPORTED_ENTITY=31,  // [distinct, tag, scope, entity, line, name]
+    METADATA_INDEX_OFFSET  = 32,  // [offset low 32 bits, offset high 32 bits]
+    METADATA_INDEX         = 33,  // [n x bit position delta]
+    METADATA_STRINGS       = 34,  // [count, offset] blob([lengths][chars])
   };
 
   // The constants block (CONSTANTS_BLOCK_ID) describes emission for each
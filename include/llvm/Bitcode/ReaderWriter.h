@@ -23,6 +23,7 @@
 namespace llvm {
   class BitstreamWriter;
   class DataStreamer;
+  class FunctionInfoIndex;
   class LLVMContext;
   class Module;
   class ModulePass;
@@ -57,6 +58,19 @@ namespace llvm {
   parseBitcodeFile(MemoryBufferRef Buffer, LLVMContext &Context,
                    DiagnosticHandlerFunction DiagnosticHandler = nullptr);
 
+  /// Return true if \p Buffer holds a module with a function summary or a
+  /// combined function index.
+  bool hasFunctionSummary(MemoryBufferRef Buffer,
+                          DiagnosticHandlerFunction DiagnosticHandler = nullptr);
+
+  /// Read the function summaries of the specified bitcode buffer without
+  /// parsing the module itself. For a module this returns its per-module
+  /// index; for a file written by WriteFunctionSummaryToFile, the combined
+  /// index. It is an error for the buffer to contain no summary.
+  ErrorOr<std::unique_ptr<FunctionInfoIndex>>
+  getFunctionInfoIndex(MemoryBufferRef Buffer,
+                       DiagnosticHandlerFunction DiagnosticHandler = nullptr);
+
   /// \brief Write the specified module to the specified raw output stream.
   ///
   /// For streams where it matters, the given stream should be in "binary"
@@ -65,8 +79,17 @@ namespace llvm {
   /// If \c ShouldPreserveUseListOrder, encode the use-list order for each \a
   /// Value in \c M.  These will be reconstructed exactly when \a M is
   /// deserialized.
+  ///
+  /// If \c EmitFunctionSummary, also emit a summary of every function defined
+  /// in \c M for use by summary-based LTO.
   void WriteBitcodeToFile(const Module *M, raw_ostream &Out,
-                          bool ShouldPreserveUseListOrder = false);
+                          bool ShouldPreserveUseListOrder = false,
+                          bool EmitFunctionSummary = false);
+
+  /// \brief Write the specified combined function index to the specified raw
+  /// output stream.
+  void WriteFunctionSummaryToFile(const FunctionInfoIndex &Index,
+                                  raw_ostream &Out);
 
   /// isBitcodeWrapper - Return true if the given bytes are the magic bytes
   /// for an LLVM IR bitcode wrapper.
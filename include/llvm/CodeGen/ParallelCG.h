@@ -0,0 +1,46 @@
+//===-- llvm/CodeGen/ParallelCG.h - Parallel code generation ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This header declares functions that can be used for parallel code generation.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_CODEGEN_PARALLELCG_H
+#define LLVM_CODEGEN_PARALLELCG_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Target/TargetMachine.h"
+#include <string>
+
+namespace llvm {
+
+class Module;
+class TargetOptions;
+class raw_pwrite_stream;
+
+/// Split M into OSs.size() partitions, and generate code for each. Writes
+/// OSs.size() output files to the output streams in OSs. The resulting output
+/// files if linked together are intended to be equivalent to the single output
+/// file that would have been code generated from M.
+///
+/// If OSs.size() is one, M is code generated in place. Otherwise each
+/// partition is serialized to bitcode and code generated on its own thread, in
+/// its own LLVMContext, so that no IR is shared between the threads; M is left
+/// unmodified in that case.
+///
+/// Returns true on success, and false with \p ErrMsg set otherwise.
+bool splitCodeGen(Module &M, ArrayRef<raw_pwrite_stream *> OSs, StringRef CPU,
+                  StringRef Features, const TargetOptions &Options,
+                  Reloc::Model RM, CodeModel::Model CM, CodeGenOpt::Level OL,
+                  TargetMachine::CodeGenFileType FT, std::string &ErrMsg);
+
+} // namespace llvm
+
+#endif
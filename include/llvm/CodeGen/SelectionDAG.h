@@ -22,6 +22,7 @@
 #include "llvm/CodeGen/DAGCombine.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/SelectionDAGNodes.h"
+#include "llvm/Support/ArrayRecycler.h"
 #include "llvm/Support/RecyclingAllocator.h"
 #include "llvm/Target/TargetMachine.h"
 #include <cassert>
@@ -80,6 +81,36 @@ template<> struct FoldingSetTrait<SDVTListNode> : DefaultFoldingSetTrait<SDVTLis
   }
 };
 
+/// Specialize FoldingSetTrait for SDNode to cache the hash of each node's
+/// profile the first time it is computed.  Looking a node up then only
+/// profiles the nodes in its bucket that have the same hash, and growing
+/// the CSE map profiles no node at all.
+///
+/// The cached hash is dropped when the node is removed from the CSE map, which
+/// has to happen before anything that is part of its profile changes.
+template<> struct FoldingSetTrait<SDNode> : DefaultFoldingSetTrait<SDNode> {
+  static bool Equals(SDNode &X, const FoldingSetNodeID &ID, unsigned IDHash,
+                     FoldingSetNodeID &TempID) {
+    if (X.HasCSEHash && X.CSEHash != IDHash)
+      return false;
+    X.Profile(TempID);
+    bool Equal = TempID == ID;
+    if (!X.HasCSEHash) {
+      X.CSEHash = Equal ? IDHash : TempID.ComputeHash();
+      X.HasCSEHash = true;
+    }
+    return Equal;
+  }
+  static unsigned ComputeHash(SDNode &X, FoldingSetNodeID &TempID) {
+    if (!X.HasCSEHash) {
+      X.Profile(TempID);
+      X.CSEHash = TempID.ComputeHash();
+      X.HasCSEHash = true;
+    }
+    return X.CSEHash;
+  }
+};
+
 template<> struct ilist_traits<SDNode> : public ilist_default_traits<SDNode> {
 private:
   mutable ilist_half_node<SDNode> Sentinel;
@@ -206,9 +237,14 @@ class SelectionDAG {
   /// CSE with existing nodes when a duplicate is requested.
   FoldingSet<SDNode> CSEMap;
 
-  /// Pool allocation for machine-opcode SDNode operands.
+  /// Pool allocation for SDNode operands.
   BumpPtrAllocator OperandAllocator;
 
+  /// Recycles the operand lists of nodes that don't keep their operands
+  /// inline, so that they are allocated from OperandAllocator next to each
+  /// other rather than individually from the heap.
+  ArrayRecycler<SDUse> OperandRecycler;
+
   /// Pool allocation for misc. objects that are created once per SelectionDAG.
   BumpPtrAllocator Allocator;
 
@@ -1249,6 +1285,14 @@ private:
   void DeleteNodeNotInCSEMaps(SDNode *N);
   void DeallocateNode(SDNode *N);
 
+  /// Allocate an operand list for Node from the OperandRecycler and
+  /// initialize it with Vals.
+  void createOperands(SDNode *Node, ArrayRef<SDValue> Vals);
+
+  /// Return the operand list of Node to the OperandRecycler, if it came from
+  /// there.
+  void removeOperands(SDNode *Node);
+
   void allnodes_clear();
 
   BinarySDNode *GetBinarySDNode(unsigned Opcode, SDLoc DL, SDVTList VTs,
@@ -0,0 +1,71 @@
+//===-- FileObjectCache.h - On-disk object cache for the JITs ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the FileObjectCache class, an ObjectCache that keeps the
+// objects in a directory, keyed by a hash of the module and of the target
+// configuration. It can be given to MCJIT (ExecutionEngine::setObjectCache) or
+// to an Orc IRCompileLayer (IRCompileLayer::setObjectCache), and lets a JIT
+// reuse the code compiled by an earlier run for the same IR.
+//
+// The directory may be shared by several processes: entries are written to a
+// temporary file and renamed into place, so a reader never sees a partial
+// entry. Two processes missing on the same module at once both compile it,
+// and the last one to finish wins. The entries are named like the ones of
+// LTOObjectCache, so CachePruning can be used to bound the directory.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+#define LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include <mutex>
+#include <string>
+
+namespace llvm {
+
+class TargetMachine;
+
+class FileObjectCache : public ObjectCache {
+public:
+  /// Cache the objects compiled by \p TM in the directory \p CacheDir, which
+  /// is created if needed. The target triple, CPU, features, optimization
+  /// level, relocation and code models of \p TM are part of the keys.
+  FileObjectCache(StringRef CacheDir, const TargetMachine &TM);
+
+  /// Cache the objects in \p CacheDir, with \p Config describing everything
+  /// besides the module that affects the objects.
+  FileObjectCache(StringRef CacheDir, StringRef Config);
+
+  ~FileObjectCache() override;
+
+  /// Compute the key of the object compiled from \p M in the configuration
+  /// \p Config.
+  static std::string computeKey(const Module &M, StringRef Config);
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override;
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+private:
+  SmallString<128> getEntryPath(StringRef Key) const;
+
+  SmallString<128> CacheDir;
+  std::string Config;
+
+  /// The code generator changes the IR it compiles, so the key of a module is
+  /// computed when it is looked up and kept until its object is stored.
+  std::mutex PendingKeysMutex;
+  DenseMap<const Module *, std::string> PendingKeys;
+};
+
+} // End llvm namespace
+
+#endif
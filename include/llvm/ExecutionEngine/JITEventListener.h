@@ -19,13 +19,16 @@
 #include "llvm/Config/llvm-config.h"
 #include "llvm/IR/DebugLoc.h"
 #include "llvm/Support/DataTypes.h"
+#include <string>
 #include <vector>
 
 namespace llvm {
 class Function;
 class MachineFunction;
+class Module;
 class OProfileWrapper;
 class IntelJITEventsWrapper;
+class raw_ostream;
 
 namespace object {
   class ObjectFile;
@@ -50,6 +53,60 @@ struct JITEvent_EmittedFunctionDetails {
   std::vector<LineStart> LineStarts;
 };
 
+/// JITEvent_FunctionCompileStats - The time code generation spent on one
+/// function in each of its phases, and the size of the code emitted for it.
+/// Times are wall clock seconds.
+struct JITEvent_FunctionCompileStats {
+  JITEvent_FunctionCompileStats()
+      : IRTime(0), ISelTime(0), RegAllocTime(0), PostRATime(0),
+        EmissionTime(0), CodeSize(0) {}
+
+  /// The symbol name of the function.
+  std::string Name;
+
+  /// Time in the IR passes of the code generator, such as CodeGenPrepare.
+  double IRTime;
+
+  /// Time in instruction selection and the machine SSA optimizations.
+  double ISelTime;
+
+  /// Time from PHI elimination up to and including register allocation.
+  double RegAllocTime;
+
+  /// Time in the machine passes that run after register allocation.
+  double PostRATime;
+
+  /// Time spent encoding the function's instructions into the object.
+  double EmissionTime;
+
+  /// The size in bytes of the function's code in the loaded object,
+  /// including any padding up to the next symbol of its section.
+  uint64_t CodeSize;
+};
+
+/// JITEvent_ModuleCompileStats - The compile statistics of one module.
+struct JITEvent_ModuleCompileStats {
+  JITEvent_ModuleCompileStats()
+      : FromObjectCache(false), ObjectWriteTime(0), LoadTime(0) {}
+
+  /// The module identifier.
+  std::string ModuleName;
+
+  /// True if the object was taken from an ObjectCache rather than compiled,
+  /// in which case all the code generation times are zero.
+  bool FromObjectCache;
+
+  /// Time spent laying out and writing the object file once all of its
+  /// functions had been emitted.
+  double ObjectWriteTime;
+
+  /// Time RuntimeDyld spent loading the object into memory.
+  double LoadTime;
+
+  /// The functions defined by the module, in the order they were compiled.
+  std::vector<JITEvent_FunctionCompileStats> Functions;
+};
+
 /// JITEventListener - Abstract interface for use by the JIT to notify clients
 /// about significant events during compilation. For example, to notify
 /// profilers and debuggers that need to know where functions have been emitted.
@@ -58,6 +115,14 @@ struct JITEvent_EmittedFunctionDetails {
 class JITEventListener {
 public:
   typedef JITEvent_EmittedFunctionDetails EmittedFunctionDetails;
+  typedef JITEvent_FunctionCompileStats FunctionCompileStats;
+  typedef JITEvent_ModuleCompileStats ModuleCompileStats;
+
+  /// The formats the compile statistics listener can write.
+  enum CompileStatsFormat {
+    CSF_JSON,
+    CSF_CSV
+  };
 
 public:
   JITEventListener() {}
@@ -78,6 +143,22 @@ public:
   /// a previously emitted object is released.
   virtual void NotifyFreeingObject(const object::ObjectFile &Obj) {}
 
+  /// wantsCompileStats - Return true if NotifyModuleCompiled should be
+  /// called for this listener.  The JIT only times code generation while a
+  /// registered listener asks for it.
+  virtual bool wantsCompileStats() const { return false; }
+
+  /// NotifyModuleCompiled - Called after a module has been compiled and its
+  /// object loaded, before NotifyObjectEmitted is called for that object.
+  virtual void NotifyModuleCompiled(const Module &M,
+                                    const ModuleCompileStats &Stats) {}
+
+  // Construct a listener that writes the compile statistics of every module
+  // to OS, either as one JSON object per line or as CSV rows.  The stream is
+  // not owned by the listener and must outlive it.
+  static JITEventListener *createCompileStatsListener(raw_ostream &OS,
+                                                      CompileStatsFormat Format);
+
   // Get a pointe to the GDB debugger registration listener.
   static JITEventListener *createGDBRegistrationListener();
 
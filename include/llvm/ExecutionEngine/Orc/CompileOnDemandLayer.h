@@ -20,8 +20,14 @@
 #include "LogicalDylib.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+#include <atomic>
 #include <list>
+#include <map>
+#include <mutex>
 #include <set>
 
 #include "llvm/Support/Debug.h"
@@ -36,6 +42,18 @@ namespace orc {
 /// added to the layer below. When a stub is called it triggers the extraction
 /// of the function body from the original module. The extracted body is then
 /// compiled and executed.
+///
+///   In background compile mode, each time a function is compiled its direct
+/// callees are compiled speculatively on a background thread, hottest first
+/// according to their entry counts, and their stubs are repointed as soon as
+/// their code is ready. A call through a stub only blocks if it arrives before
+/// the background thread is done.
+///
+///   The layer can be used from several threads at once, provided the layers
+/// below can. As an LLVMContext cannot be used by two threads at the same
+/// time, the work on the source modules and on the partitions extracted from
+/// them, compilation included, is serialized per context. The modules of
+/// different contexts are compiled concurrently.
 template <typename BaseLayerT, typename CompileCallbackMgrT,
           typename PartitioningFtor =
             std::function<std::set<Function*>(Function&)>>
@@ -79,6 +97,7 @@ private:
   struct LogicalModuleResources {
     std::shared_ptr<Module> SourceModule;
     std::set<const Function*> StubsToClone;
+    std::map<const Function*, TargetAddress> CompiledAddrs;
   };
 
   struct LogicalDylibResources {
@@ -86,6 +105,10 @@ private:
       SymbolResolverFtor;
     SymbolResolverFtor ExternalSymbolResolver;
     PartitioningFtor Partitioner;
+    // The context of the source modules, and the lock serializing the work
+    // done in it.
+    LLVMContext *Context;
+    std::shared_ptr<std::recursive_mutex> ContextMutex;
   };
 
   typedef LogicalDylib<BaseLayerT, LogicalModuleResources,
@@ -99,10 +122,23 @@ public:
   typedef typename LogicalDylibList::iterator ModuleSetHandleT;
 
   /// @brief Construct a compile-on-demand layer instance.
+  /// @param CompileInBackground If true, speculatively compile the callees of
+  ///        each compiled function on a background thread.
   CompileOnDemandLayer(BaseLayerT &BaseLayer, CompileCallbackMgrT &CallbackMgr,
-                       bool CloneStubsIntoPartitions)
+                       bool CloneStubsIntoPartitions,
+                       bool CompileInBackground = false)
       : BaseLayer(BaseLayer), CompileCallbackMgr(CallbackMgr),
-        CloneStubsIntoPartitions(CloneStubsIntoPartitions) {}
+        CloneStubsIntoPartitions(CloneStubsIntoPartitions),
+        StopBackgroundCompiles(false) {
+    if (CompileInBackground)
+      BackgroundCompiles = llvm::make_unique<ThreadPool>(1);
+  }
+
+  ~CompileOnDemandLayer() {
+    // Drop the background compiles that have not started yet. The one in
+    // flight, if any, is waited for when the pool is destroyed.
+    StopBackgroundCompiles = true;
+  }
 
   /// @brief Add a module to the compile-on-demand layer.
   template <typename ModuleSetT, typename MemoryManagerPtrT,
@@ -114,8 +150,12 @@ public:
     assert(MemMgr == nullptr &&
            "User supplied memory managers not supported with COD yet.");
 
-    LogicalDylibs.push_back(CODLogicalDylib(BaseLayer));
-    auto &LDResources = LogicalDylibs.back().getDylibResources();
+    // Build the logical dylib on the side, and only make it visible once it
+    // is complete. Splicing it in does not move it.
+    LogicalDylibList NewLogicalDylibs;
+    NewLogicalDylibs.push_back(CODLogicalDylib(BaseLayer));
+    auto &LD = NewLogicalDylibs.back();
+    auto &LDResources = LD.getDylibResources();
 
     LDResources.ExternalSymbolResolver =
       [Resolver](const std::string &Name) {
@@ -129,12 +169,26 @@ public:
         return Partition;
       };
 
+    LDResources.Context = nullptr;
+    std::unique_lock<std::recursive_mutex> ContextLock;
+    if (!Ms.empty()) {
+      LDResources.Context = &(*Ms.begin())->getContext();
+      LDResources.ContextMutex = getContextMutex(*LDResources.Context);
+      ContextLock =
+        std::unique_lock<std::recursive_mutex>(*LDResources.ContextMutex);
+    }
+
     // Process each of the modules in this module set.
-    for (auto &M : Ms)
-      addLogicalModule(LogicalDylibs.back(),
-                       std::shared_ptr<Module>(std::move(M)));
+    for (auto &M : Ms) {
+      assert(&M->getContext() == LDResources.Context &&
+             "All the modules of a set must share a context.");
+      addLogicalModule(LD, std::shared_ptr<Module>(std::move(M)));
+    }
 
-    return std::prev(LogicalDylibs.end());
+    std::lock_guard<std::mutex> Lock(LogicalDylibsMutex);
+    auto H = NewLogicalDylibs.begin();
+    LogicalDylibs.splice(LogicalDylibs.end(), NewLogicalDylibs);
+    return H;
   }
 
   /// @brief Remove the module represented by the given handle.
@@ -142,7 +196,26 @@ public:
   ///   This will remove all modules in the layers below that were derived from
   /// the module represented by H.
   void removeModuleSet(ModuleSetHandleT H) {
-    LogicalDylibs.erase(H);
+    // The background compiles may refer to H: cancel the ones that have not
+    // started yet and wait for the others.
+    if (BackgroundCompiles) {
+      StopBackgroundCompiles = true;
+      BackgroundCompiles->wait();
+      StopBackgroundCompiles = false;
+    }
+
+    // Freeing the source modules uses their context.
+    LLVMContext *Context = H->getDylibResources().Context;
+    auto ContextMutex = H->getDylibResources().ContextMutex;
+    {
+      std::unique_lock<std::recursive_mutex> ContextLock;
+      if (ContextMutex)
+        ContextLock = std::unique_lock<std::recursive_mutex>(*ContextMutex);
+      std::lock_guard<std::mutex> Lock(LogicalDylibsMutex);
+      LogicalDylibs.erase(H);
+    }
+    if (ContextMutex)
+      releaseContextMutex(*Context, std::move(ContextMutex));
   }
 
   /// @brief Search for the given named symbol.
@@ -162,6 +235,23 @@ public:
 
 private:
 
+  std::shared_ptr<std::recursive_mutex> getContextMutex(LLVMContext &Context) {
+    std::lock_guard<std::mutex> Lock(ContextMutexesMutex);
+    auto &ContextMutex = ContextMutexes[&Context];
+    if (!ContextMutex)
+      ContextMutex = std::make_shared<std::recursive_mutex>();
+    return ContextMutex;
+  }
+
+  // Forget the lock of Context once no logical dylib uses it.
+  void releaseContextMutex(LLVMContext &Context,
+                           std::shared_ptr<std::recursive_mutex> ContextMutex) {
+    std::lock_guard<std::mutex> Lock(ContextMutexesMutex);
+    // One reference from the map, one from the argument.
+    if (ContextMutex.use_count() == 2)
+      ContextMutexes.erase(&Context);
+  }
+
   void addLogicalModule(CODLogicalDylib &LD, std::shared_ptr<Module> SrcM) {
 
     // Bump the linkage and rename any anonymous/privote members in SrcM to
@@ -250,19 +340,65 @@ private:
     return MangledName;
   }
 
+  // Return the functions to compile in the background once the functions in
+  // Partition are: their direct callees in the same module, hottest first.
+  // Functions that the profile says are never called are left alone.
+  template <typename PartitionT>
+  static std::vector<Function*>
+  getSpeculationCandidates(const PartitionT &Partition) {
+    std::vector<Function*> Callees;
+    std::set<Function*> Seen(Partition.begin(), Partition.end());
+    for (auto *F : Partition)
+      for (auto &BB : *F)
+        for (auto &I : BB) {
+          CallSite CS(&I);
+          if (!CS)
+            continue;
+          Function *Callee = CS.getCalledFunction();
+          if (!Callee || Callee->isDeclaration() ||
+              Callee->getParent() != F->getParent())
+            continue;
+          auto EntryCount = Callee->getEntryCount();
+          if ((EntryCount && *EntryCount == 0) || !Seen.insert(Callee).second)
+            continue;
+          Callees.push_back(Callee);
+        }
+    std::stable_sort(Callees.begin(), Callees.end(),
+                     [](Function *LHS, Function *RHS) {
+                       auto LHSCount = LHS->getEntryCount();
+                       auto RHSCount = RHS->getEntryCount();
+                       return (LHSCount ? *LHSCount : 0) >
+                              (RHSCount ? *RHSCount : 0);
+                     });
+    return Callees;
+  }
+
   TargetAddress extractAndCompile(CODLogicalDylib &LD,
                                   LogicalModuleHandle LMH,
                                   Function &F) {
-    Module &SrcM = *LD.getLogicalModuleResources(LMH).SourceModule;
+    std::lock_guard<std::recursive_mutex> Lock(
+        *LD.getDylibResources().ContextMutex);
+    auto &LMResources = LD.getLogicalModuleResources(LMH);
+    Module &SrcM = *LMResources.SourceModule;
 
-    // If F is a declaration we must already have compiled it.
-    if (F.isDeclaration())
-      return 0;
+    // If F is a declaration we must already have compiled it, possibly in the
+    // background or as part of another partition.
+    if (F.isDeclaration()) {
+      auto I = LMResources.CompiledAddrs.find(&F);
+      return I != LMResources.CompiledAddrs.end() ? I->second : 0;
+    }
 
     // Grab the name of the function being called here.
     std::string CalledFnName = Mangle(F.getName(), SrcM.getDataLayout());
 
     auto Partition = LD.getDylibResources().Partitioner(F);
+
+    // Pick the functions to compile ahead of time while their callers' bodies
+    // are still in the source module.
+    std::vector<Function*> Speculated;
+    if (BackgroundCompiles)
+      Speculated = getSpeculationCandidates(Partition);
+
     auto PartitionH = emitPartition(LD, LMH, Partition);
 
     TargetAddress CalledAddr = 0;
@@ -287,10 +423,23 @@ private:
       // return it from this function.
       if (SubF == &F)
         CalledAddr = FnBodyAddr;
+      LMResources.CompiledAddrs[SubF] = FnBodyAddr;
 
-      memcpy(FnPtrAddr, &FnBodyAddr, sizeof(uintptr_t));
+      // Repoint the stub. In background compile mode it may be in use on
+      // another thread, so the new address has to be stored in one go.
+      reinterpret_cast<std::atomic<uintptr_t>*>(FnPtrAddr)->store(
+          static_cast<uintptr_t>(FnBodyAddr));
     }
 
+    if (!Speculated.empty())
+      BackgroundCompiles->async([this, &LD, LMH, Speculated]() {
+        for (auto *Callee : Speculated) {
+          if (StopBackgroundCompiles)
+            return;
+          this->extractAndCompile(LD, LMH, *Callee);
+        }
+      });
+
     return CalledAddr;
   }
 
@@ -344,8 +493,18 @@ private:
 
   BaseLayerT &BaseLayer;
   CompileCallbackMgrT &CompileCallbackMgr;
+  std::mutex LogicalDylibsMutex;
   LogicalDylibList LogicalDylibs;
   bool CloneStubsIntoPartitions;
+
+  // The locks serializing the work done in each context by this layer. They
+  // are recursive so that the symbol resolvers can call back into the layer.
+  std::mutex ContextMutexesMutex;
+  std::map<LLVMContext*, std::shared_ptr<std::recursive_mutex>> ContextMutexes;
+  std::atomic<bool> StopBackgroundCompiles;
+  // Declared last so that it is destroyed, waiting for the compile in flight,
+  // before anything that compile uses.
+  std::unique_ptr<ThreadPool> BackgroundCompiles;
 };
 
 } // End namespace orc.
@@ -19,6 +19,8 @@
 #include "llvm/MC/MCContext.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Target/TargetMachine.h"
+#include <functional>
+#include <mutex>
 
 namespace llvm {
 namespace orc {
@@ -56,6 +58,67 @@ private:
   TargetMachine &TM;
 };
 
+/// @brief Compile functor that can be called from several threads at once.
+///
+///   A TargetMachine caches state as it compiles, so it cannot be used by two
+/// threads at the same time. This functor compiles each module with a
+/// TargetMachine of its own, created by the given builder the first time it
+/// is needed and reused afterwards: there are never more TargetMachines than
+/// compiles running at once. The builder may be called on several threads at
+/// once. Copies of the functor share their TargetMachines.
+///
+///   The modules compiled at the same time must belong to different contexts.
+class ConcurrentIRCompiler {
+public:
+  typedef std::function<std::unique_ptr<TargetMachine>()> TargetMachineBuilder;
+
+  /// @brief Construct a concurrent compile functor creating its target
+  ///        machines with the given builder.
+  ConcurrentIRCompiler(TargetMachineBuilder BuildTM)
+      : TMs(std::make_shared<TargetMachinePool>(std::move(BuildTM))) {}
+
+  /// @brief Compile a Module to an ObjectFile.
+  object::OwningBinary<object::ObjectFile> operator()(Module &M) const {
+    std::unique_ptr<TargetMachine> TM = TMs->take();
+    auto Obj = SimpleCompiler(*TM)(M);
+    TMs->giveBack(std::move(TM));
+    return Obj;
+  }
+
+private:
+  class TargetMachinePool {
+  public:
+    TargetMachinePool(TargetMachineBuilder BuildTM)
+        : BuildTM(std::move(BuildTM)) {}
+
+    std::unique_ptr<TargetMachine> take() {
+      {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        if (!Idle.empty()) {
+          std::unique_ptr<TargetMachine> TM = std::move(Idle.back());
+          Idle.pop_back();
+          return TM;
+        }
+      }
+      std::unique_ptr<TargetMachine> TM = BuildTM();
+      assert(TM && "Could not create a TargetMachine.");
+      return TM;
+    }
+
+    void giveBack(std::unique_ptr<TargetMachine> TM) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      Idle.push_back(std::move(TM));
+    }
+
+  private:
+    TargetMachineBuilder BuildTM;
+    std::mutex Mutex;
+    std::vector<std::unique_ptr<TargetMachine>> Idle;
+  };
+
+  std::shared_ptr<TargetMachinePool> TMs;
+};
+
 } // End namespace orc.
 } // End namespace llvm.
 
@@ -22,6 +22,10 @@
 #include "llvm/IR/Mangler.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
 
 namespace llvm {
@@ -29,6 +33,12 @@ namespace orc {
 
 /// @brief Base class for JITLayer independent aspects of
 ///        JITCompileCallbackManager.
+///
+///   Callbacks can be reserved and executed from several threads at once. A
+/// callback's compile action is run only once, outside of any lock of the
+/// manager: threads calling through its trampoline while it runs wait for its
+/// result. The trampoline then keeps returning that result, as some threads
+/// may still reach it through a stand-in that was read before it was updated.
 class JITCompileCallbackManagerBase {
 public:
 
@@ -67,6 +77,16 @@ public:
   /// @brief Execute the callback for the given trampoline id. Called by the JIT
   ///        to compile functions on demand.
   TargetAddress executeCompileCallback(TargetAddress TrampolineAddr) {
+    std::unique_lock<std::mutex> Lock(TrampolinesMutex);
+
+    // If another thread is running this callback, wait for its result.
+    while (RunningTrampolines.count(TrampolineAddr))
+      TrampolineDone.wait(Lock);
+
+    auto CI = CompiledTrampolines.find(TrampolineAddr);
+    if (CI != CompiledTrampolines.end())
+      return CI->second;
+
     auto I = ActiveTrampolines.find(TrampolineAddr);
     // FIXME: Also raise an error in the Orc error-handler when we finally have
     //        one.
@@ -74,19 +94,22 @@ public:
       return ErrorHandlerAddress;
 
     // Found a callback handler. Yank this trampoline out of the active list and
-    // put it back in the available trampolines list, then try to run the
-    // handler's compile and update actions.
-    // Moving the trampoline ID back to the available list first means there's at
-    // least one available trampoline if the compile action triggers a request for
-    // a new one.
+    // run the handler's compile and update actions without holding the lock,
+    // so that other callbacks can run meanwhile.
     auto Compile = std::move(I->second);
     ActiveTrampolines.erase(I);
-    AvailableTrampolines.push_back(TrampolineAddr);
-
-    if (auto Addr = Compile())
-      return Addr;
-
-    return ErrorHandlerAddress;
+    RunningTrampolines.insert(TrampolineAddr);
+    Lock.unlock();
+
+    TargetAddress Addr = Compile();
+    if (!Addr)
+      Addr = ErrorHandlerAddress;
+
+    Lock.lock();
+    RunningTrampolines.erase(TrampolineAddr);
+    CompiledTrampolines[TrampolineAddr] = Addr;
+    TrampolineDone.notify_all();
+    return Addr;
   }
 
   /// @brief Reserve a compile callback.
@@ -94,6 +117,7 @@ public:
 
   /// @brief Get a CompileCallbackInfo for an existing callback.
   CompileCallbackInfo getCompileCallbackInfo(TargetAddress TrampolineAddr) {
+    std::lock_guard<std::mutex> Lock(TrampolinesMutex);
     auto I = ActiveTrampolines.find(TrampolineAddr);
     assert(I != ActiveTrampolines.end() && "Not an active trampoline.");
     return CompileCallbackInfo(I->first, I->second);
@@ -101,10 +125,11 @@ public:
 
   /// @brief Release a compile callback.
   ///
-  ///   Note: Callbacks are auto-released after they execute. This method should
-  /// only be called to manually release a callback that is not going to
-  /// execute.
+  ///   Note: This method should only be called to release a callback that is
+  /// not going to execute. The trampolines of the callbacks that have executed
+  /// are never reused.
   void releaseCompileCallback(TargetAddress TrampolineAddr) {
+    std::lock_guard<std::mutex> Lock(TrampolinesMutex);
     auto I = ActiveTrampolines.find(TrampolineAddr);
     assert(I != ActiveTrampolines.end() && "Not an active trampoline.");
     ActiveTrampolines.erase(I);
@@ -115,9 +140,16 @@ protected:
   TargetAddress ErrorHandlerAddress;
   unsigned NumTrampolinesPerBlock;
 
+  // Guards the trampoline lists below.
+  std::mutex TrampolinesMutex;
   typedef std::map<TargetAddress, CompileFtor> TrampolineMapT;
   TrampolineMapT ActiveTrampolines;
   std::vector<TargetAddress> AvailableTrampolines;
+
+private:
+  std::set<TargetAddress> RunningTrampolines;
+  std::map<TargetAddress, TargetAddress> CompiledTrampolines;
+  std::condition_variable TrampolineDone;
 };
 
 /// @brief Manage compile callbacks.
@@ -146,6 +178,7 @@ public:
 
   /// @brief Get/create a compile callback with the given signature.
   CompileCallbackInfo getCompileCallback(LLVMContext &Context) final {
+    std::lock_guard<std::mutex> Lock(this->TrampolinesMutex);
     TargetAddress TrampolineAddr = getAvailableTrampolineAddr(Context);
     auto &Compile = this->ActiveTrampolines[TrampolineAddr];
     return CompileCallbackInfo(TrampolineAddr, Compile);
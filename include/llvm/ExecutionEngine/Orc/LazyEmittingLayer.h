@@ -21,7 +21,10 @@
 #include "llvm/IR/Module.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/ThreadLocal.h"
+#include <condition_variable>
 #include <list>
+#include <mutex>
 
 namespace llvm {
 namespace orc {
@@ -32,6 +35,12 @@ namespace orc {
 /// not immediately emit them the layer below. Instead, emissing to the base
 /// layer is deferred until the first time the client requests the address
 /// (via JITSymbol::getAddress) for a symbol contained in this layer.
+///
+///   The layer can be used from several threads at once. Each module set is
+/// emitted only once, without holding any lock: the other threads needing it
+/// meanwhile wait for it to be done. Lookups made while emitting a module set
+/// (e.g. for common symbols) never wait for another thread, as it could be
+/// waiting for this one; they do not see the sets emitted elsewhere.
 template <typename BaseLayerT> class LazyEmittingLayer {
 public:
   typedef typename BaseLayerT::ModuleSetHandleT BaseLayerHandleT;
@@ -42,7 +51,16 @@ private:
     EmissionDeferredSet() : EmitState(NotEmitted) {}
     virtual ~EmissionDeferredSet() {}
 
-    JITSymbol find(StringRef Name, bool ExportedSymbolsOnly, BaseLayerT &B) {
+    JITSymbol find(StringRef Name, bool ExportedSymbolsOnly,
+                   LazyEmittingLayer &L) {
+      std::unique_lock<std::mutex> Lock(EmitMutex);
+      if (!waitForEmission(Lock, L))
+        // Calling "emit" can trigger external symbol lookup (e.g. to check for
+        // pre-existing definitions of common-symbol), but it will never find
+        // in this module that it would not have found already, so return null
+        // from here.
+        return nullptr;
+      BaseLayerT &B = L.BaseLayer;
       switch (EmitState) {
       case NotEmitted:
         if (auto GV = searchGVs(Name, ExportedSymbolsOnly)) {
@@ -52,26 +70,18 @@ private:
           std::string PName = Name;
           JITSymbolFlags Flags = JITSymbolBase::flagsFromGlobalValue(*GV);
           auto GetAddress =
-            [this, ExportedSymbolsOnly, PName, &B]() -> TargetAddress {
-              if (this->EmitState == Emitting)
+            [this, ExportedSymbolsOnly, PName, &L]() -> TargetAddress {
+              if (!this->emitOnce(L))
                 return 0;
-              else if (this->EmitState == NotEmitted) {
-                this->EmitState = Emitting;
-                Handle = this->emitToBaseLayer(B);
-                this->EmitState = Emitted;
-              }
-              auto Sym = B.findSymbolIn(Handle, PName, ExportedSymbolsOnly);
+              auto Sym = L.BaseLayer.findSymbolIn(Handle, PName,
+                                                  ExportedSymbolsOnly);
               return Sym.getAddress();
           };
           return JITSymbol(std::move(GetAddress), Flags);
         } else
           return nullptr;
       case Emitting:
-        // Calling "emit" can trigger external symbol lookup (e.g. to check for
-        // pre-existing definitions of common-symbol), but it will never find in
-        // this module that it would not have found already, so return null from
-        // here.
-        return nullptr;
+        break;
       case Emitted:
         return B.findSymbolIn(Handle, Name, ExportedSymbolsOnly);
       }
@@ -79,19 +89,16 @@ private:
     }
 
     void removeModulesFromBaseLayer(BaseLayerT &BaseLayer) {
-      if (EmitState != NotEmitted)
+      std::lock_guard<std::mutex> Lock(EmitMutex);
+      if (EmitState == Emitted)
         BaseLayer.removeModuleSet(Handle);
     }
 
-    void emitAndFinalize(BaseLayerT &BaseLayer) {
-      assert(EmitState != Emitting &&
-             "Cannot emitAndFinalize while already emitting");
-      if (EmitState == NotEmitted) {
-        EmitState = Emitting;
-        Handle = emitToBaseLayer(BaseLayer);
-        EmitState = Emitted;
-      }
-      BaseLayer.emitAndFinalize(Handle);
+    void emitAndFinalize(LazyEmittingLayer &L) {
+      bool Emitted = emitOnce(L);
+      (void)Emitted;
+      assert(Emitted && "Cannot emitAndFinalize while already emitting");
+      L.BaseLayer.emitAndFinalize(Handle);
     }
 
     template <typename ModuleSetT, typename MemoryManagerPtrT,
@@ -106,6 +113,44 @@ private:
     virtual BaseLayerHandleT emitToBaseLayer(BaseLayerT &BaseLayer) = 0;
 
   private:
+    // Wait for the set to be emitted if another thread is emitting it. Returns
+    // false if the emission cannot be waited for, because this thread is
+    // emitting this set or another one.
+    bool waitForEmission(std::unique_lock<std::mutex> &Lock,
+                         LazyEmittingLayer &L) {
+      while (EmitState == Emitting) {
+        if (L.EmittingSet.get())
+          return false;
+        EmitDone.wait(Lock);
+      }
+      return true;
+    }
+
+    // Emit the set to the base layer unless that is already done. Returns
+    // false if the set could not be emitted in time for this thread.
+    bool emitOnce(LazyEmittingLayer &L) {
+      std::unique_lock<std::mutex> Lock(EmitMutex);
+      if (!waitForEmission(Lock, L))
+        return false;
+      if (EmitState == NotEmitted) {
+        EmitState = Emitting;
+        Lock.unlock();
+        EmissionDeferredSet *Outer = L.EmittingSet.get();
+        L.EmittingSet.set(this);
+        BaseLayerHandleT H = emitToBaseLayer(L.BaseLayer);
+        L.EmittingSet.set(Outer);
+        Lock.lock();
+        Handle = H;
+        EmitState = Emitted;
+        EmitDone.notify_all();
+      }
+      return true;
+    }
+
+    // Guards the state below, and the source modules while they are searched.
+    // It is not held while emitting.
+    std::mutex EmitMutex;
+    std::condition_variable EmitDone;
     enum { NotEmitted, Emitting, Emitted } EmitState;
     BaseLayerHandleT Handle;
   };
@@ -216,10 +261,15 @@ private:
     mutable std::unique_ptr<StringMap<const GlobalValue*>> MangledSymbols;
   };
 
-  typedef std::list<std::unique_ptr<EmissionDeferredSet>> ModuleSetListT;
+  // The sets are shared with the lookups in flight, which search them without
+  // holding the list lock.
+  typedef std::list<std::shared_ptr<EmissionDeferredSet>> ModuleSetListT;
 
   BaseLayerT &BaseLayer;
+  std::mutex ModuleSetListMutex;
   ModuleSetListT ModuleSetList;
+  // The set being emitted by each thread, if any.
+  sys::ThreadLocal<EmissionDeferredSet> EmittingSet;
 
 public:
   /// @brief Handle to a set of loaded modules.
@@ -234,10 +284,11 @@ public:
   ModuleSetHandleT addModuleSet(ModuleSetT Ms,
                                 MemoryManagerPtrT MemMgr,
                                 SymbolResolverPtrT Resolver) {
-    return ModuleSetList.insert(
-        ModuleSetList.end(),
-        EmissionDeferredSet::create(BaseLayer, std::move(Ms), std::move(MemMgr),
-                                    std::move(Resolver)));
+    auto EDS = EmissionDeferredSet::create(BaseLayer, std::move(Ms),
+                                           std::move(MemMgr),
+                                           std::move(Resolver));
+    std::lock_guard<std::mutex> Lock(ModuleSetListMutex);
+    return ModuleSetList.insert(ModuleSetList.end(), std::move(EDS));
   }
 
   /// @brief Remove the module set represented by the given handle.
@@ -246,6 +297,7 @@ public:
   /// both in this layer, and the base layer.
   void removeModuleSet(ModuleSetHandleT H) {
     (*H)->removeModulesFromBaseLayer(BaseLayer);
+    std::lock_guard<std::mutex> Lock(ModuleSetListMutex);
     ModuleSetList.erase(H);
   }
 
@@ -261,8 +313,15 @@ public:
     // If not found then search the deferred sets. If any of these contain a
     // definition of 'Name' then they will return a JITSymbol that will emit
     // the corresponding module when the symbol address is requested.
-    for (auto &DeferredSet : ModuleSetList)
-      if (auto Symbol = DeferredSet->find(Name, ExportedSymbolsOnly, BaseLayer))
+    // The list lock is not held during the search, as the emission of a set on
+    // another thread can involve a lookup.
+    std::vector<std::shared_ptr<EmissionDeferredSet>> DeferredSets;
+    {
+      std::lock_guard<std::mutex> Lock(ModuleSetListMutex);
+      DeferredSets.assign(ModuleSetList.begin(), ModuleSetList.end());
+    }
+    for (auto &DeferredSet : DeferredSets)
+      if (auto Symbol = DeferredSet->find(Name, ExportedSymbolsOnly, *this))
         return Symbol;
 
     // If no definition found anywhere return a null symbol.
@@ -273,14 +332,14 @@ public:
   ///        compiled modules represented by the handle H.
   JITSymbol findSymbolIn(ModuleSetHandleT H, const std::string &Name,
                          bool ExportedSymbolsOnly) {
-    return (*H)->find(Name, ExportedSymbolsOnly, BaseLayer);
+    return (*H)->find(Name, ExportedSymbolsOnly, *this);
   }
 
   /// @brief Immediately emit and finalize the moduleOB set represented by the
   ///        given handle.
   /// @param H Handle for module set to emit/finalize.
   void emitAndFinalize(ModuleSetHandleT H) {
-    (*H)->emitAndFinalize(BaseLayer);
+    (*H)->emitAndFinalize(*this);
   }
 
 };
@@ -14,6 +14,9 @@
 #ifndef LLVM_EXECUTIONENGINE_ORC_LOGICALDYLIB_H
 #define LLVM_EXECUTIONENGINE_ORC_LOGICALDYLIB_H
 
+#include <list>
+#include <vector>
+
 namespace llvm {
 namespace orc {
 
@@ -31,7 +34,9 @@ private:
     LogicalModuleResources Resources;
     BaseLayerHandleList BaseLayerHandles;
   };
-  typedef std::vector<LogicalModule> LogicalModuleList;
+  // A list, so that the handles of the logical modules stay valid as more
+  // are created.
+  typedef std::list<LogicalModule> LogicalModuleList;
 
 public:
 
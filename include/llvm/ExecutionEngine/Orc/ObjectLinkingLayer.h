@@ -18,8 +18,11 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/ThreadLocal.h"
+#include <atomic>
 #include <list>
 #include <memory>
+#include <mutex>
 
 namespace llvm {
 namespace orc {
@@ -45,6 +48,10 @@ protected:
 
     virtual ~LinkedObjectSet() {}
 
+    void setLazySymbolTables(bool LazySymbolTables) {
+      RTDyld->setLazySymbolTables(LazySymbolTables);
+    }
+
     std::unique_ptr<RuntimeDyld::LoadedObjectInfo>
     addObject(const object::ObjectFile &Obj) {
       return RTDyld->loadObject(Obj);
@@ -54,7 +61,18 @@ protected:
       return RTDyld->getSymbol(Name);
     }
 
-    bool NeedsFinalization() const { return (State == Raw); }
+    bool NeedsFinalization() const { return (State != Finalized); }
+
+    /// @brief Finalize this set unless it is already finalized. If another
+    ///        thread is finalizing it, wait for it to be done.
+    /// @return true if this call finalized the set.
+    bool FinalizeOnce() {
+      std::lock_guard<std::mutex> Lock(FinalizeMutex);
+      if (State != Raw)
+        return false;
+      Finalize();
+      return true;
+    }
 
     virtual void Finalize() = 0;
 
@@ -65,16 +83,31 @@ protected:
     }
 
     void takeOwnershipOfBuffer(std::unique_ptr<MemoryBuffer> B) {
-      OwnedBuffers.push_back(std::move(B));
+      std::lock_guard<std::mutex> Lock(OwnedBuffersMutex);
+      // Another thread may have finalized the set already.
+      if (State != Finalized)
+        OwnedBuffers.push_back(std::move(B));
     }
 
   protected:
+    void releaseOwnedBuffers() {
+      std::lock_guard<std::mutex> Lock(OwnedBuffersMutex);
+      OwnedBuffers.clear();
+    }
+
     std::unique_ptr<RuntimeDyld> RTDyld;
-    enum { Raw, Finalizing, Finalized } State;
+    enum StateT { Raw, Finalizing, Finalized };
+    // Only changed with FinalizeMutex held, but read without it.
+    std::atomic<StateT> State;
+
+  private:
+    // Held while the set is finalized.
+    std::mutex FinalizeMutex;
 
     // FIXME: This ownership hack only exists because RuntimeDyldELF still
     //        wants to be able to inspect the original object when resolving
     //        relocations. As soon as that can be fixed this should be removed.
+    std::mutex OwnedBuffersMutex;
     std::vector<std::unique_ptr<MemoryBuffer>> OwnedBuffers;
   };
 
@@ -109,6 +142,13 @@ public:
 /// object files to be loaded into memory, linked, and the addresses of their
 /// symbols queried. All objects added to this layer can see each other's
 /// symbols.
+///
+///   The layer can be used from several threads at once. Objects are loaded
+/// without holding any lock of the layer, and each object set is finalized
+/// exactly once, on the first thread to ask for one of its symbols' address;
+/// other threads asking for it meanwhile wait for the set to be finalized.
+/// The symbol resolvers and the notification functors may therefore be called
+/// on any thread.
 template <typename NotifyLoadedFtor = DoNothingOnNotifyLoaded>
 class ObjectLinkingLayer : public ObjectLinkingLayerBase {
 private:
@@ -126,8 +166,8 @@ private:
       RTDyld->resolveRelocations();
       RTDyld->registerEHFrames();
       MemMgr->finalizeMemory();
-      OwnedBuffers.clear();
       State = Finalized;
+      releaseOwnedBuffers();
     }
 
   private:
@@ -158,7 +198,16 @@ public:
       NotifyLoadedFtor NotifyLoaded = NotifyLoadedFtor(),
       NotifyFinalizedFtor NotifyFinalized = NotifyFinalizedFtor())
       : NotifyLoaded(std::move(NotifyLoaded)),
-        NotifyFinalized(std::move(NotifyFinalized)) {}
+        NotifyFinalized(std::move(NotifyFinalized)),
+        LazySymbolTables(false) {}
+
+  /// @brief Build the symbol tables of the object sets added from now on
+  ///        lazily, which is cheaper for large objects of which few symbols
+  ///        are looked up (e.g. runtime libraries). See
+  ///        RuntimeDyld::setLazySymbolTables.
+  void setLazySymbolTables(bool LazySymbolTables) {
+    this->LazySymbolTables = LazySymbolTables;
+  }
 
   /// @brief Add a set of objects (or archives) that will be treated as a unit
   ///        for the purposes of symbol lookup and memory management.
@@ -177,16 +226,19 @@ public:
   ObjSetHandleT addObjectSet(const ObjSetT &Objects,
                              MemoryManagerPtrT MemMgr,
                              SymbolResolverPtrT Resolver) {
-    ObjSetHandleT Handle =
-      LinkedObjSetList.insert(
-        LinkedObjSetList.end(),
-        createLinkedObjectSet(std::move(MemMgr), std::move(Resolver)));
-
-    LinkedObjectSet &LOS = **Handle;
+    auto LOS = createLinkedObjectSet(std::move(MemMgr), std::move(Resolver));
+    LOS->setLazySymbolTables(LazySymbolTables);
     LoadedObjInfoList LoadedObjInfos;
 
+    // Load the objects before the set is visible to the other threads.
     for (auto &Obj : Objects)
-      LoadedObjInfos.push_back(LOS.addObject(*Obj));
+      LoadedObjInfos.push_back(LOS->addObject(*Obj));
+
+    ObjSetHandleT Handle;
+    {
+      std::lock_guard<std::mutex> Lock(LinkedObjSetListMutex);
+      Handle = LinkedObjSetList.insert(LinkedObjSetList.end(), std::move(LOS));
+    }
 
     NotifyLoaded(Handle, Objects, LoadedObjInfos);
 
@@ -203,6 +255,7 @@ public:
   /// layer.
   void removeObjectSet(ObjSetHandleT H) {
     // How do we invalidate the symbols in H?
+    std::lock_guard<std::mutex> Lock(LinkedObjSetListMutex);
     LinkedObjSetList.erase(H);
   }
 
@@ -211,6 +264,7 @@ public:
   /// @param ExportedSymbolsOnly If true, search only for exported symbols.
   /// @return A handle for the given named symbol, if it exists.
   JITSymbol findSymbol(StringRef Name, bool ExportedSymbolsOnly) {
+    std::lock_guard<std::mutex> Lock(LinkedObjSetListMutex);
     for (auto I = LinkedObjSetList.begin(), E = LinkedObjSetList.end(); I != E;
          ++I)
       if (auto Symbol = findSymbolIn(I, Name, ExportedSymbolsOnly))
@@ -238,16 +292,11 @@ public:
           return JITSymbol(Addr, Flags);
         } else {
           // If this instance needs finalization return a functor that will do
-          // it. The functor still needs to double-check whether finalization is
-          // required, in case someone else finalizes this set before the
-          // functor is called.
+          // it. Someone else may finalize this set before the functor is
+          // called, in which case the functor has nothing left to do.
           auto GetAddress =
             [this, Addr, H]() {
-              if ((*H)->NeedsFinalization()) {
-                (*H)->Finalize();
-                if (NotifyFinalized)
-                  NotifyFinalized(H);
-              }
+              finalize(H);
               return Addr;
             };
           return JITSymbol(std::move(GetAddress), Flags);
@@ -267,15 +316,44 @@ public:
   ///        given handle.
   /// @param H Handle for object set to emit/finalize.
   void emitAndFinalize(ObjSetHandleT H) {
-    (*H)->Finalize();
-    if (NotifyFinalized)
-      NotifyFinalized(H);
+    finalize(H);
   }
 
 private:
+
+  // Finalize H and the sets it needs, unless that is already done.
+  //
+  // Resolving the relocations of a set looks up the symbols of the sets it
+  // refers to, which may in turn refer back to it, and may be finalized on
+  // other threads at the same time. So that no thread ever waits for a set
+  // while holding another one, the sets looked up while a set is finalized
+  // are only finalized once it is done, by the same thread, before the
+  // address that started it all is returned.
+  void finalize(ObjSetHandleT H) {
+    if (auto *Pending = PendingFinalization.get()) {
+      Pending->push_back(H);
+      return;
+    }
+
+    std::vector<ObjSetHandleT> Worklist(1, H);
+    PendingFinalization.set(&Worklist);
+    while (!Worklist.empty()) {
+      ObjSetHandleT Next = Worklist.back();
+      Worklist.pop_back();
+      if ((*Next)->FinalizeOnce() && NotifyFinalized)
+        NotifyFinalized(Next);
+    }
+    PendingFinalization.erase();
+  }
+
+  std::mutex LinkedObjSetListMutex;
   LinkedObjectSetListT LinkedObjSetList;
   NotifyLoadedFtor NotifyLoaded;
   NotifyFinalizedFtor NotifyFinalized;
+  bool LazySymbolTables;
+  // The sets left to finalize by the outermost call to finalize on each
+  // thread, if any.
+  sys::ThreadLocal<std::vector<ObjSetHandleT>> PendingFinalization;
 };
 
 } // End namespace orc.
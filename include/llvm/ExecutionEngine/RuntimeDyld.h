@@ -15,11 +15,13 @@
 #define LLVM_EXECUTIONENGINE_RUNTIMEDYLD_H
 
 #include "JITSymbolFlags.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Memory.h"
 #include "llvm/DebugInfo/DIContext.h"
 #include <memory>
+#include <vector>
 
 namespace llvm {
 
@@ -173,6 +175,15 @@ public:
     /// search the logical dylib, you should override your getSymbolAddress
     /// method call this method directly.
     virtual SymbolInfo findSymbolInLogicalDylib(const std::string &Name) = 0;
+
+    /// Look up all of \p Names, as if by findSymbol, and store the results in
+    /// the corresponding elements of \p Results. RuntimeDyld resolves all the
+    /// external symbols of a resolveRelocations call with a single query
+    /// through this method; the default implementation calls findSymbol for
+    /// each name. Resolvers that can answer several lookups more cheaply at
+    /// once (e.g. with one round trip to a remote process) should override it.
+    virtual void findSymbols(ArrayRef<std::string> Names,
+                             std::vector<SymbolInfo> &Results);
   private:
     virtual void anchor();
   };
@@ -228,6 +239,26 @@ public:
     this->ProcessAllSections = ProcessAllSections;
   }
 
+  /// By default, the symbols of every loaded object are copied into a hash
+  /// table as the object is loaded. Passing 'true' to this method keeps them
+  /// instead in one compact array per object, which is only sorted the first
+  /// time a symbol is looked up in it by name, and then searched by binary
+  /// search. This cuts the load time and memory of large objects of which
+  /// only a few symbols are ever looked up, at the price of slower lookups
+  /// when many objects are loaded into the same instance.
+  ///
+  /// Must be called before the first object file is loaded.
+  void setLazySymbolTables(bool LazySymbolTables) {
+    assert(!Dyld && "setLazySymbolTables must be called before loadObject.");
+    this->LazySymbolTables = LazySymbolTables;
+  }
+
+  /// Apply the relocations of resolveRelocations on \p ThreadCount threads,
+  /// writing into different sections concurrently. Zero or one (the default)
+  /// applies them on the calling thread. Formats whose relocations are not
+  /// independent between sections ignore this setting.
+  void setRelocationThreadCount(unsigned ThreadCount);
+
 private:
   // RuntimeDyldImpl is the actual class. RuntimeDyld is just the public
   // interface.
@@ -235,6 +266,8 @@ private:
   MemoryManager &MemMgr;
   SymbolResolver &Resolver;
   bool ProcessAllSections;
+  bool LazySymbolTables;
+  unsigned RelocationThreadCount;
   RuntimeDyldCheckerImpl *Checker;
 };
 
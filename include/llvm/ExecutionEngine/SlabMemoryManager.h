@@ -0,0 +1,168 @@
+//===- SlabMemoryManager.h - Slab-based memory manager for JITs -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a memory manager for MCJIT and RuntimeDyld that packs the
+// sections of many objects into a few large slabs of memory, shared through a
+// JITMemoryArena.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+#define LLVM_EXECUTIONENGINE_SLABMEMORYMANAGER_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/Memory.h"
+#include <map>
+#include <mutex>
+
+namespace llvm {
+
+/// A source of page-aligned memory for JIT'd code and data, carved out of large
+/// slabs mapped once. Code and data come from separate slabs, so that the code
+/// of the objects sharing an arena ends up densely packed, and covered by few
+/// TLB entries.
+///
+/// Blocks are handed out read-write. Permissions are changed per block, never
+/// on memory shared with another block, so that a block being written is never
+/// executable and the other way around. Released blocks are reused; the slabs
+/// themselves are only unmapped when the arena is destroyed.
+///
+/// The arena may be shared by memory managers used on different threads.
+class JITMemoryArena {
+  JITMemoryArena(const JITMemoryArena &) = delete;
+  void operator=(const JITMemoryArena &) = delete;
+
+public:
+  /// The size and alignment of the slabs when huge pages are used.
+  static const size_t HugePageSize = 2 * 1024 * 1024;
+
+  /// Create an arena mapping slabs of \p SlabSize bytes. If \p UseHugePages is
+  /// set, the slabs are aligned to HugePageSize and the system is asked to back
+  /// them with huge pages.
+  explicit JITMemoryArena(size_t SlabSize = HugePageSize,
+                          bool UseHugePages = false);
+  ~JITMemoryArena();
+
+  /// Allocate a read-write, page-aligned block of at least \p Size bytes, from
+  /// the code slabs if \p IsCode is set and from the data slabs otherwise.
+  /// Returns a null block if memory cannot be mapped.
+  sys::MemoryBlock allocate(size_t Size, bool IsCode);
+
+  /// Give back \p Blocks, which must have been allocated from this arena, or
+  /// be whole pages of such blocks, and must be read-write again.
+  void release(ArrayRef<sys::MemoryBlock> Blocks);
+
+  /// Apply \p Permissions to \p Blocks. Adjacent blocks of the same slab are
+  /// changed by a single call to the system.
+  std::error_code protect(ArrayRef<sys::MemoryBlock> Blocks,
+                          unsigned Permissions);
+
+  /// Return the number of slabs mapped so far.
+  unsigned getNumSlabs() const;
+
+  /// Return the number of bytes in use in blocks handed out.
+  size_t getAllocatedSize() const;
+
+  size_t getPageSize() const { return PageSize; }
+
+private:
+  struct Slab {
+    sys::MemoryBlock Mapping;
+    uintptr_t End;
+    bool IsCode;
+    /// Free page runs of this slab, by start address.
+    std::map<uintptr_t, size_t> FreeRuns;
+  };
+
+  /// Return the slab containing \p Addr. Must be called with the lock held.
+  Slab &getSlab(uintptr_t Addr);
+
+  Slab *mapSlab(size_t Size, bool IsCode);
+
+  size_t SlabSize;
+  size_t PageSize;
+  bool UseHugePages;
+
+  mutable std::mutex Mutex;
+  /// The slabs, by start address.
+  std::map<uintptr_t, Slab> Slabs;
+  size_t AllocatedSize;
+};
+
+/// A memory manager allocating the sections of the objects it loads from a
+/// JITMemoryArena. Create one for each object, or set of objects, that should
+/// be freed as a unit: destroying the memory manager gives its memory back to
+/// the arena.
+///
+/// As with SectionMemoryManager, the sections are allocated read-write, and
+/// finalizeMemory must be called before the code is executed. It makes the
+/// code read-execute and the read-only data read-only. The pages left unused
+/// at that point go back to the arena, so that the next objects loaded are
+/// packed right after this one.
+class SlabMemoryManager : public RTDyldMemoryManager {
+  SlabMemoryManager(const SlabMemoryManager &) = delete;
+  void operator=(const SlabMemoryManager &) = delete;
+
+public:
+  explicit SlabMemoryManager(JITMemoryArena &Arena);
+  ~SlabMemoryManager() override;
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID,
+                               StringRef SectionName) override;
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                               unsigned SectionID, StringRef SectionName,
+                               bool IsReadOnly) override;
+
+  /// Allocate a block for each kind of section up front, so that the sections
+  /// of an object are contiguous.
+  bool needsToReserveAllocationSpace() override { return true; }
+  void reserveAllocationSpace(uintptr_t CodeSize, uintptr_t DataSizeRO,
+                              uintptr_t DataSizeRW) override;
+
+  bool finalizeMemory(std::string *ErrMsg = nullptr) override;
+
+private:
+  struct MemoryGroup {
+    MemoryGroup(bool IsCode, unsigned Permissions)
+        : IsCode(IsCode), Permissions(Permissions), NumFinalized(0), Next(0),
+          End(0) {}
+
+    bool IsCode;
+    /// The permissions to apply on finalization, or 0 to leave the group
+    /// read-write.
+    unsigned Permissions;
+    SmallVector<sys::MemoryBlock, 4> Blocks;
+    /// The number of leading blocks whose permissions have been applied.
+    unsigned NumFinalized;
+    /// The free part of the last block.
+    uintptr_t Next, End;
+  };
+
+  /// Give the whole pages left at the end of the last block of \p MemGroup
+  /// back to the arena, and stop allocating from that block.
+  void trimLastBlock(MemoryGroup &MemGroup);
+  /// Allocate from a new block of at least \p Size bytes.
+  void startBlock(MemoryGroup &MemGroup, uintptr_t Size);
+  uint8_t *allocateSection(MemoryGroup &MemGroup, uintptr_t Size,
+                           unsigned Alignment);
+  std::error_code finalizeGroup(MemoryGroup &MemGroup);
+
+  JITMemoryArena &Arena;
+  MemoryGroup CodeMem;
+  MemoryGroup RODataMem;
+  MemoryGroup RWDataMem;
+};
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,150 @@
+//===-- llvm/IR/FunctionInfo.h - Function summary index ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+/// @file
+/// This file contains the declarations of the FunctionSummary and
+/// FunctionInfoIndex classes, which describe the functions defined in one or
+/// more modules without requiring the modules themselves to be loaded. They
+/// are used to make cross-module importing decisions for summary-based LTO.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_FUNCTIONINFO_H
+#define LLVM_IR_FUNCTIONINFO_H
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/GlobalValue.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class Function;
+class Module;
+
+/// \brief A reference from a function to another global value, either
+/// through a call or by taking its address.
+struct GlobalValueRef {
+  /// The name of the referenced value. In a combined index, local values are
+  /// named by their global identifier.
+  std::string Name;
+
+  /// Whether the referenced value has local linkage in its module.
+  bool IsLocal;
+
+  /// For calls, the number of call sites in the caller.
+  unsigned CallsiteCount;
+
+  GlobalValueRef(StringRef Name, bool IsLocal, unsigned CallsiteCount = 0)
+      : Name(Name), IsLocal(IsLocal), CallsiteCount(CallsiteCount) {}
+};
+
+/// \brief Summary of a function definition: its size, its call edges and the
+/// global variables it references.
+class FunctionSummary {
+  /// The path of the module defining the function. Empty in a per-module
+  /// index; points into the module path table of a combined index.
+  StringRef ModulePath;
+
+  GlobalValue::LinkageTypes Linkage;
+
+  /// Number of instructions, a rough measure of the function's size.
+  unsigned InstCount;
+
+  /// The profile entry count of the function, or 0 if unknown.
+  uint64_t EntryCount;
+
+  std::vector<GlobalValueRef> Calls;
+  std::vector<GlobalValueRef> Refs;
+
+public:
+  FunctionSummary(GlobalValue::LinkageTypes Linkage, unsigned InstCount,
+                  uint64_t EntryCount = 0)
+      : Linkage(Linkage), InstCount(InstCount), EntryCount(EntryCount) {}
+
+  /// Compute the summary of the definition \p F.
+  static std::unique_ptr<FunctionSummary> compute(const Function &F);
+
+  StringRef modulePath() const { return ModulePath; }
+  void setModulePath(StringRef Path) { ModulePath = Path; }
+
+  GlobalValue::LinkageTypes getLinkage() const { return Linkage; }
+  unsigned getInstCount() const { return InstCount; }
+  uint64_t getEntryCount() const { return EntryCount; }
+
+  /// Functions called directly, one entry per callee.
+  const std::vector<GlobalValueRef> &calls() const { return Calls; }
+  std::vector<GlobalValueRef> &calls() { return Calls; }
+
+  /// Global values referenced other than by a direct call.
+  const std::vector<GlobalValueRef> &refs() const { return Refs; }
+  std::vector<GlobalValueRef> &refs() { return Refs; }
+
+  /// Return true if the function refers to any value with local linkage, so
+  /// that its body cannot be copied into another module as is.
+  bool hasLocalRefs() const;
+};
+
+/// \brief An index of function summaries, keyed by global identifier.
+///
+/// A per-module index describes the functions of a single module and has an
+/// empty module path table. A combined index is built by merging per-module
+/// indexes and can hold several definitions of the same (linkonce or weak)
+/// function, one per defining module.
+class FunctionInfoIndex {
+public:
+  typedef std::vector<std::unique_ptr<FunctionSummary>> FunctionSummaryList;
+  typedef StringMap<FunctionSummaryList> FunctionMapType;
+  typedef StringMap<uint64_t> ModulePathMapType;
+
+private:
+  FunctionMapType FunctionMap;
+
+  /// Map from module path to module identifier. The keys own the strings
+  /// FunctionSummary::modulePath() refers to.
+  ModulePathMapType ModulePathMap;
+
+public:
+  /// Return the identifier under which a function is known in a combined
+  /// index. Local functions are qualified by the path of their module since
+  /// their names are only unique within it.
+  static std::string getGlobalIdentifier(StringRef Name, bool IsLocal,
+                                         StringRef ModulePath);
+
+  /// Build the per-module index of every function defined in \p M.
+  static std::unique_ptr<FunctionInfoIndex> build(const Module &M);
+
+  FunctionMapType::const_iterator begin() const { return FunctionMap.begin(); }
+  FunctionMapType::const_iterator end() const { return FunctionMap.end(); }
+  size_t size() const { return FunctionMap.size(); }
+
+  const ModulePathMapType &modulePaths() const { return ModulePathMap; }
+
+  /// Register \p Path with identifier \p ModuleId and return the interned
+  /// path.
+  StringRef addModulePath(StringRef Path, uint64_t ModuleId);
+
+  void addFunctionSummary(StringRef Identifier,
+                          std::unique_ptr<FunctionSummary> Summary);
+
+  /// Return the summaries of all definitions of \p Identifier.
+  const FunctionSummaryList *findFunctionSummaries(StringRef Identifier) const;
+
+  /// Move the summaries of the per-module index \p Other into this combined
+  /// index, recording them as defined by \p ModulePath. Local functions and
+  /// references to them are renamed to their global identifiers.
+  void mergeFrom(std::unique_ptr<FunctionInfoIndex> Other,
+                 StringRef ModulePath, uint64_t ModuleId);
+};
+
+} // End llvm namespace
+
+#endif
@@ -160,6 +160,18 @@ public:
   /// any global mutex or cannot block the execution in another LLVM context.
   void yield();
 
+  /// \brief Enable or disable concurrent uniquing.
+  ///
+  /// In this mode, ConstantInt::get, ConstantFP::get, MDString::get and the
+  /// factories of types may be called from several threads at once. The rest
+  /// of the context still needs external synchronization: creating constants
+  /// with operands, metadata nodes or instructions updates the use lists of
+  /// the values they use. It must be set before the context is shared.
+  void setConcurrentUniquing(bool Enable);
+
+  /// \brief Return true if concurrent uniquing is enabled.
+  bool hasConcurrentUniquing() const;
+
   /// emitError - Emit an error message to the currently installed error handler
   /// with optional location information.  This function returns, so code should
   /// be prepared to drop the erroneous construct on the floor and "not crash".
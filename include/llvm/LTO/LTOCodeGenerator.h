@@ -40,6 +40,7 @@
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/CodeGen.h"
 #include "llvm/Target/TargetOptions.h"
 #include <string>
 #include <vector>
@@ -82,6 +83,26 @@ struct LTOCodeGenerator {
   void setShouldInternalize(bool Value) { ShouldInternalize = Value; }
   void setShouldEmbedUselists(bool Value) { ShouldEmbedUselists = Value; }
 
+  // Set the number of object files compileOptimizedToFiles() splits the merged
+  // module into. Each of them is code generated on its own thread.
+  void setParallelism(unsigned Value) { Parallelism = Value; }
+
+  // Cache the object files produced by compile() and compile_to_file() in
+  // Path, keyed by the merged module and the options it is compiled with.
+  // An empty path, the default, disables the cache.
+  void setCacheDir(StringRef Path) { CacheDir = Path; }
+
+  // Set the pruning policy of the cache: the minimum time between two
+  // prunings and the time after which an unused entry is removed, in seconds,
+  // and the size above which the least recently used entries are removed, in
+  // bytes. A zero expiration or size disables the corresponding pruning.
+  void setCachePruningPolicy(unsigned Interval, unsigned Expiration,
+                             uint64_t MaxSize) {
+    CachePruningInterval = Interval;
+    CacheEntryExpiration = Expiration;
+    MaxCacheSize = MaxSize;
+  }
+
   void addMustPreserveSymbol(StringRef sym) { MustPreserveSymbols[sym] = 1; }
 
   // To pass options to the driver and optimization passes. These options are
@@ -133,6 +154,21 @@ struct LTOCodeGenerator {
   // if the compilation was not successful.
   std::unique_ptr<MemoryBuffer> compileOptimized(std::string &errMsg);
 
+  // Compiles the merged optimized module into one object file per stream in
+  // Out. If there is more than one stream, the module is split into that many
+  // partitions which are code generated in parallel; linking the resulting
+  // objects together is equivalent to linking the single object that would
+  // otherwise be produced. Returns true on success.
+  bool compileOptimized(ArrayRef<raw_pwrite_stream *> Out,
+                        std::string &errMsg);
+
+  // Compiles the merged optimized module into as many temporary object files
+  // as set by setParallelism(). Their paths are returned in Names and stay
+  // valid until the next call. As with compile_to_file(), it is up to the
+  // linker to remove the object files. Returns true on success.
+  bool compileOptimizedToFiles(std::vector<const char *> &Names,
+                               std::string &errMsg);
+
   void setDiagnosticHandler(lto_diagnostic_handler_t, void *);
 
   LLVMContext &getContext() { return Context; }
@@ -140,8 +176,13 @@ struct LTOCodeGenerator {
 private:
   void initializeLTOPasses();
 
-  bool compileOptimized(raw_pwrite_stream &out, std::string &errMsg);
   bool compileOptimizedToFile(const char **name, std::string &errMsg);
+  std::unique_ptr<MemoryBuffer> compileUncached(bool disableInline,
+                                                bool disableGVNLoadPRE,
+                                                bool disableVectorization,
+                                                std::string &errMsg);
+  std::string getCacheKey(bool disableInline, bool disableGVNLoadPRE,
+                          bool disableVectorization);
   void applyScopeRestrictions();
   void applyRestriction(GlobalValue &GV, ArrayRef<StringRef> Libcalls,
                         std::vector<const char *> &MustPreserveList,
@@ -169,13 +210,22 @@ private:
   std::string MCpu;
   std::string MAttr;
   std::string NativeObjectPath;
+  std::vector<std::string> NativeObjectPaths;
   TargetOptions Options;
   unsigned OptLevel = 2;
+  unsigned Parallelism = 1;
+  std::string FeatureStr;
+  Reloc::Model RelocModel = Reloc::Default;
+  CodeGenOpt::Level CGOptLevel = CodeGenOpt::Default;
   lto_diagnostic_handler_t DiagHandler = nullptr;
   void *DiagContext = nullptr;
   LTOModule *OwnedModule = nullptr;
   bool ShouldInternalize = true;
   bool ShouldEmbedUselists = false;
+  std::string CacheDir;
+  unsigned CachePruningInterval = 1200;
+  unsigned CacheEntryExpiration = 7 * 24 * 3600;
+  uint64_t MaxCacheSize = 0;
 };
 }
 #endif
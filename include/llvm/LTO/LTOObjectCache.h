@@ -0,0 +1,74 @@
+//===-LTOObjectCache.h - On-disk cache of LTO native objects ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the LTOObjectCache class, which stores the native objects
+// produced by LTO in a directory, keyed by a hash of everything that
+// determines them: the module about to be optimized (including whatever was
+// imported into it), the target options and the code generation pipeline.
+//
+// The directory may be shared by several linkers running at the same time:
+//
+//   - Entries are written to a temporary file and renamed into place, so a
+//     reader never sees a partial entry.
+//   - While an entry is produced, a LockFileManager lock guards it; other
+//     linkers needing the same entry wait for it instead of redoing the work.
+//
+// Pruning is left to CachePruning, which the users run once they are done.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_LTOOBJECTCACHE_H
+#define LLVM_LTO_LTOOBJECTCACHE_H
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace llvm {
+class Module;
+class TargetOptions;
+
+class LTOObjectCache {
+public:
+  /// Use the directory \p CacheDir, which is created if needed.
+  explicit LTOObjectCache(StringRef CacheDir);
+
+  /// Compute the key of the object generated for \p M with \p Options.
+  /// \p Config describes the rest of the configuration that affects the
+  /// output, e.g. the CPU, the optimization level and the pass pipeline.
+  static std::string computeKey(const Module &M, const TargetOptions &Options,
+                                StringRef Config);
+
+  /// Return the object cached under \p Key, or null if there is none.
+  std::unique_ptr<MemoryBuffer> lookup(StringRef Key) const;
+
+  /// Cache \p Object under \p Key. Failures are ignored: the cache is only an
+  /// optimization.
+  void store(StringRef Key, StringRef Object) const;
+
+  /// Return the object cached under \p Key, calling \p Compute to produce and
+  /// cache it if needed. If another process is already producing the entry,
+  /// wait for it to finish rather than compute it twice. Compute may return
+  /// null on error, which is then returned and not cached.
+  std::unique_ptr<MemoryBuffer>
+  getOrCompute(StringRef Key,
+               std::function<std::unique_ptr<MemoryBuffer>()> Compute) const;
+
+private:
+  SmallString<128> getEntryPath(StringRef Key) const;
+
+  SmallString<128> CacheDir;
+};
+
+} // End llvm namespace
+
+#endif
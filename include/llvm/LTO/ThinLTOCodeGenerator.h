@@ -0,0 +1,127 @@
+//===-ThinLTOCodeGenerator.h - Summary-based LTO driver --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the ThinLTOCodeGenerator class.
+//
+//   Unlike LTOCodeGenerator, which links every module into a single module
+// before optimizing it, summary-based ("thin") LTO keeps the modules apart:
+//
+//   - The thin link reads only the function summaries of the modules and
+//     merges them into a combined index.
+//   - Each module is then handed to its own backend, which imports from the
+//     other modules the functions the index suggests, optimizes the module and
+//     generates code for it. Backends are independent and run in parallel.
+//
+// Peak memory is thus bounded by the largest module and its imports rather
+// than by the size of the whole program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_THINLTOCODEGENERATOR_H
+#define LLVM_LTO_THINLTOCODEGENERATOR_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Target/TargetOptions.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class FunctionInfoIndex;
+
+class ThinLTOCodeGenerator {
+public:
+  ThinLTOCodeGenerator();
+  ~ThinLTOCodeGenerator();
+
+  /// Add the bitcode module held in \p Data. \p Identifier must be unique
+  /// among the modules added; it is recorded as the module path in the
+  /// combined index. The data is not copied and must outlive the generator.
+  void addModule(StringRef Identifier, StringRef Data);
+
+  void setTargetOptions(TargetOptions Options) { this->Options = Options; }
+  void setCpu(StringRef Cpu) { MCpu = Cpu; }
+  void setAttr(StringRef Attr) { MAttr = Attr; }
+  void setCodePICModel(Reloc::Model Model) { RelocModel = Model; }
+  void setOptLevel(unsigned Level) { OptLevel = Level; }
+
+  /// Set the number of backends to run concurrently. Zero, the default,
+  /// means llvm::getDefaultParallelism().
+  void setParallelism(unsigned Jobs) { Parallelism = Jobs; }
+
+  /// Set the size, in instructions, above which functions are not imported.
+  void setImportInstrLimit(unsigned Limit) { ImportInstrLimit = Limit; }
+
+  /// Cache the object files in \p Path, keyed by the modules' content after
+  /// importing and by the code generation options. An empty path disables the
+  /// cache.
+  void setCacheDir(StringRef Path) { CacheDir = Path; }
+
+  /// Set the minimum time, in seconds, between two prunings of the cache.
+  void setCachePruningInterval(unsigned Interval) {
+    CachePruningInterval = Interval;
+  }
+
+  /// Set the time, in seconds, after which an unused cache entry is removed.
+  /// Zero disables the expiration.
+  void setCacheEntryExpiration(unsigned Expiration) {
+    CacheEntryExpiration = Expiration;
+  }
+
+  /// Set the size, in bytes, above which the least recently used cache entries
+  /// are removed. Zero means no limit.
+  void setMaxCacheSize(uint64_t Size) { MaxCacheSize = Size; }
+
+  /// Perform the thin link: merge the function summaries of every module into
+  /// a combined index. Modules without a summary are parsed to compute one.
+  /// Returns null and sets \p ErrMsg on failure.
+  std::unique_ptr<FunctionInfoIndex> linkCombinedIndex(std::string &ErrMsg);
+
+  /// Perform the thin link and run the backends. On success, the object files
+  /// are available from getProducedBinaries().
+  bool run(std::string &ErrMsg);
+
+  /// Return the object files produced by run(), one per module, in the order
+  /// the modules were added.
+  std::vector<std::unique_ptr<MemoryBuffer>> &getProducedBinaries() {
+    return ProducedBinaries;
+  }
+
+private:
+  struct ModuleInput {
+    std::string Identifier;
+    StringRef Data;
+  };
+
+  /// Import into, optimize and generate code for the module \p Input, or
+  /// take the result from the cache.
+  std::unique_ptr<MemoryBuffer> runBackend(const ModuleInput &Input,
+                                           const FunctionInfoIndex &Index,
+                                           std::string &ErrMsg) const;
+
+  std::vector<ModuleInput> Modules;
+  std::vector<std::unique_ptr<MemoryBuffer>> ProducedBinaries;
+  TargetOptions Options;
+  std::string MCpu;
+  std::string MAttr;
+  Reloc::Model RelocModel;
+  unsigned OptLevel;
+  unsigned Parallelism;
+  unsigned ImportInstrLimit;
+  std::string CacheDir;
+  unsigned CachePruningInterval;
+  unsigned CacheEntryExpiration;
+  uint64_t MaxCacheSize;
+};
+
+} // End llvm namespace
+
+#endif
@@ -55,6 +55,13 @@ public:
   /// its bundle padding will be recomputed.
   void invalidateFragmentsFrom(MCFragment *F);
 
+  /// \brief Update the layout after fragments from \p First up to \p Last,
+  /// which belong to the same section, have been resized. Rather than
+  /// invalidating everything after \p First, the offsets of the fragments
+  /// already laid out are recomputed in place, stopping as soon as they no
+  /// longer move.
+  void resizeFragments(MCFragment *First, MCFragment *Last);
+
   /// \brief Perform layout for a single fragment, assuming that the previous
   /// fragment has already been laid out correctly, and the parent section has
   /// been initialized.
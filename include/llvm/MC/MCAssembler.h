@@ -690,13 +690,47 @@ private:
   bool fragmentNeedsRelaxation(const MCRelaxableFragment *IF,
                                const MCAsmLayout &Layout) const;
 
+  /// A fragment whose size is decided by relaxation. Its value is usually
+  /// the distance between a few fragments, so rather than being checked on
+  /// every layout iteration it remembers the offsets it was last checked
+  /// against and is only checked again once those have moved.
+  struct RelaxationCandidate {
+    MCFragment *F;
+
+    /// The fragments the value of F is computed from, with their offsets
+    /// relative to the first one when F was last checked.
+    SmallVector<std::pair<const MCFragment *, uint64_t>, 2> Deps;
+
+    /// Whether Deps describes the layout F was last checked against.
+    bool Checked;
+
+    /// Whether the value of F depends on nothing but the distances between
+    /// the fragments in Deps, so that Deps can be relied on at all.
+    bool Trackable;
+
+    explicit RelaxationCandidate(MCFragment *F)
+        : F(F), Checked(false), Trackable(true) {}
+  };
+  typedef std::vector<RelaxationCandidate> RelaxationWorklist;
+
+  /// Record the fragments the value of \p C depends on in the current layout.
+  void recordRelaxationDeps(const MCAsmLayout &Layout,
+                            RelaxationCandidate &C) const;
+
+  /// Check whether the value of \p C may have changed since it was checked.
+  bool needsRelaxationCheck(const MCAsmLayout &Layout,
+                            const RelaxationCandidate &C) const;
+
   /// \brief Perform one layout iteration and return true if any offsets
-  /// were adjusted.
-  bool layoutOnce(MCAsmLayout &Layout);
+  /// were adjusted. \p Worklists holds the relaxation candidates of each
+  /// section, indexed by section ordinal.
+  bool layoutOnce(MCAsmLayout &Layout,
+                  std::vector<RelaxationWorklist> &Worklists);
 
   /// \brief Perform one layout iteration of the given section and return true
   /// if any offsets were adjusted.
-  bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec);
+  bool layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec,
+                         RelaxationWorklist &Worklist);
 
   bool relaxInstruction(MCAsmLayout &Layout, MCRelaxableFragment &IF);
 
@@ -17,6 +17,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ProfileData/InstrProf.h"
 #include "llvm/Support/DataTypes.h"
@@ -42,6 +43,12 @@ public:
   std::error_code addFunctionCounts(StringRef FunctionName,
                                     uint64_t FunctionHash,
                                     ArrayRef<uint64_t> Counters);
+  /// Merge the counts of another writer into this one, as if they had been
+  /// added here.  Each function whose counts could not be merged is reported
+  /// to \c Warn.
+  void mergeRecordsFromWriter(
+      InstrProfWriter &&IPW,
+      function_ref<void(StringRef FunctionName, std::error_code EC)> Warn);
   /// Write the profile to \c OS
   void write(raw_fd_ostream &OS);
   /// Write the profile, returning the raw data. For testing.
@@ -0,0 +1,73 @@
+//=- CachePruning.h - Helper to manage the pruning of a cache dir -*- C++ -*-=//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements pruning of a directory intended for cache storage,
+// using various policies: entries unused for too long are removed, and the
+// least recently used entries are removed until the directory fits a size
+// budget.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_CACHEPRUNING_H
+#define LLVM_SUPPORT_CACHEPRUNING_H
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+namespace llvm {
+
+/// Handle pruning a directory provided by the user. Only the files whose name
+/// starts with "llvmcache-" are considered cache entries; lock files are never
+/// removed. The modification time of an entry is taken as its last use, so
+/// users of the cache should update it on every hit.
+class CachePruning {
+public:
+  /// Prepare to prune \p Path.
+  CachePruning(StringRef Path) : Path(Path) {}
+
+  /// Define the pruning interval. This is intended to be used to avoid
+  /// scanning the directory too often. It does not impact the decision of
+  /// which file to prune. A value of 0 forces the scan to occur.
+  CachePruning &setPruningInterval(unsigned PruningInterval) {
+    Interval = PruningInterval;
+    return *this;
+  }
+
+  /// Define the expiration for a file. When a file hasn't been accessed for
+  /// \p ExpireAfter seconds, it is removed from the cache. A value of 0
+  /// disables the expiration-based pruning.
+  CachePruning &setEntryExpiration(unsigned ExpireAfter) {
+    Expiration = ExpireAfter;
+    return *this;
+  }
+
+  /// Define the maximum size, in bytes, of the cache directory. When it is
+  /// exceeded, the least recently used entries are removed first. A value of
+  /// 0 disables the size-based pruning.
+  CachePruning &setMaxSize(uint64_t MaxSizeInBytes) {
+    MaxSize = MaxSizeInBytes;
+    return *this;
+  }
+
+  /// Perform pruning using the supplied options. Returns true if pruning
+  /// occurred, i.e. if the pruning interval had expired.
+  bool prune();
+
+private:
+  // Options that match the setters above.
+  SmallString<128> Path;
+  unsigned Expiration = 7 * 24 * 3600;
+  unsigned Interval = 1200;
+  uint64_t MaxSize = 0;
+};
+
+} // namespace llvm
+
+#endif
@@ -108,6 +108,18 @@ namespace sys {
     static std::error_code protectMappedMemory(const MemoryBlock &Block,
                                                unsigned Flags);
 
+    /// This method asks the operating system to back a block of memory
+    /// allocated with the allocateMappedMemory method with huge pages where
+    /// it can. This is only a hint: the block remains usable either way.
+    /// \p Block describes the memory block, which should be aligned to the
+    /// size of huge pages.
+    ///
+    /// \r error_success if the hint was accepted, or an error_code describing
+    /// why it was not, e.g. because the system does not support it.
+    ///
+    /// @brief Advise the use of huge pages.
+    static std::error_code adviseHugePages(const MemoryBlock &Block);
+
     /// This method allocates a block of Read/Write/Execute memory that is
     /// suitable for executing dynamically generated code (e.g. JIT). An
     /// attempt to allocate \p NumBytes bytes of virtual memory is made.
@@ -0,0 +1,184 @@
+//===-- llvm/Support/ThreadPool.h - A ThreadPool implementation -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a crude C++11 based thread pool and a TaskGroup helper for
+// fork/join style parallelism on top of it.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_THREADPOOL_H
+#define LLVM_SUPPORT_THREADPOOL_H
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace llvm {
+
+/// \brief A ThreadPool for asynchronous parallel execution on a defined number
+/// of threads.
+///
+/// Every worker owns a double-ended work queue. Tasks submitted from a worker
+/// thread are pushed onto the back of that worker's queue and popped again in
+/// LIFO order, which keeps nested work cache-local; tasks submitted from any
+/// other thread go to a shared injection queue. A worker that runs out of work
+/// steals from the front of the other workers' queues.
+///
+/// When LLVM is built without thread support, no worker threads are created
+/// and every task runs synchronously inside async().
+class ThreadPool {
+public:
+  typedef std::function<void()> TaskTy;
+
+  /// \brief Construct a pool with getDefaultParallelism() threads.
+  ThreadPool();
+
+  /// \brief Construct a pool of \p ThreadCount threads. A count of zero is
+  /// treated as one.
+  explicit ThreadPool(unsigned ThreadCount);
+
+  /// \brief Blocking destructor: the pool waits for all pending tasks to
+  /// complete before joining its workers.
+  ~ThreadPool();
+
+  /// \brief Asynchronous submission of a callable with no arguments. The
+  /// returned future can be used to wait for the task to finish and to
+  /// retrieve its result.
+  template <typename Function>
+  auto async(Function &&F) -> std::shared_future<decltype(F())> {
+    typedef decltype(F()) ResultTy;
+    auto Task = std::make_shared<std::packaged_task<ResultTy()>>(
+        std::forward<Function>(F));
+    std::shared_future<ResultTy> Future = Task->get_future().share();
+    enqueue([Task]() { (*Task)(); });
+    return Future;
+  }
+
+  /// \brief Asynchronous submission of a callable and the arguments to call it
+  /// with. The arguments are copied into the task.
+  template <typename Function, typename... Args>
+  auto async(Function &&F, Args &&... ArgList)
+      -> std::shared_future<decltype(F(ArgList...))> {
+    return async(std::bind(std::forward<Function>(F),
+                           std::forward<Args>(ArgList)...));
+  }
+
+  /// \brief Blocking wait for all the tasks submitted to the pool so far,
+  /// including the ones they spawn, to complete. Must not be called from one
+  /// of the pool's own worker threads; use a TaskGroup for nested waits.
+  void wait();
+
+  /// \brief Return the number of worker threads in the pool.
+  unsigned getThreadCount() const { return ThreadCount; }
+
+  /// \brief Return true if the calling thread is one of this pool's workers.
+  bool isWorkerThread() const;
+
+private:
+  friend class TaskGroup;
+
+  struct WorkQueue {
+    std::mutex Lock;
+    std::deque<TaskTy> Tasks;
+  };
+
+  /// Push \p Task onto the calling worker's queue, or onto the injection queue
+  /// when called from outside the pool.
+  void enqueue(TaskTy Task);
+
+  /// Pop a task from the calling worker's own queue, then the injection queue,
+  /// and finally try to steal from the other workers. Returns false if no work
+  /// was found.
+  bool popTask(TaskTy &Task);
+
+  /// Run one pending task on the calling thread, if there is one. This lets a
+  /// thread that blocks on nested work make progress instead of idling.
+  bool runPendingTask();
+
+  /// Execute \p Task and update the completion bookkeeping.
+  void runTask(TaskTy &Task);
+
+  /// Main loop of the worker at \p Index.
+  void work(unsigned Index);
+
+  unsigned ThreadCount;
+
+  std::vector<std::thread> Threads;
+
+  /// One queue per worker followed by the shared injection queue.
+  std::vector<std::unique_ptr<WorkQueue>> Queues;
+
+  /// Number of tasks sitting in a queue. Only incremented while holding
+  /// SleepLock so that a worker going to sleep cannot miss new work. It may
+  /// briefly go negative when a task is popped before it has been counted.
+  std::atomic<int> QueuedTasks;
+
+  /// Number of tasks that were submitted and have not finished yet.
+  std::atomic<unsigned> ActiveTasks;
+
+  std::mutex SleepLock;
+  std::condition_variable SleepCondition;
+
+  std::mutex CompletionLock;
+  std::condition_variable CompletionCondition;
+
+  /// Signal the workers to exit once their queues are drained.
+  bool EnableFlag;
+};
+
+/// \brief A set of tasks running on a ThreadPool that can be waited for as a
+/// unit.
+///
+/// Unlike ThreadPool::wait(), TaskGroup::wait() may be called from a task that
+/// is itself running on the pool: the waiting worker keeps executing pending
+/// tasks until the group is done, so nested parallelism cannot deadlock.
+class TaskGroup {
+public:
+  explicit TaskGroup(ThreadPool &Pool) : Pool(Pool), PendingTasks(0) {}
+
+  /// \brief Waits for the outstanding tasks of the group.
+  ~TaskGroup() { wait(); }
+
+  /// \brief Run \p F on the pool as part of this group.
+  template <typename Function> void spawn(Function &&F) {
+    ++PendingTasks;
+    auto Task = std::make_shared<typename std::decay<Function>::type>(
+        std::forward<Function>(F));
+    Pool.enqueue([this, Task]() {
+      (*Task)();
+      finishTask();
+    });
+  }
+
+  /// \brief Block until every task spawned into the group so far completed.
+  void wait();
+
+private:
+  TaskGroup(const TaskGroup &) = delete;
+  void operator=(const TaskGroup &) = delete;
+
+  void finishTask();
+
+  ThreadPool &Pool;
+  std::atomic<unsigned> PendingTasks;
+  std::mutex Lock;
+  std::condition_variable Done;
+};
+
+} // namespace llvm
+
+#endif // LLVM_SUPPORT_THREADPOOL_H
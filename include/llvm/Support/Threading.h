@@ -34,6 +34,18 @@ namespace llvm {
   /// the thread stack.
   void llvm_execute_on_thread(void (*UserFn)(void*), void *UserData,
                               unsigned RequestedStackSize = 0);
+
+  /// Returns the number of threads parallel work should be spread over when
+  /// the client has no more specific preference, e.g. the size of a default
+  /// constructed ThreadPool. This is the last value passed to
+  /// setDefaultParallelism(), otherwise the value of the LLVM_PARALLEL_JOBS
+  /// environment variable, otherwise the number of hardware threads. It is
+  /// always at least one, and exactly one if LLVM is built without threads.
+  unsigned getDefaultParallelism();
+
+  /// Override the value returned by getDefaultParallelism(), typically from a
+  /// tool's -j option. Passing zero restores the default behavior.
+  void setDefaultParallelism(unsigned Jobs);
 }
 
 #endif
@@ -0,0 +1,72 @@
+//===- raw_mapped_file_ostream.h - Write a file via a mapping ---*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+//  This file defines the raw_mapped_file_ostream class.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_RAW_MAPPED_FILE_OSTREAM_H
+#define LLVM_SUPPORT_RAW_MAPPED_FILE_OSTREAM_H
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
+#include <memory>
+#include <system_error>
+
+namespace llvm {
+
+class FileOutputBuffer;
+
+/// raw_mapped_file_ostream - A raw_pwrite_stream that writes a file through a
+/// memory mapped FileOutputBuffer. Writers that know how large their output
+/// is going to be say so with reserveExtraSpace, and from then on the data
+/// is copied straight into the mapping rather than handed to the kernel one
+/// buffer at a time. Anything written before that, or beyond the reserved
+/// size, is kept in memory and written out normally.
+///
+/// The file is only written by commit(). As with FileOutputBuffer, an
+/// existing file at the path may be removed as soon as the mapping is
+/// created, and a stream destroyed without a commit leaves no file behind.
+class raw_mapped_file_ostream : public raw_pwrite_stream {
+  SmallString<128> Path;
+
+  /// The mapping of the output file, once its size is known. Holds the first
+  /// Pos bytes of the stream.
+  std::unique_ptr<FileOutputBuffer> Buffer;
+  uint64_t Pos;
+
+  /// The contents of the stream while it is not mapped.
+  SmallVector<char, 0> Data;
+
+  /// Move the contents of the mapping into Data and drop the mapping.
+  void unmap();
+
+  /// write_impl - See raw_ostream::write_impl.
+  void write_impl(const char *Ptr, size_t Size) override;
+
+  void pwrite_impl(const char *Ptr, size_t Size, uint64_t Offset) override;
+
+  /// current_pos - Return the current position within the stream, not
+  /// counting the bytes currently in the buffer.
+  uint64_t current_pos() const override;
+
+public:
+  explicit raw_mapped_file_ostream(StringRef Path);
+  ~raw_mapped_file_ostream() override;
+
+  void reserveExtraSpace(uint64_t ExtraSize) override;
+
+  /// commit - Write everything written to the stream to the file.
+  std::error_code commit();
+};
+
+} // end llvm namespace
+
+#endif
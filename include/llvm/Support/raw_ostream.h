@@ -127,6 +127,11 @@ public:
     return OutBufCur - OutBufStart;
   }
 
+  /// Hint that \p ExtraSize more bytes are about to be written, so that the
+  /// stream can make room for all of them at once. This does not change what
+  /// is written.
+  virtual void reserveExtraSpace(uint64_t ExtraSize) {}
+
   //===--------------------------------------------------------------------===//
   // Data Output Interface
   //===--------------------------------------------------------------------===//
@@ -514,6 +519,8 @@ public:
   /// raw_svector_ostream has previously been flushed.
   void resync();
 
+  void reserveExtraSpace(uint64_t ExtraSize) override;
+
   /// Flushes the stream contents to the target vector and return a StringRef
   /// for the vector contents.
   StringRef str();
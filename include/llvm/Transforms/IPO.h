@@ -118,6 +118,12 @@ ModulePass *createInternalizePass(ArrayRef<const char *> ExportList);
 /// createInternalizePass - Same as above, but with an empty exportList.
 ModulePass *createInternalizePass();
 
+//===----------------------------------------------------------------------===//
+/// createFunctionImportPass - This pass imports the definitions of functions
+/// from other modules, as directed by a combined function summary index.
+///
+ModulePass *createFunctionImportPass();
+
 //===----------------------------------------------------------------------===//
 /// createDeadArgEliminationPass - This pass removes arguments from functions
 /// which are not used by the body of the function.
@@ -0,0 +1,64 @@
+//===- FunctionImport.h - Summary-based function importing ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the FunctionImporter, which copies the definitions of
+// small functions from other modules into a module, as guided by a combined
+// function summary index. This lets the per-module backends of summary-based
+// LTO inline across module boundaries without ever loading the whole program.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_IPO_FUNCTIONIMPORT_H
+#define LLVM_TRANSFORMS_IPO_FUNCTIONIMPORT_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include <functional>
+#include <memory>
+
+namespace llvm {
+
+class FunctionInfoIndex;
+class FunctionSummary;
+class Module;
+
+/// The function importer is automatically importing functions from other
+/// modules based on the provided summary information.
+class FunctionImporter {
+public:
+  /// Returns the module with identifier \p Identifier, loaded lazily into the
+  /// context of the module being imported into.
+  typedef std::function<ErrorOr<std::unique_ptr<Module>>(StringRef Identifier)>
+      ModuleLoaderTy;
+
+  /// Create an importer using the combined index \p Index. Functions larger
+  /// than \p InstrLimit instructions are not imported.
+  FunctionImporter(const FunctionInfoIndex &Index, ModuleLoaderTy ModuleLoader,
+                   unsigned InstrLimit);
+
+  /// Import into \p M the definitions of the functions it calls that the
+  /// index says are worth importing, and transitively the functions those
+  /// call. Imported definitions get available_externally linkage. Returns the
+  /// number of functions imported.
+  ErrorOr<unsigned> importFunctions(Module &M);
+
+private:
+  /// Return the definition of \p Name to import into the module at
+  /// \p ModulePath, or null if it should not be imported.
+  const FunctionSummary *selectCallee(StringRef Name,
+                                      StringRef ModulePath) const;
+
+  const FunctionInfoIndex &Index;
+  ModuleLoaderTy ModuleLoader;
+  unsigned InstrLimit;
+};
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,63 @@
+//===- ParallelFunctionPasses.h - Run function passes on threads -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares runFunctionPassesInParallel, which runs a pipeline of
+// function passes over the functions of a module on several threads.
+//
+// Function passes cannot simply run concurrently within one LLVMContext: the
+// constants, types and metadata they create are uniqued in the context, and
+// the use lists of globals and constants are shared by every function. Each
+// thread therefore works on a partition of the module in its own context:
+//
+//   - The module is split with SplitModule into linkable partitions. Constant
+//     globals defined in another partition are given to each partition as
+//     available_externally copies, so that loads from them still fold.
+//   - Every partition is moved to its own context through bitcode, and its
+//     functions are run through a FunctionPassManager on a ThreadPool thread.
+//   - The partitions are linked back together, in partition order, into the
+//     original context. The order of the module's globals, functions, aliases
+//     and static constructors is then restored.
+//
+// The result does not depend on thread scheduling.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_IPO_PARALLELFUNCTIONPASSES_H
+#define LLVM_TRANSFORMS_IPO_PARALLELFUNCTIONPASSES_H
+
+#include <functional>
+#include <memory>
+
+namespace llvm {
+
+class Module;
+
+namespace legacy {
+class FunctionPassManager;
+}
+
+/// Run the function passes that \p AddPasses adds to a FunctionPassManager
+/// over every function defined in \p M, using up to \p ThreadCount threads,
+/// and return the optimized module. It is in the context of \p M, which it
+/// replaces.
+///
+/// \p AddPasses is called once per partition, concurrently from several
+/// threads, and must create new passes every time. Anything shared between
+/// the calls, such as a TargetMachine, must be safe to use from several
+/// threads.
+///
+/// Modules with debug info are optimized on the calling thread: the partitions
+/// would each carry a copy of the compile units.
+std::unique_ptr<Module> runFunctionPassesInParallel(
+    std::unique_ptr<Module> M, unsigned ThreadCount,
+    std::function<void(legacy::FunctionPassManager &FPM)> AddPasses);
+
+} // End llvm namespace
+
+#endif
@@ -0,0 +1,48 @@
+//===- SplitModule.h - Split a module into partitions -----------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the function llvm::SplitModule, which splits a module
+// into multiple linkable partitions. It can be used to implement parallel code
+// generation for link-time optimization.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
+#define LLVM_TRANSFORMS_UTILS_SPLITMODULE_H
+
+#include <functional>
+#include <memory>
+
+namespace llvm {
+
+class Module;
+
+/// Splits the module M into N linkable partitions. The function ModuleCallback
+/// is called N times passing each individual partition as the MPart argument,
+/// in partition order.
+///
+/// Global values are never split from the values they must be emitted with:
+/// every member of a comdat, every alias and its aliasee, and every symbol with
+/// local linkage together with all of its users end up in the same partition.
+/// This keeps local symbols local, so the partitions can be linked together
+/// without renaming anything. The resulting groups are distributed over the
+/// partitions so as to balance their instruction counts.
+///
+/// Appending globals such as llvm.global_ctors and llvm.used are split as well:
+/// each partition receives the entries that refer to its own definitions.
+/// Module-level inline asm is only emitted into the first partition.
+///
+/// M itself is not modified.
+void SplitModule(
+    const Module &M, unsigned N,
+    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback);
+
+} // End llvm namespace
+
+#endif
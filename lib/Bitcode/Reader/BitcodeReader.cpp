@@ -20,6 +20,7 @@
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/GVMaterializer.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/IntrinsicInst.h"
@@ -28,14 +29,21 @@
 #include "llvm/IR/OperandTraits.h"
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DataStream.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <deque>
 using namespace llvm;
 
+static cl::opt<unsigned> DecodeThreads(
+    "bitcode-decode-threads", cl::Hidden, cl::init(0),
+    cl::desc("Number of threads decoding the function blocks ahead of the "
+             "bitcode reader when a whole module is materialized"));
+
 namespace {
 enum {
   SWITCH_INST_MAGIC = 0x4B5 // May 2012 => 1205 => Hex
@@ -100,6 +108,9 @@ class BitcodeReaderMDValueList {
   unsigned MaxFwdRef;
   std::vector<TrackingMDRef> MDValuePtrs;
 
+  /// The IDs that placeholders were created for, to load them on demand.
+  std::vector<unsigned> PendingFwdRefs;
+
   LLVMContext &Context;
 public:
   BitcodeReaderMDValueList(LLVMContext &C)
@@ -109,7 +120,10 @@ public:
   unsigned size() const       { return MDValuePtrs.size(); }
   void resize(unsigned N)     { MDValuePtrs.resize(N); }
   void push_back(Metadata *MD) { MDValuePtrs.emplace_back(MD); }
-  void clear()                { MDValuePtrs.clear();  }
+  void clear() {
+    MDValuePtrs.clear();
+    PendingFwdRefs.clear();
+  }
   Metadata *back() const      { return MDValuePtrs.back(); }
   void pop_back()             { MDValuePtrs.pop_back(); }
   bool empty() const          { return MDValuePtrs.empty(); }
@@ -124,18 +138,241 @@ public:
     MDValuePtrs.resize(N);
   }
 
+  /// Return true if the metadata \p Idx has been read, and is not just a
+  /// placeholder for a forward reference.
+  bool isLoaded(unsigned Idx) const {
+    if (Idx >= size() || !MDValuePtrs[Idx])
+      return false;
+    auto *N = dyn_cast<MDNode>(MDValuePtrs[Idx]);
+    return !N || !N->isTemporary();
+  }
+
+  /// Take one of the IDs a placeholder was created for since the last call.
+  /// Return false if there are none left.
+  bool popPendingFwdRef(unsigned &Idx) {
+    if (PendingFwdRefs.empty())
+      return false;
+    Idx = PendingFwdRefs.back();
+    PendingFwdRefs.pop_back();
+    return true;
+  }
+
   Metadata *getValueFwdRef(unsigned Idx);
   void assignValue(Metadata *MD, unsigned Idx);
   void tryToResolveCycles();
 };
 
+/// The entries of a block read ahead of time, including the blocks nested in
+/// it.
+struct DecodedBlock {
+  struct Entry {
+    BitstreamEntry Kind;
+    /// The code of a record, or the index of the entry that follows the end of
+    /// a sub-block.
+    unsigned Code;
+    unsigned FirstOp;
+    unsigned NumOps;
+    /// The blob of a record, which points into the bitcode buffer.
+    StringRef Blob;
+  };
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> Ops;
+};
+
+/// Decode the block with ID \p BlockID that \p Cursor is at, right after its
+/// block ID, into \p Block.  Return true on failure.
+static bool decodeBlock(BitstreamCursor &Cursor, unsigned BlockID,
+                        DecodedBlock &Block) {
+  if (Cursor.EnterSubBlock(BlockID))
+    return true;
+
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    BitstreamEntry Entry = Cursor.advance();
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return true;
+    case BitstreamEntry::EndBlock:
+      Block.Entries.push_back({Entry, 0, 0, 0, StringRef()});
+      return false;
+    case BitstreamEntry::SubBlock: {
+      size_t Index = Block.Entries.size();
+      Block.Entries.push_back({Entry, 0, 0, 0, StringRef()});
+      if (decodeBlock(Cursor, Entry.ID, Block))
+        return true;
+      Block.Entries[Index].Code = Block.Entries.size();
+      break;
+    }
+    case BitstreamEntry::Record: {
+      Record.clear();
+      StringRef Blob;
+      unsigned Code = Cursor.readRecord(Entry.ID, Record, &Blob);
+      Block.Entries.push_back({Entry, Code, (unsigned)Block.Ops.size(),
+                               (unsigned)Record.size(), Blob});
+      Block.Ops.insert(Block.Ops.end(), Record.begin(), Record.end());
+      break;
+    }
+    }
+  }
+}
+
+/// A bitstream cursor that can replay a block decoded ahead of time in place
+/// of reading its bits.  Only the operations the reader uses inside function
+/// blocks are replayed.
+class BitcodeCursor : public BitstreamCursor {
+  const DecodedBlock *Replay = nullptr;
+  unsigned NextEntry = 0;
+  unsigned Depth = 0;
+
+public:
+  /// Replay \p Block as if the cursor were right after its block ID.  The
+  /// replay stops at the end of the block.
+  void replay(const DecodedBlock &Block) {
+    Replay = &Block;
+    NextEntry = 0;
+    Depth = 0;
+  }
+  void stopReplay() { Replay = nullptr; }
+
+  BitstreamEntry advance(unsigned Flags = 0) {
+    if (!Replay)
+      return BitstreamCursor::advance(Flags);
+    assert(!Flags && "Unsupported flags when replaying a block");
+    assert(NextEntry < Replay->Entries.size() && "Reading past the block");
+    BitstreamEntry Entry = Replay->Entries[NextEntry++].Kind;
+    if (Entry.Kind == BitstreamEntry::EndBlock && --Depth == 0)
+      Replay = nullptr;
+    return Entry;
+  }
+
+  BitstreamEntry advanceSkippingSubblocks(unsigned Flags = 0) {
+    if (!Replay)
+      return BitstreamCursor::advanceSkippingSubblocks(Flags);
+    while (1) {
+      BitstreamEntry Entry = advance(Flags);
+      if (Entry.Kind != BitstreamEntry::SubBlock)
+        return Entry;
+      if (SkipBlock())
+        return BitstreamEntry::getError();
+    }
+  }
+
+  bool EnterSubBlock(unsigned BlockID, unsigned *NumWordsP = nullptr) {
+    if (!Replay)
+      return BitstreamCursor::EnterSubBlock(BlockID, NumWordsP);
+    assert(!NumWordsP && "Block size unknown when replaying a block");
+    ++Depth;
+    return false;
+  }
+
+  bool SkipBlock() {
+    if (!Replay)
+      return BitstreamCursor::SkipBlock();
+    NextEntry = Replay->Entries[NextEntry - 1].Code;
+    return false;
+  }
+
+  unsigned readRecord(unsigned AbbrevID, SmallVectorImpl<uint64_t> &Vals,
+                      StringRef *Blob = nullptr) {
+    if (!Replay)
+      return BitstreamCursor::readRecord(AbbrevID, Vals, Blob);
+    const DecodedBlock::Entry &Entry = Replay->Entries[NextEntry - 1];
+    const uint64_t *Ops = Replay->Ops.data() + Entry.FirstOp;
+    Vals.append(Ops, Ops + Entry.NumOps);
+    if (Blob)
+      *Blob = Entry.Blob;
+    return Entry.Code;
+  }
+};
+
+/// Decodes the function blocks of a module on worker threads, ahead of the
+/// reader building the functions one after another.  At most a few blocks per
+/// thread are decoded ahead, to bound the memory they take.
+class FunctionBlockDecoder {
+  struct Job {
+    uint64_t Bit;
+    DecodedBlock Block;
+    bool Failed = false;
+    std::shared_future<void> Done;
+  };
+  const MemoryObject &Bytes;
+  uint64_t BlockInfoBit;
+  std::vector<Job> Jobs;
+  DenseMap<const Function *, unsigned> JobIndex;
+  unsigned NextJob = 0;
+  unsigned Window;
+  ThreadPool Pool;
+
+  void decode(Job &J) {
+    // Each thread reads the block info on its own, since the abbreviations
+    // of a reader are reference counted without synchronization.
+    uint64_t Size = Bytes.getExtent();
+    const unsigned char *Start = Bytes.getPointer(0, Size);
+    BitstreamReader Reader(Start, Start + Size);
+    BitstreamCursor Cursor(Reader);
+    if (BlockInfoBit) {
+      Cursor.JumpToBit(BlockInfoBit);
+      if (Cursor.ReadBlockInfoBlock()) {
+        J.Failed = true;
+        return;
+      }
+    }
+    Cursor.JumpToBit(J.Bit);
+    J.Failed = decodeBlock(Cursor, bitc::FUNCTION_BLOCK_ID, J.Block);
+  }
+
+  /// Keep the blocks that follow the first \p Consumed ones decoding.
+  void submit(unsigned Consumed) {
+    for (unsigned E = std::min<unsigned>(Jobs.size(), Consumed + Window);
+         NextJob < E; ++NextJob) {
+      Job &J = Jobs[NextJob];
+      J.Done = Pool.async([this, &J] { decode(J); });
+    }
+  }
+
+public:
+  /// Decode the blocks at the positions of \p Functions, in that order.
+  /// \p BlockInfoBit is the position of the block info block, or 0.
+  FunctionBlockDecoder(
+      const MemoryObject &Bytes, uint64_t BlockInfoBit,
+      ArrayRef<std::pair<const Function *, uint64_t>> Functions,
+      unsigned ThreadCount)
+      : Bytes(Bytes), BlockInfoBit(BlockInfoBit), Jobs(Functions.size()),
+        Window(4 * ThreadCount), Pool(ThreadCount) {
+    for (unsigned I = 0, E = Functions.size(); I != E; ++I) {
+      Jobs[I].Bit = Functions[I].second;
+      JobIndex[Functions[I].first] = I;
+    }
+    submit(0);
+  }
+
+  /// Wait for the block of \p F to be decoded and return it, or return null
+  /// if \p F is read from the bitstream instead.
+  const DecodedBlock *getBlock(const Function *F) {
+    auto I = JobIndex.find(F);
+    if (I == JobIndex.end() || I->second >= NextJob)
+      return nullptr;
+    submit(I->second + 1);
+    Job &J = Jobs[I->second];
+    J.Done.wait();
+    return J.Failed ? nullptr : &J.Block;
+  }
+
+  /// Free the block of \p F once it has been parsed.
+  void releaseBlock(const Function *F) {
+    auto I = JobIndex.find(F);
+    if (I != JobIndex.end() && I->second < NextJob)
+      Jobs[I->second].Block = DecodedBlock();
+  }
+};
+
 class BitcodeReader : public GVMaterializer {
   LLVMContext &Context;
   DiagnosticHandlerFunction DiagnosticHandler;
   Module *TheModule = nullptr;
   std::unique_ptr<MemoryBuffer> Buffer;
   std::unique_ptr<BitstreamReader> StreamFile;
-  BitstreamCursor Stream;
+  BitcodeCursor Stream;
   bool IsStreamed;
   uint64_t NextUnreadBit = 0;
   bool SeenValueSymbolTable = false;
@@ -190,6 +427,26 @@ class BitcodeReader : public GVMaterializer {
   /// which Metadata blocks are deferred.
   std::vector<uint64_t> DeferredMetadataInfo;
 
+  /// The position of the block info block, or 0 if there is none.
+  uint64_t BlockInfoBit = 0;
+
+  /// While materializing the whole module, this decodes the function blocks
+  /// ahead of parsing them.
+  std::unique_ptr<FunctionBlockDecoder> FunctionDecoder;
+
+  /// When the deferred module-level metadata block has an index, its records
+  /// are read on demand through this cursor: the metadata with ID
+  /// MetadataIndexFirstID + I is at bit MetadataIndex[I] of the stream.  The
+  /// strings of the block, which come first, are read along with the index,
+  /// from MetadataBlockFirstID on.  The index is dropped once the whole block
+  /// has been parsed.
+  BitstreamCursor MetadataCursor;
+  std::vector<uint64_t> MetadataIndex;
+  unsigned MetadataBlockFirstID = 0;
+  unsigned MetadataIndexFirstID = 0;
+  uint64_t MetadataIndexBlockBit = 0;
+  bool IsLazyMetadataPrepared = false;
+
   /// These are basic blocks forward-referenced by block addresses.  They are
   /// inserted lazily into functions when they're loaded.  The basic block ID is
   /// its index into the vector.
@@ -365,7 +622,19 @@ private:
   std::error_code parseFunctionBody(Function *F);
   std::error_code globalCleanup();
   std::error_code resolveGlobalAndAliasInits();
-  std::error_code parseMetadata();
+  std::error_code parseMetadata(unsigned NextMDValueNo);
+  std::error_code parseMetadataRecord(BitstreamCursor &Cursor, unsigned Code,
+                                      SmallVectorImpl<uint64_t> &Record,
+                                      StringRef Blob, unsigned &NextMDValueNo);
+  std::error_code parseMetadataStrings(ArrayRef<uint64_t> Record,
+                                       StringRef Blob, unsigned &NextMDValueNo);
+  std::error_code prepareLazyMetadata();
+  std::error_code parseMetadataIndex(uint64_t BlockBit, bool &HasIndex);
+  bool isLazyMetadata(unsigned ID) const {
+    return ID - MetadataIndexFirstID < MetadataIndex.size();
+  }
+  std::error_code loadMetadataRecord(unsigned ID);
+  std::error_code loadPendingMetadata();
   std::error_code parseMetadataAttachment(Function &F);
   ErrorOr<std::string> parseModuleTriple();
   std::error_code parseUseLists();
@@ -482,6 +751,7 @@ void BitcodeReader::freeState() {
   std::vector<Function*>().swap(FunctionsWithBodies);
   DeferredFunctionInfo.clear();
   DeferredMetadataInfo.clear();
+  std::vector<uint64_t>().swap(MetadataIndex);
   MDKindMap.clear();
 
   assert(BasicBlockFwdRefs.empty() && "Unresolved blockaddress fwd references");
@@ -928,6 +1198,7 @@ Metadata *BitcodeReaderMDValueList::getValueFwdRef(unsigned Idx) {
     MinFwdRef = MaxFwdRef = Idx;
   }
   ++NumFwdRefs;
+  PendingFwdRefs.push_back(Idx);
 
   // Create and return a placeholder, which will later be RAUW'd.
   Metadata *MD = MDNode::getTemporary(Context, None).release();
@@ -1575,31 +1846,69 @@ std::error_code BitcodeReader::parseValueSymbolTable() {
 
 static int64_t unrotateSign(uint64_t U) { return U & 1 ? ~(U >> 1) : U >> 1; }
 
-std::error_code BitcodeReader::parseMetadata() {
+/// Return true if the metadata record \p Code defines the next metadata ID.
+static bool isMetadataDefinition(unsigned Code) {
+  switch (Code) {
+  default:
+    return Code >= bitc::METADATA_GENERIC_DEBUG &&
+           Code <= bitc::METADATA_IMPORTED_ENTITY;
+  case bitc::METADATA_STRING:
+  case bitc::METADATA_VALUE:
+  case bitc::METADATA_NODE:
+  case bitc::METADATA_DISTINCT_NODE:
+  case bitc::METADATA_LOCATION:
+  case bitc::METADATA_OLD_NODE:
+  case bitc::METADATA_OLD_FN_NODE:
+    return true;
+  }
+}
+
+/// Parse a METADATA_STRINGS record: the blob holds the VBR6-encoded lengths of
+/// the strings, and the characters of all the strings from the offset in the
+/// record on.  The strings are read straight from the blob.
+std::error_code BitcodeReader::parseMetadataStrings(ArrayRef<uint64_t> Record,
+                                                    StringRef Blob,
+                                                    unsigned &NextMDValueNo) {
+  if (Record.size() != 2)
+    return error("Invalid record");
+
+  unsigned NumStrings = Record[0];
+  unsigned StringsOffset = Record[1];
+  if (!NumStrings)
+    return error("Invalid record");
+  if (StringsOffset > Blob.size() || StringsOffset % 4)
+    return error("Invalid record");
+
+  StringRef Lengths = Blob.slice(0, StringsOffset);
+  BitstreamReader LengthsReader((const unsigned char *)Lengths.begin(),
+                                (const unsigned char *)Lengths.end());
+  BitstreamCursor LengthsCursor(LengthsReader);
+
+  StringRef Strings = Blob.drop_front(StringsOffset);
+  do {
+    if (LengthsCursor.AtEndOfStream())
+      return error("Invalid record");
+
+    unsigned Size = LengthsCursor.ReadVBR(6);
+    if (Strings.size() < Size)
+      return error("Invalid record");
+
+    MDValueList.assignValue(MDString::get(Context, Strings.slice(0, Size)),
+                            NextMDValueNo++);
+    Strings = Strings.drop_front(Size);
+  } while (--NumStrings);
+
+  return std::error_code();
+}
+
+std::error_code BitcodeReader::parseMetadata(unsigned NextMDValueNo) {
   IsMetadataMaterialized = true;
-  unsigned NextMDValueNo = MDValueList.size();
 
   if (Stream.EnterSubBlock(bitc::METADATA_BLOCK_ID))
     return error("Invalid record");
 
   SmallVector<uint64_t, 64> Record;
 
-  auto getMD =
-      [&](unsigned ID) -> Metadata *{ return MDValueList.getValueFwdRef(ID); };
-  auto getMDOrNull = [&](unsigned ID) -> Metadata *{
-    if (ID)
-      return getMD(ID - 1);
-    return nullptr;
-  };
-  auto getMDString = [&](unsigned ID) -> MDString *{
-    // This requires that the ID is not really a forward reference.  In
-    // particular, the MDString must already have been resolved.
-    return cast_or_null<MDString>(getMDOrNull(ID));
-  };
-
-#define GET_OR_DISTINCT(CLASS, DISTINCT, ARGS)                                 \
-  (DISTINCT ? CLASS::getDistinct ARGS : CLASS::get ARGS)
-
   // Read all the records.
   while (1) {
     BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
@@ -1609,6 +1918,9 @@ std::error_code BitcodeReader::parseMetadata() {
     case BitstreamEntry::Error:
       return error("Malformed block");
     case BitstreamEntry::EndBlock:
+      // Load the indexed metadata that the block refers to.
+      if (std::error_code EC = loadPendingMetadata())
+        return EC;
       MDValueList.tryToResolveCycles();
       return std::error_code();
     case BitstreamEntry::Record:
@@ -1616,401 +1928,450 @@ std::error_code BitcodeReader::parseMetadata() {
       break;
     }
 
-    // Read a record.
+    // Read a record, unless it was already loaded through the index.
     Record.clear();
-    unsigned Code = Stream.readRecord(Entry.ID, Record);
-    bool IsDistinct = false;
-    switch (Code) {
-    default:  // Default behavior: ignore.
-      break;
-    case bitc::METADATA_NAME: {
-      // Read name of the named metadata.
-      SmallString<8> Name(Record.begin(), Record.end());
-      Record.clear();
-      Code = Stream.ReadCode();
-
-      unsigned NextBitCode = Stream.readRecord(Code, Record);
-      if (NextBitCode != bitc::METADATA_NAMED_NODE)
-        return error("METADATA_NAME not followed by METADATA_NAMED_NODE");
-
-      // Read named metadata elements.
-      unsigned Size = Record.size();
-      NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
-      for (unsigned i = 0; i != Size; ++i) {
-        MDNode *MD = dyn_cast_or_null<MDNode>(MDValueList.getValueFwdRef(Record[i]));
-        if (!MD)
-          return error("Invalid record");
-        NMD->addOperand(MD);
-      }
-      break;
+    StringRef Blob;
+    unsigned Code = Stream.readRecord(Entry.ID, Record, &Blob);
+    if (isMetadataDefinition(Code) && MDValueList.isLoaded(NextMDValueNo)) {
+      ++NextMDValueNo;
+      continue;
     }
-    case bitc::METADATA_OLD_FN_NODE: {
-      // FIXME: Remove in 4.0.
-      // This is a LocalAsMetadata record, the only type of function-local
-      // metadata.
-      if (Record.size() % 2 == 1)
-        return error("Invalid record");
+    if (Code == bitc::METADATA_STRINGS && !Record.empty() &&
+        MDValueList.isLoaded(NextMDValueNo)) {
+      NextMDValueNo += Record[0];
+      continue;
+    }
+    if (std::error_code EC =
+            parseMetadataRecord(Stream, Code, Record, Blob, NextMDValueNo))
+      return EC;
+  }
+}
 
-      // If this isn't a LocalAsMetadata record, we're dropping it.  This used
-      // to be legal, but there's no upgrade path.
-      auto dropRecord = [&] {
-        MDValueList.assignValue(MDNode::get(Context, None), NextMDValueNo++);
-      };
-      if (Record.size() != 2) {
-        dropRecord();
-        break;
+/// Parse the metadata record \p Code just read from \p Cursor, which defines
+/// the metadata \p NextMDValueNo if it defines any.
+std::error_code
+BitcodeReader::parseMetadataRecord(BitstreamCursor &Cursor, unsigned Code,
+                                   SmallVectorImpl<uint64_t> &Record,
+                                   StringRef Blob, unsigned &NextMDValueNo) {
+  std::error_code StringEC;
+  auto getMD =
+      [&](unsigned ID) -> Metadata *{ return MDValueList.getValueFwdRef(ID); };
+  auto getMDOrNull = [&](unsigned ID) -> Metadata *{
+    if (ID)
+      return getMD(ID - 1);
+    return nullptr;
+  };
+  auto getMDString = [&](unsigned ID) -> MDString *{
+    // This requires that the ID is not really a forward reference.  In
+    // particular, the MDString must already have been resolved, so read it
+    // right away if it comes from the index.
+    if (ID && isLazyMetadata(ID - 1) && !MDValueList.isLoaded(ID - 1))
+      if (std::error_code EC = loadMetadataRecord(ID - 1)) {
+        StringEC = EC;
+        return nullptr;
       }
+    return cast_or_null<MDString>(getMDOrNull(ID));
+  };
 
-      Type *Ty = getTypeByID(Record[0]);
-      if (Ty->isMetadataTy() || Ty->isVoidTy()) {
-        dropRecord();
-        break;
-      }
+#define GET_OR_DISTINCT(CLASS, DISTINCT, ARGS)                                 \
+  (DISTINCT ? CLASS::getDistinct ARGS : CLASS::get ARGS)
 
-      MDValueList.assignValue(
-          LocalAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_OLD_NODE: {
-      // FIXME: Remove in 4.0.
-      if (Record.size() % 2 == 1)
-        return error("Invalid record");
+  bool IsDistinct = false;
+  switch (Code) {
+  default:  // Default behavior: ignore.
+    break;
+  case bitc::METADATA_NAME: {
+    // Read name of the named metadata.
+    SmallString<8> Name(Record.begin(), Record.end());
+    Record.clear();
+    Code = Cursor.ReadCode();
 
-      unsigned Size = Record.size();
-      SmallVector<Metadata *, 8> Elts;
-      for (unsigned i = 0; i != Size; i += 2) {
-        Type *Ty = getTypeByID(Record[i]);
-        if (!Ty)
-          return error("Invalid record");
-        if (Ty->isMetadataTy())
-          Elts.push_back(MDValueList.getValueFwdRef(Record[i+1]));
-        else if (!Ty->isVoidTy()) {
-          auto *MD =
-              ValueAsMetadata::get(ValueList.getValueFwdRef(Record[i + 1], Ty));
-          assert(isa<ConstantAsMetadata>(MD) &&
-                 "Expected non-function-local metadata");
-          Elts.push_back(MD);
-        } else
-          Elts.push_back(nullptr);
-      }
-      MDValueList.assignValue(MDNode::get(Context, Elts), NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_VALUE: {
-      if (Record.size() != 2)
-        return error("Invalid record");
+    unsigned NextBitCode = Cursor.readRecord(Code, Record);
+    if (NextBitCode != bitc::METADATA_NAMED_NODE)
+      return error("METADATA_NAME not followed by METADATA_NAMED_NODE");
 
-      Type *Ty = getTypeByID(Record[0]);
-      if (Ty->isMetadataTy() || Ty->isVoidTy())
+    // Read named metadata elements.
+    unsigned Size = Record.size();
+    NamedMDNode *NMD = TheModule->getOrInsertNamedMetadata(Name);
+    for (unsigned i = 0; i != Size; ++i) {
+      MDNode *MD = dyn_cast_or_null<MDNode>(MDValueList.getValueFwdRef(Record[i]));
+      if (!MD)
         return error("Invalid record");
-
-      MDValueList.assignValue(
-          ValueAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
-          NextMDValueNo++);
-      break;
+      NMD->addOperand(MD);
     }
-    case bitc::METADATA_DISTINCT_NODE:
-      IsDistinct = true;
-      // fallthrough...
-    case bitc::METADATA_NODE: {
-      SmallVector<Metadata *, 8> Elts;
-      Elts.reserve(Record.size());
-      for (unsigned ID : Record)
-        Elts.push_back(ID ? MDValueList.getValueFwdRef(ID - 1) : nullptr);
-      MDValueList.assignValue(IsDistinct ? MDNode::getDistinct(Context, Elts)
-                                         : MDNode::get(Context, Elts),
-                              NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_OLD_FN_NODE: {
+    // FIXME: Remove in 4.0.
+    // This is a LocalAsMetadata record, the only type of function-local
+    // metadata.
+    if (Record.size() % 2 == 1)
+      return error("Invalid record");
+
+    // If this isn't a LocalAsMetadata record, we're dropping it.  This used
+    // to be legal, but there's no upgrade path.
+    auto dropRecord = [&] {
+      MDValueList.assignValue(MDNode::get(Context, None), NextMDValueNo++);
+    };
+    if (Record.size() != 2) {
+      dropRecord();
       break;
     }
-    case bitc::METADATA_LOCATION: {
-      if (Record.size() != 5)
-        return error("Invalid record");
 
-      unsigned Line = Record[1];
-      unsigned Column = Record[2];
-      MDNode *Scope = cast<MDNode>(MDValueList.getValueFwdRef(Record[3]));
-      Metadata *InlinedAt =
-          Record[4] ? MDValueList.getValueFwdRef(Record[4] - 1) : nullptr;
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DILocation, Record[0],
-                          (Context, Line, Column, Scope, InlinedAt)),
-          NextMDValueNo++);
+    Type *Ty = getTypeByID(Record[0]);
+    if (Ty->isMetadataTy() || Ty->isVoidTy()) {
+      dropRecord();
       break;
     }
-    case bitc::METADATA_GENERIC_DEBUG: {
-      if (Record.size() < 4)
-        return error("Invalid record");
 
-      unsigned Tag = Record[1];
-      unsigned Version = Record[2];
+    MDValueList.assignValue(
+        LocalAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_OLD_NODE: {
+    // FIXME: Remove in 4.0.
+    if (Record.size() % 2 == 1)
+      return error("Invalid record");
 
-      if (Tag >= 1u << 16 || Version != 0)
+    unsigned Size = Record.size();
+    SmallVector<Metadata *, 8> Elts;
+    for (unsigned i = 0; i != Size; i += 2) {
+      Type *Ty = getTypeByID(Record[i]);
+      if (!Ty)
         return error("Invalid record");
-
-      auto *Header = getMDString(Record[3]);
-      SmallVector<Metadata *, 8> DwarfOps;
-      for (unsigned I = 4, E = Record.size(); I != E; ++I)
-        DwarfOps.push_back(Record[I] ? MDValueList.getValueFwdRef(Record[I] - 1)
-                                     : nullptr);
-      MDValueList.assignValue(GET_OR_DISTINCT(GenericDINode, Record[0],
-                                              (Context, Tag, Header, DwarfOps)),
-                              NextMDValueNo++);
-      break;
+      if (Ty->isMetadataTy())
+        Elts.push_back(MDValueList.getValueFwdRef(Record[i+1]));
+      else if (!Ty->isVoidTy()) {
+        auto *MD =
+            ValueAsMetadata::get(ValueList.getValueFwdRef(Record[i + 1], Ty));
+        assert(isa<ConstantAsMetadata>(MD) &&
+               "Expected non-function-local metadata");
+        Elts.push_back(MD);
+      } else
+        Elts.push_back(nullptr);
     }
-    case bitc::METADATA_SUBRANGE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    MDValueList.assignValue(MDNode::get(Context, Elts), NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_VALUE: {
+    if (Record.size() != 2)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DISubrange, Record[0],
-                          (Context, Record[1], unrotateSign(Record[2]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_ENUMERATOR: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    Type *Ty = getTypeByID(Record[0]);
+    if (Ty->isMetadataTy() || Ty->isVoidTy())
+      return error("Invalid record");
 
-      MDValueList.assignValue(GET_OR_DISTINCT(DIEnumerator, Record[0],
-                                              (Context, unrotateSign(Record[1]),
-                                               getMDString(Record[2]))),
-                              NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_BASIC_TYPE: {
-      if (Record.size() != 6)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        ValueAsMetadata::get(ValueList.getValueFwdRef(Record[1], Ty)),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_DISTINCT_NODE:
+    IsDistinct = true;
+    // fallthrough...
+  case bitc::METADATA_NODE: {
+    SmallVector<Metadata *, 8> Elts;
+    Elts.reserve(Record.size());
+    for (unsigned ID : Record)
+      Elts.push_back(ID ? MDValueList.getValueFwdRef(ID - 1) : nullptr);
+    MDValueList.assignValue(IsDistinct ? MDNode::getDistinct(Context, Elts)
+                                       : MDNode::get(Context, Elts),
+                            NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_LOCATION: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIBasicType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           Record[3], Record[4], Record[5])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_DERIVED_TYPE: {
-      if (Record.size() != 12)
-        return error("Invalid record");
+    unsigned Line = Record[1];
+    unsigned Column = Record[2];
+    MDNode *Scope = cast<MDNode>(MDValueList.getValueFwdRef(Record[3]));
+    Metadata *InlinedAt =
+        Record[4] ? MDValueList.getValueFwdRef(Record[4] - 1) : nullptr;
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DILocation, Record[0],
+                        (Context, Line, Column, Scope, InlinedAt)),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_GENERIC_DEBUG: {
+    if (Record.size() < 4)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIDerivedType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDOrNull(Record[5]), getMDOrNull(Record[6]),
-                           Record[7], Record[8], Record[9], Record[10],
-                           getMDOrNull(Record[11]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_COMPOSITE_TYPE: {
-      if (Record.size() != 16)
-        return error("Invalid record");
+    unsigned Tag = Record[1];
+    unsigned Version = Record[2];
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DICompositeType, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDOrNull(Record[5]), getMDOrNull(Record[6]),
-                           Record[7], Record[8], Record[9], Record[10],
-                           getMDOrNull(Record[11]), Record[12],
-                           getMDOrNull(Record[13]), getMDOrNull(Record[14]),
-                           getMDString(Record[15]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_SUBROUTINE_TYPE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    if (Tag >= 1u << 16 || Version != 0)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DISubroutineType, Record[0],
-                          (Context, Record[1], getMDOrNull(Record[2]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_FILE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    auto *Header = getMDString(Record[3]);
+    SmallVector<Metadata *, 8> DwarfOps;
+    for (unsigned I = 4, E = Record.size(); I != E; ++I)
+      DwarfOps.push_back(Record[I] ? MDValueList.getValueFwdRef(Record[I] - 1)
+                                   : nullptr);
+    MDValueList.assignValue(GET_OR_DISTINCT(GenericDINode, Record[0],
+                                            (Context, Tag, Header, DwarfOps)),
+                            NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_SUBRANGE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIFile, Record[0], (Context, getMDString(Record[1]),
-                                              getMDString(Record[2]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_COMPILE_UNIT: {
-      if (Record.size() < 14 || Record.size() > 15)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DISubrange, Record[0],
+                        (Context, Record[1], unrotateSign(Record[2]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_ENUMERATOR: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(
-              DICompileUnit, Record[0],
-              (Context, Record[1], getMDOrNull(Record[2]),
-               getMDString(Record[3]), Record[4], getMDString(Record[5]),
-               Record[6], getMDString(Record[7]), Record[8],
-               getMDOrNull(Record[9]), getMDOrNull(Record[10]),
-               getMDOrNull(Record[11]), getMDOrNull(Record[12]),
-               getMDOrNull(Record[13]), Record.size() == 14 ? 0 : Record[14])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_SUBPROGRAM: {
-      if (Record.size() != 19)
-        return error("Invalid record");
+    MDValueList.assignValue(GET_OR_DISTINCT(DIEnumerator, Record[0],
+                                            (Context, unrotateSign(Record[1]),
+                                             getMDString(Record[2]))),
+                            NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_BASIC_TYPE: {
+    if (Record.size() != 6)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(
-              DISubprogram, Record[0],
-              (Context, getMDOrNull(Record[1]), getMDString(Record[2]),
-               getMDString(Record[3]), getMDOrNull(Record[4]), Record[5],
-               getMDOrNull(Record[6]), Record[7], Record[8], Record[9],
-               getMDOrNull(Record[10]), Record[11], Record[12], Record[13],
-               Record[14], getMDOrNull(Record[15]), getMDOrNull(Record[16]),
-               getMDOrNull(Record[17]), getMDOrNull(Record[18]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_LEXICAL_BLOCK: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIBasicType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         Record[3], Record[4], Record[5])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_DERIVED_TYPE: {
+    if (Record.size() != 12)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DILexicalBlock, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), Record[3], Record[4])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_LEXICAL_BLOCK_FILE: {
-      if (Record.size() != 4)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIDerivedType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDOrNull(Record[5]), getMDOrNull(Record[6]),
+                         Record[7], Record[8], Record[9], Record[10],
+                         getMDOrNull(Record[11]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_COMPOSITE_TYPE: {
+    if (Record.size() != 16)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DILexicalBlockFile, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), Record[3])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_NAMESPACE: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DICompositeType, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDOrNull(Record[5]), getMDOrNull(Record[6]),
+                         Record[7], Record[8], Record[9], Record[10],
+                         getMDOrNull(Record[11]), Record[12],
+                         getMDOrNull(Record[13]), getMDOrNull(Record[14]),
+                         getMDString(Record[15]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_SUBROUTINE_TYPE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DINamespace, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDOrNull(Record[2]), getMDString(Record[3]),
-                           Record[4])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_TEMPLATE_TYPE: {
-      if (Record.size() != 3)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DISubroutineType, Record[0],
+                        (Context, Record[1], getMDOrNull(Record[2]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_FILE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MDValueList.assignValue(GET_OR_DISTINCT(DITemplateTypeParameter,
-                                              Record[0],
-                                              (Context, getMDString(Record[1]),
-                                               getMDOrNull(Record[2]))),
-                              NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_TEMPLATE_VALUE: {
-      if (Record.size() != 5)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIFile, Record[0], (Context, getMDString(Record[1]),
+                                            getMDString(Record[2]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_COMPILE_UNIT: {
+    if (Record.size() < 14 || Record.size() > 15)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DITemplateValueParameter, Record[0],
-                          (Context, Record[1], getMDString(Record[2]),
-                           getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_GLOBAL_VAR: {
-      if (Record.size() != 11)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(
+            DICompileUnit, Record[0],
+            (Context, Record[1], getMDOrNull(Record[2]),
+             getMDString(Record[3]), Record[4], getMDString(Record[5]),
+             Record[6], getMDString(Record[7]), Record[8],
+             getMDOrNull(Record[9]), getMDOrNull(Record[10]),
+             getMDOrNull(Record[11]), getMDOrNull(Record[12]),
+             getMDOrNull(Record[13]), Record.size() == 14 ? 0 : Record[14])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_SUBPROGRAM: {
+    if (Record.size() != 19)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIGlobalVariable, Record[0],
-                          (Context, getMDOrNull(Record[1]),
-                           getMDString(Record[2]), getMDString(Record[3]),
-                           getMDOrNull(Record[4]), Record[5],
-                           getMDOrNull(Record[6]), Record[7], Record[8],
-                           getMDOrNull(Record[9]), getMDOrNull(Record[10]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_LOCAL_VAR: {
-      // 10th field is for the obseleted 'inlinedAt:' field.
-      if (Record.size() != 9 && Record.size() != 10)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(
+            DISubprogram, Record[0],
+            (Context, getMDOrNull(Record[1]), getMDString(Record[2]),
+             getMDString(Record[3]), getMDOrNull(Record[4]), Record[5],
+             getMDOrNull(Record[6]), Record[7], Record[8], Record[9],
+             getMDOrNull(Record[10]), Record[11], Record[12], Record[13],
+             Record[14], getMDOrNull(Record[15]), getMDOrNull(Record[16]),
+             getMDOrNull(Record[17]), getMDOrNull(Record[18]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_LEXICAL_BLOCK: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DILocalVariable, Record[0],
-                          (Context, Record[1], getMDOrNull(Record[2]),
-                           getMDString(Record[3]), getMDOrNull(Record[4]),
-                           Record[5], getMDOrNull(Record[6]), Record[7],
-                           Record[8])),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_EXPRESSION: {
-      if (Record.size() < 1)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DILexicalBlock, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), Record[3], Record[4])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_LEXICAL_BLOCK_FILE: {
+    if (Record.size() != 4)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIExpression, Record[0],
-                          (Context, makeArrayRef(Record).slice(1))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_OBJC_PROPERTY: {
-      if (Record.size() != 8)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DILexicalBlockFile, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), Record[3])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_NAMESPACE: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIObjCProperty, Record[0],
-                          (Context, getMDString(Record[1]),
-                           getMDOrNull(Record[2]), Record[3],
-                           getMDString(Record[4]), getMDString(Record[5]),
-                           Record[6], getMDOrNull(Record[7]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_IMPORTED_ENTITY: {
-      if (Record.size() != 6)
-        return error("Invalid record");
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DINamespace, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDOrNull(Record[2]), getMDString(Record[3]),
+                         Record[4])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_TEMPLATE_TYPE: {
+    if (Record.size() != 3)
+      return error("Invalid record");
 
-      MDValueList.assignValue(
-          GET_OR_DISTINCT(DIImportedEntity, Record[0],
-                          (Context, Record[1], getMDOrNull(Record[2]),
-                           getMDOrNull(Record[3]), Record[4],
-                           getMDString(Record[5]))),
-          NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_STRING: {
-      std::string String(Record.begin(), Record.end());
-      llvm::UpgradeMDStringConstant(String);
-      Metadata *MD = MDString::get(Context, String);
-      MDValueList.assignValue(MD, NextMDValueNo++);
-      break;
-    }
-    case bitc::METADATA_KIND: {
-      if (Record.size() < 2)
-        return error("Invalid record");
+    MDValueList.assignValue(GET_OR_DISTINCT(DITemplateTypeParameter,
+                                            Record[0],
+                                            (Context, getMDString(Record[1]),
+                                             getMDOrNull(Record[2]))),
+                            NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_TEMPLATE_VALUE: {
+    if (Record.size() != 5)
+      return error("Invalid record");
 
-      unsigned Kind = Record[0];
-      SmallString<8> Name(Record.begin()+1, Record.end());
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DITemplateValueParameter, Record[0],
+                        (Context, Record[1], getMDString(Record[2]),
+                         getMDOrNull(Record[3]), getMDOrNull(Record[4]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_GLOBAL_VAR: {
+    if (Record.size() != 11)
+      return error("Invalid record");
 
-      unsigned NewKind = TheModule->getMDKindID(Name.str());
-      if (!MDKindMap.insert(std::make_pair(Kind, NewKind)).second)
-        return error("Conflicting METADATA_KIND records");
-      break;
-    }
-    }
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIGlobalVariable, Record[0],
+                        (Context, getMDOrNull(Record[1]),
+                         getMDString(Record[2]), getMDString(Record[3]),
+                         getMDOrNull(Record[4]), Record[5],
+                         getMDOrNull(Record[6]), Record[7], Record[8],
+                         getMDOrNull(Record[9]), getMDOrNull(Record[10]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_LOCAL_VAR: {
+    // 10th field is for the obseleted 'inlinedAt:' field.
+    if (Record.size() != 9 && Record.size() != 10)
+      return error("Invalid record");
+
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DILocalVariable, Record[0],
+                        (Context, Record[1], getMDOrNull(Record[2]),
+                         getMDString(Record[3]), getMDOrNull(Record[4]),
+                         Record[5], getMDOrNull(Record[6]), Record[7],
+                         Record[8])),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_EXPRESSION: {
+    if (Record.size() < 1)
+      return error("Invalid record");
+
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIExpression, Record[0],
+                        (Context, makeArrayRef(Record).slice(1))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_OBJC_PROPERTY: {
+    if (Record.size() != 8)
+      return error("Invalid record");
+
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIObjCProperty, Record[0],
+                        (Context, getMDString(Record[1]),
+                         getMDOrNull(Record[2]), Record[3],
+                         getMDString(Record[4]), getMDString(Record[5]),
+                         Record[6], getMDOrNull(Record[7]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_IMPORTED_ENTITY: {
+    if (Record.size() != 6)
+      return error("Invalid record");
+
+    MDValueList.assignValue(
+        GET_OR_DISTINCT(DIImportedEntity, Record[0],
+                        (Context, Record[1], getMDOrNull(Record[2]),
+                         getMDOrNull(Record[3]), Record[4],
+                         getMDString(Record[5]))),
+        NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_STRING: {
+    std::string String(Record.begin(), Record.end());
+    llvm::UpgradeMDStringConstant(String);
+    Metadata *MD = MDString::get(Context, String);
+    MDValueList.assignValue(MD, NextMDValueNo++);
+    break;
+  }
+  case bitc::METADATA_STRINGS:
+    if (std::error_code EC = parseMetadataStrings(Record, Blob, NextMDValueNo))
+      return EC;
+    break;
+  case bitc::METADATA_KIND: {
+    if (Record.size() < 2)
+      return error("Invalid record");
+
+    unsigned Kind = Record[0];
+    SmallString<8> Name(Record.begin()+1, Record.end());
+
+    unsigned NewKind = TheModule->getMDKindID(Name.str());
+    if (!MDKindMap.insert(std::make_pair(Kind, NewKind)).second)
+      return error("Conflicting METADATA_KIND records");
+    break;
   }
+  }
+  return StringEC;
 #undef GET_OR_DISTINCT
 }
 
@@ -2644,10 +3005,144 @@ std::error_code BitcodeReader::materializeMetadata() {
   for (uint64_t BitPos : DeferredMetadataInfo) {
     // Move the bit stream to the saved position.
     Stream.JumpToBit(BitPos);
-    if (std::error_code EC = parseMetadata())
+    // Some of the indexed metadata may already be loaded; the records of the
+    // block still define the IDs the index numbered them with.
+    unsigned NextMDValueNo = MDValueList.size();
+    if (!MetadataIndex.empty() && BitPos == MetadataIndexBlockBit)
+      NextMDValueNo = MetadataBlockFirstID;
+    if (std::error_code EC = parseMetadata(NextMDValueNo))
       return EC;
   }
   DeferredMetadataInfo.clear();
+  std::vector<uint64_t>().swap(MetadataIndex);
+  IsLazyMetadataPrepared = true;
+  return std::error_code();
+}
+
+/// Get the deferred metadata ready for materializing function bodies.  Blocks
+/// without an index are parsed right away, but the records of an indexed block
+/// are only read when something refers to them.
+std::error_code BitcodeReader::prepareLazyMetadata() {
+  if (IsLazyMetadataPrepared)
+    return std::error_code();
+  IsLazyMetadataPrepared = true;
+
+  std::vector<uint64_t> IndexedBlocks;
+  for (uint64_t BitPos : DeferredMetadataInfo) {
+    if (MetadataIndex.empty()) {
+      bool HasIndex;
+      if (std::error_code EC = parseMetadataIndex(BitPos, HasIndex))
+        return EC;
+      if (HasIndex) {
+        IndexedBlocks.push_back(BitPos);
+        continue;
+      }
+    }
+    Stream.JumpToBit(BitPos);
+    if (std::error_code EC = parseMetadata(MDValueList.size()))
+      return EC;
+  }
+  DeferredMetadataInfo = std::move(IndexedBlocks);
+  return std::error_code();
+}
+
+/// Read the index of the metadata block at \p BlockBit, if it has one, and
+/// reserve the IDs of the metadata it defines.
+std::error_code BitcodeReader::parseMetadataIndex(uint64_t BlockBit,
+                                                  bool &HasIndex) {
+  HasIndex = false;
+  MetadataCursor.init(&*StreamFile);
+  MetadataCursor.JumpToBit(BlockBit);
+  if (MetadataCursor.EnterSubBlock(bitc::METADATA_BLOCK_ID))
+    return error("Invalid record");
+
+  // The offset of the index is the first record of the block, after the
+  // abbreviations the cursor keeps for reading the other records and the
+  // strings of the block.
+  BitstreamEntry Entry = MetadataCursor.advanceSkippingSubblocks();
+  if (Entry.Kind != BitstreamEntry::Record)
+    return std::error_code();
+  uint64_t StringsBit = MetadataCursor.GetCurrentBitNo();
+  unsigned StringsAbbrev = Entry.ID;
+  SmallVector<uint64_t, 64> Record;
+  unsigned Code = MetadataCursor.readRecord(Entry.ID, Record);
+  bool HasStrings = Code == bitc::METADATA_STRINGS;
+  if (HasStrings) {
+    Record.clear();
+    Entry = MetadataCursor.advanceSkippingSubblocks();
+    if (Entry.Kind != BitstreamEntry::Record)
+      return std::error_code();
+    Code = MetadataCursor.readRecord(Entry.ID, Record);
+  }
+  if (Code != bitc::METADATA_INDEX_OFFSET)
+    return std::error_code();
+  if (Record.size() != 2)
+    return error("Invalid record");
+  uint64_t Base = MetadataCursor.GetCurrentBitNo();
+  uint64_t Offset = Record[0] | (Record[1] << 32);
+  if (!MetadataCursor.canSkipToPos((Base + Offset) / 8))
+    return error("Invalid record");
+
+  MetadataCursor.JumpToBit(Base + Offset);
+  Entry = MetadataCursor.advanceSkippingSubblocks();
+  Record.clear();
+  if (Entry.Kind != BitstreamEntry::Record ||
+      MetadataCursor.readRecord(Entry.ID, Record) != bitc::METADATA_INDEX)
+    return error("Invalid record");
+
+  MetadataIndex.reserve(Record.size());
+  uint64_t Pos = Base;
+  for (uint64_t Delta : Record) {
+    Pos += Delta;
+    MetadataIndex.push_back(Pos);
+  }
+  // The strings are cheap to read all at once, and they have to be there
+  // before the nodes that refer to them are built.  Their record is read
+  // again, as a streamed blob only lives until more bytes are fetched.
+  MetadataBlockFirstID = MDValueList.size();
+  MetadataIndexFirstID = MetadataBlockFirstID;
+  if (HasStrings) {
+    MetadataCursor.JumpToBit(StringsBit);
+    Record.clear();
+    StringRef Blob;
+    MetadataCursor.readRecord(StringsAbbrev, Record, &Blob);
+    if (std::error_code EC =
+            parseMetadataStrings(Record, Blob, MetadataIndexFirstID))
+      return EC;
+  }
+  MetadataIndexBlockBit = BlockBit;
+  MDValueList.resize(MetadataIndexFirstID + MetadataIndex.size());
+  HasIndex = true;
+  return std::error_code();
+}
+
+/// Read the record of the indexed metadata \p ID.
+std::error_code BitcodeReader::loadMetadataRecord(unsigned ID) {
+  uint64_t Pos = MetadataIndex[ID - MetadataIndexFirstID];
+  if (!MetadataCursor.canSkipToPos(Pos / 8))
+    return error("Invalid record");
+  MetadataCursor.JumpToBit(Pos);
+  BitstreamEntry Entry = MetadataCursor.advanceSkippingSubblocks();
+  if (Entry.Kind != BitstreamEntry::Record)
+    return error("Invalid record");
+
+  SmallVector<uint64_t, 64> Record;
+  unsigned Code = MetadataCursor.readRecord(Entry.ID, Record);
+  if (!isMetadataDefinition(Code))
+    return error("Invalid record");
+  unsigned NextMDValueNo = ID;
+  return parseMetadataRecord(MetadataCursor, Code, Record, StringRef(),
+                             NextMDValueNo);
+}
+
+/// Read the indexed metadata that placeholders were created for, and all the
+/// indexed metadata they refer to in turn.
+std::error_code BitcodeReader::loadPendingMetadata() {
+  unsigned ID;
+  while (MDValueList.popPendingFwdRef(ID))
+    if (isLazyMetadata(ID) && !MDValueList.isLoaded(ID))
+      if (std::error_code EC = loadMetadataRecord(ID))
+        return EC;
   return std::error_code();
 }
 
@@ -2725,6 +3220,7 @@ std::error_code BitcodeReader::parseModule(bool Resume,
           return error("Invalid record");
         break;
       case bitc::BLOCKINFO_BLOCK_ID:
+        BlockInfoBit = Stream.GetCurrentBitNo();
         if (Stream.ReadBlockInfoBlock())
           return error("Malformed block");
         break;
@@ -2758,7 +3254,7 @@ std::error_code BitcodeReader::parseModule(bool Resume,
           break;
         }
         assert(DeferredMetadataInfo.empty() && "Unexpected deferred metadata");
-        if (std::error_code EC = parseMetadata())
+        if (std::error_code EC = parseMetadata(MDValueList.size()))
           return EC;
         break;
       case bitc::FUNCTION_BLOCK_ID:
@@ -3331,7 +3827,7 @@ std::error_code BitcodeReader::parseFunctionBody(Function *F) {
           return EC;
         break;
       case bitc::METADATA_BLOCK_ID:
-        if (std::error_code EC = parseMetadata())
+        if (std::error_code EC = parseMetadata(MDValueList.size()))
           return EC;
         break;
       case bitc::USELIST_BLOCK_ID:
@@ -4357,6 +4853,11 @@ OutOfRecordLoop:
     }
   }
 
+  // Load the indexed metadata that the function refers to.
+  if (std::error_code EC = loadPendingMetadata())
+    return EC;
+  MDValueList.tryToResolveCycles();
+
   // FIXME: Check for unresolved forward-declared metadata references
   // and clean up leaks.
 
@@ -4389,7 +4890,7 @@ std::error_code BitcodeReader::findFunctionInStream(
 void BitcodeReader::releaseBuffer() { Buffer.release(); }
 
 std::error_code BitcodeReader::materialize(GlobalValue *GV) {
-  if (std::error_code EC = materializeMetadata())
+  if (std::error_code EC = prepareLazyMetadata())
     return EC;
 
   Function *F = dyn_cast<Function>(GV);
@@ -4405,10 +4906,21 @@ std::error_code BitcodeReader::materialize(GlobalValue *GV) {
     if (std::error_code EC = findFunctionInStream(F, DFII))
       return EC;
 
-  // Move the bit stream to the saved position of the deferred function body.
-  Stream.JumpToBit(DFII->second);
-
-  if (std::error_code EC = parseFunctionBody(F))
+  // Replay the function block if it was decoded ahead, or move the bit stream
+  // to the saved position of the deferred function body.
+  const DecodedBlock *Decoded =
+      FunctionDecoder ? FunctionDecoder->getBlock(F) : nullptr;
+  if (Decoded)
+    Stream.replay(*Decoded);
+  else
+    Stream.JumpToBit(DFII->second);
+
+  std::error_code EC = parseFunctionBody(F);
+  if (Decoded) {
+    Stream.stopReplay();
+    FunctionDecoder->releaseBlock(F);
+  }
+  if (EC)
     return EC;
   F->setIsMaterializable(false);
 
@@ -4468,13 +4980,29 @@ std::error_code BitcodeReader::materializeModule(Module *M) {
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
+  // Decode the function blocks on other threads ahead of parsing them, if
+  // requested.  A streamed module may not have all its function blocks yet.
+  if (DecodeThreads && !IsStreamed) {
+    std::vector<std::pair<const Function *, uint64_t>> Functions;
+    for (Function &F : *TheModule)
+      if (F.isMaterializable())
+        Functions.push_back(std::make_pair(&F, DeferredFunctionInfo[&F]));
+    if (Functions.size() > 1)
+      FunctionDecoder = llvm::make_unique<FunctionBlockDecoder>(
+          StreamFile->getBitcodeBytes(), BlockInfoBit, Functions,
+          DecodeThreads);
+  }
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Module::iterator F = TheModule->begin(), E = TheModule->end();
        F != E; ++F) {
-    if (std::error_code EC = materialize(F))
+    if (std::error_code EC = materialize(F)) {
+      FunctionDecoder.reset();
       return EC;
+    }
   }
+  FunctionDecoder.reset();
   // At this point, if there are any function bodies, the current bit is
   // pointing to the END_BLOCK record after them. Now make sure the rest
   // of the bits in the module have been read.
@@ -4569,6 +5097,249 @@ BitcodeReader::initLazyStream(std::unique_ptr<DataStreamer> Streamer) {
   return std::error_code();
 }
 
+//===----------------------------------------------------------------------===//
+// Function summary reader
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Reads the function summaries of a module or of a combined index, skipping
+/// over everything else in the file.
+class FunctionIndexBitcodeReader {
+  DiagnosticHandlerFunction DiagnosticHandler;
+  std::unique_ptr<BitstreamReader> StreamFile;
+  BitstreamCursor Stream;
+
+  /// The index being populated, or null if only looking for a summary.
+  FunctionInfoIndex *Index;
+  bool SeenSummary;
+
+  /// Names defined by FS_CODE_NAME records, in order.
+  std::vector<std::string> Names;
+  /// Module paths of a combined index, by module identifier.
+  DenseMap<uint64_t, StringRef> ModulePaths;
+
+public:
+  FunctionIndexBitcodeReader(DiagnosticHandlerFunction DiagnosticHandler,
+                             FunctionInfoIndex *Index)
+      : DiagnosticHandler(DiagnosticHandler), Index(Index),
+        SeenSummary(false) {}
+
+  std::error_code parse(MemoryBufferRef Buffer);
+  bool seenSummary() const { return SeenSummary; }
+
+private:
+  std::error_code error(const Twine &Message);
+  std::error_code parseModule();
+  std::error_code parseModulePathStringTable();
+  std::error_code parseSummaryBlock();
+};
+}
+
+std::error_code FunctionIndexBitcodeReader::error(const Twine &Message) {
+  std::error_code EC = make_error_code(BitcodeError::CorruptedBitcode);
+  if (!DiagnosticHandler)
+    return EC;
+  return ::error(DiagnosticHandler, EC, Message);
+}
+
+std::error_code FunctionIndexBitcodeReader::parse(MemoryBufferRef Buffer) {
+  const unsigned char *BufPtr = (const unsigned char *)Buffer.getBufferStart();
+  const unsigned char *BufEnd = BufPtr + Buffer.getBufferSize();
+
+  if (Buffer.getBufferSize() & 3)
+    return error("Invalid bitcode signature");
+  if (isBitcodeWrapper(BufPtr, BufEnd))
+    if (SkipBitcodeWrapperHeader(BufPtr, BufEnd, true))
+      return error("Invalid bitcode wrapper header");
+
+  StreamFile.reset(new BitstreamReader(BufPtr, BufEnd));
+  Stream.init(&*StreamFile);
+
+  // Sniff for the signature.
+  if (Stream.Read(8) != 'B' ||
+      Stream.Read(8) != 'C' ||
+      Stream.Read(4) != 0x0 ||
+      Stream.Read(4) != 0xC ||
+      Stream.Read(4) != 0xE ||
+      Stream.Read(4) != 0xD)
+    return error("Invalid bitcode signature");
+
+  // A module carries its summary inside the module block; a combined index
+  // has the module path table and the summary block at the top level.
+  while (!Stream.AtEndOfStream()) {
+    BitstreamEntry Entry =
+        Stream.advance(BitstreamCursor::AF_DontAutoprocessAbbrevs);
+    if (Entry.Kind != BitstreamEntry::SubBlock)
+      return error("Malformed block");
+
+    std::error_code EC;
+    switch (Entry.ID) {
+    case bitc::MODULE_BLOCK_ID:
+      // A module is the last thing we are interested in; parseModule() may
+      // stop without leaving its block.
+      return parseModule();
+    case bitc::MODULE_STRTAB_BLOCK_ID:
+      EC = parseModulePathStringTable();
+      break;
+    case bitc::FUNCTION_SUMMARY_BLOCK_ID:
+      EC = parseSummaryBlock();
+      break;
+    default:
+      if (Stream.SkipBlock())
+        return error("Invalid record");
+      break;
+    }
+    if (EC)
+      return EC;
+    if (SeenSummary && !Index)
+      return std::error_code();
+  }
+  return std::error_code();
+}
+
+std::error_code FunctionIndexBitcodeReader::parseModule() {
+  if (Stream.EnterSubBlock(bitc::MODULE_BLOCK_ID))
+    return error("Invalid record");
+
+  while (1) {
+    BitstreamEntry Entry = Stream.advance();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::error_code();
+    case BitstreamEntry::SubBlock:
+      // The summary precedes the function bodies, so there is nothing left
+      // to look for once we either have it or reach a body.
+      if (Entry.ID == bitc::FUNCTION_SUMMARY_BLOCK_ID) {
+        if (std::error_code EC = parseSummaryBlock())
+          return EC;
+        return std::error_code();
+      }
+      if (Entry.ID == bitc::FUNCTION_BLOCK_ID)
+        return std::error_code();
+      if (Stream.SkipBlock())
+        return error("Invalid record");
+      continue;
+    case BitstreamEntry::Record:
+      Stream.skipRecord(Entry.ID);
+      continue;
+    }
+  }
+}
+
+std::error_code FunctionIndexBitcodeReader::parseModulePathStringTable() {
+  if (Stream.EnterSubBlock(bitc::MODULE_STRTAB_BLOCK_ID))
+    return error("Invalid record");
+
+  SmallVector<uint64_t, 64> Record;
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::error_code();
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    switch (Stream.readRecord(Entry.ID, Record)) {
+    default: // Default behavior: ignore.
+      break;
+    case bitc::MST_CODE_ENTRY: { // MST_ENTRY: [modid, namechar x N]
+      std::string Path;
+      if (Record.empty() || convertToString(Record, 1, Path))
+        return error("Invalid record");
+      if (Index)
+        ModulePaths[Record[0]] = Index->addModulePath(Path, Record[0]);
+      break;
+    }
+    }
+  }
+}
+
+std::error_code FunctionIndexBitcodeReader::parseSummaryBlock() {
+  if (Stream.EnterSubBlock(bitc::FUNCTION_SUMMARY_BLOCK_ID))
+    return error("Invalid record");
+  SeenSummary = true;
+  if (!Index)
+    return Stream.SkipBlock() ? error("Invalid record") : std::error_code();
+
+  SmallVector<uint64_t, 64> Record;
+  auto getName = [&](uint64_t ID) -> const std::string * {
+    return ID < Names.size() ? &Names[ID] : nullptr;
+  };
+
+  while (1) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return std::error_code();
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    switch (Stream.readRecord(Entry.ID, Record)) {
+    default: // Default behavior: ignore.
+      break;
+    case bitc::FS_CODE_NAME: { // NAME: [namechar x N]
+      std::string Name;
+      if (convertToString(Record, 0, Name))
+        return error("Invalid record");
+      Names.push_back(std::move(Name));
+      break;
+    }
+    case bitc::FS_CODE_ENTRY: {
+      // ENTRY: [modid, nameid, linkage, instcount, entrycount, numcalls,
+      //         numcalls x (nameid, islocal, callsitecount),
+      //         n x (nameid, islocal)]
+      if (Record.size() < 6)
+        return error("Invalid record");
+      const std::string *Name = getName(Record[1]);
+      uint64_t NumCalls = Record[5];
+      if (!Name || Record.size() < 6 + 3 * NumCalls ||
+          (Record.size() - 6 - 3 * NumCalls) % 2)
+        return error("Invalid record");
+
+      std::unique_ptr<FunctionSummary> Summary(new FunctionSummary(
+          getDecodedLinkage(Record[2]), Record[3], Record[4]));
+      unsigned I = 6;
+      for (uint64_t C = 0; C != NumCalls; ++C, I += 3) {
+        const std::string *Callee = getName(Record[I]);
+        if (!Callee)
+          return error("Invalid record");
+        Summary->calls().emplace_back(*Callee, Record[I + 1], Record[I + 2]);
+      }
+      for (; I != Record.size(); I += 2) {
+        const std::string *Ref = getName(Record[I]);
+        if (!Ref)
+          return error("Invalid record");
+        Summary->refs().emplace_back(*Ref, Record[I + 1]);
+      }
+
+      if (!ModulePaths.empty()) {
+        auto Path = ModulePaths.find(Record[0]);
+        if (Path == ModulePaths.end())
+          return error("Invalid record");
+        Summary->setModulePath(Path->second);
+      }
+      Index->addFunctionSummary(*Name, std::move(Summary));
+      break;
+    }
+    }
+  }
+}
+
 namespace {
 class BitcodeErrorCategoryType : public std::error_category {
   const char *name() const LLVM_NOEXCEPT override {
@@ -4690,3 +5461,27 @@ llvm::getBitcodeTargetTriple(MemoryBufferRef Buffer, LLVMContext &Context,
     return "";
   return Triple.get();
 }
+
+bool llvm::hasFunctionSummary(MemoryBufferRef Buffer,
+                              DiagnosticHandlerFunction DiagnosticHandler) {
+  FunctionIndexBitcodeReader R(DiagnosticHandler, nullptr);
+  if (R.parse(Buffer))
+    return false;
+  return R.seenSummary();
+}
+
+ErrorOr<std::unique_ptr<FunctionInfoIndex>>
+llvm::getFunctionInfoIndex(MemoryBufferRef Buffer,
+                           DiagnosticHandlerFunction DiagnosticHandler) {
+  std::unique_ptr<FunctionInfoIndex> Index(new FunctionInfoIndex());
+  FunctionIndexBitcodeReader R(DiagnosticHandler, Index.get());
+  if (std::error_code EC = R.parse(Buffer))
+    return EC;
+  if (!R.seenSummary()) {
+    std::error_code EC = make_error_code(BitcodeError::CorruptedBitcode);
+    if (DiagnosticHandler)
+      error(DiagnosticHandler, EC, "Missing function summary");
+    return EC;
+  }
+  return std::move(Index);
+}
@@ -13,12 +13,14 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "ValueEnumerator.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include "llvm/Bitcode/LLVMBitCodes.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/InlineAsm.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -30,6 +32,7 @@
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 #include <cctype>
 #include <map>
 using namespace llvm;
@@ -483,8 +486,8 @@ static void WriteTypeTable(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
-static unsigned getEncodedLinkage(const GlobalValue &GV) {
-  switch (GV.getLinkage()) {
+static unsigned getEncodedLinkage(GlobalValue::LinkageTypes Linkage) {
+  switch (Linkage) {
   case GlobalValue::ExternalLinkage:
     return 0;
   case GlobalValue::WeakAnyLinkage:
@@ -511,6 +514,10 @@ static unsigned getEncodedLinkage(const GlobalValue &GV) {
   llvm_unreachable("Invalid linkage");
 }
 
+static unsigned getEncodedLinkage(const GlobalValue &GV) {
+  return getEncodedLinkage(GV.getLinkage());
+}
+
 static unsigned getEncodedVisibility(const GlobalValue &GV) {
   switch (GV.getVisibility()) {
   case GlobalValue::DefaultVisibility:   return 0;
@@ -1145,25 +1152,54 @@ static void WriteDIImportedEntity(const DIImportedEntity *N,
   Record.clear();
 }
 
+/// Write all the MDStrings in a single METADATA_STRINGS record.  Its blob
+/// starts with the VBR6-encoded lengths of the strings, padded to a 32-bit
+/// boundary, and the characters of the strings follow from the offset in the
+/// record on.  The reader can then take the strings straight from the blob.
+static void WriteMetadataStrings(ArrayRef<const Metadata *> Strings,
+                                 BitstreamWriter &Stream,
+                                 SmallVectorImpl<uint64_t> &Record) {
+  if (Strings.empty())
+    return;
+
+  // Start the record with the number of strings.
+  Record.push_back(bitc::METADATA_STRINGS);
+  Record.push_back(Strings.size());
+
+  // Emit the sizes of the strings in the blob.
+  SmallString<256> Blob;
+  {
+    BitstreamWriter W(Blob);
+    for (const Metadata *MD : Strings)
+      W.EmitVBR(cast<MDString>(MD)->getLength(), 6);
+    W.FlushToWord();
+  }
+
+  // Add the offset to the strings to the record.
+  Record.push_back(Blob.size());
+
+  // Add the strings to the blob.
+  for (const Metadata *MD : Strings)
+    Blob.append(cast<MDString>(MD)->getString());
+
+  // Emit the final record.
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRINGS));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  Stream.EmitRecordWithBlob(Stream.EmitAbbrev(Abbv), Record, Blob);
+  Record.clear();
+}
+
 static void WriteModuleMetadata(const Module *M,
                                 const ValueEnumerator &VE,
                                 BitstreamWriter &Stream) {
-  const auto &MDs = VE.getMDs();
-  if (MDs.empty() && M->named_metadata_empty())
+  if (VE.getMDs().empty() && M->named_metadata_empty())
     return;
 
   Stream.EnterSubblock(bitc::METADATA_BLOCK_ID, 3);
 
-  unsigned MDSAbbrev = 0;
-  if (VE.hasMDString()) {
-    // Abbrev for METADATA_STRING.
-    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
-    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_STRING));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
-    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
-    MDSAbbrev = Stream.EmitAbbrev(Abbv);
-  }
-
   // Initialize MDNode abbreviations.
 #define HANDLE_MDNODE_LEAF(CLASS) unsigned CLASS##Abbrev = 0;
 #include "llvm/IR/Metadata.def"
@@ -1210,7 +1246,32 @@ static void WriteModuleMetadata(const Module *M,
   }
 
   SmallVector<uint64_t, 64> Record;
+
+  // Emit all the MDStrings in a single record.
+  WriteMetadataStrings(VE.getMDStrings(), Stream, Record);
+
+  // Reserve the offset of the metadata index, which lets a lazy reader load
+  // the records of the other metadata it needs without parsing the whole
+  // block.
+  ArrayRef<const Metadata *> MDs = VE.getNonMDStrings();
+  uint64_t IndexOffsetBase = 0;
+  if (!MDs.empty()) {
+    BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+    Abbv->Add(BitCodeAbbrevOp(bitc::METADATA_INDEX_OFFSET));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 32));
+    unsigned OffsetAbbrev = Stream.EmitAbbrev(Abbv);
+    Record.append(2, 0u);
+    Stream.EmitRecord(bitc::METADATA_INDEX_OFFSET, Record, OffsetAbbrev);
+    Record.clear();
+    IndexOffsetBase = Stream.GetCurrentBitNo();
+  }
+
+  // The bit position of the record of each metadata, in ID order.
+  std::vector<uint64_t> IndexPos;
+  IndexPos.reserve(MDs.size());
   for (const Metadata *MD : MDs) {
+    IndexPos.push_back(Stream.GetCurrentBitNo());
     if (const MDNode *N = dyn_cast<MDNode>(MD)) {
       assert(N->isResolved() && "Expected forward references to be resolved");
 
@@ -1224,16 +1285,20 @@ static void WriteModuleMetadata(const Module *M,
 #include "llvm/IR/Metadata.def"
       }
     }
-    if (const auto *MDC = dyn_cast<ConstantAsMetadata>(MD)) {
-      WriteValueAsMetadata(MDC, VE, Stream, Record);
-      continue;
-    }
-    const MDString *MDS = cast<MDString>(MD);
-    // Code: [strchar x N]
-    Record.append(MDS->bytes_begin(), MDS->bytes_end());
+    WriteValueAsMetadata(cast<ConstantAsMetadata>(MD), VE, Stream, Record);
+  }
 
-    // Emit the finished record.
-    Stream.EmitRecord(bitc::METADATA_STRING, Record, MDSAbbrev);
+  // Write the index as deltas from the previous position, the first one
+  // relative to the end of the offset record.
+  uint64_t IndexOffset = 0;
+  if (!MDs.empty()) {
+    IndexOffset = Stream.GetCurrentBitNo() - IndexOffsetBase;
+    uint64_t PrevPos = IndexOffsetBase;
+    for (uint64_t Pos : IndexPos) {
+      Record.push_back(Pos - PrevPos);
+      PrevPos = Pos;
+    }
+    Stream.EmitRecord(bitc::METADATA_INDEX, Record);
     Record.clear();
   }
 
@@ -1253,6 +1318,13 @@ static void WriteModuleMetadata(const Module *M,
   }
 
   Stream.ExitBlock();
+
+  // Now that the index is written and flushed, fill in its offset, which sits
+  // in the last 64 bits of the offset record.
+  if (!MDs.empty()) {
+    Stream.BackpatchWordAtBit(IndexOffsetBase - 64, (uint32_t)IndexOffset);
+    Stream.BackpatchWordAtBit(IndexOffsetBase - 32, IndexOffset >> 32);
+  }
 }
 
 static void WriteFunctionLocalMetadata(const Function &F,
@@ -2330,9 +2402,111 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
   Stream.ExitBlock();
 }
 
+/// Emit the summaries of the functions described by \p Index, preceded by the
+/// names they refer to.
+static void WriteFunctionSummaryBlock(const FunctionInfoIndex &Index,
+                                      BitstreamWriter &Stream) {
+  Stream.EnterSubblock(bitc::FUNCTION_SUMMARY_BLOCK_ID, 4);
+
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FS_CODE_NAME));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Char6));
+  unsigned NameChar6Abbrev = Stream.EmitAbbrev(Abbv);
+
+  Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FS_CODE_NAME));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed, 8));
+  unsigned Name8Abbrev = Stream.EmitAbbrev(Abbv);
+
+  Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(bitc::FS_CODE_ENTRY));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+  unsigned EntryAbbrev = Stream.EmitAbbrev(Abbv);
+
+  // Names are numbered in the order they are first used.
+  StringMap<unsigned> NameIDs;
+  SmallVector<unsigned, 64> Vals;
+  auto getNameID = [&](StringRef Name) {
+    auto Inserted = NameIDs.insert(std::make_pair(Name, NameIDs.size()));
+    if (Inserted.second) {
+      // NAME: [namechar x N]
+      bool IsChar6 = std::all_of(Name.begin(), Name.end(),
+                                 BitCodeAbbrevOp::isChar6);
+      SmallVector<unsigned, 64> NameVals(Name.bytes_begin(), Name.bytes_end());
+      Stream.EmitRecord(bitc::FS_CODE_NAME, NameVals,
+                        IsChar6 ? NameChar6Abbrev : Name8Abbrev);
+    }
+    return Inserted.first->second;
+  };
+
+  for (const auto &Entry : Index) {
+    for (const std::unique_ptr<FunctionSummary> &Summary : Entry.second) {
+      uint64_t ModuleId = 0;
+      if (!Summary->modulePath().empty())
+        ModuleId = Index.modulePaths().lookup(Summary->modulePath());
+
+      // Emit every name first so they are not interleaved with the entry.
+      unsigned NameID = getNameID(Entry.first());
+      for (const GlobalValueRef &Call : Summary->calls())
+        getNameID(Call.Name);
+      for (const GlobalValueRef &Ref : Summary->refs())
+        getNameID(Ref.Name);
+
+      // ENTRY: [modid, nameid, linkage, instcount, entrycount, numcalls,
+      //         calls..., refs...]
+      Vals.push_back(ModuleId);
+      Vals.push_back(NameID);
+      Vals.push_back(getEncodedLinkage(Summary->getLinkage()));
+      Vals.push_back(Summary->getInstCount());
+      Vals.push_back(Summary->getEntryCount());
+      Vals.push_back(Summary->calls().size());
+      for (const GlobalValueRef &Call : Summary->calls()) {
+        Vals.push_back(getNameID(Call.Name));
+        Vals.push_back(Call.IsLocal);
+        Vals.push_back(Call.CallsiteCount);
+      }
+      for (const GlobalValueRef &Ref : Summary->refs()) {
+        Vals.push_back(getNameID(Ref.Name));
+        Vals.push_back(Ref.IsLocal);
+      }
+      Stream.EmitRecord(bitc::FS_CODE_ENTRY, Vals, EntryAbbrev);
+      Vals.clear();
+    }
+  }
+
+  Stream.ExitBlock();
+}
+
+/// Emit the table mapping module identifiers of a combined index to paths.
+static void WriteModulePathStringTable(const FunctionInfoIndex &Index,
+                                       BitstreamWriter &Stream) {
+  Stream.EnterSubblock(bitc::MODULE_STRTAB_BLOCK_ID, 3);
+
+  // Sort by identifier so that the output does not depend on hashing.
+  std::vector<std::pair<uint64_t, StringRef>> Paths;
+  for (const auto &Entry : Index.modulePaths())
+    Paths.push_back(std::make_pair(Entry.second, Entry.first()));
+  std::sort(Paths.begin(), Paths.end());
+
+  SmallVector<uint64_t, 64> Vals;
+  for (const auto &Path : Paths) {
+    // MST_ENTRY: [modid, namechar x N]
+    Vals.push_back(Path.first);
+    Vals.append(Path.second.bytes_begin(), Path.second.bytes_end());
+    Stream.EmitRecord(bitc::MST_CODE_ENTRY, Vals);
+    Vals.clear();
+  }
+
+  Stream.ExitBlock();
+}
+
 /// WriteModule - Emit the specified module to the bitstream.
 static void WriteModule(const Module *M, BitstreamWriter &Stream,
-                        bool ShouldPreserveUseListOrder) {
+                        bool ShouldPreserveUseListOrder,
+                        bool EmitFunctionSummary) {
   Stream.EnterSubblock(bitc::MODULE_BLOCK_ID, 3);
 
   SmallVector<unsigned, 1> Vals;
@@ -2377,6 +2551,11 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
   if (VE.shouldPreserveUseListOrder())
     WriteUseListBlock(nullptr, VE, Stream);
 
+  // Emit the function summaries ahead of the bodies, so that readers which
+  // only want the summaries can stop early.
+  if (EmitFunctionSummary)
+    WriteFunctionSummaryBlock(*FunctionInfoIndex::build(*M), Stream);
+
   // Emit function bodies.
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
     if (!F->isDeclaration())
@@ -2461,7 +2640,8 @@ static void EmitDarwinBCHeaderAndTrailer(SmallVectorImpl<char> &Buffer,
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
-                              bool ShouldPreserveUseListOrder) {
+                              bool ShouldPreserveUseListOrder,
+                              bool EmitFunctionSummary) {
   SmallVector<char, 0> Buffer;
   Buffer.reserve(256*1024);
 
@@ -2484,7 +2664,7 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
     Stream.Emit(0xD, 4);
 
     // Emit the module.
-    WriteModule(M, Stream, ShouldPreserveUseListOrder);
+    WriteModule(M, Stream, ShouldPreserveUseListOrder, EmitFunctionSummary);
   }
 
   if (TT.isOSDarwin())
@@ -2493,3 +2673,28 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
   // Write the generated bitstream to "Out".
   Out.write((char*)&Buffer.front(), Buffer.size());
 }
+
+/// WriteFunctionSummaryToFile - Write the specified combined function index
+/// to the specified output stream.
+void llvm::WriteFunctionSummaryToFile(const FunctionInfoIndex &Index,
+                                      raw_ostream &Out) {
+  SmallVector<char, 0> Buffer;
+  Buffer.reserve(256 * 1024);
+
+  {
+    BitstreamWriter Stream(Buffer);
+
+    // Emit the file header.
+    Stream.Emit((unsigned)'B', 8);
+    Stream.Emit((unsigned)'C', 8);
+    Stream.Emit(0x0, 4);
+    Stream.Emit(0xC, 4);
+    Stream.Emit(0xE, 4);
+    Stream.Emit(0xD, 4);
+
+    WriteModulePathStringTable(Index, Stream);
+    WriteFunctionSummaryBlock(Index, Stream);
+  }
+
+  Out.write((char *)&Buffer.front(), Buffer.size());
+}
@@ -285,7 +285,7 @@ static bool isIntOrIntVectorValue(const std::pair<const Value*, unsigned> &V) {
 
 ValueEnumerator::ValueEnumerator(const Module &M,
                                  bool ShouldPreserveUseListOrder)
-    : HasMDString(false), HasDILocation(false), HasGenericDINode(false),
+    : NumMDStrings(0), HasDILocation(false), HasGenericDINode(false),
       ShouldPreserveUseListOrder(ShouldPreserveUseListOrder) {
   if (ShouldPreserveUseListOrder)
     UseListOrders = predictUseListOrder(M);
@@ -385,6 +385,9 @@ ValueEnumerator::ValueEnumerator(const Module &M,
 
   // Optimize constant ordering.
   OptimizeConstants(FirstConstant, Values.size());
+
+  // Organize metadata ordering.
+  organizeMetadata();
 }
 
 unsigned ValueEnumerator::getInstructionID(const Instruction *Inst) const {
@@ -543,7 +546,6 @@ void ValueEnumerator::EnumerateMetadata(const Metadata *MD) {
   else if (auto *C = dyn_cast<ConstantAsMetadata>(MD))
     EnumerateValue(C->getValue());
 
-  HasMDString |= isa<MDString>(MD);
   HasDILocation |= isa<DILocation>(MD);
   HasGenericDINode |= isa<GenericDINode>(MD);
 
@@ -553,6 +555,19 @@ void ValueEnumerator::EnumerateMetadata(const Metadata *MD) {
   MDValueMap[MD] = MDs.size();
 }
 
+/// Move the MDStrings to the front of the metadata, so that the writer can
+/// emit them all in a single record.  The other metadata keep their order.
+void ValueEnumerator::organizeMetadata() {
+  auto FirstNonString =
+      std::stable_partition(MDs.begin(), MDs.end(),
+                            [](const Metadata *MD) { return isa<MDString>(MD); });
+  NumMDStrings = FirstNonString - MDs.begin();
+
+  // Renumber the metadata to match.
+  for (unsigned I = 0, E = MDs.size(); I != E; ++I)
+    MDValueMap[MDs[I]] = I + 1;
+}
+
 /// EnumerateFunctionLocalMetadataa - Incorporate function-local metadata
 /// information reachable from the metadata.
 void ValueEnumerator::EnumerateFunctionLocalMetadata(
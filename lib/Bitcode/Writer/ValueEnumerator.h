@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_BITCODE_WRITER_VALUEENUMERATOR_H
 #define LLVM_LIB_BITCODE_WRITER_VALUEENUMERATOR_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/UniqueVector.h"
@@ -64,7 +65,8 @@ private:
   SmallVector<const LocalAsMetadata *, 8> FunctionLocalMDs;
   typedef DenseMap<const Metadata *, unsigned> MetadataMapType;
   MetadataMapType MDValueMap;
-  bool HasMDString;
+  /// The number of MDStrings, which come first in MDs.
+  unsigned NumMDStrings;
   bool HasDILocation;
   bool HasGenericDINode;
   bool ShouldPreserveUseListOrder;
@@ -120,7 +122,6 @@ public:
     return MDValueMap.lookup(MD);
   }
 
-  bool hasMDString() const { return HasMDString; }
   bool hasDILocation() const { return HasDILocation; }
   bool hasGenericDINode() const { return HasGenericDINode; }
 
@@ -158,6 +159,12 @@ public:
 
   const ValueList &getValues() const { return Values; }
   const std::vector<const Metadata *> &getMDs() const { return MDs; }
+  ArrayRef<const Metadata *> getMDStrings() const {
+    return makeArrayRef(MDs).slice(0, NumMDStrings);
+  }
+  ArrayRef<const Metadata *> getNonMDStrings() const {
+    return makeArrayRef(MDs).slice(NumMDStrings);
+  }
   const SmallVectorImpl<const LocalAsMetadata *> &getFunctionLocalMDs() const {
     return FunctionLocalMDs;
   }
@@ -192,6 +199,7 @@ private:
 
   void EnumerateMDNodeOperands(const MDNode *N);
   void EnumerateMetadata(const Metadata *MD);
+  void organizeMetadata();
   void EnumerateFunctionLocalMetadata(const LocalAsMetadata *Local);
   void EnumerateNamedMDNode(const NamedMDNode *NMD);
   void EnumerateValue(const Value *V);
@@ -0,0 +1,95 @@
+//===-- ParallelCG.cpp ----------------------------------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines functions that can be used for parallel code generation.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+
+using namespace llvm;
+
+static bool codegen(Module &M, raw_pwrite_stream &OS, const Target *TheTarget,
+                    StringRef CPU, StringRef Features,
+                    const TargetOptions &Options, Reloc::Model RM,
+                    CodeModel::Model CM, CodeGenOpt::Level OL,
+                    TargetMachine::CodeGenFileType FT) {
+  std::unique_ptr<TargetMachine> TM(TheTarget->createTargetMachine(
+      M.getTargetTriple(), CPU, Features, Options, RM, CM, OL));
+
+  legacy::PassManager CodeGenPasses;
+  if (TM->addPassesToEmitFile(CodeGenPasses, OS, FT))
+    return false;
+  CodeGenPasses.run(M);
+  return true;
+}
+
+bool llvm::splitCodeGen(Module &M, ArrayRef<raw_pwrite_stream *> OSs,
+                        StringRef CPU, StringRef Features,
+                        const TargetOptions &Options, Reloc::Model RM,
+                        CodeModel::Model CM, CodeGenOpt::Level OL,
+                        TargetMachine::CodeGenFileType FT,
+                        std::string &ErrMsg) {
+  StringRef TripleStr = M.getTargetTriple();
+  const Target *TheTarget = TargetRegistry::lookupTarget(TripleStr, ErrMsg);
+  if (!TheTarget)
+    return false;
+
+  if (OSs.size() == 1) {
+    if (!codegen(M, *OSs[0], TheTarget, CPU, Features, Options, RM, CM, OL,
+                 FT)) {
+      ErrMsg = "target file type not supported";
+      return false;
+    }
+    return true;
+  }
+
+  // Serialize each partition into memory on this thread, then hand it to a
+  // worker which deserializes it into a fresh context and code generates it.
+  ThreadPool Pool(OSs.size());
+  std::vector<std::shared_future<bool>> Results;
+  unsigned PartitionIndex = 0;
+  SplitModule(M, OSs.size(), [&](std::unique_ptr<Module> MPart) {
+    auto BC = std::make_shared<SmallVector<char, 0>>();
+    {
+      raw_svector_ostream BCOS(*BC);
+      WriteBitcodeToFile(MPart.get(), BCOS);
+    }
+    raw_pwrite_stream *ThreadOS = OSs[PartitionIndex++];
+    Results.push_back(Pool.async([=]() {
+      LLVMContext Ctx;
+      ErrorOr<std::unique_ptr<Module>> MOrErr =
+          parseBitcodeFile(MemoryBufferRef(StringRef(BC->data(), BC->size()),
+                                           "<split-module>"),
+                           Ctx);
+      if (!MOrErr)
+        report_fatal_error("Failed to read bitcode");
+      return codegen(*MOrErr.get(), *ThreadOS, TheTarget, CPU, Features,
+                     Options, RM, CM, OL, FT);
+    }));
+  });
+
+  bool Success = true;
+  for (auto &Result : Results)
+    Success &= Result.get();
+  if (!Success)
+    ErrMsg = "target file type not supported";
+  return Success;
+}
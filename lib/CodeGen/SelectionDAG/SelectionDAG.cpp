@@ -707,9 +707,34 @@ void SDDbgInfo::erase(const SDNode *Node) {
   DbgValMap.erase(I);
 }
 
+void SelectionDAG::createOperands(SDNode *Node, ArrayRef<SDValue> Vals) {
+  assert(!Node->OperandsNeedRecycle && "Node already has recycled operands");
+  if (Vals.empty()) {
+    Node->InitOperands(nullptr, nullptr, 0);
+    return;
+  }
+  SDUse *Ops = OperandRecycler.allocate(
+      ArrayRecycler<SDUse>::Capacity::get(Vals.size()), OperandAllocator);
+  Node->InitOperands(Ops, Vals.data(), Vals.size());
+  Node->OperandsNeedRecycle = true;
+}
+
+void SelectionDAG::removeOperands(SDNode *Node) {
+  if (!Node->OperandsNeedRecycle)
+    return;
+  // The list may have shrunk since it was allocated, in which case it goes
+  // back into a smaller size class than it came from.  That wastes the tail,
+  // but is safe.
+  OperandRecycler.deallocate(
+      ArrayRecycler<SDUse>::Capacity::get(Node->NumOperands),
+      Node->OperandList);
+  Node->OperandList = nullptr;
+  Node->NumOperands = 0;
+  Node->OperandsNeedRecycle = false;
+}
+
 void SelectionDAG::DeallocateNode(SDNode *N) {
-  if (N->OperandsNeedDelete)
-    delete[] N->OperandList;
+  removeOperands(N);
 
   // Set the opcode to DELETED_NODE to help catch bugs when node
   // memory is reallocated.
@@ -812,6 +837,8 @@ bool SelectionDAG::RemoveNodeFromCSEMaps(SDNode *N) {
     assert(N->getOpcode() != ISD::DELETED_NODE && "DELETED_NODE in CSEMap!");
     assert(N->getOpcode() != ISD::EntryToken && "EntryToken in CSEMap!");
     Erased = CSEMap.RemoveNode(N);
+    // The node is about to change, so its profile has to be computed again.
+    N->HasCSEHash = false;
     break;
   }
 #ifndef NDEBUG
@@ -941,6 +968,7 @@ void SelectionDAG::init(MachineFunction &mf) {
 SelectionDAG::~SelectionDAG() {
   assert(!UpdateListeners && "Dangling registered DAGUpdateListeners");
   allnodes_clear();
+  OperandRecycler.clear(OperandAllocator);
   delete DbgInfo;
 }
 
@@ -1008,6 +1036,7 @@ SDNode *SelectionDAG::FindNodeOrInsertPos(const FoldingSetNodeID &ID,
 
 void SelectionDAG::clear() {
   allnodes_clear();
+  OperandRecycler.clear(OperandAllocator);
   OperandAllocator.Reset();
   CSEMap.clear();
 
@@ -1698,7 +1727,8 @@ SDValue SelectionDAG::getConvertRndSat(EVT VT, SDLoc dl,
 
   CvtRndSatSDNode *N = new (NodeAllocator) CvtRndSatSDNode(VT, dl.getIROrder(),
                                                            dl.getDebugLoc(),
-                                                           Ops, Code);
+                                                           Code);
+  createOperands(N, Ops);
   CSEMap.InsertNode(N, IP);
   InsertNode(N);
   return SDValue(N, 0);
@@ -4829,13 +4859,15 @@ SelectionDAG::getMemIntrinsicNode(unsigned Opcode, SDLoc dl, SDVTList VTList,
     }
 
     N = new (NodeAllocator) MemIntrinsicSDNode(Opcode, dl.getIROrder(),
-                                               dl.getDebugLoc(), VTList, Ops,
+                                               dl.getDebugLoc(), VTList,
                                                MemVT, MMO);
+    createOperands(N, Ops);
     CSEMap.InsertNode(N, IP);
   } else {
     N = new (NodeAllocator) MemIntrinsicSDNode(Opcode, dl.getIROrder(),
-                                               dl.getDebugLoc(), VTList, Ops,
+                                               dl.getDebugLoc(), VTList,
                                                MemVT, MMO);
+    createOperands(N, Ops);
   }
   InsertNode(N);
   return SDValue(N, 0);
@@ -5333,11 +5365,13 @@ SDValue SelectionDAG::getNode(unsigned Opcode, SDLoc DL, EVT VT,
       return SDValue(E, 0);
 
     N = new (NodeAllocator) SDNode(Opcode, DL.getIROrder(), DL.getDebugLoc(),
-                                   VTs, Ops);
+                                   VTs);
+    createOperands(N, Ops);
     CSEMap.InsertNode(N, IP);
   } else {
     N = new (NodeAllocator) SDNode(Opcode, DL.getIROrder(), DL.getDebugLoc(),
-                                   VTs, Ops);
+                                   VTs);
+    createOperands(N, Ops);
   }
 
   InsertNode(N);
@@ -5400,7 +5434,8 @@ SDValue SelectionDAG::getNode(unsigned Opcode, SDLoc DL, SDVTList VTList,
                                             Ops[1], Ops[2]);
     } else {
       N = new (NodeAllocator) SDNode(Opcode, DL.getIROrder(), DL.getDebugLoc(),
-                                     VTList, Ops);
+                                     VTList);
+      createOperands(N, Ops);
     }
     CSEMap.InsertNode(N, IP);
   } else {
@@ -5417,7 +5452,8 @@ SDValue SelectionDAG::getNode(unsigned Opcode, SDLoc DL, SDVTList VTList,
                                             Ops[1], Ops[2]);
     } else {
       N = new (NodeAllocator) SDNode(Opcode, DL.getIROrder(), DL.getDebugLoc(),
-                                     VTList, Ops);
+                                     VTList);
+      createOperands(N, Ops);
     }
   }
   InsertNode(N);
@@ -5838,9 +5874,8 @@ SDNode *SelectionDAG::MorphNodeTo(SDNode *N, unsigned Opc,
     MN->setMemRefs(nullptr, nullptr);
     // If NumOps is larger than the # of operands we can have in a
     // MachineSDNode, reallocate the operand list.
-    if (NumOps > MN->NumOperands || !MN->OperandsNeedDelete) {
-      if (MN->OperandsNeedDelete)
-        delete[] MN->OperandList;
+    if (NumOps > MN->NumOperands || !MN->OperandsNeedRecycle) {
+      removeOperands(MN);
       if (NumOps > array_lengthof(MN->LocalOperands))
         // We're creating a final node that will live unmorphed for the
         // remainder of the current SelectionDAG iteration, so we can allocate
@@ -5849,17 +5884,14 @@ SDNode *SelectionDAG::MorphNodeTo(SDNode *N, unsigned Opc,
                          Ops.data(), NumOps);
       else
         MN->InitOperands(MN->LocalOperands, Ops.data(), NumOps);
-      MN->OperandsNeedDelete = false;
     } else
       MN->InitOperands(MN->OperandList, Ops.data(), NumOps);
   } else {
     // If NumOps is larger than the # of operands we currently have, reallocate
     // the operand list.
     if (NumOps > N->NumOperands) {
-      if (N->OperandsNeedDelete)
-        delete[] N->OperandList;
-      N->InitOperands(new SDUse[NumOps], Ops.data(), NumOps);
-      N->OperandsNeedDelete = true;
+      removeOperands(N);
+      createOperands(N, Ops);
     } else
       N->InitOperands(N->OperandList, Ops.data(), NumOps);
   }
@@ -6034,7 +6066,6 @@ SelectionDAG::getMachineNode(unsigned Opcode, SDLoc DL, SDVTList VTs,
                     Ops, NumOps);
   else
     N->InitOperands(N->LocalOperands, Ops, NumOps);
-  N->OperandsNeedDelete = false;
 
   if (DoCSE)
     CSEMap.InsertNode(N, IP);
@@ -6563,16 +6594,6 @@ MemSDNode::MemSDNode(unsigned Opc, unsigned Order, DebugLoc dl, SDVTList VTs,
   assert(memvt.getStoreSize() <= MMO->getSize() && "Size mismatch!");
 }
 
-MemSDNode::MemSDNode(unsigned Opc, unsigned Order, DebugLoc dl, SDVTList VTs,
-                     ArrayRef<SDValue> Ops, EVT memvt, MachineMemOperand *mmo)
-   : SDNode(Opc, Order, dl, VTs, Ops),
-     MemoryVT(memvt), MMO(mmo) {
-  SubclassData = encodeMemSDNodeFlags(0, ISD::UNINDEXED, MMO->isVolatile(),
-                                      MMO->isNonTemporal(), MMO->isInvariant());
-  assert(isVolatile() == MMO->isVolatile() && "Volatile encoding error!");
-  assert(memvt.getStoreSize() <= MMO->getSize() && "Size mismatch!");
-}
-
 /// Profile - Gather unique data for the node.
 ///
 void SDNode::Profile(FoldingSetNodeID &ID) const {
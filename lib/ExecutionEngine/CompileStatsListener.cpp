@@ -0,0 +1,157 @@
+//===-- CompileStatsListener.cpp - Write out JIT compile statistics -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a JITEventListener that writes the per-function compile
+// times and code sizes the JIT reports to a stream, as JSON or as CSV.
+//
+// The JSON output is one object per compiled module and line, so that the
+// output stays well formed even if the process exits without destroying the
+// listener.  The CSV output has one row per function, plus one row per module
+// with an empty function column that carries the module-wide times.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/MutexGuard.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace {
+
+class CompileStatsListener : public JITEventListener {
+public:
+  CompileStatsListener(raw_ostream &OS, CompileStatsFormat Format)
+      : OS(OS), Format(Format) {
+    if (Format == CSF_CSV) {
+      OS << "module,function,ir_time,isel_time,regalloc_time,post_ra_time,"
+            "emission_time,object_write_time,load_time,code_size\n";
+      OS.flush();
+    }
+  }
+
+  bool wantsCompileStats() const override { return true; }
+
+  void NotifyModuleCompiled(const Module &M,
+                            const ModuleCompileStats &Stats) override {
+    MutexGuard Locked(Lock);
+    if (Format == CSF_JSON)
+      writeJSON(Stats);
+    else
+      writeCSV(Stats);
+    OS.flush();
+  }
+
+private:
+  void writeTime(double T) { OS << format("%.6f", T); }
+  void writeJSONString(StringRef S);
+  void writeCSVString(StringRef S);
+  void writeJSON(const ModuleCompileStats &Stats);
+  void writeCSV(const ModuleCompileStats &Stats);
+
+  raw_ostream &OS;
+  CompileStatsFormat Format;
+  sys::Mutex Lock;
+};
+
+} // end anonymous namespace
+
+void CompileStatsListener::writeJSONString(StringRef S) {
+  OS << '"';
+  for (unsigned char C : S) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void CompileStatsListener::writeCSVString(StringRef S) {
+  if (S.find_first_of(",\"\r\n") == StringRef::npos) {
+    OS << S;
+    return;
+  }
+  OS << '"';
+  for (char C : S) {
+    if (C == '"')
+      OS << '"';
+    OS << C;
+  }
+  OS << '"';
+}
+
+void CompileStatsListener::writeJSON(const ModuleCompileStats &Stats) {
+  OS << "{\"module\":";
+  writeJSONString(Stats.ModuleName);
+  OS << ",\"cached\":" << (Stats.FromObjectCache ? "true" : "false");
+  OS << ",\"object_write_time\":";
+  writeTime(Stats.ObjectWriteTime);
+  OS << ",\"load_time\":";
+  writeTime(Stats.LoadTime);
+  OS << ",\"functions\":[";
+  for (unsigned I = 0, E = Stats.Functions.size(); I != E; ++I) {
+    const FunctionCompileStats &F = Stats.Functions[I];
+    if (I)
+      OS << ',';
+    OS << "{\"name\":";
+    writeJSONString(F.Name);
+    OS << ",\"ir_time\":";
+    writeTime(F.IRTime);
+    OS << ",\"isel_time\":";
+    writeTime(F.ISelTime);
+    OS << ",\"regalloc_time\":";
+    writeTime(F.RegAllocTime);
+    OS << ",\"post_ra_time\":";
+    writeTime(F.PostRATime);
+    OS << ",\"emission_time\":";
+    writeTime(F.EmissionTime);
+    OS << ",\"code_size\":" << F.CodeSize << '}';
+  }
+  OS << "]}\n";
+}
+
+void CompileStatsListener::writeCSV(const ModuleCompileStats &Stats) {
+  for (const FunctionCompileStats &F : Stats.Functions) {
+    writeCSVString(Stats.ModuleName);
+    OS << ',';
+    writeCSVString(F.Name);
+    OS << ',';
+    writeTime(F.IRTime);
+    OS << ',';
+    writeTime(F.ISelTime);
+    OS << ',';
+    writeTime(F.RegAllocTime);
+    OS << ',';
+    writeTime(F.PostRATime);
+    OS << ',';
+    writeTime(F.EmissionTime);
+    OS << ",,," << F.CodeSize << '\n';
+  }
+  writeCSVString(Stats.ModuleName);
+  OS << ",,,,,,,";
+  writeTime(Stats.ObjectWriteTime);
+  OS << ',';
+  writeTime(Stats.LoadTime);
+  OS << ",\n";
+}
+
+namespace llvm {
+
+JITEventListener *
+JITEventListener::createCompileStatsListener(raw_ostream &OS,
+                                             CompileStatsFormat Format) {
+  return new CompileStatsListener(OS, Format);
+}
+
+} // namespace llvm
@@ -0,0 +1,144 @@
+//===-- FileObjectCache.cpp - On-disk object cache for the JITs -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the FileObjectCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/FileObjectCache.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "file-object-cache"
+
+/// Describe everything in \p TM that affects the objects it produces.
+static std::string getConfig(const TargetMachine &TM) {
+  std::string Config;
+  raw_string_ostream OS(Config);
+  OS << "triple=" << TM.getTargetTriple().str() << ';'
+     << "cpu=" << TM.getTargetCPU() << ';'
+     << "features=" << TM.getTargetFeatureString() << ';'
+     << "opt=" << TM.getOptLevel() << ';'
+     << "reloc=" << TM.getRelocationModel() << ';'
+     << "code=" << TM.getCodeModel() << ';'
+     << "fast-isel=" << TM.Options.EnableFastISel << ';'
+     << "float-abi=" << TM.Options.FloatABIType << ';';
+  return OS.str();
+}
+
+FileObjectCache::FileObjectCache(StringRef CacheDir, const TargetMachine &TM)
+    : FileObjectCache(CacheDir, getConfig(TM)) {}
+
+FileObjectCache::FileObjectCache(StringRef CacheDir, StringRef Config)
+    : CacheDir(CacheDir), Config(Config) {
+  sys::fs::create_directories(CacheDir);
+}
+
+FileObjectCache::~FileObjectCache() {}
+
+std::string FileObjectCache::computeKey(const Module &M, StringRef Config) {
+  // Unlike the textual IR, the bitcode does not depend on the module
+  // identifier, so the same IR loaded from different places shares entries.
+  SmallString<0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+
+  MD5 Hasher;
+  Hasher.update("LLVM " LLVM_VERSION_STRING ";");
+  Hasher.update(Config);
+  Hasher.update(Bitcode);
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+SmallString<128> FileObjectCache::getEntryPath(StringRef Key) const {
+  SmallString<128> EntryPath(CacheDir);
+  sys::path::append(EntryPath, "llvmcache-" + Key);
+  return EntryPath;
+}
+
+std::unique_ptr<MemoryBuffer> FileObjectCache::getObject(const Module *M) {
+  std::string Key = computeKey(*M, Config);
+  SmallString<128> EntryPath = getEntryPath(Key);
+
+  int FD;
+  if (!sys::fs::openFileForRead(EntryPath, FD)) {
+    // Record the use of the entry for CachePruning.
+    sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getOpenFile(FD, EntryPath, -1, false);
+    sys::Process::SafelyCloseFileDescriptor(FD);
+    if (BufferOrErr) {
+      DEBUG(dbgs() << "Cache hit for " << M->getModuleIdentifier() << " ("
+                   << Key << ")\n");
+      // The JIT may apply relocations in place, so hand out a copy rather
+      // than the mapped file.
+      return MemoryBuffer::getMemBufferCopy((*BufferOrErr)->getBuffer(),
+                                            M->getModuleIdentifier());
+    }
+  }
+
+  DEBUG(dbgs() << "Cache miss for " << M->getModuleIdentifier() << " (" << Key
+               << ")\n");
+  std::lock_guard<std::mutex> Lock(PendingKeysMutex);
+  PendingKeys[M] = std::move(Key);
+  return nullptr;
+}
+
+void FileObjectCache::notifyObjectCompiled(const Module *M,
+                                           MemoryBufferRef Obj) {
+  std::string Key;
+  {
+    std::lock_guard<std::mutex> Lock(PendingKeysMutex);
+    auto I = PendingKeys.find(M);
+    if (I != PendingKeys.end()) {
+      Key = std::move(I->second);
+      PendingKeys.erase(I);
+    }
+  }
+  // The module was compiled without being looked up first: what it looks like
+  // now is the best we have.
+  if (Key.empty())
+    Key = computeKey(*M, Config);
+
+  // Write to a temporary file first so that the entry appears atomically.
+  // Failures are ignored: the cache is only an optimization.
+  SmallString<128> TempPath(CacheDir);
+  sys::path::append(TempPath, "llvmcache-tmp-%%%%%%%%");
+  int FD;
+  if (sys::fs::createUniqueFile(TempPath, FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Obj.getBuffer();
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, getEntryPath(Key)))
+    sys::fs::remove(TempPath);
+}
@@ -0,0 +1,1045 @@
+//===-- Bytecode.cpp - Translate and run functions as bytecode ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file translates functions into the register-based bytecode described
+// in Bytecode.h, and contains the dispatch loop that executes it.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Bytecode.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include <cmath>
+#include <cstring>
+using namespace llvm;
+
+#define DEBUG_TYPE "interpreter"
+
+STATISTIC(NumBytecodeFunctions, "Number of functions run as bytecode");
+STATISTIC(NumBytecodeInsts, "Number of bytecode instructions executed");
+
+static cl::opt<bool> DisableBytecode("interpreter-disable-bytecode",
+  cl::Hidden, cl::init(false),
+  cl::desc("Interpret every function by visiting its IR instructions "
+           "instead of translating it to bytecode first"));
+
+//===----------------------------------------------------------------------===//
+//                     Various Helper Functions
+//===----------------------------------------------------------------------===//
+
+static uint64_t getWidthMask(unsigned Width) {
+  return Width == 64 ? ~0ULL : (1ULL << Width) - 1;
+}
+
+static int64_t signExtend(uint64_t Val, unsigned Width) {
+  return (int64_t)(Val << (64 - Width)) >> (64 - Width);
+}
+
+static void *getPointer(const BytecodeValue &V) {
+  return (void *)(uintptr_t)V.IntVal;
+}
+
+static void setPointer(BytecodeValue &V, void *P) {
+  V.IntVal = (uintptr_t)P;
+}
+
+// Shift amounts of at least the bit width are undefined; handle them the way
+// getShiftAmount in Execution.cpp does.
+static unsigned getShiftAmount(uint64_t Amount, unsigned Width) {
+  if (Amount < Width)
+    return Amount;
+  return (NextPowerOf2(Width - 1) - 1) & Amount;
+}
+
+static GenericValue toGenericValue(const BytecodeValue &V, Type *Ty) {
+  GenericValue GV;
+  switch (Ty->getTypeID()) {
+  default: llvm_unreachable("Type not supported by bytecode");
+  case Type::IntegerTyID:
+    GV.IntVal = APInt(cast<IntegerType>(Ty)->getBitWidth(), V.IntVal);
+    break;
+  case Type::FloatTyID:   GV.FloatVal = V.FloatVal; break;
+  case Type::DoubleTyID:  GV.DoubleVal = V.DoubleVal; break;
+  case Type::PointerTyID: GV.PointerVal = getPointer(V); break;
+  }
+  return GV;
+}
+
+static BytecodeValue fromGenericValue(const GenericValue &GV, Type *Ty) {
+  BytecodeValue V;
+  V.IntVal = 0;
+  switch (Ty->getTypeID()) {
+  default: llvm_unreachable("Type not supported by bytecode");
+  case Type::IntegerTyID:
+    V.IntVal = GV.IntVal.zextOrTrunc(cast<IntegerType>(Ty)->getBitWidth())
+                   .getZExtValue();
+    break;
+  case Type::FloatTyID:   V.FloatVal = GV.FloatVal; break;
+  case Type::DoubleTyID:  V.DoubleVal = GV.DoubleVal; break;
+  case Type::PointerTyID: setPointer(V, GV.PointerVal); break;
+  }
+  return V;
+}
+
+template <typename T> static bool executeFCmp(unsigned Predicate, T L, T R) {
+  bool Unordered = std::isnan(L) || std::isnan(R);
+  switch (Predicate) {
+  default: llvm_unreachable("Invalid FCmp predicate");
+  case FCmpInst::FCMP_FALSE: return false;
+  case FCmpInst::FCMP_OEQ:   return !Unordered && L == R;
+  case FCmpInst::FCMP_OGT:   return !Unordered && L > R;
+  case FCmpInst::FCMP_OGE:   return !Unordered && L >= R;
+  case FCmpInst::FCMP_OLT:   return !Unordered && L < R;
+  case FCmpInst::FCMP_OLE:   return !Unordered && L <= R;
+  case FCmpInst::FCMP_ONE:   return !Unordered && L != R;
+  case FCmpInst::FCMP_ORD:   return !Unordered;
+  case FCmpInst::FCMP_UNO:   return Unordered;
+  case FCmpInst::FCMP_UEQ:   return Unordered || L == R;
+  case FCmpInst::FCMP_UGT:   return Unordered || L > R;
+  case FCmpInst::FCMP_UGE:   return Unordered || L >= R;
+  case FCmpInst::FCMP_ULT:   return Unordered || L < R;
+  case FCmpInst::FCMP_ULE:   return Unordered || L <= R;
+  case FCmpInst::FCMP_UNE:   return Unordered || L != R;
+  case FCmpInst::FCMP_TRUE:  return true;
+  }
+}
+
+//===----------------------------------------------------------------------===//
+//                        Translation to Bytecode
+//===----------------------------------------------------------------------===//
+
+namespace llvm {
+
+// BytecodeBuilder - Translate one function.  Branches are first emitted with
+// the index of a CFG edge as their target; once all blocks are laid out, the
+// PHI copies for each edge that needs them are emitted after the body and
+// the targets are patched to point at them.
+//
+class BytecodeBuilder {
+  Interpreter &Interp;
+  const DataLayout &TD;
+  Function &F;
+  std::unique_ptr<BytecodeFunction> BF;
+
+  DenseMap<const Value *, unsigned> Registers;
+  DenseMap<Constant *, unsigned> ConstantRegisters;
+  SmallVector<std::pair<unsigned, BytecodeValue>, 16> ConstantValues;
+  unsigned NumRegisters;
+
+  DenseMap<const BasicBlock *, unsigned> BlockStart;
+  DenseMap<std::pair<const BasicBlock *, BasicBlock *>, unsigned> EdgeIDs;
+  SmallVector<std::pair<const BasicBlock *, BasicBlock *>, 16> Edges;
+
+public:
+  BytecodeBuilder(Interpreter &Interp, Function &F)
+      : Interp(Interp), TD(Interp.TD), F(F), BF(new BytecodeFunction()),
+        NumRegisters(0) {
+    BF->F = &F;
+  }
+
+  std::unique_ptr<BytecodeFunction> build();
+
+private:
+  static bool isRegisterType(Type *Ty) {
+    if (IntegerType *ITy = dyn_cast<IntegerType>(Ty))
+      return ITy->getBitWidth() <= 64;
+    return Ty->isFloatTy() || Ty->isDoubleTy() || Ty->isPointerTy();
+  }
+
+  static bool isDecodableConstant(Constant *C);
+
+  unsigned getPointerWidth() const { return TD.getPointerSizeInBits(); }
+
+  unsigned getWidth(Type *Ty) const {
+    if (Ty->isPointerTy())
+      return getPointerWidth();
+    return cast<IntegerType>(Ty)->getBitWidth();
+  }
+
+  bool getRegister(Value *V, unsigned &Reg);
+  unsigned getEdge(const BasicBlock *From, BasicBlock *To);
+
+  bool emitInstruction(Instruction &I);
+  bool emitBinaryOperator(BinaryOperator &I, unsigned Dst);
+  bool emitCast(CastInst &I, unsigned Dst);
+  bool emitMemoryAccess(Instruction &I, Type *Ty, bool IsStore);
+  bool emitGEP(GetElementPtrInst &I, unsigned Dst);
+  bool emitCall(CallInst &I);
+  bool emitEdge(const BasicBlock *From, BasicBlock *To);
+
+  void emit(const BytecodeInst &Inst) { BF->Code.push_back(Inst); }
+};
+
+} // End llvm namespace
+
+bool BytecodeBuilder::isDecodableConstant(Constant *C) {
+  if (isa<BlockAddress>(C))
+    return false;
+  ConstantExpr *CE = dyn_cast<ConstantExpr>(C);
+  if (!CE)
+    return true;
+  // Only the expressions getConstantExprValue knows how to evaluate.
+  switch (CE->getOpcode()) {
+  default:
+    if (!Instruction::isBinaryOp(CE->getOpcode()))
+      return false;
+    break;
+  case Instruction::Trunc:    case Instruction::ZExt:
+  case Instruction::SExt:     case Instruction::FPTrunc:
+  case Instruction::FPExt:    case Instruction::UIToFP:
+  case Instruction::SIToFP:   case Instruction::FPToUI:
+  case Instruction::FPToSI:   case Instruction::PtrToInt:
+  case Instruction::IntToPtr: case Instruction::BitCast:
+  case Instruction::GetElementPtr:
+  case Instruction::ICmp:     case Instruction::FCmp:
+  case Instruction::Select:
+    break;
+  }
+  for (Use &Op : CE->operands())
+    if (!isDecodableConstant(cast<Constant>(Op)))
+      return false;
+  return true;
+}
+
+bool BytecodeBuilder::getRegister(Value *V, unsigned &Reg) {
+  if (!isRegisterType(V->getType()))
+    return false;
+
+  auto I = Registers.find(V);
+  if (I != Registers.end()) {
+    Reg = I->second;
+    return true;
+  }
+
+  // Constants are evaluated once, now, and live in registers of their own
+  // which every call starts out with.  Globals have their final address by
+  // the time anything runs, so this holds for constant expressions too.
+  Constant *C = dyn_cast<Constant>(V);
+  if (!C || !isDecodableConstant(C))
+    return false;
+  auto CI = ConstantRegisters.find(C);
+  if (CI != ConstantRegisters.end()) {
+    Reg = CI->second;
+    return true;
+  }
+  ExecutionContext Dummy;
+  GenericValue GV = Interp.getOperandValue(C, Dummy);
+  Reg = NumRegisters++;
+  ConstantRegisters[C] = Reg;
+  ConstantValues.push_back(
+      std::make_pair(Reg, fromGenericValue(GV, C->getType())));
+  return true;
+}
+
+unsigned BytecodeBuilder::getEdge(const BasicBlock *From, BasicBlock *To) {
+  auto Key = std::make_pair(From, To);
+  auto I = EdgeIDs.find(Key);
+  if (I != EdgeIDs.end())
+    return I->second;
+  unsigned ID = Edges.size();
+  EdgeIDs[Key] = ID;
+  Edges.push_back(Key);
+  return ID;
+}
+
+std::unique_ptr<BytecodeFunction> BytecodeBuilder::build() {
+  if (F.isVarArg())
+    return nullptr;
+  if (!F.getReturnType()->isVoidTy() && !isRegisterType(F.getReturnType()))
+    return nullptr;
+
+  for (Argument &A : F.args()) {
+    if (!isRegisterType(A.getType()))
+      return nullptr;
+    Registers[&A] = NumRegisters++;
+  }
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      if (!I.getType()->isVoidTy()) {
+        if (!isRegisterType(I.getType()))
+          return nullptr;
+        Registers[&I] = NumRegisters++;
+      }
+
+  for (BasicBlock &BB : F) {
+    BlockStart[&BB] = BF->Code.size();
+    for (Instruction &I : BB)
+      if (!isa<PHINode>(I) && !emitInstruction(I))
+        return nullptr;
+  }
+
+  // Emit the PHI copies, resolving each edge to the index they start at.
+  unsigned BodySize = BF->Code.size();
+  SmallVector<unsigned, 16> EdgeTarget;
+  for (unsigned i = 0; i != Edges.size(); ++i) {
+    BasicBlock *To = Edges[i].second;
+    if (!isa<PHINode>(To->begin())) {
+      EdgeTarget.push_back(BlockStart[To]);
+      continue;
+    }
+    EdgeTarget.push_back(BF->Code.size());
+    if (!emitEdge(Edges[i].first, To))
+      return nullptr;
+  }
+
+  for (unsigned i = 0; i != BodySize; ++i) {
+    BytecodeInst &Inst = BF->Code[i];
+    switch (Inst.Opcode) {
+    default: break;
+    case BytecodeInst::Br:
+      Inst.A = EdgeTarget[Inst.A];
+      break;
+    case BytecodeInst::CondBr:
+      Inst.B = EdgeTarget[Inst.B];
+      Inst.C = EdgeTarget[Inst.C];
+      break;
+    }
+  }
+  for (BytecodeSwitch &S : BF->Switches) {
+    for (auto &Case : S.Cases)
+      Case.second = EdgeTarget[Case.second];
+    S.DefaultDest = EdgeTarget[S.DefaultDest];
+  }
+
+  BytecodeValue Zero;
+  Zero.IntVal = 0;
+  BF->InitialRegisters.assign(NumRegisters, Zero);
+  for (auto &CV : ConstantValues)
+    BF->InitialRegisters[CV.first] = CV.second;
+
+  DEBUG(dbgs() << "Translated '" << F.getName() << "' to "
+               << BF->Code.size() << " bytecode instructions using "
+               << NumRegisters << " registers\n");
+  return std::move(BF);
+}
+
+// emitEdge - Copy the incoming values of the PHI nodes of To for the edge
+// from From, then jump to the body of To.  All PHI nodes read their inputs
+// before any is written, so when one PHI feeds another the copies go through
+// temporary registers.
+//
+bool BytecodeBuilder::emitEdge(const BasicBlock *From, BasicBlock *To) {
+  SmallVector<std::pair<unsigned, unsigned>, 8> Copies;
+  bool NeedsTemporaries = false;
+  for (Instruction &I : *To) {
+    PHINode *PN = dyn_cast<PHINode>(&I);
+    if (!PN)
+      break;
+    Value *Incoming = PN->getIncomingValueForBlock(From);
+    unsigned Src;
+    if (!getRegister(Incoming, Src))
+      return false;
+    if (PHINode *InPN = dyn_cast<PHINode>(Incoming))
+      if (InPN->getParent() == To)
+        NeedsTemporaries = true;
+    Copies.push_back(std::make_pair(Registers[PN], Src));
+  }
+
+  if (NeedsTemporaries) {
+    unsigned Temp = NumRegisters;
+    NumRegisters += Copies.size();
+    for (unsigned i = 0; i != Copies.size(); ++i)
+      emit(BytecodeInst(BytecodeInst::Move, Temp + i, Copies[i].second));
+    for (unsigned i = 0; i != Copies.size(); ++i)
+      emit(BytecodeInst(BytecodeInst::Move, Copies[i].first, Temp + i));
+  } else {
+    for (auto &Copy : Copies)
+      if (Copy.first != Copy.second)
+        emit(BytecodeInst(BytecodeInst::Move, Copy.first, Copy.second));
+  }
+  emit(BytecodeInst(BytecodeInst::Br, 0, BlockStart[To]));
+  return true;
+}
+
+bool BytecodeBuilder::emitInstruction(Instruction &I) {
+  unsigned Dst = I.getType()->isVoidTy() ? BytecodeFunction::NoRegister
+                                         : Registers[&I];
+
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(&I))
+    return emitBinaryOperator(*BO, Dst);
+  if (CastInst *CI = dyn_cast<CastInst>(&I))
+    return emitCast(*CI, Dst);
+
+  switch (I.getOpcode()) {
+  default:
+    return false;
+
+  case Instruction::ICmp: {
+    ICmpInst &CI = cast<ICmpInst>(I);
+    BytecodeInst Inst(BytecodeInst::ICmpEQ, Dst);
+    if (!getRegister(CI.getOperand(0), Inst.A) ||
+        !getRegister(CI.getOperand(1), Inst.B))
+      return false;
+    switch (CI.getPredicate()) {
+    default: return false;
+    case ICmpInst::ICMP_EQ:  Inst.Opcode = BytecodeInst::ICmpEQ; break;
+    case ICmpInst::ICMP_NE:  Inst.Opcode = BytecodeInst::ICmpNE; break;
+    case ICmpInst::ICMP_UGT: Inst.Opcode = BytecodeInst::ICmpUGT; break;
+    case ICmpInst::ICMP_UGE: Inst.Opcode = BytecodeInst::ICmpUGE; break;
+    case ICmpInst::ICMP_ULT: Inst.Opcode = BytecodeInst::ICmpULT; break;
+    case ICmpInst::ICMP_ULE: Inst.Opcode = BytecodeInst::ICmpULE; break;
+    case ICmpInst::ICMP_SGT: Inst.Opcode = BytecodeInst::ICmpSGT; break;
+    case ICmpInst::ICMP_SGE: Inst.Opcode = BytecodeInst::ICmpSGE; break;
+    case ICmpInst::ICMP_SLT: Inst.Opcode = BytecodeInst::ICmpSLT; break;
+    case ICmpInst::ICMP_SLE: Inst.Opcode = BytecodeInst::ICmpSLE; break;
+    }
+    Inst.Width = getWidth(CI.getOperand(0)->getType());
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::FCmp: {
+    FCmpInst &CI = cast<FCmpInst>(I);
+    BytecodeInst Inst(CI.getOperand(0)->getType()->isFloatTy()
+                          ? BytecodeInst::FCmpF
+                          : BytecodeInst::FCmpD,
+                      Dst);
+    if (!getRegister(CI.getOperand(0), Inst.A) ||
+        !getRegister(CI.getOperand(1), Inst.B))
+      return false;
+    Inst.Aux = CI.getPredicate();
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Select: {
+    BytecodeInst Inst(BytecodeInst::Select, Dst);
+    if (!getRegister(I.getOperand(0), Inst.A) ||
+        !getRegister(I.getOperand(1), Inst.B) ||
+        !getRegister(I.getOperand(2), Inst.C))
+      return false;
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Alloca: {
+    AllocaInst &AI = cast<AllocaInst>(I);
+    BytecodeInst Inst(BytecodeInst::Alloca, Dst);
+    if (!getRegister(AI.getArraySize(), Inst.A))
+      return false;
+    Inst.Imm = TD.getTypeAllocSize(AI.getAllocatedType());
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Load:
+    return emitMemoryAccess(I, I.getType(), false);
+  case Instruction::Store:
+    return emitMemoryAccess(I, I.getOperand(0)->getType(), true);
+  case Instruction::GetElementPtr:
+    return emitGEP(cast<GetElementPtrInst>(I), Dst);
+  case Instruction::Call:
+    return emitCall(cast<CallInst>(I));
+
+  case Instruction::Ret: {
+    ReturnInst &RI = cast<ReturnInst>(I);
+    BytecodeInst Inst(BytecodeInst::Ret, 0, BytecodeFunction::NoRegister);
+    if (RI.getReturnValue() && !getRegister(RI.getReturnValue(), Inst.A))
+      return false;
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Br: {
+    BranchInst &BI = cast<BranchInst>(I);
+    const BasicBlock *BB = BI.getParent();
+    if (BI.isUnconditional()) {
+      emit(BytecodeInst(BytecodeInst::Br, 0, getEdge(BB, BI.getSuccessor(0))));
+      return true;
+    }
+    BytecodeInst Inst(BytecodeInst::CondBr);
+    if (!getRegister(BI.getCondition(), Inst.A))
+      return false;
+    Inst.B = getEdge(BB, BI.getSuccessor(0));
+    Inst.C = getEdge(BB, BI.getSuccessor(1));
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Switch: {
+    SwitchInst &SI = cast<SwitchInst>(I);
+    const BasicBlock *BB = SI.getParent();
+    BytecodeInst Inst(BytecodeInst::Switch, 0, 0, BF->Switches.size());
+    if (!getRegister(SI.getCondition(), Inst.A))
+      return false;
+    BytecodeSwitch Table;
+    for (SwitchInst::CaseIt i = SI.case_begin(), e = SI.case_end(); i != e;
+         ++i)
+      Table.Cases.push_back(std::make_pair(
+          i.getCaseValue()->getZExtValue(), getEdge(BB, i.getCaseSuccessor())));
+    Table.DefaultDest = getEdge(BB, SI.getDefaultDest());
+    BF->Switches.push_back(std::move(Table));
+    emit(Inst);
+    return true;
+  }
+
+  case Instruction::Unreachable:
+    emit(BytecodeInst(BytecodeInst::Unreachable));
+    return true;
+  }
+}
+
+bool BytecodeBuilder::emitBinaryOperator(BinaryOperator &I, unsigned Dst) {
+  BytecodeInst Inst(BytecodeInst::Move, Dst);
+  if (!getRegister(I.getOperand(0), Inst.A) ||
+      !getRegister(I.getOperand(1), Inst.B))
+    return false;
+
+  Type *Ty = I.getType();
+  if (Ty->isFloatTy() || Ty->isDoubleTy()) {
+    bool IsFloat = Ty->isFloatTy();
+    switch (I.getOpcode()) {
+    default: return false;
+    case Instruction::FAdd:
+      Inst.Opcode = IsFloat ? BytecodeInst::FAddF : BytecodeInst::FAddD;
+      break;
+    case Instruction::FSub:
+      Inst.Opcode = IsFloat ? BytecodeInst::FSubF : BytecodeInst::FSubD;
+      break;
+    case Instruction::FMul:
+      Inst.Opcode = IsFloat ? BytecodeInst::FMulF : BytecodeInst::FMulD;
+      break;
+    case Instruction::FDiv:
+      Inst.Opcode = IsFloat ? BytecodeInst::FDivF : BytecodeInst::FDivD;
+      break;
+    case Instruction::FRem:
+      Inst.Opcode = IsFloat ? BytecodeInst::FRemF : BytecodeInst::FRemD;
+      break;
+    }
+    emit(Inst);
+    return true;
+  }
+
+  if (!Ty->isIntegerTy())
+    return false;
+  switch (I.getOpcode()) {
+  default: return false;
+  case Instruction::Add:  Inst.Opcode = BytecodeInst::Add; break;
+  case Instruction::Sub:  Inst.Opcode = BytecodeInst::Sub; break;
+  case Instruction::Mul:  Inst.Opcode = BytecodeInst::Mul; break;
+  case Instruction::UDiv: Inst.Opcode = BytecodeInst::UDiv; break;
+  case Instruction::SDiv: Inst.Opcode = BytecodeInst::SDiv; break;
+  case Instruction::URem: Inst.Opcode = BytecodeInst::URem; break;
+  case Instruction::SRem: Inst.Opcode = BytecodeInst::SRem; break;
+  case Instruction::And:  Inst.Opcode = BytecodeInst::And; break;
+  case Instruction::Or:   Inst.Opcode = BytecodeInst::Or; break;
+  case Instruction::Xor:  Inst.Opcode = BytecodeInst::Xor; break;
+  case Instruction::Shl:  Inst.Opcode = BytecodeInst::Shl; break;
+  case Instruction::LShr: Inst.Opcode = BytecodeInst::LShr; break;
+  case Instruction::AShr: Inst.Opcode = BytecodeInst::AShr; break;
+  }
+  Inst.Width = getWidth(Ty);
+  Inst.Imm = getWidthMask(Inst.Width);
+  emit(Inst);
+  return true;
+}
+
+bool BytecodeBuilder::emitCast(CastInst &I, unsigned Dst) {
+  BytecodeInst Inst(BytecodeInst::Move, Dst);
+  if (!getRegister(I.getOperand(0), Inst.A))
+    return false;
+
+  Type *SrcTy = I.getSrcTy();
+  Type *DstTy = I.getDestTy();
+  switch (I.getOpcode()) {
+  default:
+    return false;
+  case Instruction::ZExt:
+    // Integers are kept zero-extended already.
+    break;
+  case Instruction::Trunc:
+  case Instruction::PtrToInt:
+  case Instruction::IntToPtr:
+    Inst.Opcode = BytecodeInst::Trunc;
+    Inst.Imm = getWidthMask(getWidth(DstTy));
+    break;
+  case Instruction::SExt:
+    Inst.Opcode = BytecodeInst::SExt;
+    Inst.Width = getWidth(SrcTy);
+    Inst.Imm = getWidthMask(getWidth(DstTy));
+    break;
+  case Instruction::FPTrunc:
+    if (!SrcTy->isDoubleTy() || !DstTy->isFloatTy())
+      return false;
+    Inst.Opcode = BytecodeInst::FPTrunc;
+    break;
+  case Instruction::FPExt:
+    if (!SrcTy->isFloatTy() || !DstTy->isDoubleTy())
+      return false;
+    Inst.Opcode = BytecodeInst::FPExt;
+    break;
+  case Instruction::UIToFP:
+  case Instruction::SIToFP:
+    Inst.Opcode = I.getOpcode() == Instruction::UIToFP ? BytecodeInst::UIToFP
+                                                       : BytecodeInst::SIToFP;
+    Inst.Width = getWidth(SrcTy);
+    Inst.Aux = DstTy->isDoubleTy();
+    break;
+  case Instruction::FPToUI:
+  case Instruction::FPToSI:
+    Inst.Opcode = I.getOpcode() == Instruction::FPToUI ? BytecodeInst::FPToUI
+                                                       : BytecodeInst::FPToSI;
+    Inst.Width = getWidth(DstTy);
+    Inst.Aux = SrcTy->isDoubleTy();
+    break;
+  case Instruction::BitCast:
+    // Registers hold doubles and 64-bit integers in the same bits, but a
+    // float only occupies part of one.
+    if (SrcTy->isFloatTy() && DstTy->isIntegerTy())
+      Inst.Opcode = BytecodeInst::BitCastFToI;
+    else if (SrcTy->isIntegerTy() && DstTy->isFloatTy())
+      Inst.Opcode = BytecodeInst::BitCastIToF;
+    break;
+  }
+  emit(Inst);
+  return true;
+}
+
+bool BytecodeBuilder::emitMemoryAccess(Instruction &I, Type *Ty,
+                                       bool IsStore) {
+  // Leave volatile accesses to the IR interpreter, which can print them.
+  bool IsVolatile = IsStore ? cast<StoreInst>(I).isVolatile()
+                            : cast<LoadInst>(I).isVolatile();
+  if (IsVolatile)
+    return false;
+  if (!isRegisterType(Ty))
+    return false;
+
+  BytecodeInst Inst(BytecodeInst::Move);
+  if (IsStore) {
+    if (!getRegister(I.getOperand(0), Inst.A) ||
+        !getRegister(I.getOperand(1), Inst.B))
+      return false;
+  } else {
+    Inst.Dst = Registers[&I];
+    if (!getRegister(I.getOperand(0), Inst.A))
+      return false;
+  }
+
+  if (Ty->isFloatTy()) {
+    Inst.Opcode = IsStore ? BytecodeInst::StoreF : BytecodeInst::LoadF;
+  } else if (Ty->isDoubleTy()) {
+    Inst.Opcode = IsStore ? BytecodeInst::StoreD : BytecodeInst::LoadD;
+  } else if (Ty->isPointerTy()) {
+    Inst.Opcode = IsStore ? BytecodeInst::StoreP : BytecodeInst::LoadP;
+  } else {
+    Inst.Imm = getWidthMask(getWidth(Ty));
+    switch (TD.getTypeStoreSize(Ty)) {
+    default:
+      return false;
+    case 1:
+      Inst.Opcode = IsStore ? BytecodeInst::Store8 : BytecodeInst::Load8;
+      break;
+    case 2:
+      Inst.Opcode = IsStore ? BytecodeInst::Store16 : BytecodeInst::Load16;
+      break;
+    case 4:
+      Inst.Opcode = IsStore ? BytecodeInst::Store32 : BytecodeInst::Load32;
+      break;
+    case 8:
+      Inst.Opcode = IsStore ? BytecodeInst::Store64 : BytecodeInst::Load64;
+      break;
+    }
+  }
+  emit(Inst);
+  return true;
+}
+
+bool BytecodeBuilder::emitGEP(GetElementPtrInst &I, unsigned Dst) {
+  BytecodeInst Base(BytecodeInst::GEP, Dst);
+  if (!getRegister(I.getPointerOperand(), Base.A))
+    return false;
+
+  // Fold the constant indices into one offset and scale the others.
+  SmallVector<BytecodeInst, 4> Indices;
+  uint64_t Offset = 0;
+  for (gep_type_iterator GTI = gep_type_begin(I), E = gep_type_end(I);
+       GTI != E; ++GTI) {
+    if (StructType *STy = dyn_cast<StructType>(*GTI)) {
+      unsigned Field = cast<ConstantInt>(GTI.getOperand())->getZExtValue();
+      Offset += TD.getStructLayout(STy)->getElementOffset(Field);
+      continue;
+    }
+    uint64_t Size =
+        TD.getTypeAllocSize(cast<SequentialType>(*GTI)->getElementType());
+    Value *Idx = GTI.getOperand();
+    if (ConstantInt *CI = dyn_cast<ConstantInt>(Idx)) {
+      if (CI->getBitWidth() > 64)
+        return false;
+      Offset += Size * (uint64_t)CI->getSExtValue();
+      continue;
+    }
+    BytecodeInst Index(BytecodeInst::GEPIndex, Dst, 0, 0, 0, Size);
+    if (!getRegister(Idx, Index.B))
+      return false;
+    Index.Width = getWidth(Idx->getType());
+    Indices.push_back(Index);
+  }
+
+  Base.Imm = Offset;
+  emit(Base);
+  for (const BytecodeInst &Index : Indices)
+    emit(Index);
+  return true;
+}
+
+bool BytecodeBuilder::emitCall(CallInst &I) {
+  CallSite CS(&I);
+  // Intrinsics may be lowered to new instructions at run time and inline
+  // assembly cannot be interpreted at all; leave both to the IR interpreter.
+  Function *Callee = CS.getCalledFunction();
+  if (Callee && Callee->isIntrinsic())
+    return false;
+
+  BytecodeCall Call;
+  Call.Site = CS;
+  Call.Callee = Callee;
+  Call.CalleeReg = BytecodeFunction::NoRegister;
+  if (!Callee && !getRegister(CS.getCalledValue(), Call.CalleeReg))
+    return false;
+  for (Value *Arg : CS.args()) {
+    unsigned Reg;
+    if (!getRegister(Arg, Reg))
+      return false;
+    Call.ArgRegs.push_back(Reg);
+    Call.ArgTypes.push_back(Arg->getType());
+  }
+
+  unsigned Dst = I.getType()->isVoidTy() ? BytecodeFunction::NoRegister
+                                         : Registers[&I];
+  emit(BytecodeInst(BytecodeInst::Call, Dst, 0, BF->Calls.size()));
+  BF->Calls.push_back(std::move(Call));
+  return true;
+}
+
+const BytecodeFunction *Interpreter::getBytecode(Function *F) {
+  if (DisableBytecode)
+    return nullptr;
+  auto I = BytecodeCache.find(F);
+  if (I != BytecodeCache.end())
+    return I->second.get();
+
+  std::unique_ptr<BytecodeFunction> BF = BytecodeBuilder(*this, *F).build();
+  if (BF)
+    ++NumBytecodeFunctions;
+  else
+    DEBUG(dbgs() << "Interpreting '" << F->getName() << "' as IR\n");
+  return (BytecodeCache[F] = std::move(BF)).get();
+}
+
+//===----------------------------------------------------------------------===//
+//                        Bytecode Dispatch Loop
+//===----------------------------------------------------------------------===//
+
+void Interpreter::runBytecode(ExecutionContext &SF) {
+  const BytecodeFunction &BF = *SF.Code;
+  const BytecodeInst *Code = BF.Code.data();
+  BytecodeValue *R = SF.Registers.data();
+  unsigned PC = SF.PC;
+
+  for (;;) {
+    const BytecodeInst &I = Code[PC++];
+    ++NumBytecodeInsts;
+
+    switch (I.Opcode) {
+    case BytecodeInst::Move:
+      R[I.Dst] = R[I.A];
+      break;
+
+#define IMPLEMENT_INTEGER_BINOP(OPC, OP)                                       \
+    case BytecodeInst::OPC:                                                    \
+      R[I.Dst].IntVal = (R[I.A].IntVal OP R[I.B].IntVal) & I.Imm;              \
+      break;
+    IMPLEMENT_INTEGER_BINOP(Add, +)
+    IMPLEMENT_INTEGER_BINOP(Sub, -)
+    IMPLEMENT_INTEGER_BINOP(Mul, *)
+    IMPLEMENT_INTEGER_BINOP(And, &)
+    IMPLEMENT_INTEGER_BINOP(Or, |)
+    IMPLEMENT_INTEGER_BINOP(Xor, ^)
+#undef IMPLEMENT_INTEGER_BINOP
+
+    case BytecodeInst::UDiv:
+      assert(R[I.B].IntVal && "Divide by zero?");
+      R[I.Dst].IntVal = R[I.A].IntVal / R[I.B].IntVal;
+      break;
+    case BytecodeInst::URem:
+      assert(R[I.B].IntVal && "Remainder by zero?");
+      R[I.Dst].IntVal = R[I.A].IntVal % R[I.B].IntVal;
+      break;
+    case BytecodeInst::SDiv:
+    case BytecodeInst::SRem: {
+      int64_t LHS = signExtend(R[I.A].IntVal, I.Width);
+      int64_t RHS = signExtend(R[I.B].IntVal, I.Width);
+      assert(RHS && "Divide by zero?");
+      // Dividing the minimum value by -1 overflows natively; like APInt,
+      // wrap instead.
+      uint64_t Result;
+      if (RHS == -1)
+        Result = I.Opcode == BytecodeInst::SDiv ? 0 - (uint64_t)LHS : 0;
+      else
+        Result = I.Opcode == BytecodeInst::SDiv ? LHS / RHS : LHS % RHS;
+      R[I.Dst].IntVal = Result & I.Imm;
+      break;
+    }
+
+    case BytecodeInst::Shl:
+      R[I.Dst].IntVal =
+          (R[I.A].IntVal << getShiftAmount(R[I.B].IntVal, I.Width)) & I.Imm;
+      break;
+    case BytecodeInst::LShr:
+      R[I.Dst].IntVal =
+          R[I.A].IntVal >> getShiftAmount(R[I.B].IntVal, I.Width);
+      break;
+    case BytecodeInst::AShr:
+      R[I.Dst].IntVal = (signExtend(R[I.A].IntVal, I.Width) >>
+                         getShiftAmount(R[I.B].IntVal, I.Width)) & I.Imm;
+      break;
+
+#define IMPLEMENT_FP_BINOP(OPC, TY, OP)                                        \
+    case BytecodeInst::OPC:                                                    \
+      R[I.Dst].TY = R[I.A].TY OP R[I.B].TY;                                    \
+      break;
+    IMPLEMENT_FP_BINOP(FAddF, FloatVal, +)
+    IMPLEMENT_FP_BINOP(FSubF, FloatVal, -)
+    IMPLEMENT_FP_BINOP(FMulF, FloatVal, *)
+    IMPLEMENT_FP_BINOP(FDivF, FloatVal, /)
+    IMPLEMENT_FP_BINOP(FAddD, DoubleVal, +)
+    IMPLEMENT_FP_BINOP(FSubD, DoubleVal, -)
+    IMPLEMENT_FP_BINOP(FMulD, DoubleVal, *)
+    IMPLEMENT_FP_BINOP(FDivD, DoubleVal, /)
+#undef IMPLEMENT_FP_BINOP
+    case BytecodeInst::FRemF:
+      R[I.Dst].FloatVal = fmod(R[I.A].FloatVal, R[I.B].FloatVal);
+      break;
+    case BytecodeInst::FRemD:
+      R[I.Dst].DoubleVal = fmod(R[I.A].DoubleVal, R[I.B].DoubleVal);
+      break;
+
+#define IMPLEMENT_ICMP(OPC, OP, EXT)                                           \
+    case BytecodeInst::OPC:                                                    \
+      R[I.Dst].IntVal = EXT(R[I.A].IntVal, I.Width) OP                         \
+                        EXT(R[I.B].IntVal, I.Width);                           \
+      break;
+#define ZEXT(V, W) (V)
+    IMPLEMENT_ICMP(ICmpEQ, ==, ZEXT)
+    IMPLEMENT_ICMP(ICmpNE, !=, ZEXT)
+    IMPLEMENT_ICMP(ICmpUGT, >, ZEXT)
+    IMPLEMENT_ICMP(ICmpUGE, >=, ZEXT)
+    IMPLEMENT_ICMP(ICmpULT, <, ZEXT)
+    IMPLEMENT_ICMP(ICmpULE, <=, ZEXT)
+    IMPLEMENT_ICMP(ICmpSGT, >, signExtend)
+    IMPLEMENT_ICMP(ICmpSGE, >=, signExtend)
+    IMPLEMENT_ICMP(ICmpSLT, <, signExtend)
+    IMPLEMENT_ICMP(ICmpSLE, <=, signExtend)
+#undef ZEXT
+#undef IMPLEMENT_ICMP
+
+    case BytecodeInst::FCmpF:
+      R[I.Dst].IntVal = executeFCmp(I.Aux, R[I.A].FloatVal, R[I.B].FloatVal);
+      break;
+    case BytecodeInst::FCmpD:
+      R[I.Dst].IntVal = executeFCmp(I.Aux, R[I.A].DoubleVal, R[I.B].DoubleVal);
+      break;
+
+    case BytecodeInst::Select:
+      R[I.Dst] = R[I.A].IntVal ? R[I.B] : R[I.C];
+      break;
+
+    case BytecodeInst::Trunc:
+      R[I.Dst].IntVal = R[I.A].IntVal & I.Imm;
+      break;
+    case BytecodeInst::SExt:
+      R[I.Dst].IntVal = signExtend(R[I.A].IntVal, I.Width) & I.Imm;
+      break;
+    case BytecodeInst::FPTrunc:
+      R[I.Dst].FloatVal = (float)R[I.A].DoubleVal;
+      break;
+    case BytecodeInst::FPExt:
+      R[I.Dst].DoubleVal = (double)R[I.A].FloatVal;
+      break;
+    // Convert through APInt to round exactly as the IR interpreter does.
+    case BytecodeInst::UIToFP: {
+      APInt Src(I.Width, R[I.A].IntVal);
+      if (I.Aux)
+        R[I.Dst].DoubleVal = APIntOps::RoundAPIntToDouble(Src);
+      else
+        R[I.Dst].FloatVal = APIntOps::RoundAPIntToFloat(Src);
+      break;
+    }
+    case BytecodeInst::SIToFP: {
+      APInt Src(I.Width, R[I.A].IntVal);
+      if (I.Aux)
+        R[I.Dst].DoubleVal = APIntOps::RoundSignedAPIntToDouble(Src);
+      else
+        R[I.Dst].FloatVal = APIntOps::RoundSignedAPIntToFloat(Src);
+      break;
+    }
+    case BytecodeInst::FPToUI:
+    case BytecodeInst::FPToSI:
+      R[I.Dst].IntVal =
+          (I.Aux ? APIntOps::RoundDoubleToAPInt(R[I.A].DoubleVal, I.Width)
+                 : APIntOps::RoundFloatToAPInt(R[I.A].FloatVal, I.Width))
+              .getZExtValue();
+      break;
+    case BytecodeInst::BitCastFToI: {
+      uint32_t Bits;
+      memcpy(&Bits, &R[I.A].FloatVal, sizeof(Bits));
+      R[I.Dst].IntVal = Bits;
+      break;
+    }
+    case BytecodeInst::BitCastIToF: {
+      uint32_t Bits = (uint32_t)R[I.A].IntVal;
+      memcpy(&R[I.Dst].FloatVal, &Bits, sizeof(Bits));
+      break;
+    }
+
+    case BytecodeInst::Alloca: {
+      // Same sizing as visitAllocaInst, never malloc-ing zero bytes.
+      unsigned NumElements = (unsigned)R[I.A].IntVal;
+      unsigned MemToAlloc = std::max(1U, NumElements * (unsigned)I.Imm);
+      void *Memory = malloc(MemToAlloc);
+      assert(Memory && "Null pointer returned by malloc!");
+      SF.Allocas.add(Memory);
+      setPointer(R[I.Dst], Memory);
+      break;
+    }
+
+#define IMPLEMENT_INTEGER_LOAD(OPC, TY)                                        \
+    case BytecodeInst::OPC: {                                                  \
+      TY Val;                                                                  \
+      memcpy(&Val, getPointer(R[I.A]), sizeof(TY));                            \
+      R[I.Dst].IntVal = Val & I.Imm;                                           \
+      break;                                                                   \
+    }
+#define IMPLEMENT_INTEGER_STORE(OPC, TY)                                       \
+    case BytecodeInst::OPC: {                                                  \
+      TY Val = (TY)R[I.A].IntVal;                                              \
+      memcpy(getPointer(R[I.B]), &Val, sizeof(TY));                            \
+      break;                                                                   \
+    }
+    IMPLEMENT_INTEGER_LOAD(Load8, uint8_t)
+    IMPLEMENT_INTEGER_LOAD(Load16, uint16_t)
+    IMPLEMENT_INTEGER_LOAD(Load32, uint32_t)
+    IMPLEMENT_INTEGER_LOAD(Load64, uint64_t)
+    IMPLEMENT_INTEGER_STORE(Store8, uint8_t)
+    IMPLEMENT_INTEGER_STORE(Store16, uint16_t)
+    IMPLEMENT_INTEGER_STORE(Store32, uint32_t)
+    IMPLEMENT_INTEGER_STORE(Store64, uint64_t)
+#undef IMPLEMENT_INTEGER_STORE
+#undef IMPLEMENT_INTEGER_LOAD
+    case BytecodeInst::LoadF:
+      memcpy(&R[I.Dst].FloatVal, getPointer(R[I.A]), sizeof(float));
+      break;
+    case BytecodeInst::LoadD:
+      memcpy(&R[I.Dst].DoubleVal, getPointer(R[I.A]), sizeof(double));
+      break;
+    case BytecodeInst::LoadP: {
+      void *Val;
+      memcpy(&Val, getPointer(R[I.A]), sizeof(void *));
+      setPointer(R[I.Dst], Val);
+      break;
+    }
+    case BytecodeInst::StoreF:
+      memcpy(getPointer(R[I.B]), &R[I.A].FloatVal, sizeof(float));
+      break;
+    case BytecodeInst::StoreD:
+      memcpy(getPointer(R[I.B]), &R[I.A].DoubleVal, sizeof(double));
+      break;
+    case BytecodeInst::StoreP: {
+      void *Val = getPointer(R[I.A]);
+      memcpy(getPointer(R[I.B]), &Val, sizeof(void *));
+      break;
+    }
+
+    case BytecodeInst::GEP:
+      setPointer(R[I.Dst], (char *)getPointer(R[I.A]) + I.Imm);
+      break;
+    case BytecodeInst::GEPIndex:
+      setPointer(R[I.Dst], (char *)getPointer(R[I.Dst]) +
+                               signExtend(R[I.B].IntVal, I.Width) * I.Imm);
+      break;
+
+    case BytecodeInst::Br:
+      PC = I.A;
+      break;
+    case BytecodeInst::CondBr:
+      PC = R[I.A].IntVal ? I.B : I.C;
+      break;
+    case BytecodeInst::Switch: {
+      const BytecodeSwitch &Table = BF.Switches[I.B];
+      uint64_t Cond = R[I.A].IntVal;
+      PC = Table.DefaultDest;
+      for (const auto &Case : Table.Cases)
+        if (Case.first == Cond) {
+          PC = Case.second;
+          break;
+        }
+      break;
+    }
+
+    case BytecodeInst::Call: {
+      const BytecodeCall &Call = BF.Calls[I.B];
+      std::vector<GenericValue> ArgVals;
+      ArgVals.reserve(Call.ArgRegs.size());
+      for (unsigned i = 0, e = Call.ArgRegs.size(); i != e; ++i)
+        ArgVals.push_back(toGenericValue(R[Call.ArgRegs[i]], Call.ArgTypes[i]));
+      Function *Callee = Call.Callee;
+      if (!Callee)
+        Callee = (Function *)getPointer(R[Call.CalleeReg]);
+
+      // The callee's frame goes on ECStack like any other, and the result
+      // comes back through popStackAndReturnValueToCaller.  Pushing it may
+      // move SF, so leave the loop.
+      SF.PC = PC;
+      SF.Caller = Call.Site;
+      callFunction(Callee, ArgVals);
+      return;
+    }
+
+    case BytecodeInst::Ret: {
+      Type *RetTy = BF.F->getReturnType();
+      GenericValue Result;
+      if (I.A != BytecodeFunction::NoRegister)
+        Result = toGenericValue(R[I.A], RetTy);
+      popStackAndReturnValueToCaller(RetTy, Result);
+      return;
+    }
+
+    case BytecodeInst::Unreachable:
+      report_fatal_error("Program executed an 'unreachable' instruction!");
+    }
+  }
+}
+
+void Interpreter::setBytecodeCallResult(ExecutionContext &SF,
+                                        GenericValue Result) {
+  const BytecodeInst &Call = SF.Code->Code[SF.PC - 1];
+  assert(Call.Opcode == BytecodeInst::Call && "Not returning to a call");
+  SF.Registers[Call.Dst] =
+      fromGenericValue(Result, SF.Code->Calls[Call.B].Site.getType());
+}
+
+void Interpreter::enterBytecode(ExecutionContext &SF,
+                                const BytecodeFunction &BF,
+                                ArrayRef<GenericValue> ArgVals) {
+  SF.Code = &BF;
+  SF.PC = 0;
+  SF.Registers = BF.InitialRegisters;
+  unsigned i = 0;
+  for (Argument &A : BF.F->args()) {
+    SF.Registers[i] = fromGenericValue(ArgVals[i], A.getType());
+    ++i;
+  }
+}
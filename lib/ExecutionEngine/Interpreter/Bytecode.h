@@ -0,0 +1,114 @@
+//===-- Bytecode.h - Pre-decoded form of interpreted functions --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This header defines the register-based bytecode the interpreter translates
+// functions into before running them.  Every argument, instruction result and
+// constant of the function is given a slot in a flat register file, so
+// executing an instruction is an array access instead of a lookup in the
+// ExecutionContext's value map, and integers up to 64 bits wide are computed
+// natively instead of through APInt.
+//
+// Only functions whose values are all scalars that fit in a register are
+// translated; everything else is run by the InstVisitor-based interpreter,
+// and the two kinds of stack frame call each other freely.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_BYTECODE_H
+#define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_BYTECODE_H
+
+#include "Interpreter.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CallSite.h"
+#include <vector>
+
+namespace llvm {
+
+class Function;
+class Type;
+
+// BytecodeInst - One instruction of a pre-decoded function.  Dst, A, B and C
+// are register numbers, except for branch targets which are instruction
+// indices and for Switch and Call, whose B indexes the side tables of the
+// BytecodeFunction.  Width is the bit width of the integer operand where it
+// matters, and Imm holds the width mask, a size or an offset.
+//
+struct BytecodeInst {
+  enum OpcodeTy : uint8_t {
+    Move,
+    // Integer arithmetic, Imm is the mask of the result width.
+    Add, Sub, Mul, UDiv, SDiv, URem, SRem, And, Or, Xor, Shl, LShr, AShr,
+    // Floating point arithmetic on float and double.
+    FAddF, FSubF, FMulF, FDivF, FRemF,
+    FAddD, FSubD, FMulD, FDivD, FRemD,
+    // Integer and pointer comparisons.
+    ICmpEQ, ICmpNE, ICmpUGT, ICmpUGE, ICmpULT, ICmpULE,
+    ICmpSGT, ICmpSGE, ICmpSLT, ICmpSLE,
+    // Floating point comparisons, Aux is the FCmpInst predicate.
+    FCmpF, FCmpD,
+    Select,
+    // Casts.  Aux is 1 when the floating point side is a double.
+    Trunc, SExt, FPTrunc, FPExt, UIToFP, SIToFP, FPToUI, FPToSI,
+    BitCastFToI, BitCastIToF,
+    // Memory.  Loads and stores of integers are by store size.
+    Alloca,
+    Load8, Load16, Load32, Load64, LoadF, LoadD, LoadP,
+    Store8, Store16, Store32, Store64, StoreF, StoreD, StoreP,
+    GEP, GEPIndex,
+    // Control flow.
+    Br, CondBr, Switch, Call, Ret, Unreachable
+  };
+
+  OpcodeTy Opcode;
+  uint8_t Width;
+  uint8_t Aux;
+  unsigned Dst, A, B, C;
+  uint64_t Imm;
+
+  BytecodeInst(OpcodeTy Opcode, unsigned Dst = 0, unsigned A = 0,
+               unsigned B = 0, unsigned C = 0, uint64_t Imm = 0)
+      : Opcode(Opcode), Width(0), Aux(0), Dst(Dst), A(A), B(B), C(C),
+        Imm(Imm) {}
+};
+
+// BytecodeCall - The operands of a call, which do not fit in a BytecodeInst.
+// Callee is null for an indirect call through register CalleeReg.
+//
+struct BytecodeCall {
+  CallSite Site;
+  Function *Callee;
+  unsigned CalleeReg;
+  SmallVector<unsigned, 4> ArgRegs;
+  SmallVector<Type *, 4> ArgTypes;
+};
+
+// BytecodeSwitch - The case table of a switch, checked in order.
+//
+struct BytecodeSwitch {
+  SmallVector<std::pair<uint64_t, unsigned>, 8> Cases;
+  unsigned DefaultDest;
+};
+
+// BytecodeFunction - A function translated to bytecode.  Registers
+// 0 .. arg_size()-1 hold the arguments, and InitialRegisters already contains
+// the values of all constants the function uses.
+//
+struct BytecodeFunction {
+  Function *F;
+  std::vector<BytecodeInst> Code;
+  std::vector<BytecodeValue> InitialRegisters;
+  std::vector<BytecodeCall> Calls;
+  std::vector<BytecodeSwitch> Switches;
+
+  static const unsigned NoRegister = ~0U;
+};
+
+} // End llvm namespace
+
+#endif
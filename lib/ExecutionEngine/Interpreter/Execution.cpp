@@ -851,8 +851,12 @@ void Interpreter::popStackAndReturnValueToCaller(Type *RetTy,
     ExecutionContext &CallingSF = ECStack.back();
     if (Instruction *I = CallingSF.Caller.getInstruction()) {
       // Save result...
-      if (!CallingSF.Caller.getType()->isVoidTy())
-        SetValue(I, Result, CallingSF);
+      if (!CallingSF.Caller.getType()->isVoidTy()) {
+        if (CallingSF.Code)
+          setBytecodeCallResult(CallingSF, Result);
+        else
+          SetValue(I, Result, CallingSF);
+      }
       if (InvokeInst *II = dyn_cast<InvokeInst> (I))
         SwitchToNewBasicBlock (II->getNormalDest (), CallingSF);
       CallingSF.Caller = CallSite();          // We returned from the call...
@@ -2090,6 +2094,14 @@ void Interpreter::callFunction(Function *F, ArrayRef<GenericValue> ArgVals) {
     return;
   }
 
+  // Run the function as bytecode if it can be translated.
+  if (const BytecodeFunction *Code = getBytecode(F)) {
+    assert(ArgVals.size() == F->arg_size() &&
+           "Invalid number of values passed to function invocation!");
+    enterBytecode(StackFrame, *Code, ArgVals);
+    return;
+  }
+
   // Get pointers to first LLVM BB & Instruction in function.
   StackFrame.CurBB     = F->begin();
   StackFrame.CurInst   = StackFrame.CurBB->begin();
@@ -2114,6 +2126,11 @@ void Interpreter::run() {
   while (!ECStack.empty()) {
     // Interpret a single instruction & increment the "PC".
     ExecutionContext &SF = ECStack.back();  // Current stack frame
+    if (SF.Code) {
+      runBytecode(SF);
+      continue;
+    }
+
     Instruction &I = *SF.CurInst++;         // Increment before execute
 
     // Track the number of dynamic instructions executed.
@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 #define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/IR/CallSite.h"
@@ -26,6 +27,7 @@
 namespace llvm {
 
 class IntrinsicLowering;
+struct BytecodeFunction;
 struct FunctionInfo;
 template<typename T> class generic_gep_type_iterator;
 class ConstantExpr;
@@ -59,6 +61,15 @@ public:
 
 typedef std::vector<GenericValue> ValuePlaneTy;
 
+// BytecodeValue - One register of a function running as bytecode.  Integers
+// and pointers are held zero-extended in IntVal.
+//
+union BytecodeValue {
+  uint64_t IntVal;
+  float FloatVal;
+  double DoubleVal;
+};
+
 // ExecutionContext struct - This struct represents one stack frame currently
 // executing.
 //
@@ -71,13 +82,19 @@ struct ExecutionContext {
   std::map<Value *, GenericValue> Values; // LLVM values used in this invocation
   std::vector<GenericValue>  VarArgs; // Values passed through an ellipsis
   AllocaHolder Allocas;            // Track memory allocated by alloca
+  const BytecodeFunction *Code;    // Bytecode of CurFunction, if it has any,
+  unsigned PC;                     // the next instruction to execute in it
+  std::vector<BytecodeValue> Registers; // and its register file
 
-  ExecutionContext() : CurFunction(nullptr), CurBB(nullptr), CurInst(nullptr) {}
+  ExecutionContext()
+      : CurFunction(nullptr), CurBB(nullptr), CurInst(nullptr),
+        Code(nullptr), PC(0) {}
 
   ExecutionContext(ExecutionContext &&O)
       : CurFunction(O.CurFunction), CurBB(O.CurBB), CurInst(O.CurInst),
         Caller(O.Caller), Values(std::move(O.Values)),
-        VarArgs(std::move(O.VarArgs)), Allocas(std::move(O.Allocas)) {}
+        VarArgs(std::move(O.VarArgs)), Allocas(std::move(O.Allocas)),
+        Code(O.Code), PC(O.PC), Registers(std::move(O.Registers)) {}
 
   ExecutionContext &operator=(ExecutionContext &&O) {
     CurFunction = O.CurFunction;
@@ -87,6 +104,9 @@ struct ExecutionContext {
     Values = std::move(O.Values);
     VarArgs = std::move(O.VarArgs);
     Allocas = std::move(O.Allocas);
+    Code = O.Code;
+    PC = O.PC;
+    Registers = std::move(O.Registers);
     return *this;
   }
 };
@@ -106,6 +126,12 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // BytecodeCache - The bytecode of every function called so far, or null
+  // for functions that cannot be translated and run as IR instead.
+  DenseMap<Function *, std::unique_ptr<BytecodeFunction>> BytecodeCache;
+
+  friend class BytecodeBuilder;
+
 public:
   explicit Interpreter(std::unique_ptr<Module> M);
   ~Interpreter() override;
@@ -217,6 +243,22 @@ private:  // Helper functions
 
   void *getPointerToFunction(Function *F) override { return (void*)F; }
 
+  // getBytecode - Return the bytecode for F, translating it on first use, or
+  // null if F has to be run by visiting its instructions.
+  const BytecodeFunction *getBytecode(Function *F);
+
+  // runBytecode - Execute the bytecode of the top stack frame until it calls
+  // or returns from a function.
+  void runBytecode(ExecutionContext &SF);
+
+  // enterBytecode - Set up SF to run F's bytecode BF with the given arguments.
+  void enterBytecode(ExecutionContext &SF, const BytecodeFunction &BF,
+                     ArrayRef<GenericValue> ArgVals);
+
+  // setBytecodeCallResult - Store the value returned to the call SF's
+  // bytecode is waiting on.
+  void setBytecodeCallResult(ExecutionContext &SF, GenericValue Result);
+
   void initializeExecutionEngine() { }
   void initializeExternalFunctions();
   GenericValue getConstantExprValue(ConstantExpr *CE, ExecutionContext &SF);
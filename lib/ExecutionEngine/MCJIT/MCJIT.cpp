@@ -8,7 +8,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "MCJIT.h"
+#include "TimedCodeGenPassManager.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
@@ -138,14 +140,16 @@ void MCJIT::setObjectCache(ObjectCache* NewCache) {
   ObjCache = NewCache;
 }
 
-std::unique_ptr<MemoryBuffer> MCJIT::emitObject(Module *M) {
+std::unique_ptr<MemoryBuffer>
+MCJIT::emitObject(Module *M, JITEvent_ModuleCompileStats *Stats) {
   MutexGuard locked(lock);
 
   // This must be a module which has already been added but not loaded to this
   // MCJIT instance, since these conditions are tested by our caller,
   // generateCodeForModule.
 
-  legacy::PassManager PM;
+  std::unique_ptr<legacy::PassManager> PM(
+      Stats ? new TimedCodeGenPassManager(*TM) : new legacy::PassManager());
 
   M->setDataLayout(*TM->getDataLayout());
 
@@ -155,11 +159,14 @@ std::unique_ptr<MemoryBuffer> MCJIT::emitObject(Module *M) {
 
   // Turn the machine code intermediate representation into bytes in memory
   // that may be executed.
-  if (TM->addPassesToEmitMC(PM, Ctx, ObjStream, !getVerifyModules()))
+  if (TM->addPassesToEmitMC(*PM, Ctx, ObjStream, !getVerifyModules()))
     report_fatal_error("Target does not support MC emission!");
 
   // Initialize passes.
-  PM.run(*M);
+  if (Stats)
+    static_cast<TimedCodeGenPassManager &>(*PM).run(*M, *Stats);
+  else
+    PM->run(*M);
   // Flush the output buffer to get the generated code into memory
   ObjStream.flush();
 
@@ -178,6 +185,50 @@ std::unique_ptr<MemoryBuffer> MCJIT::emitObject(Module *M) {
   return CompiledObjBuffer;
 }
 
+// Set the code size of each function in Stats to the distance from its symbol
+// in Obj to the next higher symbol address, or the end, of its section.
+static void computeCodeSizes(const object::ObjectFile &Obj,
+                             JITEvent_ModuleCompileStats &Stats) {
+  struct SymbolStart {
+    object::SectionRef Section;
+    uint64_t Address;
+    StringRef Name;
+  };
+  std::vector<SymbolStart> Starts;
+  for (const object::SymbolRef &Sym : Obj.symbols()) {
+    if (Sym.getFlags() & object::SymbolRef::SF_Undefined)
+      continue;
+    object::section_iterator SI = Obj.section_end();
+    SymbolStart Start;
+    if (Sym.getSection(SI) || SI == Obj.section_end() ||
+        Sym.getAddress(Start.Address) || Sym.getName(Start.Name))
+      continue;
+    Start.Section = *SI;
+    Starts.push_back(Start);
+  }
+  std::sort(Starts.begin(), Starts.end(),
+            [](const SymbolStart &A, const SymbolStart &B) {
+              if (A.Section == B.Section)
+                return A.Address < B.Address;
+              return A.Section < B.Section;
+            });
+
+  StringMap<uint64_t> Sizes;
+  for (unsigned I = 0, E = Starts.size(); I != E; ++I) {
+    const SymbolStart &Start = Starts[I];
+    uint64_t End = Start.Section.getAddress() + Start.Section.getSize();
+    for (unsigned J = I + 1; J != E && Starts[J].Section == Start.Section; ++J)
+      if (Starts[J].Address > Start.Address) {
+        End = Starts[J].Address;
+        break;
+      }
+    Sizes[Start.Name] = End - Start.Address;
+  }
+
+  for (JITEvent_FunctionCompileStats &F : Stats.Functions)
+    F.CodeSize = Sizes.lookup(F.Name);
+}
+
 void MCJIT::generateCodeForModule(Module *M) {
   // Get a thread lock to make sure we aren't trying to load multiple times
   MutexGuard locked(lock);
@@ -190,6 +241,9 @@ void MCJIT::generateCodeForModule(Module *M) {
   if (OwnedModules.hasModuleBeenLoaded(M))
     return;
 
+  bool CollectStats = wantsCompileStats();
+  JITEvent_ModuleCompileStats Stats;
+
   std::unique_ptr<MemoryBuffer> ObjectToLoad;
   // Try to load the pre-compiled object from cache if possible
   if (ObjCache)
@@ -197,20 +251,40 @@ void MCJIT::generateCodeForModule(Module *M) {
 
   // If the cache did not contain a suitable object, compile the object
   if (!ObjectToLoad) {
-    ObjectToLoad = emitObject(M);
+    ObjectToLoad = emitObject(M, CollectStats ? &Stats : nullptr);
     assert(ObjectToLoad && "Compilation did not produce an object.");
-  }
+  } else
+    Stats.FromObjectCache = true;
 
   // Load the object into the dynamic linker.
   // MCJIT now owns the ObjectImage pointer (via its LoadedObjects list).
   ErrorOr<std::unique_ptr<object::ObjectFile>> LoadedObject =
     object::ObjectFile::createObjectFile(ObjectToLoad->getMemBufferRef());
+  double LoadStart = CollectStats ? TimedCodeGenPassManager::getWallTime() : 0;
   std::unique_ptr<RuntimeDyld::LoadedObjectInfo> L =
     Dyld.loadObject(*LoadedObject.get());
 
   if (Dyld.hasError())
     report_fatal_error(Dyld.getErrorString());
 
+  if (CollectStats) {
+    Stats.LoadTime = TimedCodeGenPassManager::getWallTime() - LoadStart;
+    Stats.ModuleName = M->getModuleIdentifier();
+    if (Stats.FromObjectCache) {
+      Mangler Mang(TM->getDataLayout());
+      for (const Function &F : *M) {
+        if (F.isDeclaration())
+          continue;
+        SmallString<128> Name;
+        TM->getNameWithPrefix(Name, &F, Mang);
+        Stats.Functions.push_back(JITEvent_FunctionCompileStats());
+        Stats.Functions.back().Name = Name.str();
+      }
+    }
+    computeCodeSizes(*LoadedObject.get(), Stats);
+    NotifyModuleCompiled(*M, Stats);
+  }
+
   NotifyObjectEmitted(*LoadedObject.get(), *L);
 
   Buffers.push_back(std::move(ObjectToLoad));
@@ -579,6 +653,20 @@ void MCJIT::UnregisterJITEventListener(JITEventListener *L) {
   }
 }
 
+bool MCJIT::wantsCompileStats() const {
+  for (const JITEventListener *L : EventListeners)
+    if (L->wantsCompileStats())
+      return true;
+  return false;
+}
+
+void MCJIT::NotifyModuleCompiled(const Module &M,
+                                 const JITEvent_ModuleCompileStats &Stats) {
+  MutexGuard locked(lock);
+  for (JITEventListener *L : EventListeners)
+    L->NotifyModuleCompiled(M, Stats);
+}
+
 void MCJIT::NotifyObjectEmitted(const object::ObjectFile& Obj,
                                 const RuntimeDyld::LoadedObjectInfo &L) {
   MutexGuard locked(lock);
@@ -22,6 +22,7 @@
 
 namespace llvm {
 class MCJIT;
+struct JITEvent_ModuleCompileStats;
 
 // This is a helper class that the MCJIT execution engine uses for linking
 // functions across modules that it owns.  It aggregates the memory manager
@@ -314,8 +315,18 @@ protected:
   /// this function call is expected to be the contained module.  The module
   /// is passed as a parameter here to prepare for multiple module support in
   /// the future.
-  std::unique_ptr<MemoryBuffer> emitObject(Module *M);
+  ///
+  /// If Stats is non-null, the time spent in each phase of code generation is
+  /// recorded in it.
+  std::unique_ptr<MemoryBuffer>
+  emitObject(Module *M, JITEvent_ModuleCompileStats *Stats = nullptr);
+
+  /// wantsCompileStats - Return true if a registered listener asked for the
+  /// compile statistics of each module.
+  bool wantsCompileStats() const;
 
+  void NotifyModuleCompiled(const Module &M,
+                            const JITEvent_ModuleCompileStats &Stats);
   void NotifyObjectEmitted(const object::ObjectFile& Obj,
                            const RuntimeDyld::LoadedObjectInfo &L);
   void NotifyFreeingObject(const object::ObjectFile& Obj);
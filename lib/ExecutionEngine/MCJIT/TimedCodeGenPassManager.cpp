@@ -0,0 +1,136 @@
+//===-- TimedCodeGenPassManager.cpp - Time each codegen phase -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "TimedCodeGenPassManager.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/CodeGen/MachineFunctionAnalysis.h"
+#include "llvm/CodeGen/Passes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Target/TargetMachine.h"
+
+using namespace llvm;
+
+namespace {
+
+// PhaseMarker - Tells the pass manager that the function it runs on enters a
+// new phase.  It does not touch the function, so the analyses of the passes
+// around it, including the MachineFunction, stay valid.
+class PhaseMarker : public FunctionPass {
+public:
+  static char ID;
+
+  PhaseMarker(TimedCodeGenPassManager &PM,
+              TimedCodeGenPassManager::Phase P)
+      : FunctionPass(ID), PM(PM), P(P) {}
+
+  const char *getPassName() const override {
+    return "Code generation phase marker";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnFunction(Function &F) override {
+    PM.enterPhase(F, P);
+    return false;
+  }
+
+private:
+  TimedCodeGenPassManager &PM;
+  TimedCodeGenPassManager::Phase P;
+};
+
+} // end anonymous namespace
+
+char PhaseMarker::ID = 0;
+
+TimedCodeGenPassManager::TimedCodeGenPassManager(TargetMachine &TM)
+    : TM(TM), Pending(nullptr), Stats(nullptr), CurrentFunction(0),
+      CurrentPhase(Done), LastTime(0) {}
+
+TimedCodeGenPassManager::~TimedCodeGenPassManager() {
+  delete Pending;
+}
+
+void TimedCodeGenPassManager::addMarker(Phase P) {
+  legacy::PassManager::add(new PhaseMarker(*this, P));
+}
+
+void TimedCodeGenPassManager::add(Pass *P) {
+  if (Pending)
+    legacy::PassManager::add(Pending);
+  else
+    addMarker(IRPasses);
+  Pending = P;
+
+  const void *ID = P->getPassID();
+  if (ID == &MachineFunctionAnalysis::ID)
+    addMarker(ISel);
+  else if (ID == &PHIEliminationID)
+    addMarker(RegAlloc);
+  else if (ID == &PrologEpilogCodeInserterID)
+    addMarker(PostRA);
+}
+
+bool TimedCodeGenPassManager::run(Module &M,
+                                  JITEvent_ModuleCompileStats &ModuleStats) {
+  assert(Pending && "No AsmPrinter was added!");
+  addMarker(Emission);
+  legacy::PassManager::add(Pending);
+  Pending = nullptr;
+  addMarker(Done);
+
+  Stats = &ModuleStats;
+  LastTime = getWallTime();
+  bool Changed = legacy::PassManager::run(M);
+  ModuleStats.ObjectWriteTime = getWallTime() - LastTime;
+  Stats = nullptr;
+  FunctionIndices.clear();
+  return Changed;
+}
+
+void TimedCodeGenPassManager::enterPhase(const Function &F, Phase P) {
+  double Now = getWallTime();
+
+  if (CurrentPhase != Done) {
+    JITEvent_FunctionCompileStats &FS = Stats->Functions[CurrentFunction];
+    double Elapsed = Now - LastTime;
+    switch (CurrentPhase) {
+    case IRPasses:  FS.IRTime += Elapsed; break;
+    case ISel:      FS.ISelTime += Elapsed; break;
+    case RegAlloc:  FS.RegAllocTime += Elapsed; break;
+    case PostRA:    FS.PostRATime += Elapsed; break;
+    case Emission:  FS.EmissionTime += Elapsed; break;
+    case Done:      llvm_unreachable("Done is not a timed phase");
+    }
+  }
+
+  auto I = FunctionIndices.insert(
+      std::make_pair(&F, unsigned(Stats->Functions.size())));
+  if (I.second) {
+    SmallString<128> Name;
+    Mangler Mang(TM.getDataLayout());
+    TM.getNameWithPrefix(Name, &F, Mang);
+    Stats->Functions.push_back(JITEvent_FunctionCompileStats());
+    Stats->Functions.back().Name = Name.str();
+  }
+
+  CurrentFunction = I.first->second;
+  CurrentPhase = P;
+  LastTime = Now;
+}
+
+double TimedCodeGenPassManager::getWallTime() {
+  sys::TimeValue Now = sys::TimeValue::now();
+  return Now.seconds() + Now.nanoseconds() / 1000000000.0;
+}
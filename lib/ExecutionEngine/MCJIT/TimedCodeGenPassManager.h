@@ -0,0 +1,77 @@
+//===-- TimedCodeGenPassManager.h - Time each codegen phase -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a pass manager that records how long the code generator
+// spends on each function in each of its phases, for the compile statistics
+// MCJIT hands to JITEventListeners.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LIB_EXECUTIONENGINE_MCJIT_TIMEDCODEGENPASSMANAGER_H
+#define LLVM_LIB_EXECUTIONENGINE_MCJIT_TIMEDCODEGENPASSMANAGER_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/IR/LegacyPassManager.h"
+
+namespace llvm {
+
+class Function;
+class Pass;
+class TargetMachine;
+
+// TimedCodeGenPassManager - A pass manager for the code generation pipeline
+// that inserts marker passes where the pipeline moves from one phase to the
+// next.  The markers run for each function like the passes around them, and
+// the time between two markers is charged to the function and phase of the
+// first one.
+//
+// Phases are recognized by the first pass the target adds for them, so a
+// target that replaces one of those passes has its time charged to the phase
+// before.
+class TimedCodeGenPassManager : public legacy::PassManager {
+public:
+  enum Phase { IRPasses, ISel, RegAlloc, PostRA, Emission, Done };
+
+  explicit TimedCodeGenPassManager(TargetMachine &TM);
+  ~TimedCodeGenPassManager() override;
+
+  void add(Pass *P) override;
+
+  /// run - Run the pipeline on M and fill in the function times and the
+  /// object write time of Stats.  Must be called after the target has added
+  /// its passes, the last of which has to be the AsmPrinter.
+  bool run(Module &M, JITEvent_ModuleCompileStats &Stats);
+
+  /// enterPhase - Called by the marker passes.
+  void enterPhase(const Function &F, Phase P);
+
+  /// getWallTime - The current wall clock time in seconds.
+  static double getWallTime();
+
+private:
+  void addMarker(Phase P);
+
+  TargetMachine &TM;
+
+  /// The pass most recently given to add, which is only handed on to the
+  /// underlying pass manager once the next one arrives.  This keeps the
+  /// AsmPrinter back until run is called.
+  Pass *Pending;
+
+  JITEvent_ModuleCompileStats *Stats;
+  DenseMap<const Function *, unsigned> FunctionIndices;
+  unsigned CurrentFunction;
+  Phase CurrentPhase;
+  double LastTime;
+};
+
+} // End llvm namespace
+
+#endif
@@ -19,6 +19,7 @@
 #include "RuntimeDyldMachO.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/COFF.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MutexGuard.h"
 
@@ -27,6 +28,71 @@ using namespace llvm::object;
 
 #define DEBUG_TYPE "dyld"
 
+static cl::opt<unsigned> ParallelRelocationThreshold(
+    "rtdyld-parallel-relocation-threshold", cl::Hidden, cl::init(256),
+    cl::desc("Minimum number of relocations written into a section for them "
+             "to be applied on a separate thread"));
+
+// Number of lookups answered by scanning a lazy symbol table before it is
+// sorted.
+static const unsigned MaxUnsortedLookups = 16;
+
+void RTDyldLazySymbolTable::add(StringRef Name,
+                                const SymbolTableEntry &Symbol) {
+  assert(!Complete && "Adding a symbol to a complete table");
+  Entry E = { static_cast<uint32_t>(Names.size()),
+              static_cast<uint32_t>(Name.size()), Symbol };
+  Names.insert(Names.end(), Name.begin(), Name.end());
+  Entries.push_back(E);
+}
+
+const RTDyldLazySymbolTable::Entry *
+RTDyldLazySymbolTable::findUnsorted(StringRef Name) const {
+  // Search backwards, so that the last entry with this name wins.
+  for (auto I = Entries.rbegin(), E = Entries.rend(); I != E; ++I)
+    if (I->NameSize == Name.size() && getName(*I) == Name)
+      return &*I;
+  return nullptr;
+}
+
+bool RTDyldLazySymbolTable::find(StringRef Name,
+                                 SymbolTableEntry &Result) const {
+  assert(Complete && "Searching a table that is still being filled");
+  if (!Sorted) {
+    std::lock_guard<std::mutex> Lock(SortMutex);
+    if (!Sorted) {
+      // Sorting costs about as much as log2(size()) scans, which is about
+      // as many lookups as most JIT clients make in an object.
+      if (++UnsortedLookups <= MaxUnsortedLookups) {
+        const Entry *E = findUnsorted(Name);
+        if (!E)
+          return false;
+        Result = E->Symbol;
+        return true;
+      }
+      // The names are laid out in the order the symbols were added, so the
+      // name offsets keep entries with the same name in that order.
+      std::sort(Entries.begin(), Entries.end(),
+                [this](const Entry &LHS, const Entry &RHS) {
+                  int Cmp = getName(LHS).compare(getName(RHS));
+                  return Cmp < 0 ||
+                         (Cmp == 0 && LHS.NameOffset < RHS.NameOffset);
+                });
+      Sorted = true;
+    }
+  }
+  // Take the last of the entries with this name, like a StringMap that each
+  // of them was assigned to in turn would.
+  auto I = std::upper_bound(Entries.begin(), Entries.end(), Name,
+                            [this](StringRef Name, const Entry &E) {
+                              return Name < getName(E);
+                            });
+  if (I == Entries.begin() || getName(*--I) != Name)
+    return false;
+  Result = I->Symbol;
+  return true;
+}
+
 // Empty out-of-line virtual destructor as the key function.
 RuntimeDyldImpl::~RuntimeDyldImpl() {}
 
@@ -85,9 +151,15 @@ void RuntimeDyldImpl::resolveRelocations() {
   // First, resolve relocations associated with external symbols.
   resolveExternalSymbols();
 
+  if (RelocationThreadCount > 1 && canResolveRelocationsInParallel()) {
+    resolveSectionRelocationsInParallel();
+    return;
+  }
+
   // Just iterate over the sections we have and resolve all the relocations
   // in them. Gross overkill, but it gets the job done.
-  for (int i = 0, e = Sections.size(); i != e; ++i) {
+  for (unsigned i = 0, e = std::min(Sections.size(), Relocations.size());
+       i != e; ++i) {
     // The Section here (Sections[i]) refers to the section in which the
     // symbol for the relocation is located.  The SectionID in the relocation
     // entry provides the section to which the relocation will be applied.
@@ -97,10 +169,50 @@ void RuntimeDyldImpl::resolveRelocations() {
     DEBUG(dumpSectionMemory(Sections[i], "before relocations"));
     resolveRelocationList(Relocations[i], Addr);
     DEBUG(dumpSectionMemory(Sections[i], "after relocations"));
-    Relocations.erase(i);
+    Relocations[i].clear();
   }
 }
 
+void RuntimeDyldImpl::resolveSectionRelocationsInParallel() {
+  // Regroup the relocations by the section they write into, keeping the
+  // order in which the serial loop would apply them.  Each group only touches
+  // the memory of its own section, so the groups are independent.
+  typedef std::pair<const RelocationEntry *, uint64_t> PendingRelocation;
+  std::vector<std::vector<PendingRelocation>> ByTarget(Sections.size());
+  for (unsigned i = 0, e = std::min(Sections.size(), Relocations.size());
+       i != e; ++i) {
+    uint64_t Addr = Sections[i].LoadAddress;
+    for (const RelocationEntry &RE : Relocations[i])
+      ByTarget[RE.SectionID].push_back(PendingRelocation(&RE, Addr));
+  }
+
+  for (unsigned i = 0, e = ByTarget.size(); i != e; ++i) {
+    // Ignore relocations for sections that were not loaded
+    if (ByTarget[i].empty() || Sections[i].Address == nullptr)
+      continue;
+    DEBUG(dbgs() << "Resolving " << ByTarget[i].size()
+                 << " relocations into Section #" << i << "\n");
+    const std::vector<PendingRelocation> &Relocs = ByTarget[i];
+    auto ResolveAll = [this, &Relocs]() {
+      for (const PendingRelocation &R : Relocs)
+        resolveRelocation(*R.first, R.second);
+    };
+    // Small sections are not worth the hand-off to another thread.
+    if (Relocs.size() < ParallelRelocationThreshold) {
+      ResolveAll();
+      continue;
+    }
+    if (!RelocationPool)
+      RelocationPool.reset(new ThreadPool(RelocationThreadCount));
+    RelocationPool->async(ResolveAll);
+  }
+  if (RelocationPool)
+    RelocationPool->wait();
+
+  for (RelocationList &Relocs : Relocations)
+    Relocs.clear();
+}
+
 void RuntimeDyldImpl::mapSectionAddress(const void *LocalAddress,
                                         uint64_t TargetAddress) {
   MutexGuard locked(lock);
@@ -165,6 +277,9 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
   // Common symbols requiring allocation, with their sizes and alignments
   CommonSymbolList CommonSymbols;
 
+  if (LazySymbolTables)
+    ObjectSymbolTables.push_back(llvm::make_unique<RTDyldLazySymbolTable>());
+
   // Parse symbols
   DEBUG(dbgs() << "Parse symbols:\n");
   for (symbol_iterator I = Obj.symbol_begin(), E = Obj.symbol_end(); I != E;
@@ -175,38 +290,16 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
     if (IsCommon)
       CommonSymbols.push_back(*I);
     else {
-      object::SymbolRef::Type SymType;
-      Check(I->getType(SymType));
-
-      if (SymType == object::SymbolRef::ST_Function ||
-          SymType == object::SymbolRef::ST_Data ||
-          SymType == object::SymbolRef::ST_Unknown) {
-
-        StringRef Name;
-        uint64_t SectOffset;
-        Check(I->getName(Name));
-        Check(getOffset(*I, SectOffset));
-        section_iterator SI = Obj.section_end();
-        Check(I->getSection(SI));
-        if (SI == Obj.section_end())
-          continue;
-        StringRef SectionData;
-        Check(SI->getContents(SectionData));
-        bool IsCode = SI->isText();
-        unsigned SectionID =
-            findOrEmitSection(Obj, *SI, IsCode, LocalSections);
-        DEBUG(dbgs() << "\tType: " << SymType << " Name: " << Name
-                     << " SID: " << SectionID << " Offset: "
-                     << format("%p", (uintptr_t)SectOffset)
-                     << " flags: " << Flags << "\n");
-        JITSymbolFlags RTDyldSymFlags = JITSymbolFlags::None;
-        if (Flags & SymbolRef::SF_Weak)
-          RTDyldSymFlags |= JITSymbolFlags::Weak;
-        if (Flags & SymbolRef::SF_Exported)
-          RTDyldSymFlags |= JITSymbolFlags::Exported;
-        GlobalSymbolTable[Name] =
-          SymbolTableEntry(SectionID, SectOffset, RTDyldSymFlags);
-      }
+      SymbolTableEntry Entry;
+      if (!getSymbolTableEntry(Obj, *I, LocalSections, Entry))
+        continue;
+      StringRef Name;
+      Check(I->getName(Name));
+      DEBUG(dbgs() << "\tName: " << Name
+                   << " SID: " << Entry.getSectionID() << " Offset: "
+                   << format("%p", (uintptr_t)Entry.getOffset())
+                   << " flags: " << Flags << "\n");
+      addSymbol(Name, Entry);
     }
   }
 
@@ -247,6 +340,9 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
   // Give the subclasses a chance to tie-up any loose ends.
   finalizeLoad(Obj, LocalSections);
 
+  if (LazySymbolTables)
+    ObjectSymbolTables.back()->setComplete();
+
   unsigned SectionsAddedEndIdx = Sections.size();
 
   return std::make_pair(SectionsAddedBeginIdx, SectionsAddedEndIdx);
@@ -486,7 +582,8 @@ void RuntimeDyldImpl::emitCommonSymbols(const ObjectFile &Obj,
     Check(Sym.getName(Name));
 
     // Skip common symbols already elsewhere.
-    if (GlobalSymbolTable.count(Name) ||
+    SymbolTableEntry Existing;
+    if (findSymbolEntry(Name, Existing) ||
         Resolver.findSymbolInLogicalDylib(Name)) {
       DEBUG(dbgs() << "\tSkipping already emitted common symbol '" << Name
                    << "'\n");
@@ -533,8 +630,7 @@ void RuntimeDyldImpl::emitCommonSymbols(const ObjectFile &Obj,
       RTDyldSymFlags |= JITSymbolFlags::Exported;
     DEBUG(dbgs() << "Allocating common symbol " << Name << " address "
                  << format("%p", Addr) << "\n");
-    GlobalSymbolTable[Name] =
-      SymbolTableEntry(SectionID, Offset, RTDyldSymFlags);
+    addSymbol(Name, SymbolTableEntry(SectionID, Offset, RTDyldSymFlags));
     Offset += Size;
     Addr += Size;
   }
@@ -644,8 +740,82 @@ unsigned RuntimeDyldImpl::findOrEmitSection(const ObjectFile &Obj,
   return SectionID;
 }
 
+void RuntimeDyldImpl::addSymbol(StringRef Name,
+                                const SymbolTableEntry &Entry) {
+  if (LazySymbolTables)
+    ObjectSymbolTables.back()->add(Name, Entry);
+  else
+    GlobalSymbolTable[Name] = Entry;
+}
+
+bool RuntimeDyldImpl::findSymbolEntry(StringRef Name,
+                                      SymbolTableEntry &Result) const {
+  if (!LazySymbolTables) {
+    RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
+    if (Loc == GlobalSymbolTable.end())
+      return false;
+    Result = Loc->second;
+    return true;
+  }
+  // Later objects override the definitions of earlier ones.  The object
+  // being loaded is skipped, findRelocationSymbol handles its symbols.
+  for (auto I = ObjectSymbolTables.rbegin(), E = ObjectSymbolTables.rend();
+       I != E; ++I)
+    if ((*I)->isComplete() && (*I)->find(Name, Result))
+      return true;
+  return false;
+}
+
+bool RuntimeDyldImpl::getSymbolTableEntry(const ObjectFile &Obj,
+                                          const SymbolRef &Sym,
+                                          ObjSectionToIDMap &LocalSections,
+                                          SymbolTableEntry &Result) {
+  object::SymbolRef::Type SymType;
+  Check(Sym.getType(SymType));
+  if (SymType != object::SymbolRef::ST_Function &&
+      SymType != object::SymbolRef::ST_Data &&
+      SymType != object::SymbolRef::ST_Unknown)
+    return false;
+
+  uint64_t SectOffset;
+  Check(getOffset(Sym, SectOffset));
+  section_iterator SI = Obj.section_end();
+  Check(Sym.getSection(SI));
+  if (SI == Obj.section_end())
+    return false;
+  bool IsCode = SI->isText();
+  unsigned SectionID = findOrEmitSection(Obj, *SI, IsCode, LocalSections);
+
+  uint32_t Flags = Sym.getFlags();
+  JITSymbolFlags RTDyldSymFlags = JITSymbolFlags::None;
+  if (Flags & SymbolRef::SF_Weak)
+    RTDyldSymFlags |= JITSymbolFlags::Weak;
+  if (Flags & SymbolRef::SF_Exported)
+    RTDyldSymFlags |= JITSymbolFlags::Exported;
+  Result = SymbolTableEntry(SectionID, SectOffset, RTDyldSymFlags);
+  return true;
+}
+
+bool RuntimeDyldImpl::findRelocationSymbol(const ObjectFile &Obj,
+                                           const SymbolRef &Sym,
+                                           StringRef Name,
+                                           ObjSectionToIDMap &LocalSections,
+                                           SymbolTableEntry &Result) {
+  // The symbols of the object being loaded are not searchable by name yet
+  // in the lazy mode, and computing the entry of one is cheaper than sorting
+  // the object's table anyway.
+  uint32_t Flags = Sym.getFlags();
+  if (LazySymbolTables &&
+      !(Flags & (SymbolRef::SF_Undefined | SymbolRef::SF_Common)) &&
+      getSymbolTableEntry(Obj, Sym, LocalSections, Result))
+    return true;
+  return findSymbolEntry(Name, Result);
+}
+
 void RuntimeDyldImpl::addRelocationForSection(const RelocationEntry &RE,
                                               unsigned SectionID) {
+  if (SectionID >= Relocations.size())
+    Relocations.resize(SectionID + 1);
   Relocations[SectionID].push_back(RE);
 }
 
@@ -654,15 +824,20 @@ void RuntimeDyldImpl::addRelocationForSymbol(const RelocationEntry &RE,
   // Relocation by symbol.  If the symbol is found in the global symbol table,
   // create an appropriate section relocation.  Otherwise, add it to
   // ExternalSymbolRelocations.
-  RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(SymbolName);
-  if (Loc == GlobalSymbolTable.end()) {
-    ExternalSymbolRelocations[SymbolName].push_back(RE);
+  SymbolTableEntry SymInfo;
+  if (!findSymbolEntry(SymbolName, SymInfo)) {
+    auto I = ExternalSymbolIndices.insert(
+        std::make_pair(SymbolName, ExternalSymbolRelocations.size()));
+    if (I.second) {
+      ExternalSymbolRelocations.push_back(ExternalSymbolRelocs());
+      ExternalSymbolRelocations.back().Name = SymbolName;
+    }
+    ExternalSymbolRelocations[I.first->second].Relocs.push_back(RE);
   } else {
     // Copy the RE since we want to modify its addend.
     RelocationEntry RECopy = RE;
-    const auto &SymInfo = Loc->second;
     RECopy.Addend += SymInfo.getOffset();
-    Relocations[SymInfo.getSectionID()].push_back(RECopy);
+    addRelocationForSection(RECopy, SymInfo.getSectionID());
   }
 }
 
@@ -776,51 +951,58 @@ void RuntimeDyldImpl::resolveRelocationList(const RelocationList &Relocs,
 
 void RuntimeDyldImpl::resolveExternalSymbols() {
   while (!ExternalSymbolRelocations.empty()) {
-    StringMap<RelocationList>::iterator i = ExternalSymbolRelocations.begin();
-
-    StringRef Name = i->first();
-    if (Name.size() == 0) {
-      // This is an absolute symbol, use an address of zero.
-      DEBUG(dbgs() << "Resolving absolute relocations."
-                   << "\n");
-      RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, 0);
-    } else {
-      uint64_t Addr = 0;
-      RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
-      if (Loc == GlobalSymbolTable.end()) {
-        // This is an external symbol, try to get its address from the symbol
-        // resolver.
-        Addr = Resolver.findSymbol(Name.data()).getAddress();
-        // The call to getSymbolAddress may have caused additional modules to
-        // be loaded, which may have added new entries to the
-        // ExternalSymbolRelocations map.  Consquently, we need to update our
-        // iterator.  This is also why retrieval of the relocation list
-        // associated with this symbol is deferred until below this point.
-        // New entries may have been added to the relocation list.
-        i = ExternalSymbolRelocations.find(Name);
+    // Take the pending relocations out of the table first.  Looking symbols
+    // up may cause additional modules to be loaded, which add new entries
+    // to the table; those are handled by the next iteration.
+    std::vector<ExternalSymbolRelocs> Pending;
+    Pending.swap(ExternalSymbolRelocations);
+    ExternalSymbolIndices.clear();
+
+    std::vector<uint64_t> Addrs(Pending.size(), 0);
+    std::vector<std::string> Queries;
+    std::vector<unsigned> QueryIndices;
+    for (unsigned i = 0, e = Pending.size(); i != e; ++i) {
+      const std::string &Name = Pending[i].Name;
+      // An empty name is an absolute symbol, use an address of zero.
+      if (Name.empty())
+        continue;
+      SymbolTableEntry SymInfo;
+      if (!findSymbolEntry(Name, SymInfo)) {
+        // This is an external symbol, get its address from the symbol
+        // resolver below.
+        Queries.push_back(Name);
+        QueryIndices.push_back(i);
       } else {
         // We found the symbol in our global table.  It was probably in a
         // Module that we loaded previously.
-        const auto &SymInfo = Loc->second;
-        Addr = getSectionLoadAddress(SymInfo.getSectionID()) +
-               SymInfo.getOffset();
+        Addrs[i] = getSectionLoadAddress(SymInfo.getSectionID()) +
+                   SymInfo.getOffset();
       }
+    }
+
+    // Ask the resolver for all the external symbols at once.
+    if (!Queries.empty()) {
+      std::vector<RuntimeDyld::SymbolInfo> Results;
+      Resolver.findSymbols(Queries, Results);
+      assert(Results.size() == Queries.size() &&
+             "Resolver returned the wrong number of results");
+      for (unsigned i = 0, e = QueryIndices.size(); i != e; ++i)
+        Addrs[QueryIndices[i]] = Results[i].getAddress();
+    }
+
+    for (unsigned i = 0, e = Pending.size(); i != e; ++i) {
+      StringRef Name = Pending[i].Name;
+      uint64_t Addr = Addrs[i];
 
       // FIXME: Implement error handling that doesn't kill the host program!
-      if (!Addr)
+      if (!Addr && !Name.empty())
         report_fatal_error("Program used external function '" + Name +
                            "' which could not be resolved!");
 
       DEBUG(dbgs() << "Resolving relocations Name: " << Name << "\t"
                    << format("0x%lx", Addr) << "\n");
-      // This list may have been updated when we called getSymbolAddress, so
-      // don't change this code to get the list earlier.
-      RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, Addr);
+      resolveRelocationList(Pending[i].Relocs, Addr);
     }
-
-    ExternalSymbolRelocations.erase(i);
   }
 }
 
@@ -839,6 +1021,14 @@ uint64_t RuntimeDyld::LoadedObjectInfo::getSectionLoadAddress(
 void RuntimeDyld::MemoryManager::anchor() {}
 void RuntimeDyld::SymbolResolver::anchor() {}
 
+void RuntimeDyld::SymbolResolver::findSymbols(
+    ArrayRef<std::string> Names, std::vector<SymbolInfo> &Results) {
+  Results.clear();
+  Results.reserve(Names.size());
+  for (const std::string &Name : Names)
+    Results.push_back(findSymbol(Name));
+}
+
 RuntimeDyld::RuntimeDyld(RuntimeDyld::MemoryManager &MemMgr,
                          RuntimeDyld::SymbolResolver &Resolver)
     : MemMgr(MemMgr), Resolver(Resolver) {
@@ -850,6 +1040,8 @@ RuntimeDyld::RuntimeDyld(RuntimeDyld::MemoryManager &MemMgr,
   // permissions are applied.
   Dyld = nullptr;
   ProcessAllSections = false;
+  LazySymbolTables = false;
+  RelocationThreadCount = 0;
   Checker = nullptr;
 }
 
@@ -903,6 +1095,8 @@ RuntimeDyld::loadObject(const ObjectFile &Obj) {
                ProcessAllSections, Checker);
     else
       report_fatal_error("Incompatible object format!");
+    Dyld->setLazySymbolTables(LazySymbolTables);
+    Dyld->setRelocationThreadCount(RelocationThreadCount);
   }
 
   if (!Dyld->isCompatibleFile(Obj))
@@ -925,6 +1119,12 @@ RuntimeDyld::SymbolInfo RuntimeDyld::getSymbol(StringRef Name) const {
 
 void RuntimeDyld::resolveRelocations() { Dyld->resolveRelocations(); }
 
+void RuntimeDyld::setRelocationThreadCount(unsigned ThreadCount) {
+  RelocationThreadCount = ThreadCount;
+  if (Dyld)
+    Dyld->setRelocationThreadCount(ThreadCount);
+}
+
 void RuntimeDyld::reassignSectionAddress(unsigned SectionID, uint64_t Addr) {
   Dyld->reassignSectionAddress(SectionID, Addr);
 }
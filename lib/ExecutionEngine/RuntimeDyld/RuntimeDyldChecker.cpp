@@ -846,11 +846,9 @@ std::pair<uint64_t, std::string> RuntimeDyldCheckerImpl::getStubAddrFor(
 
 StringRef
 RuntimeDyldCheckerImpl::getSubsectionStartingAt(StringRef Name) const {
-  RTDyldSymbolTable::const_iterator pos =
-      getRTDyld().GlobalSymbolTable.find(Name);
-  if (pos == getRTDyld().GlobalSymbolTable.end())
+  SymbolTableEntry SymInfo;
+  if (!getRTDyld().findSymbolEntry(Name, SymInfo))
     return StringRef();
-  const auto &SymInfo = pos->second;
   uint8_t *SectionAddr = getRTDyld().getSectionAddress(SymInfo.getSectionID());
   return StringRef(reinterpret_cast<const char *>(SectionAddr) +
                      SymInfo.getOffset(),
@@ -884,15 +882,23 @@ void RuntimeDyldCheckerImpl::registerStubMap(
     else {
       // If this is a (Section, Offset) pair, do a reverse lookup in the
       // global symbol table to find the name.
+      auto Matches = [&](const SymbolTableEntry &SymInfo) {
+        return SymInfo.getSectionID() == StubMapEntry.first.SectionID &&
+               SymInfo.getOffset() ==
+                 static_cast<uint64_t>(StubMapEntry.first.Offset);
+      };
       for (auto &GSTEntry : getRTDyld().GlobalSymbolTable) {
-        const auto &SymInfo = GSTEntry.second;
-        if (SymInfo.getSectionID() == StubMapEntry.first.SectionID &&
-            SymInfo.getOffset() ==
-              static_cast<uint64_t>(StubMapEntry.first.Offset)) {
+        if (Matches(GSTEntry.second)) {
           SymbolName = GSTEntry.first();
           break;
         }
       }
+      for (auto &SymTab : getRTDyld().ObjectSymbolTables) {
+        for (unsigned I = 0, E = SymTab->size(); I != E && SymbolName == "";
+             ++I)
+          if (Matches(SymTab->getEntry(I)))
+            SymbolName = SymTab->getName(I);
+      }
     }
 
     if (SymbolName != "")
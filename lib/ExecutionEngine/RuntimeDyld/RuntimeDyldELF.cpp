@@ -1077,13 +1077,14 @@ relocation_iterator RuntimeDyldELF::processRelocationRef(
   SymbolRef::Type SymType = SymbolRef::ST_Unknown;
 
   // Search for the symbol in the global symbol table
-  RTDyldSymbolTable::const_iterator gsi = GlobalSymbolTable.end();
+  SymbolTableEntry SymInfo;
+  bool IsKnownSymbol = false;
   if (Symbol != Obj.symbol_end()) {
-    gsi = GlobalSymbolTable.find(TargetName.data());
+    IsKnownSymbol = findRelocationSymbol(Obj, *Symbol, TargetName,
+                                         ObjSectionToID, SymInfo);
     Symbol->getType(SymType);
   }
-  if (gsi != GlobalSymbolTable.end()) {
-    const auto &SymInfo = gsi->second;
+  if (IsKnownSymbol) {
     Value.SectionID = SymInfo.getSectionID();
     Value.Offset = SymInfo.getOffset();
     Value.Addend = SymInfo.getOffset() + Addend;
@@ -87,6 +87,12 @@ class RuntimeDyldELF : public RuntimeDyldImpl {
 
   void setMipsABI(const ObjectFile &Obj) override;
 
+  // MIPS relocations fill in the GOT entries they refer to while they are
+  // being applied.
+  bool canResolveRelocationsInParallel() const override {
+    return !IsMipsO32ABI && !IsMipsN64ABI;
+  }
+
   void findPPC64TOCSection(const ObjectFile &Obj,
                            ObjSectionToIDMap &LocalSections,
                            RelocationValueRef &Rel);
@@ -28,9 +28,13 @@
 #include "llvm/Support/Host.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/SwapByteOrder.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <system_error>
+#include <vector>
 
 using namespace llvm;
 using namespace llvm::object;
@@ -184,6 +188,56 @@ private:
 
 typedef StringMap<SymbolTableEntry> RTDyldSymbolTable;
 
+/// @brief The symbols of one object, in the compact form used by the lazy
+/// symbol table mode. The entries live in a single array and the names in a
+/// single buffer, so adding a symbol neither hashes its name nor allocates.
+/// The first few lookups scan the array, and it is only sorted, so that it
+/// can be searched by binary search, when more are made.
+class RTDyldLazySymbolTable {
+public:
+  RTDyldLazySymbolTable()
+      : Complete(false), Sorted(false), UnsortedLookups(0) {}
+
+  void add(StringRef Name, const SymbolTableEntry &Entry);
+
+  /// Mark all the symbols of the object as added. Only complete tables are
+  /// searched.
+  void setComplete() { Complete = true; }
+  bool isComplete() const { return Complete; }
+
+  /// Look a symbol up by name. When a name was added several times, the
+  /// last entry wins. Safe to call from several threads at once.
+  bool find(StringRef Name, SymbolTableEntry &Result) const;
+
+  /// Access the symbols, in an unspecified order.
+  unsigned size() const { return Entries.size(); }
+  StringRef getName(unsigned Idx) const { return getName(Entries[Idx]); }
+  const SymbolTableEntry &getEntry(unsigned Idx) const {
+    return Entries[Idx].Symbol;
+  }
+
+private:
+  struct Entry {
+    uint32_t NameOffset;
+    uint32_t NameSize;
+    SymbolTableEntry Symbol;
+  };
+
+  StringRef getName(const Entry &E) const {
+    return StringRef(Names.data() + E.NameOffset, E.NameSize);
+  }
+
+  const Entry *findUnsorted(StringRef Name) const;
+
+  mutable std::vector<Entry> Entries;
+  std::vector<char> Names;
+  bool Complete;
+  mutable std::atomic<bool> Sorted;
+  // Guards the array and UnsortedLookups until the array is sorted.
+  mutable std::mutex SortMutex;
+  mutable unsigned UnsortedLookups;
+};
+
 class RuntimeDyldImpl {
   friend class RuntimeDyld::LoadedObjectInfo;
   friend class RuntimeDyldCheckerImpl;
@@ -212,6 +266,10 @@ protected:
   // A global symbol table for symbols from all loaded modules.
   RTDyldSymbolTable GlobalSymbolTable;
 
+  // With LazySymbolTables, the symbols of each loaded module, in load order,
+  // are kept here instead of in GlobalSymbolTable.
+  std::vector<std::unique_ptr<RTDyldLazySymbolTable>> ObjectSymbolTables;
+
   // Keep a map of common symbols to their info pairs
   typedef std::vector<SymbolRef> CommonSymbolList;
 
@@ -224,12 +282,19 @@ protected:
   // Relocations to sections already loaded. Indexed by SectionID which is the
   // source of the address. The target where the address will be written is
   // SectionID/Offset in the relocation itself.
-  DenseMap<unsigned, RelocationList> Relocations;
+  std::vector<RelocationList> Relocations;
 
   // Relocations to external symbols that are not yet resolved.  Symbols are
   // external when they aren't found in the global symbol table of all loaded
-  // modules.  This map is indexed by symbol name.
-  StringMap<RelocationList> ExternalSymbolRelocations;
+  // modules.  The relocations are grouped by symbol, in the order the symbols
+  // were first referenced, and ExternalSymbolIndices maps a symbol name to
+  // its group.
+  struct ExternalSymbolRelocs {
+    std::string Name;
+    RelocationList Relocs;
+  };
+  std::vector<ExternalSymbolRelocs> ExternalSymbolRelocations;
+  StringMap<unsigned> ExternalSymbolIndices;
 
 
   typedef std::map<RelocationValueRef, uintptr_t> StubMap;
@@ -243,6 +308,18 @@ protected:
   // sections containing relocations should be. Defaults to 'false'.
   bool ProcessAllSections;
 
+  // True if the symbols of each object should be kept in an array that is
+  // sorted on demand rather than in GlobalSymbolTable. Defaults to 'false'.
+  bool LazySymbolTables;
+
+  // Number of threads to apply section relocations with. Zero or one means
+  // relocations are applied on the calling thread.
+  unsigned RelocationThreadCount;
+
+  // Pool the section relocations are applied on, created by the first
+  // resolveRelocations call that needs it.
+  std::unique_ptr<ThreadPool> RelocationPool;
+
   // This mutex prevents simultaneously loading objects from two different
   // threads.  This keeps us from having to protect individual data structures
   // and guarantees that section allocation requests to the memory manager
@@ -348,9 +425,40 @@ protected:
   /// \return Pointer to the memory area for emitting target address.
   uint8_t *createStubFunction(uint8_t *Addr, unsigned AbiVariant = 0);
 
+  /// \brief Add a symbol of the object being loaded to the symbol table.
+  void addSymbol(StringRef Name, const SymbolTableEntry &Entry);
+
+  /// \brief Look a symbol of the loaded objects up by name.
+  /// \return false if no loaded object defines it.
+  bool findSymbolEntry(StringRef Name, SymbolTableEntry &Result) const;
+
+  /// \brief Compute the symbol table entry of a symbol defined in the object
+  ///        being loaded, emitting its section if needed.
+  /// \return false if the symbol table does not record this kind of symbol.
+  bool getSymbolTableEntry(const ObjectFile &Obj, const SymbolRef &Sym,
+                           ObjSectionToIDMap &LocalSections,
+                           SymbolTableEntry &Result);
+
+  /// \brief Find the symbol a relocation of the object being loaded refers
+  ///        to, by name or, in the lazy symbol table mode, directly from the
+  ///        symbol when the object defines it.
+  /// \return false if the symbol is not defined by any loaded object.
+  bool findRelocationSymbol(const ObjectFile &Obj, const SymbolRef &Sym,
+                            StringRef Name, ObjSectionToIDMap &LocalSections,
+                            SymbolTableEntry &Result);
+
   /// \brief Resolves relocations from Relocs list with address from Value.
   void resolveRelocationList(const RelocationList &Relocs, uint64_t Value);
 
+  /// \brief Apply the relocations of all the loaded sections on
+  ///        RelocationPool, one task per section being written to.
+  void resolveSectionRelocationsInParallel();
+
+  /// \brief Return true if the relocations written into different sections
+  ///        can be applied concurrently. Formats whose relocations also
+  ///        update shared tables (e.g. the MIPS GOT) return false.
+  virtual bool canResolveRelocationsInParallel() const { return true; }
+
   /// \brief A object file specific relocation resolver
   /// \param RE The relocation to be resolved
   /// \param Value Target symbol address to apply the relocation action
@@ -384,7 +492,8 @@ public:
   RuntimeDyldImpl(RuntimeDyld::MemoryManager &MemMgr,
                   RuntimeDyld::SymbolResolver &Resolver)
     : MemMgr(MemMgr), Resolver(Resolver), Checker(nullptr),
-      ProcessAllSections(false), HasError(false) {
+      ProcessAllSections(false), LazySymbolTables(false),
+      RelocationThreadCount(0), HasError(false) {
   }
 
   virtual ~RuntimeDyldImpl();
@@ -393,6 +502,14 @@ public:
     this->ProcessAllSections = ProcessAllSections;
   }
 
+  void setLazySymbolTables(bool LazySymbolTables) {
+    this->LazySymbolTables = LazySymbolTables;
+  }
+
+  void setRelocationThreadCount(unsigned ThreadCount) {
+    RelocationThreadCount = ThreadCount;
+  }
+
   void setRuntimeDyldChecker(RuntimeDyldCheckerImpl *Checker) {
     this->Checker = Checker;
   }
@@ -403,20 +520,18 @@ public:
   uint8_t* getSymbolLocalAddress(StringRef Name) const {
     // FIXME: Just look up as a function for now. Overly simple of course.
     // Work in progress.
-    RTDyldSymbolTable::const_iterator pos = GlobalSymbolTable.find(Name);
-    if (pos == GlobalSymbolTable.end())
+    SymbolTableEntry SymInfo;
+    if (!findSymbolEntry(Name, SymInfo))
       return nullptr;
-    const auto &SymInfo = pos->second;
     return getSectionAddress(SymInfo.getSectionID()) + SymInfo.getOffset();
   }
 
   RuntimeDyld::SymbolInfo getSymbol(StringRef Name) const {
     // FIXME: Just look up as a function for now. Overly simple of course.
     // Work in progress.
-    RTDyldSymbolTable::const_iterator pos = GlobalSymbolTable.find(Name);
-    if (pos == GlobalSymbolTable.end())
+    SymbolTableEntry SymEntry;
+    if (!findSymbolEntry(Name, SymEntry))
       return nullptr;
-    const auto &SymEntry = pos->second;
     uint64_t TargetAddr =
       getSectionLoadAddress(SymEntry.getSectionID()) + SymEntry.getOffset();
     return RuntimeDyld::SymbolInfo(TargetAddr, SymEntry.getFlags());
@@ -65,10 +65,9 @@ RelocationValueRef RuntimeDyldMachO::getRelocationValueRef(
     symbol_iterator Symbol = RI->getSymbol();
     StringRef TargetName;
     Symbol->getName(TargetName);
-    RTDyldSymbolTable::const_iterator SI =
-      GlobalSymbolTable.find(TargetName.data());
-    if (SI != GlobalSymbolTable.end()) {
-      const auto &SymInfo = SI->second;
+    SymbolTableEntry SymInfo;
+    if (findRelocationSymbol(Obj, *Symbol, TargetName, ObjSectionToID,
+                             SymInfo)) {
       Value.SectionID = SymInfo.getSectionID();
       Value.Offset = SymInfo.getOffset() + RE.Addend;
     } else {
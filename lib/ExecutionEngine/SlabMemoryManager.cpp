@@ -0,0 +1,322 @@
+//===- SlabMemoryManager.cpp - Slab-based memory manager for JITs ---------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements JITMemoryArena and SlabMemoryManager.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+// JITMemoryArena
+//===----------------------------------------------------------------------===//
+
+const size_t JITMemoryArena::HugePageSize;
+
+JITMemoryArena::JITMemoryArena(size_t SlabSize, bool UseHugePages)
+    : PageSize(sys::Process::getPageSize()), UseHugePages(UseHugePages),
+      AllocatedSize(0) {
+  this->SlabSize =
+      RoundUpToAlignment(SlabSize, UseHugePages ? HugePageSize : PageSize);
+}
+
+JITMemoryArena::~JITMemoryArena() {
+  for (auto &KV : Slabs)
+    sys::Memory::releaseMappedMemory(KV.second.Mapping);
+}
+
+JITMemoryArena::Slab &JITMemoryArena::getSlab(uintptr_t Addr) {
+  auto I = Slabs.upper_bound(Addr);
+  assert(I != Slabs.begin() && "Address not in any slab");
+  --I;
+  assert(Addr < I->second.End && "Address not in any slab");
+  return I->second;
+}
+
+JITMemoryArena::Slab *JITMemoryArena::mapSlab(size_t Size, bool IsCode) {
+  Size = std::max<size_t>(
+      SlabSize, RoundUpToAlignment(Size, UseHugePages ? HugePageSize : PageSize));
+
+  // Map the slab next to the last one of the same kind, so that the code stays
+  // together. When huge pages are used, map enough to align the slab.
+  const sys::MemoryBlock *Near = nullptr;
+  for (auto I = Slabs.rbegin(), E = Slabs.rend(); I != E; ++I)
+    if (I->second.IsCode == IsCode) {
+      Near = &I->second.Mapping;
+      break;
+    }
+  std::error_code EC;
+  sys::MemoryBlock Mapping = sys::Memory::allocateMappedMemory(
+      Size + (UseHugePages ? HugePageSize : 0), Near,
+      sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
+  if (EC)
+    return nullptr;
+
+  uintptr_t Begin = reinterpret_cast<uintptr_t>(Mapping.base());
+  if (UseHugePages) {
+    Begin = RoundUpToAlignment(Begin, HugePageSize);
+    // This is only a hint: ignore failures.
+    sys::Memory::adviseHugePages(
+        sys::MemoryBlock(reinterpret_cast<void *>(Begin), Size));
+  }
+
+  Slab &S = Slabs[Begin];
+  S.Mapping = Mapping;
+  S.End = Begin + Size;
+  S.IsCode = IsCode;
+  S.FreeRuns[Begin] = Size;
+  return &S;
+}
+
+sys::MemoryBlock JITMemoryArena::allocate(size_t Size, bool IsCode) {
+  if (!Size)
+    return sys::MemoryBlock();
+  Size = RoundUpToAlignment(Size, PageSize);
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  // Take the first run large enough, so that the blocks are packed towards the
+  // start of the slabs.
+  Slab *S = nullptr;
+  std::map<uintptr_t, size_t>::iterator Run;
+  for (auto &KV : Slabs) {
+    if (KV.second.IsCode != IsCode)
+      continue;
+    auto &FreeRuns = KV.second.FreeRuns;
+    Run = std::find_if(FreeRuns.begin(), FreeRuns.end(),
+                       [=](const std::pair<const uintptr_t, size_t> &R) {
+                         return R.second >= Size;
+                       });
+    if (Run != FreeRuns.end()) {
+      S = &KV.second;
+      break;
+    }
+  }
+  if (!S) {
+    S = mapSlab(Size, IsCode);
+    if (!S)
+      return sys::MemoryBlock();
+    Run = S->FreeRuns.begin();
+  }
+
+  uintptr_t Addr = Run->first;
+  size_t Left = Run->second - Size;
+  S->FreeRuns.erase(Run);
+  if (Left)
+    S->FreeRuns[Addr + Size] = Left;
+  AllocatedSize += Size;
+  return sys::MemoryBlock(reinterpret_cast<void *>(Addr), Size);
+}
+
+void JITMemoryArena::release(ArrayRef<sys::MemoryBlock> Blocks) {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  for (const sys::MemoryBlock &B : Blocks) {
+    if (!B.size())
+      continue;
+    uintptr_t Addr = reinterpret_cast<uintptr_t>(B.base());
+    size_t Size = B.size();
+    assert(Addr % PageSize == 0 && Size % PageSize == 0 &&
+           "Released memory must be whole pages");
+    AllocatedSize -= Size;
+
+    // Merge the run with its free neighbours.
+    auto &FreeRuns = getSlab(Addr).FreeRuns;
+    auto Next = FreeRuns.lower_bound(Addr);
+    assert((Next == FreeRuns.end() || Addr + Size <= Next->first) &&
+           "Memory released twice");
+    if (Next != FreeRuns.end() && Addr + Size == Next->first) {
+      Size += Next->second;
+      Next = FreeRuns.erase(Next);
+    }
+    if (Next != FreeRuns.begin()) {
+      auto Prev = std::prev(Next);
+      assert(Prev->first + Prev->second <= Addr && "Memory released twice");
+      if (Prev->first + Prev->second == Addr) {
+        Prev->second += Size;
+        continue;
+      }
+    }
+    FreeRuns[Addr] = Size;
+  }
+}
+
+std::error_code JITMemoryArena::protect(ArrayRef<sys::MemoryBlock> Blocks,
+                                        unsigned Permissions) {
+  // Sort the blocks and merge those that are adjacent in the same slab: on
+  // some systems, a single call cannot span two mappings.
+  typedef std::pair<uintptr_t, uintptr_t> Range;
+  SmallVector<std::pair<Range, uintptr_t>, 8> Ranges;
+  {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    for (const sys::MemoryBlock &B : Blocks) {
+      if (!B.size())
+        continue;
+      uintptr_t Addr = reinterpret_cast<uintptr_t>(B.base());
+      Ranges.push_back(
+          std::make_pair(Range(Addr, Addr + B.size()), getSlab(Addr).End));
+    }
+  }
+  std::sort(Ranges.begin(), Ranges.end());
+
+  std::error_code Result;
+  for (unsigned I = 0, E = Ranges.size(); I != E;) {
+    uintptr_t Begin = Ranges[I].first.first, End = Ranges[I].first.second;
+    uintptr_t SlabEnd = Ranges[I].second;
+    for (++I; I != E && Ranges[I].first.first == End &&
+              Ranges[I].second == SlabEnd;
+         ++I)
+      End = Ranges[I].first.second;
+    std::error_code EC = sys::Memory::protectMappedMemory(
+        sys::MemoryBlock(reinterpret_cast<void *>(Begin), End - Begin),
+        Permissions);
+    if (EC && !Result)
+      Result = EC;
+  }
+  return Result;
+}
+
+unsigned JITMemoryArena::getNumSlabs() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return Slabs.size();
+}
+
+size_t JITMemoryArena::getAllocatedSize() const {
+  std::lock_guard<std::mutex> Lock(Mutex);
+  return AllocatedSize;
+}
+
+//===----------------------------------------------------------------------===//
+// SlabMemoryManager
+//===----------------------------------------------------------------------===//
+
+SlabMemoryManager::SlabMemoryManager(JITMemoryArena &Arena)
+    : Arena(Arena),
+      CodeMem(true, sys::Memory::MF_READ | sys::Memory::MF_EXEC),
+      RODataMem(false, sys::Memory::MF_READ), RWDataMem(false, 0) {}
+
+SlabMemoryManager::~SlabMemoryManager() {
+  // Make the finalized blocks read-write again, with as few calls as possible.
+  SmallVector<sys::MemoryBlock, 8> Protected;
+  for (MemoryGroup *MemGroup : {&CodeMem, &RODataMem})
+    Protected.append(MemGroup->Blocks.begin(),
+                     MemGroup->Blocks.begin() + MemGroup->NumFinalized);
+  Arena.protect(Protected, sys::Memory::MF_READ | sys::Memory::MF_WRITE);
+
+  for (MemoryGroup *MemGroup : {&CodeMem, &RODataMem, &RWDataMem})
+    Arena.release(MemGroup->Blocks);
+}
+
+void SlabMemoryManager::trimLastBlock(MemoryGroup &MemGroup) {
+  if (!MemGroup.End)
+    return;
+  sys::MemoryBlock &Last = MemGroup.Blocks.back();
+  uintptr_t Begin = reinterpret_cast<uintptr_t>(Last.base());
+  uintptr_t UsedEnd = RoundUpToAlignment(MemGroup.Next, Arena.getPageSize());
+  if (UsedEnd < MemGroup.End) {
+    Arena.release(sys::MemoryBlock(reinterpret_cast<void *>(UsedEnd),
+                                   MemGroup.End - UsedEnd));
+    if (UsedEnd == Begin)
+      MemGroup.Blocks.pop_back();
+    else
+      Last = sys::MemoryBlock(Last.base(), UsedEnd - Begin);
+  }
+  MemGroup.Next = MemGroup.End = 0;
+}
+
+void SlabMemoryManager::startBlock(MemoryGroup &MemGroup, uintptr_t Size) {
+  trimLastBlock(MemGroup);
+  sys::MemoryBlock B = Arena.allocate(Size, MemGroup.IsCode);
+  if (!B.size())
+    return;
+  MemGroup.Blocks.push_back(B);
+  MemGroup.Next = reinterpret_cast<uintptr_t>(B.base());
+  MemGroup.End = MemGroup.Next + B.size();
+}
+
+void SlabMemoryManager::reserveAllocationSpace(uintptr_t CodeSize,
+                                               uintptr_t DataSizeRO,
+                                               uintptr_t DataSizeRW) {
+  for (auto &Reservation : {std::make_pair(&CodeMem, CodeSize),
+                            std::make_pair(&RODataMem, DataSizeRO),
+                            std::make_pair(&RWDataMem, DataSizeRW)}) {
+    MemoryGroup &MemGroup = *Reservation.first;
+    uintptr_t Size = Reservation.second;
+    if (Size && MemGroup.End - MemGroup.Next < Size)
+      startBlock(MemGroup, Size);
+  }
+}
+
+uint8_t *SlabMemoryManager::allocateSection(MemoryGroup &MemGroup,
+                                            uintptr_t Size,
+                                            unsigned Alignment) {
+  if (!Alignment)
+    Alignment = 16;
+
+  assert(!(Alignment & (Alignment - 1)) && "Alignment must be a power of two.");
+
+  if (MemGroup.End) {
+    uintptr_t Addr = RoundUpToAlignment(MemGroup.Next, Alignment);
+    if (Addr + Size <= MemGroup.End) {
+      MemGroup.Next = Addr + Size;
+      return reinterpret_cast<uint8_t *>(Addr);
+    }
+  }
+
+  // The blocks are page-aligned, so only larger alignments need padding.
+  startBlock(MemGroup, std::max<uintptr_t>(Size, 1) +
+                           (Alignment > Arena.getPageSize() ? Alignment : 0));
+  if (!MemGroup.End)
+    return nullptr;
+  uintptr_t Addr = RoundUpToAlignment(MemGroup.Next, Alignment);
+  MemGroup.Next = Addr + Size;
+  return reinterpret_cast<uint8_t *>(Addr);
+}
+
+uint8_t *SlabMemoryManager::allocateCodeSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName) {
+  return allocateSection(CodeMem, Size, Alignment);
+}
+
+uint8_t *SlabMemoryManager::allocateDataSection(uintptr_t Size,
+                                                unsigned Alignment,
+                                                unsigned SectionID,
+                                                StringRef SectionName,
+                                                bool IsReadOnly) {
+  return allocateSection(IsReadOnly ? RODataMem : RWDataMem, Size, Alignment);
+}
+
+std::error_code SlabMemoryManager::finalizeGroup(MemoryGroup &MemGroup) {
+  // Nothing may be written to the blocks once their permissions are applied:
+  // give back what is left of the last one.
+  trimLastBlock(MemGroup);
+  ArrayRef<sys::MemoryBlock> NewBlocks =
+      makeArrayRef(MemGroup.Blocks).slice(MemGroup.NumFinalized);
+  MemGroup.NumFinalized = MemGroup.Blocks.size();
+  // Making the code executable also invalidates the instruction cache.
+  return Arena.protect(NewBlocks, MemGroup.Permissions);
+}
+
+bool SlabMemoryManager::finalizeMemory(std::string *ErrMsg) {
+  for (MemoryGroup *MemGroup : {&CodeMem, &RODataMem}) {
+    if (std::error_code EC = finalizeGroup(*MemGroup)) {
+      if (ErrMsg)
+        *ErrMsg = EC.message();
+      return true;
+    }
+  }
+  // Read-write data memory already has the correct permissions.
+  return false;
+}
@@ -558,7 +558,8 @@ Constant *ConstantInt::getFalse(Type *Ty) {
 ConstantInt *ConstantInt::get(LLVMContext &Context, const APInt &V) {
   // get an existing value or the insertion position
   LLVMContextImpl *pImpl = Context.pImpl;
-  ConstantInt *&Slot = pImpl->IntConstants[V];
+  std::unique_lock<std::mutex> Lock;
+  ConstantInt *&Slot = pImpl->getUniquingShard(pImpl->IntConstants, V, Lock)[V];
   if (!Slot) {
     // Get the corresponding integer type for the bit width of the value.
     IntegerType *ITy = IntegerType::get(Context, V.getBitWidth());
@@ -698,7 +699,8 @@ Constant *ConstantFP::getZeroValueForNegation(Type *Ty) {
 ConstantFP* ConstantFP::get(LLVMContext &Context, const APFloat& V) {
   LLVMContextImpl* pImpl = Context.pImpl;
 
-  ConstantFP *&Slot = pImpl->FPConstants[V];
+  std::unique_lock<std::mutex> Lock;
+  ConstantFP *&Slot = pImpl->getUniquingShard(pImpl->FPConstants, V, Lock)[V];
 
   if (!Slot) {
     Type *Ty;
@@ -0,0 +1,153 @@
+//===-- FunctionInfo.cpp - Function summary index -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the function summary index used by summary-based LTO.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include <algorithm>
+
+using namespace llvm;
+
+/// Record in \p Refs every global value \p V refers to, looking through
+/// constant expressions and initializers of aggregates.
+static void findRefs(const Value *V, SmallPtrSetImpl<const Value *> &Visited,
+                     SmallPtrSetImpl<const GlobalValue *> &Refs) {
+  if (!Visited.insert(V).second)
+    return;
+  if (auto *GV = dyn_cast<GlobalValue>(V)) {
+    Refs.insert(GV);
+    return;
+  }
+  if (auto *BA = dyn_cast<BlockAddress>(V)) {
+    Refs.insert(BA->getFunction());
+    return;
+  }
+  if (auto *C = dyn_cast<Constant>(V))
+    for (const Use &Op : C->operands())
+      findRefs(Op, Visited, Refs);
+}
+
+std::unique_ptr<FunctionSummary> FunctionSummary::compute(const Function &F) {
+  assert(!F.isDeclaration() && "Cannot summarize a declaration");
+  unsigned InstCount = 0;
+  SmallVector<const Function *, 16> CallOrder;
+  DenseMap<const Function *, unsigned> CallsiteCounts;
+  SmallPtrSet<const Value *, 32> Visited;
+  SmallPtrSet<const GlobalValue *, 16> RefSet;
+  SmallVector<const GlobalValue *, 16> RefOrder;
+
+  auto AddRefs = [&](const Value *V) {
+    if (!isa<Constant>(V))
+      return;
+    SmallPtrSet<const GlobalValue *, 4> Found;
+    findRefs(V, Visited, Found);
+    for (const GlobalValue *GV : Found)
+      if (RefSet.insert(GV).second)
+        RefOrder.push_back(GV);
+  };
+
+  for (const BasicBlock &BB : F)
+    for (const Instruction &I : BB) {
+      ++InstCount;
+      ImmutableCallSite CS(&I);
+      const Function *Callee =
+          CS ? dyn_cast<Function>(CS.getCalledValue()->stripPointerCasts())
+             : nullptr;
+      if (Callee && !Callee->isIntrinsic()) {
+        auto Inserted = CallsiteCounts.insert(std::make_pair(Callee, 0));
+        if (Inserted.second)
+          CallOrder.push_back(Callee);
+        ++Inserted.first->second;
+      }
+      for (const Use &Op : I.operands())
+        if (!Callee || Op.get() != CS.getCalledValue())
+          AddRefs(Op);
+    }
+
+  Optional<uint64_t> EntryCount = F.getEntryCount();
+  std::unique_ptr<FunctionSummary> Summary(new FunctionSummary(
+      F.getLinkage(), InstCount, EntryCount ? *EntryCount : 0));
+  for (const Function *Callee : CallOrder)
+    Summary->Calls.emplace_back(Callee->getName(), Callee->hasLocalLinkage(),
+                                CallsiteCounts[Callee]);
+  for (const GlobalValue *GV : RefOrder) {
+    auto *Fn = dyn_cast<Function>(GV);
+    if (!Fn || !Fn->isIntrinsic())
+      Summary->Refs.emplace_back(GV->getName(), GV->hasLocalLinkage());
+  }
+  return Summary;
+}
+
+bool FunctionSummary::hasLocalRefs() const {
+  auto IsLocal = [](const GlobalValueRef &Ref) { return Ref.IsLocal; };
+  return std::any_of(Calls.begin(), Calls.end(), IsLocal) ||
+         std::any_of(Refs.begin(), Refs.end(), IsLocal);
+}
+
+std::string FunctionInfoIndex::getGlobalIdentifier(StringRef Name,
+                                                   bool IsLocal,
+                                                   StringRef ModulePath) {
+  if (!IsLocal || ModulePath.empty())
+    return Name;
+  return (ModulePath + ":" + Name).str();
+}
+
+std::unique_ptr<FunctionInfoIndex> FunctionInfoIndex::build(const Module &M) {
+  std::unique_ptr<FunctionInfoIndex> Index(new FunctionInfoIndex());
+  for (const Function &F : M)
+    if (!F.isDeclaration() && F.hasName())
+      Index->addFunctionSummary(F.getName(), FunctionSummary::compute(F));
+  return Index;
+}
+
+StringRef FunctionInfoIndex::addModulePath(StringRef Path, uint64_t ModuleId) {
+  return ModulePathMap.insert(std::make_pair(Path, ModuleId)).first->first();
+}
+
+void FunctionInfoIndex::addFunctionSummary(
+    StringRef Identifier, std::unique_ptr<FunctionSummary> Summary) {
+  FunctionMap[Identifier].push_back(std::move(Summary));
+}
+
+const FunctionInfoIndex::FunctionSummaryList *
+FunctionInfoIndex::findFunctionSummaries(StringRef Identifier) const {
+  auto I = FunctionMap.find(Identifier);
+  if (I == FunctionMap.end())
+    return nullptr;
+  return &I->second;
+}
+
+void FunctionInfoIndex::mergeFrom(std::unique_ptr<FunctionInfoIndex> Other,
+                                  StringRef ModulePath, uint64_t ModuleId) {
+  StringRef Path = addModulePath(ModulePath, ModuleId);
+  auto Qualify = [&](std::vector<GlobalValueRef> &Refs) {
+    for (GlobalValueRef &Ref : Refs)
+      if (Ref.IsLocal)
+        Ref.Name = getGlobalIdentifier(Ref.Name, true, Path);
+  };
+  for (auto &Entry : Other->FunctionMap)
+    for (std::unique_ptr<FunctionSummary> &Summary : Entry.second) {
+      Qualify(Summary->calls());
+      Qualify(Summary->refs());
+      std::string Identifier = getGlobalIdentifier(
+          Entry.first(), GlobalValue::isLocalLinkage(Summary->getLinkage()),
+          Path);
+      Summary->setModulePath(Path);
+      addFunctionSummary(Identifier, std::move(Summary));
+    }
+}
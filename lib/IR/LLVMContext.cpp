@@ -166,6 +166,14 @@ void LLVMContext::yield() {
     pImpl->YieldCallback(this, pImpl->YieldOpaqueHandle);
 }
 
+void LLVMContext::setConcurrentUniquing(bool Enable) {
+  pImpl->setConcurrentUniquing(Enable);
+}
+
+bool LLVMContext::hasConcurrentUniquing() const {
+  return pImpl->ConcurrentUniquing;
+}
+
 void LLVMContext::emitError(const Twine &ErrorStr) {
   diagnose(DiagnosticInfoInlineAsm(ErrorStr));
 }
@@ -45,6 +45,7 @@ LLVMContextImpl::LLVMContextImpl(LLVMContext &C)
   YieldCallback = nullptr;
   YieldOpaqueHandle = nullptr;
   NamedStructTypesUniqueID = 0;
+  ConcurrentUniquing = false;
 }
 
 namespace {
@@ -114,8 +115,10 @@ LLVMContextImpl::~LLVMContextImpl() {
   DeleteContainerSeconds(CPNConstants);
   DeleteContainerSeconds(UVConstants);
   InlineAsms.freeConstants();
-  DeleteContainerSeconds(IntConstants);
-  DeleteContainerSeconds(FPConstants);
+  for (auto &Shard : IntConstants.Shards)
+    DeleteContainerSeconds(Shard.Map);
+  for (auto &Shard : FPConstants.Shards)
+    DeleteContainerSeconds(Shard.Map);
   
   for (StringMap<ConstantDataSequential*>::iterator I = CDSConstants.begin(),
        E = CDSConstants.end(); I != E; ++I)
@@ -159,7 +162,57 @@ LLVMContextImpl::~LLVMContextImpl() {
     delete Pair.second;
 
   // Destroy MDStrings.
-  MDStringCache.clear();
+  for (auto &Shard : MDStringCache.Shards)
+    Shard.Map.clear();
+}
+
+template <typename KeyT, typename ValueT>
+static const KeyT &getKey(const std::pair<KeyT, ValueT> &Entry) {
+  return Entry.first;
+}
+template <typename T> static T *const &getKey(T *const &Entry) { return Entry; }
+
+/// Move the entries of the sharded DenseMap or DenseSet \p Map to their
+/// shards.
+template <typename MapTy, typename KeyInfoT>
+static void redistribute(ShardedUniqueMap<MapTy, KeyInfoT> &Map,
+                         bool Concurrent) {
+  SmallVector<typename MapTy::value_type, 64> Entries;
+  for (auto &Shard : Map.Shards) {
+    Entries.append(Shard.Map.begin(), Shard.Map.end());
+    Shard.Map.clear();
+  }
+  for (auto &Entry : Entries)
+    Map.getShard(Concurrent, getKey(Entry)).Map.insert(Entry);
+}
+
+void LLVMContextImpl::setConcurrentUniquing(bool Enable) {
+  if (ConcurrentUniquing == Enable)
+    return;
+  redistribute(IntConstants, Enable);
+  redistribute(FPConstants, Enable);
+  redistribute(IntegerTypes, Enable);
+  redistribute(FunctionTypes, Enable);
+  redistribute(AnonStructTypes, Enable);
+  redistribute(ArrayTypes, Enable);
+  redistribute(VectorTypes, Enable);
+  redistribute(PointerTypes, Enable);
+  redistribute(ASPointerTypes, Enable);
+
+  // The MDStrings point to their map entries: move the entries themselves.
+  typedef StringMapEntry<MDString> MDStringEntryTy;
+  SmallVector<MDStringEntryTy *, 64> Entries;
+  for (auto &Shard : MDStringCache.Shards) {
+    size_t Begin = Entries.size();
+    for (auto &Entry : Shard.Map)
+      Entries.push_back(&Entry);
+    for (size_t I = Begin, E = Entries.size(); I != E; ++I)
+      Shard.Map.remove(Entries[I]);
+  }
+  for (MDStringEntryTy *Entry : Entries)
+    MDStringCache.getShard(Enable, Entry->getKey()).Map.insert(Entry);
+
+  ConcurrentUniquing = Enable;
 }
 
 void LLVMContextImpl::dropTriviallyDeadConstantArrays() {
@@ -25,6 +25,7 @@
 #include "llvm/ADT/FoldingSet.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
@@ -32,6 +33,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/ValueHandle.h"
+#include <mutex>
 #include <vector>
 
 namespace llvm {
@@ -76,6 +78,34 @@ struct DenseMapAPFloatKeyInfo {
   }
 };
 
+/// A uniquing table split into shards by the hash of the keys, which
+/// \p KeyInfoT computes, each with a lock of its own so that threads creating
+/// different values rarely contend. Outside of concurrent uniquing mode, every
+/// key lives in the first shard and no lock is taken, which keeps the
+/// single-threaded cost unchanged.
+template <typename MapTy, typename KeyInfoT> struct ShardedUniqueMap {
+  enum { NumShardsLog2 = 4, NumShards = 1 << NumShardsLog2 };
+
+  struct Shard {
+    std::mutex Lock;
+    MapTy Map;
+  };
+  Shard Shards[NumShards];
+
+  template <typename KeyT> Shard &getShard(bool Concurrent, const KeyT &Key) {
+    if (!Concurrent)
+      return Shards[0];
+    // The maps index their buckets with the low bits of the hash: pick the
+    // shard with the high bits of a scrambled copy.
+    unsigned Hash = KeyInfoT::getHashValue(Key);
+    return Shards[(Hash * 0x9E3779B9U) >> (32 - NumShardsLog2)];
+  }
+};
+
+struct MDStringKeyInfo {
+  static unsigned getHashValue(StringRef Key) { return HashString(Key); }
+};
+
 struct AnonStructTypeKeyInfo {
   struct KeyTy {
     ArrayRef<Type*> ETypes;
@@ -908,17 +938,53 @@ public:
   LLVMContext::YieldCallbackTy YieldCallback;
   void *YieldOpaqueHandle;
 
-  typedef DenseMap<APInt, ConstantInt *, DenseMapAPIntKeyInfo> IntMapTy;
+  /// Whether ConstantInt::get, ConstantFP::get, MDString::get and the type
+  /// factories may be called from several threads at once.
+  bool ConcurrentUniquing;
+
+  /// Allocate a type of \p Size bytes from TypeAllocator.
+  void *allocateType(size_t Size, size_t Alignment) {
+    auto Lock = lockForUniquing(TypeLock);
+    return TypeAllocator.Allocate(Size, Alignment);
+  }
+
+  /// Switch concurrent uniquing on or off, moving the entries of the sharded
+  /// tables to their shards.
+  void setConcurrentUniquing(bool Enable);
+
+  /// Lock \p M for the lifetime of the result, if the context is in
+  /// concurrent uniquing mode.
+  template <typename MutexT>
+  std::unique_lock<MutexT> lockForUniquing(MutexT &M) {
+    if (ConcurrentUniquing)
+      return std::unique_lock<MutexT>(M);
+    return std::unique_lock<MutexT>();
+  }
+
+  /// Return the map of the shard of \p Map that holds \p Key, locked by
+  /// \p Lock if the context is in concurrent uniquing mode.
+  template <typename MapTy, typename KeyInfoT, typename KeyT>
+  MapTy &getUniquingShard(ShardedUniqueMap<MapTy, KeyInfoT> &Map,
+                          const KeyT &Key, std::unique_lock<std::mutex> &Lock) {
+    auto &Shard = Map.getShard(ConcurrentUniquing, Key);
+    Lock = lockForUniquing(Shard.Lock);
+    return Shard.Map;
+  }
+
+  typedef ShardedUniqueMap<DenseMap<APInt, ConstantInt *, DenseMapAPIntKeyInfo>,
+                           DenseMapAPIntKeyInfo> IntMapTy;
   IntMapTy IntConstants;
 
-  typedef DenseMap<APFloat, ConstantFP *, DenseMapAPFloatKeyInfo> FPMapTy;
+  typedef ShardedUniqueMap<DenseMap<APFloat, ConstantFP *,
+                                    DenseMapAPFloatKeyInfo>,
+                           DenseMapAPFloatKeyInfo> FPMapTy;
   FPMapTy FPConstants;
 
   FoldingSet<AttributeImpl> AttrsSet;
   FoldingSet<AttributeSetImpl> AttrsLists;
   FoldingSet<AttributeSetNode> AttrsSetNodes;
 
-  StringMap<MDString> MDStringCache;
+  ShardedUniqueMap<StringMap<MDString>, MDStringKeyInfo> MDStringCache;
   DenseMap<Value *, ValueAsMetadata *> ValuesAsMetadata;
   DenseMap<Metadata *, MetadataAsValue *> MetadataAsValues;
 
@@ -968,20 +1034,33 @@ public:
   /// TypeAllocator - All dynamically allocated types are allocated from this.
   /// They live forever until the context is torn down.
   BumpPtrAllocator TypeAllocator;
-  
-  DenseMap<unsigned, IntegerType*> IntegerTypes;
+
+  /// TypeLock - Guards TypeAllocator and the named struct types in concurrent
+  /// uniquing mode.
+  std::mutex TypeLock;
+
+  ShardedUniqueMap<DenseMap<unsigned, IntegerType *>, DenseMapInfo<unsigned>>
+      IntegerTypes;
 
   typedef DenseSet<FunctionType *, FunctionTypeKeyInfo> FunctionTypeSet;
-  FunctionTypeSet FunctionTypes;
+  ShardedUniqueMap<FunctionTypeSet, FunctionTypeKeyInfo> FunctionTypes;
   typedef DenseSet<StructType *, AnonStructTypeKeyInfo> StructTypeSet;
-  StructTypeSet AnonStructTypes;
+  ShardedUniqueMap<StructTypeSet, AnonStructTypeKeyInfo> AnonStructTypes;
   StringMap<StructType*> NamedStructTypes;
   unsigned NamedStructTypesUniqueID;
-    
-  DenseMap<std::pair<Type *, uint64_t>, ArrayType*> ArrayTypes;
-  DenseMap<std::pair<Type *, unsigned>, VectorType*> VectorTypes;
-  DenseMap<Type*, PointerType*> PointerTypes;  // Pointers in AddrSpace = 0
-  DenseMap<std::pair<Type*, unsigned>, PointerType*> ASPointerTypes;
+
+  typedef std::pair<Type *, uint64_t> ArrayKeyTy;
+  ShardedUniqueMap<DenseMap<ArrayKeyTy, ArrayType *>, DenseMapInfo<ArrayKeyTy>>
+      ArrayTypes;
+  typedef std::pair<Type *, unsigned> VectorKeyTy;
+  ShardedUniqueMap<DenseMap<VectorKeyTy, VectorType *>,
+                   DenseMapInfo<VectorKeyTy>> VectorTypes;
+  // Pointers in AddrSpace = 0
+  ShardedUniqueMap<DenseMap<Type *, PointerType *>, DenseMapInfo<Type *>>
+      PointerTypes;
+  typedef std::pair<Type *, unsigned> ASPointerKeyTy;
+  ShardedUniqueMap<DenseMap<ASPointerKeyTy, PointerType *>,
+                   DenseMapInfo<ASPointerKeyTy>> ASPointerTypes;
 
 
   /// ValueHandles - This map keeps track of all of the value handles that are
@@ -358,7 +358,9 @@ void ValueAsMetadata::handleRAUW(Value *From, Value *To) {
 //
 
 MDString *MDString::get(LLVMContext &Context, StringRef Str) {
-  auto &Store = Context.pImpl->MDStringCache;
+  LLVMContextImpl *pImpl = Context.pImpl;
+  std::unique_lock<std::mutex> Lock;
+  auto &Store = pImpl->getUniquingShard(pImpl->MDStringCache, Str, Lock);
   auto I = Store.find(Str);
   if (I != Store.end())
     return &I->second;
@@ -317,10 +317,15 @@ IntegerType *IntegerType::get(LLVMContext &C, unsigned NumBits) {
     break;
   }
   
-  IntegerType *&Entry = C.pImpl->IntegerTypes[NumBits];
+  LLVMContextImpl *pImpl = C.pImpl;
+  std::unique_lock<std::mutex> Lock;
+  IntegerType *&Entry =
+      pImpl->getUniquingShard(pImpl->IntegerTypes, NumBits, Lock)[NumBits];
 
   if (!Entry)
-    Entry = new (C.pImpl->TypeAllocator) IntegerType(C, NumBits);
+    Entry = new (pImpl->allocateType(sizeof(IntegerType),
+                                     AlignOf<IntegerType>::Alignment))
+        IntegerType(C, NumBits);
   
   return Entry;
 }
@@ -362,15 +367,17 @@ FunctionType *FunctionType::get(Type *ReturnType,
                                 ArrayRef<Type*> Params, bool isVarArg) {
   LLVMContextImpl *pImpl = ReturnType->getContext().pImpl;
   FunctionTypeKeyInfo::KeyTy Key(ReturnType, Params, isVarArg);
-  auto I = pImpl->FunctionTypes.find_as(Key);
+  std::unique_lock<std::mutex> Lock;
+  auto &FunctionTypes = pImpl->getUniquingShard(pImpl->FunctionTypes, Key, Lock);
+  auto I = FunctionTypes.find_as(Key);
   FunctionType *FT;
 
-  if (I == pImpl->FunctionTypes.end()) {
-    FT = (FunctionType*) pImpl->TypeAllocator.
-      Allocate(sizeof(FunctionType) + sizeof(Type*) * (Params.size() + 1),
-               AlignOf<FunctionType>::Alignment);
+  if (I == FunctionTypes.end()) {
+    FT = (FunctionType*) pImpl->
+      allocateType(sizeof(FunctionType) + sizeof(Type*) * (Params.size() + 1),
+                   AlignOf<FunctionType>::Alignment);
     new (FT) FunctionType(ReturnType, Params, isVarArg);
-    pImpl->FunctionTypes.insert(FT);
+    FunctionTypes.insert(FT);
   } else {
     FT = *I;
   }
@@ -405,15 +412,20 @@ StructType *StructType::get(LLVMContext &Context, ArrayRef<Type*> ETypes,
                             bool isPacked) {
   LLVMContextImpl *pImpl = Context.pImpl;
   AnonStructTypeKeyInfo::KeyTy Key(ETypes, isPacked);
-  auto I = pImpl->AnonStructTypes.find_as(Key);
+  std::unique_lock<std::mutex> Lock;
+  auto &AnonStructTypes =
+      pImpl->getUniquingShard(pImpl->AnonStructTypes, Key, Lock);
+  auto I = AnonStructTypes.find_as(Key);
   StructType *ST;
 
-  if (I == pImpl->AnonStructTypes.end()) {
+  if (I == AnonStructTypes.end()) {
     // Value not found.  Create a new type!
-    ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+    ST = new (pImpl->allocateType(sizeof(StructType),
+                                  AlignOf<StructType>::Alignment))
+        StructType(Context);
     ST->setSubclassData(SCDB_IsLiteral);  // Literal struct.
     ST->setBody(ETypes, isPacked);
-    Context.pImpl->AnonStructTypes.insert(ST);
+    AnonStructTypes.insert(ST);
   } else {
     ST = *I;
   }
@@ -429,7 +441,8 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
     setSubclassData(getSubclassData() | SCDB_Packed);
 
   unsigned NumElements = Elements.size();
-  Type **Elts = getContext().pImpl->TypeAllocator.Allocate<Type*>(NumElements);
+  Type **Elts = (Type **)getContext().pImpl->allocateType(
+      sizeof(Type *) * NumElements, AlignOf<Type *>::Alignment);
   memcpy(Elts, Elements.data(), sizeof(Elements[0]) * NumElements);
   
   ContainedTys = Elts;
@@ -439,6 +452,8 @@ void StructType::setBody(ArrayRef<Type*> Elements, bool isPacked) {
 void StructType::setName(StringRef Name) {
   if (Name == getName()) return;
 
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockForUniquing(pImpl->TypeLock);
   StringMap<StructType *> &SymbolTable = getContext().pImpl->NamedStructTypes;
   typedef StringMap<StructType *>::MapEntryTy EntryTy;
 
@@ -488,7 +503,8 @@ void StructType::setName(StringRef Name) {
 // StructType Helper functions.
 
 StructType *StructType::create(LLVMContext &Context, StringRef Name) {
-  StructType *ST = new (Context.pImpl->TypeAllocator) StructType(Context);
+  StructType *ST = new (Context.pImpl->allocateType(
+      sizeof(StructType), AlignOf<StructType>::Alignment)) StructType(Context);
   if (!Name.empty())
     ST->setName(Name);
   return ST;
@@ -620,7 +636,9 @@ bool StructType::isLayoutIdentical(StructType *Other) const {
 /// getTypeByName - Return the type with the specified name, or null if there
 /// is none by that name.
 StructType *Module::getTypeByName(StringRef Name) const {
-  return getContext().pImpl->NamedStructTypes.lookup(Name);
+  LLVMContextImpl *pImpl = getContext().pImpl;
+  auto Lock = pImpl->lockForUniquing(pImpl->TypeLock);
+  return pImpl->NamedStructTypes.lookup(Name);
 }
 
 
@@ -685,11 +703,14 @@ ArrayType *ArrayType::get(Type *elementType, uint64_t NumElements) {
   assert(isValidElementType(ElementType) && "Invalid type for array element!");
     
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
-  ArrayType *&Entry = 
-    pImpl->ArrayTypes[std::make_pair(ElementType, NumElements)];
+  auto Key = std::make_pair(ElementType, NumElements);
+  std::unique_lock<std::mutex> Lock;
+  ArrayType *&Entry = pImpl->getUniquingShard(pImpl->ArrayTypes, Key, Lock)[Key];
 
   if (!Entry)
-    Entry = new (pImpl->TypeAllocator) ArrayType(ElementType, NumElements);
+    Entry = new (pImpl->allocateType(sizeof(ArrayType),
+                                     AlignOf<ArrayType>::Alignment))
+        ArrayType(ElementType, NumElements);
   return Entry;
 }
 
@@ -715,11 +736,15 @@ VectorType *VectorType::get(Type *elementType, unsigned NumElements) {
                                             "pointer type.");
 
   LLVMContextImpl *pImpl = ElementType->getContext().pImpl;
-  VectorType *&Entry = ElementType->getContext().pImpl
-    ->VectorTypes[std::make_pair(ElementType, NumElements)];
+  auto Key = std::make_pair(ElementType, NumElements);
+  std::unique_lock<std::mutex> Lock;
+  VectorType *&Entry =
+      pImpl->getUniquingShard(pImpl->VectorTypes, Key, Lock)[Key];
 
   if (!Entry)
-    Entry = new (pImpl->TypeAllocator) VectorType(ElementType, NumElements);
+    Entry = new (pImpl->allocateType(sizeof(VectorType),
+                                     AlignOf<VectorType>::Alignment))
+        VectorType(ElementType, NumElements);
   return Entry;
 }
 
@@ -739,11 +764,17 @@ PointerType *PointerType::get(Type *EltTy, unsigned AddressSpace) {
   LLVMContextImpl *CImpl = EltTy->getContext().pImpl;
   
   // Since AddressSpace #0 is the common case, we special case it.
-  PointerType *&Entry = AddressSpace == 0 ? CImpl->PointerTypes[EltTy]
-     : CImpl->ASPointerTypes[std::make_pair(EltTy, AddressSpace)];
+  std::unique_lock<std::mutex> Lock;
+  auto ASKey = std::make_pair(EltTy, AddressSpace);
+  PointerType *&Entry =
+      AddressSpace == 0
+          ? CImpl->getUniquingShard(CImpl->PointerTypes, EltTy, Lock)[EltTy]
+          : CImpl->getUniquingShard(CImpl->ASPointerTypes, ASKey, Lock)[ASKey];
 
   if (!Entry)
-    Entry = new (CImpl->TypeAllocator) PointerType(EltTy, AddressSpace);
+    Entry = new (CImpl->allocateType(sizeof(PointerType),
+                                     AlignOf<PointerType>::Alignment))
+        PointerType(EltTy, AddressSpace);
   return Entry;
 }
 
@@ -18,6 +18,7 @@
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/CodeGen/RuntimeLibcalls.h"
 #include "llvm/Config/config.h"
 #include "llvm/IR/Constants.h"
@@ -32,10 +33,12 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/LTOObjectCache.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/CachePruning.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Host.h"
@@ -231,7 +234,7 @@ bool LTOCodeGenerator::compileOptimizedToFile(const char **name,
   // generate object file
   tool_output_file objFile(Filename.c_str(), FD);
 
-  bool genResult = compileOptimized(objFile.os(), errMsg);
+  bool genResult = compileOptimized(&objFile.os(), errMsg);
   objFile.os().close();
   if (objFile.os().has_error()) {
     objFile.os().clear_error();
@@ -250,6 +253,47 @@ bool LTOCodeGenerator::compileOptimizedToFile(const char **name,
   return true;
 }
 
+bool LTOCodeGenerator::compileOptimizedToFiles(std::vector<const char *> &Names,
+                                               std::string &errMsg) {
+  // make one unique temp .o file per partition
+  std::vector<std::unique_ptr<tool_output_file>> ObjFiles;
+  std::vector<raw_pwrite_stream *> Streams;
+  std::vector<std::string> Paths;
+  for (unsigned I = 0, E = std::max(Parallelism, 1u); I != E; ++I) {
+    SmallString<128> Filename;
+    int FD;
+    std::error_code EC =
+        sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+    if (EC) {
+      errMsg = EC.message();
+      return false;
+    }
+    ObjFiles.emplace_back(new tool_output_file(Filename.c_str(), FD));
+    Streams.push_back(&ObjFiles.back()->os());
+    Paths.push_back(Filename.str());
+  }
+
+  // generate the object files; the ones not kept are removed on return
+  bool genResult = compileOptimized(Streams, errMsg);
+  for (auto &ObjFile : ObjFiles) {
+    ObjFile->os().close();
+    if (ObjFile->os().has_error()) {
+      ObjFile->os().clear_error();
+      genResult = false;
+    }
+  }
+  if (!genResult)
+    return false;
+
+  for (auto &ObjFile : ObjFiles)
+    ObjFile->keep();
+  NativeObjectPaths = std::move(Paths);
+  Names.clear();
+  for (const std::string &Path : NativeObjectPaths)
+    Names.push_back(Path.c_str());
+  return true;
+}
+
 std::unique_ptr<MemoryBuffer>
 LTOCodeGenerator::compileOptimized(std::string &errMsg) {
   const char *name;
@@ -277,16 +321,47 @@ bool LTOCodeGenerator::compile_to_file(const char **name,
                                        bool disableGVNLoadPRE,
                                        bool disableVectorization,
                                        std::string &errMsg) {
-  if (!optimize(disableInline, disableGVNLoadPRE,
-                disableVectorization, errMsg))
+  if (CacheDir.empty()) {
+    if (!optimize(disableInline, disableGVNLoadPRE,
+                  disableVectorization, errMsg))
+      return false;
+
+    return compileOptimizedToFile(name, errMsg);
+  }
+
+  // The object may come from the cache: copy it to a temp .o file.
+  std::unique_ptr<MemoryBuffer> Object =
+      compile(disableInline, disableGVNLoadPRE, disableVectorization, errMsg);
+  if (!Object)
+    return false;
+
+  SmallString<128> Filename;
+  int FD;
+  std::error_code EC =
+      sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+  if (EC) {
+    errMsg = EC.message();
+    return false;
+  }
+  tool_output_file objFile(Filename.c_str(), FD);
+  objFile.os() << Object->getBuffer();
+  objFile.os().close();
+  if (objFile.os().has_error()) {
+    objFile.os().clear_error();
+    errMsg = "could not write " + Filename.str().str();
     return false;
+  }
+  objFile.keep();
 
-  return compileOptimizedToFile(name, errMsg);
+  NativeObjectPath = Filename.c_str();
+  *name = NativeObjectPath.c_str();
+  return true;
 }
 
 std::unique_ptr<MemoryBuffer>
-LTOCodeGenerator::compile(bool disableInline, bool disableGVNLoadPRE,
-                          bool disableVectorization, std::string &errMsg) {
+LTOCodeGenerator::compileUncached(bool disableInline, bool disableGVNLoadPRE,
+                                  bool disableVectorization,
+                                  std::string &errMsg) {
   if (!optimize(disableInline, disableGVNLoadPRE,
                 disableVectorization, errMsg))
     return nullptr;
@@ -294,13 +369,68 @@ LTOCodeGenerator::compile(bool disableInline, bool disableGVNLoadPRE,
   return compileOptimized(errMsg);
 }
 
+std::string LTOCodeGenerator::getCacheKey(bool disableInline,
+                                          bool disableGVNLoadPRE,
+                                          bool disableVectorization) {
+  // Everything but the merged module and the TargetOptions that decides what
+  // optimize() and compileOptimized() produce.
+  std::string Config;
+  raw_string_ostream OS(Config);
+  OS << "lto;cpu=" << MCpu << ";attr=" << MAttr << ";pic=" << CodeModel
+     << ";O" << OptLevel << ";internalize=" << ShouldInternalize
+     << ";noinline=" << disableInline << ";nogvnloadpre=" << disableGVNLoadPRE
+     << ";novectorize=" << disableVectorization << ";dwarf="
+     << EmitDwarfDebugInfo << ";uselists=" << ShouldEmbedUselists;
+  for (const char *Option : CodegenOptions)
+    OS << ";opt=" << Option;
+
+  // The symbols to preserve decide what gets internalized.
+  for (const StringSet *Symbols : {&MustPreserveSymbols, &AsmUndefinedRefs}) {
+    std::vector<StringRef> Names;
+    for (const auto &Entry : *Symbols)
+      Names.push_back(Entry.getKey());
+    std::sort(Names.begin(), Names.end());
+    OS << ";symbols=";
+    for (StringRef Name : Names)
+      OS << Name << ',';
+  }
+  OS.flush();
+
+  return LTOObjectCache::computeKey(*IRLinker.getModule(), Options, Config);
+}
+
+std::unique_ptr<MemoryBuffer>
+LTOCodeGenerator::compile(bool disableInline, bool disableGVNLoadPRE,
+                          bool disableVectorization, std::string &errMsg) {
+  if (CacheDir.empty())
+    return compileUncached(disableInline, disableGVNLoadPRE,
+                           disableVectorization, errMsg);
+
+  LTOObjectCache Cache(CacheDir);
+  std::unique_ptr<MemoryBuffer> Object = Cache.getOrCompute(
+      getCacheKey(disableInline, disableGVNLoadPRE, disableVectorization),
+      [&] {
+        return compileUncached(disableInline, disableGVNLoadPRE,
+                               disableVectorization, errMsg);
+      });
+
+  CachePruning(CacheDir)
+      .setPruningInterval(CachePruningInterval)
+      .setEntryExpiration(CacheEntryExpiration)
+      .setMaxSize(MaxCacheSize)
+      .prune();
+  return Object;
+}
+
 bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
   if (TargetMach)
     return true;
 
   std::string TripleStr = IRLinker.getModule()->getTargetTriple();
-  if (TripleStr.empty())
+  if (TripleStr.empty()) {
     TripleStr = sys::getDefaultTargetTriple();
+    IRLinker.getModule()->setTargetTriple(TripleStr);
+  }
   llvm::Triple Triple(TripleStr);
 
   // create target machine from info for merged modules
@@ -310,7 +440,7 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
 
   // The relocation model is actually a static member of TargetMachine and
   // needs to be set before the TargetMachine is instantiated.
-  Reloc::Model RelocModel = Reloc::Default;
+  RelocModel = Reloc::Default;
   switch (CodeModel) {
   case LTO_CODEGEN_PIC_MODEL_STATIC:
     RelocModel = Reloc::Static;
@@ -330,7 +460,7 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
   // the default set of features.
   SubtargetFeatures Features(MAttr);
   Features.getDefaultSubtargetFeatures(Triple);
-  std::string FeatureStr = Features.getString();
+  FeatureStr = Features.getString();
   // Set a default CPU for Darwin triples.
   if (MCpu.empty() && Triple.isOSDarwin()) {
     if (Triple.getArch() == llvm::Triple::x86_64)
@@ -341,7 +471,6 @@ bool LTOCodeGenerator::determineTarget(std::string &errMsg) {
       MCpu = "cyclone";
   }
 
-  CodeGenOpt::Level CGOptLevel;
   switch (OptLevel) {
   case 0:
     CGOptLevel = CodeGenOpt::None;
@@ -546,29 +675,22 @@ bool LTOCodeGenerator::optimize(bool DisableInline,
   return true;
 }
 
-bool LTOCodeGenerator::compileOptimized(raw_pwrite_stream &out,
+bool LTOCodeGenerator::compileOptimized(ArrayRef<raw_pwrite_stream *> Out,
                                         std::string &errMsg) {
   if (!this->determineTarget(errMsg))
     return false;
 
   Module *mergedModule = IRLinker.getModule();
 
-  legacy::PassManager codeGenPasses;
-
   // If the bitcode files contain ARC code and were compiled with optimization,
   // the ObjCARCContractPass must be run, so do it unconditionally here.
-  codeGenPasses.add(createObjCARCContractPass());
-
-  if (TargetMach->addPassesToEmitFile(codeGenPasses, out,
-                                      TargetMachine::CGFT_ObjectFile)) {
-    errMsg = "target file type not supported";
-    return false;
-  }
-
-  // Run the code generator, and write assembly file
-  codeGenPasses.run(*mergedModule);
+  legacy::PassManager preCodeGenPasses;
+  preCodeGenPasses.add(createObjCARCContractPass());
+  preCodeGenPasses.run(*mergedModule);
 
-  return true;
+  return splitCodeGen(*mergedModule, Out, MCpu, FeatureStr, Options,
+                      RelocModel, CodeModel::Default, CGOptLevel,
+                      TargetMachine::CGFT_ObjectFile, errMsg);
 }
 
 /// setCodeGenDebugOptions - Set codegen debugging options to aid in debugging
@@ -0,0 +1,178 @@
+//===-LTOObjectCache.cpp - On-disk cache of LTO native objects ------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the LTOObjectCache class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/LTOObjectCache.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/LockFileManager.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "lto-object-cache"
+
+LTOObjectCache::LTOObjectCache(StringRef CacheDir) : CacheDir(CacheDir) {
+  sys::fs::create_directories(CacheDir);
+}
+
+/// Describe the fields of \p Options that affect code generation.
+static void printTargetOptions(raw_ostream &OS, const TargetOptions &Options) {
+#define PRINT(X) OS << #X "=" << Options.X << ';'
+  PRINT(PrintMachineCode);
+  PRINT(LessPreciseFPMADOption);
+  PRINT(UnsafeFPMath);
+  PRINT(NoInfsFPMath);
+  PRINT(NoNaNsFPMath);
+  PRINT(HonorSignDependentRoundingFPMathOption);
+  PRINT(NoZerosInBSS);
+  PRINT(GuaranteedTailCallOpt);
+  PRINT(StackAlignmentOverride);
+  PRINT(EnableFastISel);
+  PRINT(PositionIndependentExecutable);
+  PRINT(UseInitArray);
+  PRINT(DisableIntegratedAS);
+  PRINT(CompressDebugSections);
+  PRINT(FunctionSections);
+  PRINT(DataSections);
+  PRINT(UniqueSectionNames);
+  PRINT(TrapUnreachable);
+  PRINT(TrapFuncName);
+  PRINT(FloatABIType);
+  PRINT(AllowFPOpFusion);
+  PRINT(JTType);
+  PRINT(ThreadModel);
+  PRINT(MCOptions.SanitizeAddress);
+  PRINT(MCOptions.MCRelaxAll);
+  PRINT(MCOptions.MCNoExecStack);
+  PRINT(MCOptions.MCFatalWarnings);
+  PRINT(MCOptions.MCSaveTempLabels);
+  PRINT(MCOptions.MCUseDwarfDirectory);
+  PRINT(MCOptions.DwarfVersion);
+  PRINT(MCOptions.ABIName);
+#undef PRINT
+}
+
+std::string LTOObjectCache::computeKey(const Module &M,
+                                       const TargetOptions &Options,
+                                       StringRef Config) {
+  // Serializing the module is cheap next to optimizing it, and captures
+  // everything in it, imported functions included.
+  SmallString<0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+
+  std::string Settings;
+  {
+    raw_string_ostream OS(Settings);
+    OS << "LLVM " << LLVM_VERSION_STRING << ';';
+    printTargetOptions(OS, Options);
+    OS << Config;
+  }
+
+  MD5 Hasher;
+  Hasher.update(Settings);
+  Hasher.update(Bitcode);
+  MD5::MD5Result Result;
+  Hasher.final(Result);
+  SmallString<32> Key;
+  MD5::stringifyResult(Result, Key);
+  return Key.str();
+}
+
+SmallString<128> LTOObjectCache::getEntryPath(StringRef Key) const {
+  SmallString<128> EntryPath(CacheDir);
+  sys::path::append(EntryPath, "llvmcache-" + Key);
+  return EntryPath;
+}
+
+std::unique_ptr<MemoryBuffer> LTOObjectCache::lookup(StringRef Key) const {
+  SmallString<128> EntryPath = getEntryPath(Key);
+  int FD;
+  if (sys::fs::openFileForRead(EntryPath, FD))
+    return nullptr;
+
+  // Record the use of the entry: pruning removes the least recently used
+  // entries first.
+  sys::fs::setLastModificationAndAccessTime(FD, sys::TimeValue::now());
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getOpenFile(FD, EntryPath, -1, false);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!BufferOrErr)
+    return nullptr;
+  DEBUG(dbgs() << "Cache hit for " << Key << "\n");
+  return std::move(*BufferOrErr);
+}
+
+void LTOObjectCache::store(StringRef Key, StringRef Object) const {
+  // Write to a temporary file first so that the entry appears atomically.
+  SmallString<128> TempPath(CacheDir);
+  sys::path::append(TempPath, "llvmcache-tmp-%%%%%%%%");
+  int FD;
+  if (sys::fs::createUniqueFile(TempPath, FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Object;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, getEntryPath(Key)))
+    sys::fs::remove(TempPath);
+}
+
+std::unique_ptr<MemoryBuffer> LTOObjectCache::getOrCompute(
+    StringRef Key,
+    std::function<std::unique_ptr<MemoryBuffer>()> Compute) const {
+  while (true) {
+    if (std::unique_ptr<MemoryBuffer> Cached = lookup(Key))
+      return Cached;
+
+    LockFileManager Lock(getEntryPath(Key));
+    switch (Lock) {
+    case LockFileManager::LFS_Error:
+      // The cache cannot be used, e.g. it is read-only: just do the work.
+      return Compute();
+
+    case LockFileManager::LFS_Owned: {
+      // The entry may have been produced while we acquired the lock.
+      if (std::unique_ptr<MemoryBuffer> Cached = lookup(Key))
+        return Cached;
+      DEBUG(dbgs() << "Cache miss for " << Key << "\n");
+      std::unique_ptr<MemoryBuffer> Object = Compute();
+      if (Object)
+        store(Key, Object->getBuffer());
+      return Object;
+    }
+
+    case LockFileManager::LFS_Shared:
+      // Someone else is producing the entry: wait for them and look it up
+      // again. If they failed or gave up, try again to produce it ourselves.
+      if (Lock.waitForUnlock() == LockFileManager::Res_Timeout)
+        Lock.unsafeRemoveLockFile();
+      continue;
+    }
+  }
+}
@@ -0,0 +1,230 @@
+//===-ThinLTOCodeGenerator.cpp - Summary-based LTO driver -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the ThinLTOCodeGenerator class.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/LTO/LTOObjectCache.h"
+#include "llvm/MC/SubtargetFeature.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+using namespace llvm;
+
+ThinLTOCodeGenerator::ThinLTOCodeGenerator()
+    : RelocModel(Reloc::Default), OptLevel(2), Parallelism(0),
+      ImportInstrLimit(100), CachePruningInterval(1200),
+      CacheEntryExpiration(7 * 24 * 3600), MaxCacheSize(0) {}
+
+ThinLTOCodeGenerator::~ThinLTOCodeGenerator() {}
+
+void ThinLTOCodeGenerator::addModule(StringRef Identifier, StringRef Data) {
+  ModuleInput Input;
+  Input.Identifier = Identifier;
+  Input.Data = Data;
+  Modules.push_back(Input);
+}
+
+/// Return a diagnostic handler that records the first error in \p ErrMsg.
+static DiagnosticHandlerFunction getErrorRecorder(std::string &ErrMsg) {
+  return [&ErrMsg](const DiagnosticInfo &DI) {
+    if (DI.getSeverity() != DS_Error || !ErrMsg.empty())
+      return;
+    raw_string_ostream OS(ErrMsg);
+    DiagnosticPrinterRawOStream DP(OS);
+    DI.print(DP);
+  };
+}
+
+std::unique_ptr<FunctionInfoIndex>
+ThinLTOCodeGenerator::linkCombinedIndex(std::string &ErrMsg) {
+  std::unique_ptr<FunctionInfoIndex> CombinedIndex(new FunctionInfoIndex());
+  uint64_t NextModuleId = 0;
+  for (const ModuleInput &Input : Modules) {
+    MemoryBufferRef Buffer(Input.Data, Input.Identifier);
+    std::unique_ptr<FunctionInfoIndex> Index;
+    if (hasFunctionSummary(Buffer)) {
+      ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+          getFunctionInfoIndex(Buffer, getErrorRecorder(ErrMsg));
+      if (!IndexOrErr)
+        return nullptr;
+      Index = std::move(*IndexOrErr);
+    } else {
+      // Older bitcode: compute the summary from the module itself.
+      LLVMContext Context;
+      ErrorOr<std::unique_ptr<Module>> MOrErr =
+          parseBitcodeFile(Buffer, Context, getErrorRecorder(ErrMsg));
+      if (!MOrErr)
+        return nullptr;
+      Index = FunctionInfoIndex::build(**MOrErr);
+    }
+    CombinedIndex->mergeFrom(std::move(Index), Input.Identifier,
+                             NextModuleId++);
+  }
+  return CombinedIndex;
+}
+
+std::unique_ptr<MemoryBuffer>
+ThinLTOCodeGenerator::runBackend(const ModuleInput &Input,
+                                 const FunctionInfoIndex &Index,
+                                 std::string &ErrMsg) const {
+  LLVMContext Context;
+  Context.setDiagnosticHandler(
+      [](const DiagnosticInfo &DI, void *Context) {
+        getErrorRecorder(*static_cast<std::string *>(Context))(DI);
+      },
+      &ErrMsg);
+
+  ErrorOr<std::unique_ptr<Module>> MOrErr =
+      parseBitcodeFile(MemoryBufferRef(Input.Data, Input.Identifier), Context);
+  if (!MOrErr)
+    return nullptr;
+  Module &M = **MOrErr;
+
+  // Import from the other modules, loading each one lazily and only once.
+  StringMap<StringRef> DataByPath;
+  for (const ModuleInput &Other : Modules)
+    DataByPath[Other.Identifier] = Other.Data;
+  auto ModuleLoader = [&](StringRef Identifier)
+      -> ErrorOr<std::unique_ptr<Module>> {
+    return getLazyBitcodeModule(
+        MemoryBuffer::getMemBuffer(DataByPath.lookup(Identifier), Identifier,
+                                   false),
+        Context, nullptr, /*ShouldLazyLoadMetadata=*/true);
+  };
+  FunctionImporter Importer(Index, ModuleLoader, ImportInstrLimit);
+  ErrorOr<unsigned> Imported = Importer.importFunctions(M);
+  if (std::error_code EC = Imported.getError()) {
+    if (ErrMsg.empty())
+      ErrMsg = "error importing functions into '" + Input.Identifier +
+               "': " + EC.message();
+    return nullptr;
+  }
+
+  std::string TripleStr = M.getTargetTriple();
+  if (TripleStr.empty()) {
+    TripleStr = sys::getDefaultTargetTriple();
+    M.setTargetTriple(TripleStr);
+  }
+  Triple TheTriple(TripleStr);
+  const Target *TheTarget = TargetRegistry::lookupTarget(TripleStr, ErrMsg);
+  if (!TheTarget)
+    return nullptr;
+
+  SubtargetFeatures Features(MAttr);
+  Features.getDefaultSubtargetFeatures(TheTriple);
+  CodeGenOpt::Level CGOptLevel = CodeGenOpt::Default;
+  switch (OptLevel) {
+  case 0:
+    CGOptLevel = CodeGenOpt::None;
+    break;
+  case 1:
+    CGOptLevel = CodeGenOpt::Less;
+    break;
+  case 3:
+    CGOptLevel = CodeGenOpt::Aggressive;
+    break;
+  }
+  std::unique_ptr<TargetMachine> TM(TheTarget->createTargetMachine(
+      TripleStr, MCpu, Features.getString(), Options, RelocModel,
+      CodeModel::Default, CGOptLevel));
+  M.setDataLayout(*TM->getDataLayout());
+
+  auto OptimizeAndCodegen = [&]() -> std::unique_ptr<MemoryBuffer> {
+    // Optimize the module together with its imports. The imported
+    // available_externally definitions are dropped by code generation.
+    legacy::PassManager Passes;
+    Passes.add(
+        createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+    PassManagerBuilder PMB;
+    PMB.OptLevel = OptLevel;
+    PMB.Inliner = createFunctionInliningPass(OptLevel, 0);
+    PMB.LibraryInfo = new TargetLibraryInfoImpl(TheTriple);
+    PMB.VerifyInput = true;
+    PMB.VerifyOutput = true;
+    PMB.populateModulePassManager(Passes);
+    Passes.run(M);
+
+    SmallString<0> Object;
+    {
+      raw_svector_ostream OS(Object);
+      legacy::PassManager CodeGenPasses;
+      if (TM->addPassesToEmitFile(CodeGenPasses, OS,
+                                  TargetMachine::CGFT_ObjectFile)) {
+        ErrMsg = "target file type not supported";
+        return nullptr;
+      }
+      CodeGenPasses.run(M);
+    }
+    return MemoryBuffer::getMemBufferCopy(Object, Input.Identifier);
+  };
+  if (CacheDir.empty())
+    return OptimizeAndCodegen();
+
+  // The module now holds everything that was imported into it, so its content
+  // together with the options identifies the object file.
+  std::string Config;
+  raw_string_ostream(Config) << "thinlto;cpu=" << MCpu << ";attr=" << MAttr
+                             << ";reloc=" << RelocModel << ";O" << OptLevel;
+  LTOObjectCache Cache(CacheDir);
+  return Cache.getOrCompute(LTOObjectCache::computeKey(M, Options, Config),
+                            OptimizeAndCodegen);
+}
+
+bool ThinLTOCodeGenerator::run(std::string &ErrMsg) {
+  std::unique_ptr<FunctionInfoIndex> Index = linkCombinedIndex(ErrMsg);
+  if (!Index)
+    return false;
+
+  ProducedBinaries.clear();
+  ProducedBinaries.resize(Modules.size());
+  std::vector<std::string> Errors(Modules.size());
+  {
+    ThreadPool Pool(Parallelism ? Parallelism : getDefaultParallelism());
+    for (unsigned I = 0, E = Modules.size(); I != E; ++I)
+      Pool.async([&, I] {
+        ProducedBinaries[I] = runBackend(Modules[I], *Index, Errors[I]);
+      });
+  }
+
+  if (!CacheDir.empty())
+    CachePruning(CacheDir)
+        .setPruningInterval(CachePruningInterval)
+        .setEntryExpiration(CacheEntryExpiration)
+        .setMaxSize(MaxCacheSize)
+        .prune();
+
+  for (unsigned I = 0, E = Modules.size(); I != E; ++I)
+    if (!ProducedBinaries[I]) {
+      ErrMsg = Errors[I].empty() ? "failed to compile " + Modules[I].Identifier
+                                 : Errors[I];
+      return false;
+    }
+  return true;
+}
@@ -133,7 +133,10 @@ class ELFObjectWriter : public MCObjectWriter {
       return TargetObjectWriter->GetRelocType(Target, Fixup, IsPCRel);
     }
 
-    void align(unsigned Alignment);
+    // The contents of the debug sections that are emitted compressed.
+    std::map<const MCSectionELF *, SmallVector<char, 128>> CompressedSections;
+
+    void writePaddingTo(uint64_t Offset);
 
   public:
     ELFObjectWriter(MCELFObjectTargetWriter *MOTW, raw_pwrite_stream &OS,
@@ -145,6 +148,7 @@ class ELFObjectWriter : public MCObjectWriter {
       Relocations.clear();
       StrTabBuilder.clear();
       SectionTable.clear();
+      CompressedSections.clear();
       MCObjectWriter::reset();
     }
 
@@ -164,7 +168,7 @@ class ELFObjectWriter : public MCObjectWriter {
         support::endian::Writer<support::big>(OS).write(Val);
     }
 
-    void writeHeader(const MCAssembler &Asm);
+    void writeHeader(const MCAssembler &Asm, uint64_t SectionHeaderOffset);
 
     void writeSymbol(SymbolTableWriter &Writer, uint32_t StringIndex,
                      ELFSymbolData &MSD, const MCAsmLayout &Layout);
@@ -191,10 +195,19 @@ class ELFObjectWriter : public MCObjectWriter {
     /// \param Asm - The assembler.
     /// \param SectionIndexMap - Maps a section to its index.
     /// \param RevGroupMap - Maps a signature symbol to the group section.
+    /// \param LocalSymbolData - The local symbols, in symbol table order.
+    /// \param ExternalSymbolData - The other symbols, in symbol table order.
     void computeSymbolTable(MCAssembler &Asm, const MCAsmLayout &Layout,
                             const SectionIndexMapTy &SectionIndexMap,
                             const RevGroupMapTy &RevGroupMap,
-                            SectionOffsetsTy &SectionOffsets);
+                            std::vector<ELFSymbolData> &LocalSymbolData,
+                            std::vector<ELFSymbolData> &ExternalSymbolData);
+
+    /// Write the symbol table computed by computeSymbolTable, followed by the
+    /// .symtab_shndx section if there is one.
+    void writeSymbolTable(MCAssembler &Asm, const MCAsmLayout &Layout,
+                          std::vector<ELFSymbolData> &LocalSymbolData,
+                          std::vector<ELFSymbolData> &ExternalSymbolData);
 
     MCSectionELF *createRelocationSection(MCContext &Ctx,
                                           const MCSectionELF &Sec);
@@ -208,6 +221,11 @@ class ELFObjectWriter : public MCObjectWriter {
                             const SectionIndexMapTy &SectionIndexMap,
                             const SectionOffsetsTy &SectionOffsets);
 
+    /// Compress a debug section if compression is enabled and pays off, and
+    /// return the size of the section in the file.
+    uint64_t compressSectionData(const MCAssembler &Asm, MCSectionELF &Section,
+                                 const MCAsmLayout &Layout);
+
     void writeSectionData(const MCAssembler &Asm, MCSection &Sec,
                           const MCAsmLayout &Layout);
 
@@ -233,9 +251,9 @@ class ELFObjectWriter : public MCObjectWriter {
   };
 }
 
-void ELFObjectWriter::align(unsigned Alignment) {
-  uint64_t Padding = OffsetToAlignment(OS.tell(), Alignment);
-  WriteZeros(Padding);
+void ELFObjectWriter::writePaddingTo(uint64_t Offset) {
+  assert(OS.tell() <= Offset && "Wrote past the start of a section");
+  WriteZeros(Offset - OS.tell());
 }
 
 unsigned ELFObjectWriter::addToSectionTable(const MCSectionELF *Sec) {
@@ -305,7 +323,8 @@ ELFObjectWriter::~ELFObjectWriter()
 {}
 
 // Emit the ELF header.
-void ELFObjectWriter::writeHeader(const MCAssembler &Asm) {
+void ELFObjectWriter::writeHeader(const MCAssembler &Asm,
+                                  uint64_t SectionHeaderOffset) {
   // ELF Header
   // ----------
   //
@@ -335,7 +354,7 @@ void ELFObjectWriter::writeHeader(const MCAssembler &Asm) {
   write32(ELF::EV_CURRENT);         // e_version
   WriteWord(0);                    // e_entry, no entry point in .o file
   WriteWord(0);                    // e_phoff, no program header for .o
-  WriteWord(0);                     // e_shoff = sec hdr table off in bytes
+  WriteWord(SectionHeaderOffset);   // e_shoff = sec hdr table off in bytes
 
   // e_flags = whatever the target wants
   write32(Asm.getELFHeaderEFlags());
@@ -350,7 +369,9 @@ void ELFObjectWriter::writeHeader(const MCAssembler &Asm) {
   write16(is64Bit() ? sizeof(ELF::Elf64_Shdr) : sizeof(ELF::Elf32_Shdr));
 
   // e_shnum     = # of section header ents
-  write16(0);
+  write16(SectionTable.size() + 1 >= ELF::SHN_LORESERVE
+              ? (uint16_t)ELF::SHN_UNDEF
+              : SectionTable.size() + 1);
 
   // e_shstrndx  = Section # of '.shstrtab'
   assert(StringTableIndex < ELF::SHN_LORESERVE);
@@ -754,9 +775,9 @@ bool ELFObjectWriter::isInSymtab(const MCAsmLayout &Layout,
 void ELFObjectWriter::computeSymbolTable(
     MCAssembler &Asm, const MCAsmLayout &Layout,
     const SectionIndexMapTy &SectionIndexMap, const RevGroupMapTy &RevGroupMap,
-    SectionOffsetsTy &SectionOffsets) {
+    std::vector<ELFSymbolData> &LocalSymbolData,
+    std::vector<ELFSymbolData> &ExternalSymbolData) {
   MCContext &Ctx = Asm.getContext();
-  SymbolTableWriter Writer(*this, is64Bit());
 
   // Symbol table
   unsigned EntrySize = is64Bit() ? ELF::SYMENTRY_SIZE64 : ELF::SYMENTRY_SIZE32;
@@ -765,15 +786,6 @@ void ELFObjectWriter::computeSymbolTable(
   SymtabSection->setAlignment(is64Bit() ? 8 : 4);
   SymbolTableIndex = addToSectionTable(SymtabSection);
 
-  align(SymtabSection->getAlignment());
-  uint64_t SecStart = OS.tell();
-
-  // The first entry is the undefined symbol entry.
-  Writer.writeSymbol(0, 0, 0, 0, 0, 0, false);
-
-  std::vector<ELFSymbolData> LocalSymbolData;
-  std::vector<ELFSymbolData> ExternalSymbolData;
-
   // Add the data for the symbols.
   bool HasLargeSectionIndex = false;
   for (const MCSymbol &S : Asm.symbols()) {
@@ -874,11 +886,6 @@ void ELFObjectWriter::computeSymbolTable(
 
   StrTabBuilder.finalize(StringTableBuilder::ELF);
 
-  for (const std::string &Name : FileNames)
-    Writer.writeSymbol(StrTabBuilder.getOffset(Name),
-                       ELF::STT_FILE | ELF::STB_LOCAL, 0, 0, ELF::STV_DEFAULT,
-                       ELF::SHN_ABS, true);
-
   // Symbols are required to be in lexicographic order.
   array_pod_sort(LocalSymbolData.begin(), LocalSymbolData.end());
   array_pod_sort(ExternalSymbolData.begin(), ExternalSymbolData.end());
@@ -887,27 +894,44 @@ void ELFObjectWriter::computeSymbolTable(
   // symbols with non-local bindings.
   unsigned Index = FileNames.size() + 1;
 
+  for (ELFSymbolData &MSD : LocalSymbolData)
+    MSD.Symbol->setIndex(Index++);
+
+  LastLocalSymbolIndex = Index;
+
+  for (ELFSymbolData &MSD : ExternalSymbolData) {
+    MSD.Symbol->setIndex(Index++);
+    assert(MSD.Symbol->getBinding() != ELF::STB_LOCAL);
+  }
+}
+
+void ELFObjectWriter::writeSymbolTable(
+    MCAssembler &Asm, const MCAsmLayout &Layout,
+    std::vector<ELFSymbolData> &LocalSymbolData,
+    std::vector<ELFSymbolData> &ExternalSymbolData) {
+  SymbolTableWriter Writer(*this, is64Bit());
+
+  // The first entry is the undefined symbol entry.
+  Writer.writeSymbol(0, 0, 0, 0, 0, 0, false);
+
+  for (const std::string &Name : Asm.getFileNames())
+    Writer.writeSymbol(StrTabBuilder.getOffset(Name),
+                       ELF::STT_FILE | ELF::STB_LOCAL, 0, 0, ELF::STV_DEFAULT,
+                       ELF::SHN_ABS, true);
+
+  // Write the symbol table entries.
   for (ELFSymbolData &MSD : LocalSymbolData) {
     unsigned StringIndex = MSD.Symbol->getType() == ELF::STT_SECTION
                                ? 0
                                : StrTabBuilder.getOffset(MSD.Name);
-    MSD.Symbol->setIndex(Index++);
     writeSymbol(Writer, StringIndex, MSD, Layout);
   }
 
-  // Write the symbol table entries.
-  LastLocalSymbolIndex = Index;
-
   for (ELFSymbolData &MSD : ExternalSymbolData) {
     unsigned StringIndex = StrTabBuilder.getOffset(MSD.Name);
-    MSD.Symbol->setIndex(Index++);
     writeSymbol(Writer, StringIndex, MSD, Layout);
-    assert(MSD.Symbol->getBinding() != ELF::STB_LOCAL);
   }
 
-  uint64_t SecEnd = OS.tell();
-  SectionOffsets[SymtabSection] = std::make_pair(SecStart, SecEnd);
-
   ArrayRef<uint32_t> ShndxIndexes = Writer.getShndxIndexes();
   if (ShndxIndexes.empty()) {
     assert(SymtabShndxSectionIndex == 0);
@@ -915,13 +939,8 @@ void ELFObjectWriter::computeSymbolTable(
   }
   assert(SymtabShndxSectionIndex != 0);
 
-  SecStart = OS.tell();
-  const MCSectionELF *SymtabShndxSection =
-      SectionTable[SymtabShndxSectionIndex - 1];
   for (uint32_t Index : ShndxIndexes)
     write(Index);
-  SecEnd = OS.tell();
-  SectionOffsets[SymtabShndxSection] = std::make_pair(SecStart, SecEnd);
 }
 
 MCSectionELF *
@@ -996,19 +1015,17 @@ prependCompressionHeader(uint64_t Size,
   return true;
 }
 
-void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
-                                       const MCAsmLayout &Layout) {
-  MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
+uint64_t ELFObjectWriter::compressSectionData(const MCAssembler &Asm,
+                                              MCSectionELF &Section,
+                                              const MCAsmLayout &Layout) {
   StringRef SectionName = Section.getSectionName();
 
   // Compressing debug_frame requires handling alignment fragments which is
   // more work (possibly generalizing MCAssembler.cpp:writeFragment to allow
   // for writing to arbitrary buffers) for little benefit.
   if (!Asm.getContext().getAsmInfo()->compressDebugSections() ||
-      !SectionName.startswith(".debug_") || SectionName == ".debug_frame") {
-    Asm.writeSectionData(&Section, Layout);
-    return;
-  }
+      !SectionName.startswith(".debug_") || SectionName == ".debug_frame")
+    return Layout.getSectionFileSize(&Section);
 
   // Gather the uncompressed data from all the fragments.
   const MCSection::FragmentListType &Fragments = Section.getFragmentList();
@@ -1019,18 +1036,28 @@ void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
   zlib::Status Success = zlib::compress(
       StringRef(UncompressedData.data(), UncompressedData.size()),
       CompressedContents);
-  if (Success != zlib::StatusOK) {
-    Asm.writeSectionData(&Section, Layout);
-    return;
-  }
+  if (Success != zlib::StatusOK)
+    return Layout.getSectionFileSize(&Section);
+
+  if (!prependCompressionHeader(UncompressedData.size(), CompressedContents))
+    return Layout.getSectionFileSize(&Section);
 
-  if (!prependCompressionHeader(UncompressedData.size(), CompressedContents)) {
+  Asm.getContext().renameELFSection(&Section,
+                                    (".z" + SectionName.drop_front(1)).str());
+  SmallVector<char, 128> &Contents = CompressedSections[&Section];
+  Contents.swap(CompressedContents);
+  return Contents.size();
+}
+
+void ELFObjectWriter::writeSectionData(const MCAssembler &Asm, MCSection &Sec,
+                                       const MCAsmLayout &Layout) {
+  MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
+  auto I = CompressedSections.find(&Section);
+  if (I == CompressedSections.end()) {
     Asm.writeSectionData(&Section, Layout);
     return;
   }
-  Asm.getContext().renameELFSection(&Section,
-                                    (".z" + SectionName.drop_front(1)).str());
-  OS << CompressedContents;
+  OS << StringRef(I->second.data(), I->second.size());
 }
 
 void ELFObjectWriter::WriteSecHdrEntry(uint32_t Name, uint32_t Type,
@@ -1190,26 +1217,19 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
 
   std::map<const MCSymbol *, std::vector<const MCSectionELF *>> GroupMembers;
 
-  // Write out the ELF header ...
-  writeHeader(Asm);
-
-  // ... then the sections ...
-  SectionOffsetsTy SectionOffsets;
+  // The whole file is laid out before anything is written, so that the
+  // header can be written with its final contents and the stream can be told
+  // up front how much is coming. First build the section table, compressing
+  // the debug sections on the way, which makes the size of every section
+  // known ...
   std::vector<MCSectionELF *> Groups;
-  std::vector<MCSectionELF *> Relocations;
+  std::vector<MCSectionELF *> RelSections;
+  DenseMap<const MCSectionELF *, uint64_t> SectionSizes;
   for (MCSection &Sec : Asm) {
     MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
 
-    align(Section.getAlignment());
-
-    // Remember the offset into the file for this section.
-    uint64_t SecStart = OS.tell();
-
     const MCSymbolELF *SignatureSymbol = Section.getGroup();
-    writeSectionData(Asm, Section, Layout);
-
-    uint64_t SecEnd = OS.tell();
-    SectionOffsets[&Section] = std::make_pair(SecStart, SecEnd);
+    SectionSizes[&Section] = compressSectionData(Asm, Section, Layout);
 
     MCSectionELF *RelSection = createRelocationSection(Ctx, Section);
 
@@ -1232,15 +1252,78 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
     SectionIndexMap[&Section] = addToSectionTable(&Section);
     if (RelSection) {
       SectionIndexMap[RelSection] = addToSectionTable(RelSection);
-      Relocations.push_back(RelSection);
+      RelSections.push_back(RelSection);
     }
   }
 
-  for (MCSectionELF *Group : Groups) {
-    align(Group->getAlignment());
+  // ... and the symbol table ...
+  std::vector<ELFSymbolData> LocalSymbolData;
+  std::vector<ELFSymbolData> ExternalSymbolData;
+  computeSymbolTable(Asm, Layout, SectionIndexMap, RevGroupMap,
+                     LocalSymbolData, ExternalSymbolData);
+  const MCSectionELF *SymtabSection = SectionTable[SymbolTableIndex - 1];
+  unsigned NumSymbols = 1 + Asm.getFileNames().size() +
+                        LocalSymbolData.size() + ExternalSymbolData.size();
+
+  // ... then assign file offsets in the order the sections are written:
+  // the ELF header, the sections, the groups, the symbol table, the
+  // relocations, the string table and the section header table.
+  SectionOffsetsTy SectionOffsets;
+  uint64_t Offset =
+      is64Bit() ? sizeof(ELF::Elf64_Ehdr) : sizeof(ELF::Elf32_Ehdr);
+  auto AddSection = [&](const MCSectionELF *Sec, uint64_t Size,
+                        unsigned Alignment) {
+    Offset += OffsetToAlignment(Offset, Alignment);
+    SectionOffsets[Sec] = std::make_pair(Offset, Offset + Size);
+    Offset += Size;
+  };
+
+  for (MCSection &Sec : Asm) {
+    const MCSectionELF &Section = static_cast<MCSectionELF &>(Sec);
+    AddSection(&Section, SectionSizes[&Section], Section.getAlignment());
+  }
 
-    // Remember the offset into the file for this section.
-    uint64_t SecStart = OS.tell();
+  for (const MCSectionELF *Group : Groups)
+    AddSection(Group, 4 * (1 + GroupMembers[Group->getGroup()].size()),
+               Group->getAlignment());
+
+  AddSection(SymtabSection, NumSymbols * SymtabSection->getEntrySize(),
+             SymtabSection->getAlignment());
+  if (SymtabShndxSectionIndex)
+    AddSection(SectionTable[SymtabShndxSectionIndex - 1],
+               NumSymbols * sizeof(uint32_t), 1);
+
+  for (const MCSectionELF *RelSection : RelSections)
+    AddSection(RelSection,
+               Relocations[RelSection->getAssociatedSection()].size() *
+                   RelSection->getEntrySize(),
+               RelSection->getAlignment());
+
+  AddSection(StrtabSection, StrTabBuilder.data().size(), 1);
+
+  uint64_t NaturalAlignment = is64Bit() ? 8 : 4;
+  uint64_t SectionHeaderOffset =
+      Offset + OffsetToAlignment(Offset, NaturalAlignment);
+  uint64_t FileSize =
+      SectionHeaderOffset +
+      (SectionTable.size() + 1) *
+          (is64Bit() ? sizeof(ELF::Elf64_Shdr) : sizeof(ELF::Elf32_Shdr));
+  OS.reserveExtraSpace(FileSize);
+
+  // Write out the ELF header ...
+  writeHeader(Asm, SectionHeaderOffset);
+
+  // ... then the sections ...
+  for (MCSection &Sec : Asm) {
+    const std::pair<uint64_t, uint64_t> &Offsets =
+        SectionOffsets[static_cast<MCSectionELF *>(&Sec)];
+    writePaddingTo(Offsets.first);
+    writeSectionData(Asm, Sec, Layout);
+    assert(OS.tell() == Offsets.second && "Section size changed");
+  }
+
+  for (MCSectionELF *Group : Groups) {
+    writePaddingTo(SectionOffsets[Group].first);
 
     const MCSymbol *SignatureSymbol = Group->getGroup();
     assert(SignatureSymbol);
@@ -1249,65 +1332,23 @@ void ELFObjectWriter::writeObject(MCAssembler &Asm,
       uint32_t SecIndex = SectionIndexMap.lookup(Member);
       write(SecIndex);
     }
-
-    uint64_t SecEnd = OS.tell();
-    SectionOffsets[Group] = std::make_pair(SecStart, SecEnd);
   }
 
-  // Compute symbol table information.
-  computeSymbolTable(Asm, Layout, SectionIndexMap, RevGroupMap, SectionOffsets);
-
-  for (MCSectionELF *RelSection : Relocations) {
-    align(RelSection->getAlignment());
-
-    // Remember the offset into the file for this section.
-    uint64_t SecStart = OS.tell();
+  writePaddingTo(SectionOffsets[SymtabSection].first);
+  writeSymbolTable(Asm, Layout, LocalSymbolData, ExternalSymbolData);
 
+  for (MCSectionELF *RelSection : RelSections) {
+    writePaddingTo(SectionOffsets[RelSection].first);
     writeRelocations(Asm, *RelSection->getAssociatedSection());
-
-    uint64_t SecEnd = OS.tell();
-    SectionOffsets[RelSection] = std::make_pair(SecStart, SecEnd);
-  }
-
-  {
-    uint64_t SecStart = OS.tell();
-    const MCSectionELF *Sec = createStringTable(Ctx);
-    uint64_t SecEnd = OS.tell();
-    SectionOffsets[Sec] = std::make_pair(SecStart, SecEnd);
   }
 
-  uint64_t NaturalAlignment = is64Bit() ? 8 : 4;
-  align(NaturalAlignment);
-
-  const unsigned SectionHeaderOffset = OS.tell();
+  writePaddingTo(SectionOffsets[StrtabSection].first);
+  createStringTable(Ctx);
 
-  // ... then the section header table ...
+  // ... then the section header table.
+  writePaddingTo(SectionHeaderOffset);
   writeSectionHeader(Layout, SectionIndexMap, SectionOffsets);
-
-  uint16_t NumSections = (SectionTable.size() + 1 >= ELF::SHN_LORESERVE)
-                             ? (uint16_t)ELF::SHN_UNDEF
-                             : SectionTable.size() + 1;
-  if (sys::IsLittleEndianHost != IsLittleEndian)
-    sys::swapByteOrder(NumSections);
-  unsigned NumSectionsOffset;
-
-  if (is64Bit()) {
-    uint64_t Val = SectionHeaderOffset;
-    if (sys::IsLittleEndianHost != IsLittleEndian)
-      sys::swapByteOrder(Val);
-    OS.pwrite(reinterpret_cast<char *>(&Val), sizeof(Val),
-              offsetof(ELF::Elf64_Ehdr, e_shoff));
-    NumSectionsOffset = offsetof(ELF::Elf64_Ehdr, e_shnum);
-  } else {
-    uint32_t Val = SectionHeaderOffset;
-    if (sys::IsLittleEndianHost != IsLittleEndian)
-      sys::swapByteOrder(Val);
-    OS.pwrite(reinterpret_cast<char *>(&Val), sizeof(Val),
-              offsetof(ELF::Elf32_Ehdr, e_shoff));
-    NumSectionsOffset = offsetof(ELF::Elf32_Ehdr, e_shnum);
-  }
-  OS.pwrite(reinterpret_cast<char *>(&NumSections), sizeof(NumSections),
-            NumSectionsOffset);
+  assert(OS.tell() == FileSize && "ELF layout mismatch");
 }
 
 bool ELFObjectWriter::isSymbolRefDifferenceFullyResolvedImpl(
@@ -54,6 +54,8 @@ STATISTIC(FragmentLayouts, "Number of fragment layouts");
 STATISTIC(ObjectBytes, "Number of emitted object file bytes");
 STATISTIC(RelaxationSteps, "Number of assembler layout and relaxation steps");
 STATISTIC(RelaxedInstructions, "Number of relaxed instructions");
+STATISTIC(SkippedRelaxationChecks,
+          "Number of relaxation candidates skipped as unchanged");
 }
 }
 
@@ -95,6 +97,40 @@ void MCAsmLayout::invalidateFragmentsFrom(MCFragment *F) {
   LastValidFragment[F->getParent()] = F->getPrevNode();
 }
 
+void MCAsmLayout::resizeFragments(MCFragment *First, MCFragment *Last) {
+  // Fragments which have not been laid out yet pick up the new sizes when they
+  // are. Bundle padding is decided as each fragment is laid out, so with
+  // bundling enabled the section has to be laid out again.
+  if (!isFragmentValid(First))
+    return;
+  if (Assembler.isBundlingEnabled()) {
+    invalidateFragmentsFrom(First);
+    return;
+  }
+
+  MCSection *Sec = First->getParent();
+  MCFragment *LastValid = LastValidFragment[Sec];
+  for (MCFragment *F = First; F != LastValid; F = F->getNextNode()) {
+    // The size of an org may depend on any symbol, so leave the fragments
+    // after it to be laid out again.
+    if (isa<MCOrgFragment>(F)) {
+      LastValidFragment[Sec] = F;
+      return;
+    }
+
+    // Once past the resized fragments, a fragment that did not move means
+    // none of the ones after it did either.
+    MCFragment *Next = F->getNextNode();
+    uint64_t Offset = F->Offset + getAssembler().computeFragmentSize(*this, *F);
+    if (Offset == Next->Offset &&
+        F->getLayoutOrder() >= Last->getLayoutOrder())
+      return;
+
+    ++stats::FragmentLayouts;
+    Next->Offset = Offset;
+  }
+}
+
 void MCAsmLayout::ensureValid(const MCFragment *F) const {
   MCSection *Sec = F->getParent();
   MCFragment *Cur = LastValidFragment[Sec];
@@ -855,8 +891,31 @@ void MCAssembler::Finish() {
       iFrag->setLayoutOrder(FragmentIndex++);
   }
 
+  // Collect the fragments whose size is decided by relaxation.
+  std::vector<RelaxationWorklist> Worklists(size());
+  for (MCSection &Sec : *this) {
+    RelaxationWorklist &Worklist = Worklists[Sec.getOrdinal()];
+    for (MCFragment &F : Sec) {
+      switch (F.getKind()) {
+      default:
+        break;
+      case MCFragment::FT_Relaxable:
+        // Instructions that were pushed out already relaxed never change.
+        if (getBackend().mayNeedRelaxation(
+                cast<MCRelaxableFragment>(F).getInst()))
+          Worklist.push_back(RelaxationCandidate(&F));
+        break;
+      case MCFragment::FT_Dwarf:
+      case MCFragment::FT_DwarfFrame:
+      case MCFragment::FT_LEB:
+        Worklist.push_back(RelaxationCandidate(&F));
+        break;
+      }
+    }
+  }
+
   // Layout until everything fits.
-  while (layoutOnce(Layout))
+  while (layoutOnce(Layout, Worklists))
     continue;
 
   DEBUG_WITH_TYPE("mc-dump", {
@@ -1012,55 +1071,221 @@ bool MCAssembler::relaxDwarfCallFrameFragment(MCAsmLayout &Layout,
   return OldSize != Data.size();
 }
 
-bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec) {
-  // Holds the first fragment which needed relaxing during this layout. It will
-  // remain NULL if none were relaxed.
-  // When a fragment is relaxed, all the fragments following it should get
-  // invalidated because their offset is going to change.
-  MCFragment *FirstRelaxedFragment = nullptr;
-
-  // Attempt to relax all the fragments in the section.
-  for (MCSection::iterator I = Sec.begin(), IE = Sec.end(); I != IE; ++I) {
-    // Check if this is a fragment that needs relaxation.
-    bool RelaxedFrag = false;
-    switch(I->getKind()) {
-    default:
-      break;
-    case MCFragment::FT_Relaxable:
-      assert(!getRelaxAll() &&
-             "Did not expect a MCRelaxableFragment in RelaxAll mode");
-      RelaxedFrag = relaxInstruction(Layout, *cast<MCRelaxableFragment>(I));
-      break;
-    case MCFragment::FT_Dwarf:
-      RelaxedFrag = relaxDwarfLineAddr(Layout,
-                                       *cast<MCDwarfLineAddrFragment>(I));
-      break;
-    case MCFragment::FT_DwarfFrame:
-      RelaxedFrag =
-        relaxDwarfCallFrameFragment(Layout,
-                                    *cast<MCDwarfCallFrameFragment>(I));
-      break;
-    case MCFragment::FT_LEB:
-      RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(I));
-      break;
+/// Add the fragments the value of \p E is computed from to \p Terms, each with
+/// the factor its offset is multiplied by. Returns false if the value of \p E
+/// is not simply a sum of fragment offsets and constants.
+static bool
+collectFragmentTerms(const MCExpr &E, int64_t Factor,
+                     SmallVectorImpl<std::pair<const MCFragment *, int64_t>>
+                         &Terms) {
+  switch (E.getKind()) {
+  case MCExpr::Constant:
+    return true;
+
+  case MCExpr::SymbolRef: {
+    const MCSymbol &Sym = cast<MCSymbolRefExpr>(E).getSymbol();
+    if (Sym.isVariable() || !Sym.getFragment())
+      return false;
+    Terms.push_back(std::make_pair(Sym.getFragment(), Factor));
+    return true;
+  }
+
+  case MCExpr::Unary: {
+    const MCUnaryExpr &UE = cast<MCUnaryExpr>(E);
+    if (UE.getOpcode() == MCUnaryExpr::Plus)
+      return collectFragmentTerms(*UE.getSubExpr(), Factor, Terms);
+    if (UE.getOpcode() == MCUnaryExpr::Minus)
+      return collectFragmentTerms(*UE.getSubExpr(), -Factor, Terms);
+    return false;
+  }
+
+  case MCExpr::Binary: {
+    const MCBinaryExpr &BE = cast<MCBinaryExpr>(E);
+    if (BE.getOpcode() == MCBinaryExpr::Add)
+      return collectFragmentTerms(*BE.getLHS(), Factor, Terms) &&
+             collectFragmentTerms(*BE.getRHS(), Factor, Terms);
+    if (BE.getOpcode() == MCBinaryExpr::Sub)
+      return collectFragmentTerms(*BE.getLHS(), Factor, Terms) &&
+             collectFragmentTerms(*BE.getRHS(), -Factor, Terms);
+    return false;
+  }
+
+  case MCExpr::Target:
+    return false;
+  }
+
+  llvm_unreachable("Invalid assembly expression kind!");
+}
+
+/// Collect the terms of the value of \p E, less the offset of \p PCRelTo if
+/// that is set, and check that they only depend on the distances between
+/// fragments, that is, that their factors add up to zero.
+static bool
+collectDistanceTerms(const MCExpr &E, const MCFragment *PCRelTo,
+                     SmallVectorImpl<std::pair<const MCFragment *, int64_t>>
+                         &Terms) {
+  unsigned Start = Terms.size();
+  if (PCRelTo)
+    Terms.push_back(std::make_pair(PCRelTo, int64_t(-1)));
+  if (!collectFragmentTerms(E, 1, Terms))
+    return false;
+  int64_t Sum = 0;
+  for (unsigned i = Start, e = Terms.size(); i != e; ++i)
+    Sum += Terms[i].second;
+  return Sum == 0;
+}
+
+void MCAssembler::recordRelaxationDeps(const MCAsmLayout &Layout,
+                                       RelaxationCandidate &C) const {
+  if (!C.Trackable)
+    return;
+
+  SmallVector<std::pair<const MCFragment *, int64_t>, 4> Terms;
+  switch (C.F->getKind()) {
+  default:
+    llvm_unreachable("Not a relaxation candidate!");
+  case MCFragment::FT_Relaxable: {
+    const MCRelaxableFragment &RF = cast<MCRelaxableFragment>(*C.F);
+    for (const MCFixup &Fixup : RF.getFixups()) {
+      unsigned Flags = getBackend().getFixupKindInfo(Fixup.getKind()).Flags;
+      // An aligned down PC depends on the offset of the fixup itself.
+      if (Flags & MCFixupKindInfo::FKF_IsAlignedDownTo32Bits) {
+        C.Trackable = false;
+        return;
+      }
+      // A PC-relative value is the distance from the fixup.
+      const MCFragment *PCRelTo =
+          (Flags & MCFixupKindInfo::FKF_IsPCRel) ? C.F : nullptr;
+      if (!collectDistanceTerms(*Fixup.getValue(), PCRelTo, Terms)) {
+        C.Trackable = false;
+        return;
+      }
     }
-    if (RelaxedFrag && !FirstRelaxedFragment)
-      FirstRelaxedFragment = I;
+    break;
   }
-  if (FirstRelaxedFragment) {
-    Layout.invalidateFragmentsFrom(FirstRelaxedFragment);
-    return true;
+  case MCFragment::FT_LEB:
+    C.Trackable =
+        collectDistanceTerms(cast<MCLEBFragment>(C.F)->getValue(), nullptr,
+                             Terms);
+    break;
+  case MCFragment::FT_Dwarf:
+    C.Trackable = collectDistanceTerms(
+        cast<MCDwarfLineAddrFragment>(C.F)->getAddrDelta(), nullptr, Terms);
+    break;
+  case MCFragment::FT_DwarfFrame:
+    C.Trackable = collectDistanceTerms(
+        cast<MCDwarfCallFrameFragment>(C.F)->getAddrDelta(), nullptr, Terms);
+    break;
+  }
+  if (!C.Trackable)
+    return;
+
+  // Distances are only fixed within a section.
+  C.Deps.clear();
+  if (!Terms.empty()) {
+    const MCFragment *Base = Terms.front().first;
+    uint64_t BaseOffset = Layout.getFragmentOffset(Base);
+    for (const auto &Term : Terms) {
+      if (Term.first->getParent() != Base->getParent()) {
+        C.Trackable = false;
+        return;
+      }
+      C.Deps.push_back(std::make_pair(
+          Term.first, Layout.getFragmentOffset(Term.first) - BaseOffset));
+    }
   }
+  C.Checked = true;
+}
+
+bool MCAssembler::needsRelaxationCheck(const MCAsmLayout &Layout,
+                                       const RelaxationCandidate &C) const {
+  if (!C.Trackable || !C.Checked)
+    return true;
+  if (C.Deps.empty())
+    return false;
+
+  uint64_t BaseOffset = Layout.getFragmentOffset(C.Deps.front().first);
+  for (const auto &Dep : C.Deps)
+    if (Layout.getFragmentOffset(Dep.first) - BaseOffset != Dep.second)
+      return true;
   return false;
 }
 
-bool MCAssembler::layoutOnce(MCAsmLayout &Layout) {
+bool MCAssembler::layoutSectionOnce(MCAsmLayout &Layout, MCSection &Sec,
+                                    RelaxationWorklist &Worklist) {
+  // The first and last fragments relaxed during this iteration.
+  MCFragment *FirstRelaxed = nullptr, *LastRelaxed = nullptr;
+
+  // Attempt to relax the candidates whose layout changed, and drop those that
+  // can't be relaxed any further.
+  RelaxationWorklist::iterator Out = Worklist.begin();
+  for (RelaxationCandidate &C : Worklist) {
+    bool Keep = true;
+    if (!needsRelaxationCheck(Layout, C)) {
+      ++stats::SkippedRelaxationChecks;
+    } else {
+      MCFragment *F = C.F;
+      bool RelaxedFrag = false;
+      switch (F->getKind()) {
+      default:
+        llvm_unreachable("Not a relaxation candidate!");
+      case MCFragment::FT_Relaxable: {
+        assert(!getRelaxAll() &&
+               "Did not expect a MCRelaxableFragment in RelaxAll mode");
+        MCRelaxableFragment &RF = *cast<MCRelaxableFragment>(F);
+        RelaxedFrag = relaxInstruction(Layout, RF);
+        Keep = getBackend().mayNeedRelaxation(RF.getInst());
+        break;
+      }
+      case MCFragment::FT_Dwarf:
+        RelaxedFrag = relaxDwarfLineAddr(Layout,
+                                         *cast<MCDwarfLineAddrFragment>(F));
+        break;
+      case MCFragment::FT_DwarfFrame:
+        RelaxedFrag =
+          relaxDwarfCallFrameFragment(Layout,
+                                      *cast<MCDwarfCallFrameFragment>(F));
+        break;
+      case MCFragment::FT_LEB:
+        RelaxedFrag = relaxLEB(Layout, *cast<MCLEBFragment>(F));
+        break;
+      }
+
+      if (RelaxedFrag) {
+        if (!FirstRelaxed)
+          FirstRelaxed = F;
+        LastRelaxed = F;
+        C.Checked = false;
+      } else {
+        recordRelaxationDeps(Layout, C);
+      }
+    }
+
+    if (Keep) {
+      if (&*Out != &C)
+        *Out = std::move(C);
+      ++Out;
+    }
+  }
+  Worklist.erase(Out, Worklist.end());
+
+  if (!FirstRelaxed)
+    return false;
+  Layout.resizeFragments(FirstRelaxed, LastRelaxed);
+  return true;
+}
+
+bool MCAssembler::layoutOnce(MCAsmLayout &Layout,
+                             std::vector<RelaxationWorklist> &Worklists) {
   ++stats::RelaxationSteps;
 
   bool WasRelaxed = false;
   for (iterator it = begin(), ie = end(); it != ie; ++it) {
     MCSection &Sec = *it;
-    while (layoutSectionOnce(Layout, Sec))
+    RelaxationWorklist &Worklist = Worklists[Sec.getOrdinal()];
+    if (Worklist.empty())
+      continue;
+    while (layoutSectionOnce(Layout, Sec, Worklist))
       WasRelaxed = true;
   }
 
@@ -106,6 +106,28 @@ InstrProfWriter::addFunctionCounts(StringRef FunctionName,
   return instrprof_error::success;
 }
 
+void InstrProfWriter::mergeRecordsFromWriter(
+    InstrProfWriter &&IPW,
+    function_ref<void(StringRef FunctionName, std::error_code EC)> Warn) {
+  for (auto &I : IPW.FunctionData) {
+    auto Where = FunctionData.find(I.getKey());
+    if (Where == FunctionData.end()) {
+      // We've never seen a function with this name, take all of its counts.
+      FunctionData[I.getKey()] = std::move(I.getValue());
+      continue;
+    }
+    for (const auto &Counts : I.getValue())
+      if (std::error_code EC =
+              addFunctionCounts(I.getKey(), Counts.first, Counts.second))
+        Warn(I.getKey(), EC);
+  }
+  // The counts we took as they were are covered by the other writer's max.
+  if (IPW.MaxFunctionCount > MaxFunctionCount)
+    MaxFunctionCount = IPW.MaxFunctionCount;
+  IPW.FunctionData.clear();
+  IPW.MaxFunctionCount = 0;
+}
+
 std::pair<uint64_t, uint64_t> InstrProfWriter::writeImpl(raw_ostream &OS) {
   OnDiskChainedHashTableGenerator<InstrProfRecordTrait> Generator;
 
@@ -0,0 +1,132 @@
+//===-CachePruning.cpp - LLVM Cache Directory Pruning ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the pruning of a directory based on least recently
+// used.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <tuple>
+#include <vector>
+
+#define DEBUG_TYPE "cache-pruning"
+
+using namespace llvm;
+
+/// Write a new timestamp file with the given path. This is used for the
+/// pruning interval option.
+static void writeTimestampFile(StringRef TimestampFile) {
+  std::error_code EC;
+  raw_fd_ostream Out(TimestampFile.str(), EC, sys::fs::F_None);
+}
+
+bool CachePruning::prune() {
+  if (Path.empty())
+    return false;
+
+  bool isPathDir;
+  if (sys::fs::is_directory(Path, isPathDir))
+    return false;
+  if (!isPathDir)
+    return false;
+
+  if (Expiration == 0 && MaxSize == 0) {
+    DEBUG(dbgs() << "No pruning settings set, exit early\n");
+    // Nothing will be pruned, early exit.
+    return false;
+  }
+
+  // Try to stat() the timestamp file.
+  SmallString<128> TimestampFile(Path);
+  sys::path::append(TimestampFile, "llvmcache.timestamp");
+  sys::fs::file_status FileStatus;
+  sys::TimeValue CurrentTime = sys::TimeValue::now();
+  if (sys::fs::status(TimestampFile, FileStatus)) {
+    // The timestamp file does not exist (or cannot be read): this is the first
+    // time the cache is pruned, create the file.
+    writeTimestampFile(TimestampFile);
+  } else {
+    if (Interval) {
+      // Check whether the time stamp is older than our pruning interval.
+      // If not, do nothing.
+      sys::TimeValue TimeStampModTime = FileStatus.getLastModificationTime();
+      auto TimeInterval = sys::TimeValue(sys::TimeValue::SecondsType(Interval));
+      if (CurrentTime - TimeStampModTime <= TimeInterval) {
+        DEBUG(dbgs() << "Timestamp file too recent (" << TimeStampModTime.str()
+                     << "), skip pruning\n");
+        return false;
+      }
+    }
+    // Write a new timestamp file so that nobody else attempts to prune.
+    // There is a benign race condition here, if two processes happen to
+    // notice at the same time that the timestamp is out-of-date.
+    writeTimestampFile(TimestampFile);
+  }
+
+  // Keep track of the entries that survive expiration, ordered from the least
+  // to the most recently used, to prune them if the cache is too large.
+  std::vector<std::tuple<sys::TimeValue, uint64_t, std::string>> Entries;
+  uint64_t TotalSize = 0;
+
+  // Walk the entire directory cache, looking for unused files.
+  std::error_code EC;
+  SmallString<128> CachePathNative;
+  sys::path::native(Path, CachePathNative);
+  for (sys::fs::directory_iterator File(CachePathNative, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    StringRef Filename = sys::path::filename(File->path());
+    // Ignore anything that is not a cache entry, and the lock files guarding
+    // entries that are being produced.
+    if (!Filename.startswith("llvmcache-") ||
+        Filename.find(".lock") != StringRef::npos)
+      continue;
+
+    if (File->status(FileStatus)) {
+      DEBUG(dbgs() << "Ignore " << File->path() << " (can't stat)\n");
+      continue;
+    }
+
+    // If the file hasn't been used recently enough, delete it.
+    sys::TimeValue FileModTime = FileStatus.getLastModificationTime();
+    auto TimeExpiration =
+        sys::TimeValue(sys::TimeValue::SecondsType(Expiration));
+    if (Expiration && CurrentTime - FileModTime > TimeExpiration) {
+      DEBUG(dbgs() << "Remove " << File->path() << " ("
+                   << FileModTime.str() << ")\n");
+      sys::fs::remove(File->path());
+      continue;
+    }
+
+    Entries.push_back(std::make_tuple(FileModTime, FileStatus.getSize(),
+                                      File->path()));
+    TotalSize += FileStatus.getSize();
+  }
+
+  // Prune for size now if needed, starting with the least recently used
+  // entries.
+  if (MaxSize && TotalSize > MaxSize) {
+    std::sort(Entries.begin(), Entries.end());
+    for (const auto &Entry : Entries) {
+      if (TotalSize <= MaxSize)
+        break;
+      DEBUG(dbgs() << "Remove " << std::get<2>(Entry) << " ("
+                   << std::get<1>(Entry) << " bytes) to fit the cache size\n");
+      sys::fs::remove(std::get<2>(Entry));
+      TotalSize -= std::get<1>(Entry);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,171 @@
+//==-- llvm/Support/ThreadPool.cpp - A ThreadPool implementation -*- C++ -*-==//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a crude C++11 based thread pool.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Threading.h"
+#include <cassert>
+
+using namespace llvm;
+
+// The pool and the index of the worker running on the current thread, if any.
+static LLVM_THREAD_LOCAL const ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = 0;
+
+ThreadPool::ThreadPool() : ThreadPool(getDefaultParallelism()) {}
+
+ThreadPool::ThreadPool(unsigned ThreadCount)
+    : ThreadCount(ThreadCount ? ThreadCount : 1), QueuedTasks(0),
+      ActiveTasks(0), EnableFlag(true) {
+#if LLVM_ENABLE_THREADS != 0
+  // One queue per worker, plus the injection queue for external submissions.
+  for (unsigned I = 0; I <= this->ThreadCount; ++I)
+    Queues.emplace_back(new WorkQueue());
+  Threads.reserve(this->ThreadCount);
+  for (unsigned I = 0; I < this->ThreadCount; ++I)
+    Threads.emplace_back([this, I] { work(I); });
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+#if LLVM_ENABLE_THREADS != 0
+  wait();
+  {
+    std::unique_lock<std::mutex> LockGuard(SleepLock);
+    EnableFlag = false;
+  }
+  SleepCondition.notify_all();
+  for (auto &Worker : Threads)
+    Worker.join();
+#endif
+}
+
+bool ThreadPool::isWorkerThread() const { return CurrentPool == this; }
+
+void ThreadPool::enqueue(TaskTy Task) {
+#if LLVM_ENABLE_THREADS != 0
+  ++ActiveTasks;
+  WorkQueue &Queue =
+      isWorkerThread() ? *Queues[CurrentWorker] : *Queues[ThreadCount];
+  {
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_back(std::move(Task));
+  }
+  {
+    std::unique_lock<std::mutex> LockGuard(SleepLock);
+    assert(EnableFlag && "Queuing a task during ThreadPool destruction");
+    ++QueuedTasks;
+  }
+  SleepCondition.notify_one();
+#else
+  // Without thread support, run the task synchronously.
+  Task();
+#endif
+}
+
+bool ThreadPool::popTask(TaskTy &Task) {
+  // The calling worker's own queue is used as a stack.
+  unsigned Self = ThreadCount;
+  if (isWorkerThread()) {
+    Self = CurrentWorker;
+    WorkQueue &Queue = *Queues[Self];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (!Queue.Tasks.empty()) {
+      Task = std::move(Queue.Tasks.back());
+      Queue.Tasks.pop_back();
+      --QueuedTasks;
+      return true;
+    }
+  }
+
+  // Everything else is taken FIFO: first the injection queue, then the other
+  // workers' queues starting with our neighbour to spread contention.
+  for (unsigned I = 0; I <= ThreadCount; ++I) {
+    unsigned Victim = (Self + 1 + I) % (ThreadCount + 1);
+    if (Victim == Self)
+      continue;
+    WorkQueue &Queue = *Queues[Victim];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (!Queue.Tasks.empty()) {
+      Task = std::move(Queue.Tasks.front());
+      Queue.Tasks.pop_front();
+      --QueuedTasks;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::runTask(TaskTy &Task) {
+  Task();
+  Task = nullptr;
+  if (--ActiveTasks == 0) {
+    std::unique_lock<std::mutex> LockGuard(CompletionLock);
+    CompletionCondition.notify_all();
+  }
+}
+
+bool ThreadPool::runPendingTask() {
+  TaskTy Task;
+  if (!popTask(Task))
+    return false;
+  runTask(Task);
+  return true;
+}
+
+void ThreadPool::work(unsigned Index) {
+  CurrentPool = this;
+  CurrentWorker = Index;
+  while (true) {
+    if (runPendingTask())
+      continue;
+
+    std::unique_lock<std::mutex> LockGuard(SleepLock);
+    // Wait for work or a signal to exit. New tasks are counted while holding
+    // SleepLock, so this cannot race with enqueue().
+    SleepCondition.wait(LockGuard,
+                        [&] { return !EnableFlag || QueuedTasks > 0; });
+    if (!EnableFlag && QueuedTasks <= 0)
+      return;
+  }
+}
+
+void ThreadPool::wait() {
+#if LLVM_ENABLE_THREADS != 0
+  assert(!isWorkerThread() &&
+         "ThreadPool::wait() called from a worker; use a TaskGroup instead");
+  std::unique_lock<std::mutex> LockGuard(CompletionLock);
+  CompletionCondition.wait(LockGuard, [&] { return ActiveTasks == 0; });
+#endif
+}
+
+void TaskGroup::finishTask() {
+  std::unique_lock<std::mutex> LockGuard(Lock);
+  if (--PendingTasks == 0)
+    Done.notify_all();
+}
+
+void TaskGroup::wait() {
+  if (Pool.isWorkerThread()) {
+    // A worker waiting on nested work helps with it rather than blocking a
+    // thread the group's own tasks may need.
+    while (PendingTasks != 0)
+      if (!Pool.runPendingTask())
+        std::this_thread::yield();
+    // Synchronize with the last finishTask() before the group may go away.
+    std::unique_lock<std::mutex> LockGuard(Lock);
+    return;
+  }
+  std::unique_lock<std::mutex> LockGuard(Lock);
+  Done.wait(LockGuard, [&] { return PendingTasks == 0; });
+}
@@ -16,7 +16,10 @@
 #include "llvm/Config/config.h"
 #include "llvm/Support/Atomic.h"
 #include "llvm/Support/Mutex.h"
+#include <atomic>
 #include <cassert>
+#include <cstdlib>
+#include <thread>
 
 using namespace llvm;
 
@@ -28,6 +31,26 @@ bool llvm::llvm_is_multithreaded() {
 #endif
 }
 
+static std::atomic<unsigned> ParallelismOverride(0);
+
+void llvm::setDefaultParallelism(unsigned Jobs) { ParallelismOverride = Jobs; }
+
+unsigned llvm::getDefaultParallelism() {
+#if LLVM_ENABLE_THREADS != 0
+  if (unsigned Jobs = ParallelismOverride)
+    return Jobs;
+  if (const char *Env = std::getenv("LLVM_PARALLEL_JOBS")) {
+    int Jobs = std::atoi(Env);
+    if (Jobs > 0)
+      return Jobs;
+  }
+  // hardware_concurrency() returns zero if the value is not computable.
+  if (unsigned Jobs = std::thread::hardware_concurrency())
+    return Jobs;
+#endif
+  return 1;
+}
+
 #if LLVM_ENABLE_THREADS != 0 && defined(HAVE_PTHREAD_H)
 #include <pthread.h>
 
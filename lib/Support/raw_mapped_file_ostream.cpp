@@ -0,0 +1,113 @@
+//===--- raw_mapped_file_ostream.cpp - Write a file through a mapping -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This implements a raw_pwrite_stream that writes through a FileOutputBuffer.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/raw_mapped_file_ostream.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/FileSystem.h"
+#include <cstring>
+using namespace llvm;
+
+raw_mapped_file_ostream::raw_mapped_file_ostream(StringRef Path)
+    : Path(Path), Pos(0) {}
+
+raw_mapped_file_ostream::~raw_mapped_file_ostream() {
+  // Without a commit the output is dropped, along with the mapping.
+  flush();
+}
+
+void raw_mapped_file_ostream::unmap() {
+  assert(Data.empty() && "Stream contents are in two places");
+  Data.append(Buffer->getBufferStart(), Buffer->getBufferStart() + Pos);
+  Buffer.reset();
+  Pos = 0;
+}
+
+void raw_mapped_file_ostream::reserveExtraSpace(uint64_t ExtraSize) {
+  flush();
+  if (Buffer) {
+    if (Pos + ExtraSize <= Buffer->getBufferSize())
+      return;
+    unmap();
+  }
+  if (!ExtraSize)
+    return;
+
+  // If the file can't be mapped, keep writing to memory.
+  uint64_t Size = Data.size() + ExtraSize;
+  std::unique_ptr<FileOutputBuffer> NewBuffer;
+  if (FileOutputBuffer::create(Path, Size, NewBuffer)) {
+    Data.reserve(Size);
+    return;
+  }
+
+  if (!Data.empty())
+    memcpy(NewBuffer->getBufferStart(), Data.data(), Data.size());
+  Pos = Data.size();
+  SmallVector<char, 0>().swap(Data);
+  Buffer = std::move(NewBuffer);
+}
+
+void raw_mapped_file_ostream::write_impl(const char *Ptr, size_t Size) {
+  if (Buffer) {
+    if (Pos + Size <= Buffer->getBufferSize()) {
+      memcpy(Buffer->getBufferStart() + Pos, Ptr, Size);
+      Pos += Size;
+      return;
+    }
+    // More was written than was reserved.
+    unmap();
+  }
+  Data.append(Ptr, Ptr + Size);
+}
+
+void raw_mapped_file_ostream::pwrite_impl(const char *Ptr, size_t Size,
+                                          uint64_t Offset) {
+  flush();
+  if (Buffer)
+    memcpy(Buffer->getBufferStart() + Offset, Ptr, Size);
+  else
+    memcpy(Data.data() + Offset, Ptr, Size);
+}
+
+uint64_t raw_mapped_file_ostream::current_pos() const {
+  return Buffer ? Pos : Data.size();
+}
+
+std::error_code raw_mapped_file_ostream::commit() {
+  flush();
+
+  if (Buffer) {
+    if (Pos == Buffer->getBufferSize()) {
+      std::error_code EC = Buffer->commit();
+      Buffer.reset();
+      Pos = 0;
+      return EC;
+    }
+    // Less was written than was reserved, and the mapping can't shrink.
+    unmap();
+  }
+
+  std::error_code EC;
+  raw_fd_ostream OS(Path, EC, sys::fs::F_None);
+  if (EC)
+    return EC;
+  OS.write(Data.data(), Data.size());
+  OS.close();
+  if (OS.has_error()) {
+    OS.clear_error();
+    return make_error_code(errc::io_error);
+  }
+  SmallVector<char, 0>().swap(Data);
+  return EC;
+}
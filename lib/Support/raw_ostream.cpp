@@ -799,6 +799,12 @@ void raw_svector_ostream::resync() {
   SetBuffer(OS.end(), OS.capacity() - OS.size());
 }
 
+void raw_svector_ostream::reserveExtraSpace(uint64_t ExtraSize) {
+  flush();
+  OS.reserve(OS.size() + ExtraSize);
+  SetBuffer(OS.end(), OS.capacity() - OS.size());
+}
+
 void raw_svector_ostream::write_impl(const char *Ptr, size_t Size) {
   if (Ptr == OS.end()) {
     // Grow the buffer to include the scratch area without copying.
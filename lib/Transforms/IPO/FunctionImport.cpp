@@ -0,0 +1,239 @@
+//===- FunctionImport.cpp - Summary-based function importing --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements function importing based on a combined function
+// summary index.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+using namespace llvm;
+
+#define DEBUG_TYPE "function-import"
+
+static cl::opt<unsigned> ImportInstrLimit(
+    "import-instr-limit", cl::init(100), cl::Hidden, cl::value_desc("N"),
+    cl::desc("Only import functions with less than N instructions"));
+
+static cl::opt<unsigned long long> ImportHotCount(
+    "import-hot-count", cl::init(10000), cl::Hidden, cl::value_desc("N"),
+    cl::desc("Treat functions entered at least N times as hot when importing"));
+
+static cl::opt<unsigned> ImportHotMultiplier(
+    "import-hot-multiplier", cl::init(3), cl::Hidden,
+    cl::desc("Multiply the import instruction limit by this for hot functions"));
+
+FunctionImporter::FunctionImporter(const FunctionInfoIndex &Index,
+                                   ModuleLoaderTy ModuleLoader,
+                                   unsigned InstrLimit)
+    : Index(Index), ModuleLoader(ModuleLoader), InstrLimit(InstrLimit) {}
+
+const FunctionSummary *
+FunctionImporter::selectCallee(StringRef Name, StringRef ModulePath) const {
+  const FunctionInfoIndex::FunctionSummaryList *Summaries =
+      Index.findFunctionSummaries(Name);
+  if (!Summaries)
+    return nullptr;
+
+  for (const std::unique_ptr<FunctionSummary> &Summary : *Summaries) {
+    if (Summary->modulePath() == ModulePath)
+      continue;
+
+    // Only definitions that cannot be replaced at link time may be copied.
+    switch (Summary->getLinkage()) {
+    case GlobalValue::ExternalLinkage:
+    case GlobalValue::LinkOnceODRLinkage:
+    case GlobalValue::WeakODRLinkage:
+      break;
+    default:
+      continue;
+    }
+
+    // Local symbols would have to be promoted to be referenced from here.
+    if (Summary->hasLocalRefs())
+      continue;
+
+    unsigned Limit = InstrLimit;
+    if (Summary->getEntryCount() >= ImportHotCount)
+      Limit *= ImportHotMultiplier;
+    if (Summary->getInstCount() > Limit)
+      continue;
+    return Summary.get();
+  }
+  return nullptr;
+}
+
+/// Return a module holding a copy of \p F, taken from \p Src, along with
+/// declarations of what it uses. The copy has external linkage so that the
+/// linker does not skip it; the caller makes it available_externally.
+static std::unique_ptr<Module> extractFunction(const Module &Src,
+                                               const Function &F) {
+  ValueToValueMapTy VMap;
+  std::unique_ptr<Module> Extracted(CloneModule(
+      &Src, VMap, [&](const GlobalValue *GV) { return GV == &F; }));
+
+  Function *NewF = cast<Function>(VMap[&F]);
+  NewF->setLinkage(GlobalValue::ExternalLinkage);
+  NewF->setComdat(nullptr);
+
+  // The debug info of the source module does not describe the destination.
+  StripDebugInfo(*Extracted);
+  SmallVector<NamedMDNode *, 4> NamedMDs;
+  for (NamedMDNode &NMD : Extracted->named_metadata())
+    if (NMD.getName() != "llvm.module.flags")
+      NamedMDs.push_back(&NMD);
+  for (NamedMDNode *NMD : NamedMDs)
+    NMD->eraseFromParent();
+
+  // Drop the declarations of everything else the source module contains.
+  SmallVector<GlobalValue *, 64> Dead;
+  for (GlobalVariable &GV : Extracted->globals())
+    if (GV.use_empty())
+      Dead.push_back(&GV);
+  for (Function &Fn : *Extracted)
+    if (&Fn != NewF && Fn.use_empty())
+      Dead.push_back(&Fn);
+  for (GlobalValue *GV : Dead)
+    GV->eraseFromParent();
+  return Extracted;
+}
+
+ErrorOr<unsigned> FunctionImporter::importFunctions(Module &M) {
+  StringRef ModulePath = M.getModuleIdentifier();
+
+  SmallVector<std::string, 64> Worklist;
+  for (Function &F : M)
+    if (F.isDeclaration() && !F.isIntrinsic() && !F.use_empty())
+      Worklist.push_back(F.getName());
+
+  StringSet<> Visited;
+  StringMap<std::unique_ptr<Module>> SourceModules;
+  unsigned ImportCount = 0;
+  while (!Worklist.empty()) {
+    std::string Name = Worklist.pop_back_val();
+    if (!Visited.insert(Name).second)
+      continue;
+
+    Function *Decl = M.getFunction(Name);
+    if (!Decl || !Decl->isDeclaration())
+      continue;
+    const FunctionSummary *Summary = selectCallee(Name, ModulePath);
+    if (!Summary)
+      continue;
+
+    std::unique_ptr<Module> &Src = SourceModules[Summary->modulePath()];
+    if (!Src) {
+      ErrorOr<std::unique_ptr<Module>> SrcOrErr =
+          ModuleLoader(Summary->modulePath());
+      if (std::error_code EC = SrcOrErr.getError())
+        return EC;
+      Src = std::move(*SrcOrErr);
+    }
+
+    // The index may be stale; only import what is really defined there.
+    Function *F = Src->getFunction(Name);
+    if (!F || F->isDeclaration())
+      continue;
+    if (std::error_code EC = F->materialize())
+      return EC;
+
+    DEBUG(dbgs() << "Importing " << Name << " from " << Summary->modulePath()
+                 << "\n");
+    std::unique_ptr<Module> Extracted = extractFunction(*Src, *F);
+    if (Linker::LinkModules(&M, Extracted.get()))
+      return make_error_code(std::errc::invalid_argument);
+    M.getFunction(Name)->setLinkage(GlobalValue::AvailableExternallyLinkage);
+    ++ImportCount;
+
+    for (const GlobalValueRef &Callee : Summary->calls())
+      Worklist.push_back(Callee.Name);
+  }
+  return ImportCount;
+}
+
+//===----------------------------------------------------------------------===//
+// Function import pass
+//===----------------------------------------------------------------------===//
+
+static cl::opt<std::string>
+    SummaryFile("summary-file",
+                cl::desc("The combined function summary index to import "
+                         "functions with"));
+
+namespace {
+/// Pass that imports functions named in the combined index given with
+/// -summary-file, loading the defining modules from their paths.
+class FunctionImportPass : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  FunctionImportPass() : ModulePass(ID) {
+    initializeFunctionImportPassPass(*PassRegistry::getPassRegistry());
+  }
+
+  bool runOnModule(Module &M) override;
+};
+}
+
+char FunctionImportPass::ID = 0;
+INITIALIZE_PASS(FunctionImportPass, "function-import",
+                "Summary Based Function Import", false, false)
+
+ModulePass *llvm::createFunctionImportPass() {
+  return new FunctionImportPass();
+}
+
+bool FunctionImportPass::runOnModule(Module &M) {
+  if (SummaryFile.empty())
+    report_fatal_error("-function-import requires -summary-file");
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+      MemoryBuffer::getFile(SummaryFile);
+  if (std::error_code EC = BufferOrErr.getError())
+    report_fatal_error("Cannot open '" + SummaryFile + "': " + EC.message());
+  ErrorOr<std::unique_ptr<FunctionInfoIndex>> IndexOrErr =
+      getFunctionInfoIndex((*BufferOrErr)->getMemBufferRef());
+  if (std::error_code EC = IndexOrErr.getError())
+    report_fatal_error("Cannot read function summary '" + SummaryFile +
+                       "': " + EC.message());
+
+  LLVMContext &Context = M.getContext();
+  auto ModuleLoader = [&](StringRef Identifier)
+      -> ErrorOr<std::unique_ptr<Module>> {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> Buffer =
+        MemoryBuffer::getFile(Identifier);
+    if (std::error_code EC = Buffer.getError())
+      return EC;
+    return getLazyBitcodeModule(std::move(*Buffer), Context, nullptr,
+                                /*ShouldLazyLoadMetadata=*/true);
+  };
+
+  FunctionImporter Importer(**IndexOrErr, ModuleLoader, ImportInstrLimit);
+  ErrorOr<unsigned> Imported = Importer.importFunctions(M);
+  if (std::error_code EC = Imported.getError())
+    report_fatal_error("Error importing functions into '" +
+                       M.getModuleIdentifier() + "': " + EC.message());
+  return *Imported != 0;
+}
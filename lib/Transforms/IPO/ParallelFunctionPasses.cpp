@@ -0,0 +1,280 @@
+//===- ParallelFunctionPasses.cpp - Run function passes on threads --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements runFunctionPassesInParallel.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/ParallelFunctionPasses.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static void runFunctionPasses(
+    Module &M,
+    const std::function<void(legacy::FunctionPassManager &)> &AddPasses) {
+  legacy::FunctionPassManager FPM(&M);
+  AddPasses(FPM);
+  FPM.doInitialization();
+  for (Function &F : M)
+    if (!F.isDeclaration())
+      FPM.run(F);
+  FPM.doFinalization();
+}
+
+/// Return true if the constant \p C refers to a global value.
+static bool refersToGlobal(const Constant *C) {
+  if (isa<GlobalValue>(C) || isa<BlockAddress>(C))
+    return true;
+  for (const Use &Op : C->operands())
+    if (refersToGlobal(cast<Constant>(Op)))
+      return true;
+  return false;
+}
+
+/// Give \p MPart, a partition of \p M, an available_externally copy of each
+/// constant it only declares, so that function passes can still fold loads
+/// from them. The linker drops the copies in favour of the definitions.
+static void addConstantCopies(Module &M, Module &MPart) {
+  for (GlobalVariable &GV : MPart.globals()) {
+    if (!GV.isDeclaration())
+      continue;
+    GlobalVariable *Def = M.getNamedGlobal(GV.getName());
+    if (!Def || !Def->isConstant() || !Def->hasDefinitiveInitializer() ||
+        Def->hasLocalLinkage() || refersToGlobal(Def->getInitializer()))
+      continue;
+    // Both modules are in the same context, so the initializer can be shared.
+    GV.setInitializer(Def->getInitializer());
+    GV.setLinkage(GlobalValue::AvailableExternallyLinkage);
+  }
+}
+
+/// Remove from \p MPart, a partition of \p M, the unused declarations of the
+/// values that another partition defines. Those of local values would clash
+/// with the definitions when the partitions are linked back together.
+static void dropForeignDeclarations(const Module &M, Module &MPart) {
+  std::vector<GlobalValue *> Dead;
+  auto Visit = [&](GlobalValue &GV) {
+    if (!GV.isDeclaration())
+      return;
+    const GlobalValue *Def = M.getNamedValue(GV.getName());
+    if (!Def || Def->isDeclaration())
+      return;
+    GV.removeDeadConstantUsers();
+    if (GV.use_empty())
+      Dead.push_back(&GV);
+  };
+  for (GlobalVariable &GV : MPart.globals())
+    Visit(GV);
+  for (Function &F : MPart)
+    Visit(F);
+  for (GlobalValue *GV : Dead)
+    GV->eraseFromParent();
+}
+
+static std::unique_ptr<Module> parsePartition(StringRef Bitcode,
+                                              LLVMContext &Context) {
+  ErrorOr<std::unique_ptr<Module>> MOrErr = parseBitcodeFile(
+      MemoryBufferRef(Bitcode, "<partition>"), Context);
+  if (std::error_code EC = MOrErr.getError())
+    report_fatal_error("Failed to read partition: " + EC.message());
+  return std::move(*MOrErr);
+}
+
+/// Return the global value that the element \p Elt of an appending global
+/// refers to, e.g. the constructor of an llvm.global_ctors entry.
+static const GlobalValue *getAppendingElementTarget(const Constant *Elt) {
+  if (auto *CS = dyn_cast<ConstantStruct>(Elt))
+    Elt = CS->getNumOperands() > 1 ? CS->getOperand(1) : nullptr;
+  if (!Elt)
+    return nullptr;
+  return dyn_cast<GlobalValue>(Elt->stripPointerCasts());
+}
+
+namespace {
+/// The layout of a module, recorded by name so that it can be restored after
+/// the module has been split and linked back together.
+struct ModuleLayout {
+  std::vector<std::string> Globals, Functions, Aliases;
+  /// For each appending global, the names of the values its elements refer
+  /// to, in order.
+  StringMap<std::vector<std::string>> AppendingTargets;
+
+  explicit ModuleLayout(const Module &M);
+  void restore(Module &M) const;
+};
+}
+
+ModuleLayout::ModuleLayout(const Module &M) {
+  for (const GlobalVariable &GV : M.globals()) {
+    Globals.push_back(GV.getName());
+    if (!GV.hasAppendingLinkage() || !GV.hasInitializer())
+      continue;
+    auto *Init = dyn_cast<ConstantArray>(GV.getInitializer());
+    if (!Init)
+      continue;
+    std::vector<std::string> &Targets = AppendingTargets[GV.getName()];
+    for (const Use &Op : Init->operands()) {
+      const GlobalValue *Target =
+          getAppendingElementTarget(cast<Constant>(Op));
+      Targets.push_back(Target ? Target->getName() : "");
+    }
+  }
+  for (const Function &F : M)
+    Functions.push_back(F.getName());
+  for (const GlobalAlias &GA : M.aliases())
+    Aliases.push_back(GA.getName());
+}
+
+/// Move the values of \p List named in \p Order to the end of the list, in
+/// that order, followed by the values that are not named there.
+template <typename ListTy>
+static void reorder(Module &M, ListTy &List, ArrayRef<std::string> Order) {
+  typedef typename ListTy::value_type ValueTy;
+  typedef typename ListTy::iterator IteratorTy;
+  std::vector<ValueTy *> Others;
+  StringSet<> Ordered;
+  for (const std::string &Name : Order)
+    Ordered.insert(Name);
+  for (ValueTy &V : List)
+    if (!Ordered.count(V.getName()))
+      Others.push_back(&V);
+
+  for (const std::string &Name : Order)
+    if (auto *V = dyn_cast_or_null<ValueTy>(M.getNamedValue(Name)))
+      List.splice(List.end(), List, IteratorTy(V));
+  for (ValueTy *V : Others)
+    List.splice(List.end(), List, IteratorTy(V));
+}
+
+void ModuleLayout::restore(Module &M) const {
+  reorder(M, M.getGlobalList(), Globals);
+  reorder(M, M.getFunctionList(), Functions);
+  reorder(M, M.getAliasList(), Aliases);
+
+  // Linking appended the elements of the appending globals partition by
+  // partition: put them back in their original order.
+  for (const auto &Entry : AppendingTargets) {
+    GlobalVariable *GV = M.getNamedGlobal(Entry.getKey());
+    auto *Init =
+        GV && GV->hasInitializer()
+            ? dyn_cast<ConstantArray>(GV->getInitializer()) : nullptr;
+    if (!Init)
+      continue;
+    const std::vector<std::string> &Targets = Entry.getValue();
+    auto IndexOf = [&](Constant *Elt) -> size_t {
+      const GlobalValue *Target = getAppendingElementTarget(Elt);
+      std::string Name = Target ? Target->getName() : "";
+      return std::find(Targets.begin(), Targets.end(), Name) - Targets.begin();
+    };
+    std::vector<Constant *> Elts;
+    for (Use &Op : Init->operands())
+      Elts.push_back(cast<Constant>(Op));
+    std::stable_sort(Elts.begin(), Elts.end(), [&](Constant *A, Constant *B) {
+      return IndexOf(A) < IndexOf(B);
+    });
+    GV->setInitializer(ConstantArray::get(Init->getType(), Elts));
+  }
+}
+
+std::unique_ptr<Module> llvm::runFunctionPassesInParallel(
+    std::unique_ptr<Module> M, unsigned ThreadCount,
+    std::function<void(legacy::FunctionPassManager &)> AddPasses) {
+  if (ThreadCount <= 1 || M->getNamedMetadata("llvm.dbg.cu")) {
+    runFunctionPasses(*M, AddPasses);
+    return M;
+  }
+
+  // Values are matched up by name once linked back together: name the
+  // unnamed ones for the time being.
+  std::vector<std::string> TemporaryNames;
+  auto NameValue = [&](GlobalValue &GV) {
+    if (GV.hasName())
+      return;
+    GV.setName("__unnamed");
+    TemporaryNames.push_back(GV.getName());
+  };
+  for (GlobalVariable &GV : M->globals())
+    NameValue(GV);
+  for (Function &F : *M)
+    NameValue(F);
+  for (GlobalAlias &GA : M->aliases())
+    NameValue(GA);
+  ModuleLayout Layout(*M);
+
+  std::vector<SmallString<0>> Partitions;
+  SplitModule(*M, ThreadCount, [&](std::unique_ptr<Module> MPart) {
+    dropForeignDeclarations(*M, *MPart);
+    addConstantCopies(*M, *MPart);
+    Partitions.emplace_back();
+    raw_svector_ostream OS(Partitions.back());
+    WriteBitcodeToFile(MPart.get(), OS);
+  });
+
+  {
+    ThreadPool Pool(ThreadCount);
+    for (unsigned I = 0, E = Partitions.size(); I != E; ++I)
+      Pool.async([&, I] {
+        LLVMContext Context;
+        std::unique_ptr<Module> MPart = parsePartition(Partitions[I], Context);
+        runFunctionPasses(*MPart, AddPasses);
+
+        // Every partition has a copy of the named metadata: keep the first.
+        if (I != 0) {
+          std::vector<NamedMDNode *> NamedMDs;
+          for (NamedMDNode &NMD : MPart->named_metadata())
+            if (NMD.getName() != "llvm.module.flags")
+              NamedMDs.push_back(&NMD);
+          for (NamedMDNode *NMD : NamedMDs)
+            NMD->eraseFromParent();
+        }
+
+        Partitions[I].clear();
+        raw_svector_ostream OS(Partitions[I]);
+        WriteBitcodeToFile(MPart.get(), OS);
+      });
+  }
+
+  LLVMContext &Context = M->getContext();
+  std::unique_ptr<Module> Merged(
+      new Module(M->getModuleIdentifier(), Context));
+  Merged->setDataLayout(M->getDataLayout());
+  Merged->setTargetTriple(M->getTargetTriple());
+  M.reset();
+
+  Linker L(Merged.get());
+  for (SmallString<0> &Partition : Partitions) {
+    std::unique_ptr<Module> MPart = parsePartition(Partition, Context);
+    if (L.linkInModule(MPart.get()))
+      report_fatal_error("Failed to link partitions back together");
+    Partition.clear();
+  }
+
+  Layout.restore(*Merged);
+  for (const std::string &Name : TemporaryNames)
+    if (GlobalValue *GV = Merged->getNamedValue(Name))
+      GV->setName("");
+  return Merged;
+}
@@ -0,0 +1,234 @@
+//===- SplitModule.cpp - Split a module into partitions -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the function llvm::SplitModule, which splits a module
+// into multiple linkable partitions. It can be used to implement parallel code
+// generation for link-time optimization.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/GlobalObject.h"
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+typedef EquivalenceClasses<const GlobalValue *> ClusterMapType;
+typedef DenseMap<const Comdat *, const GlobalValue *> ComdatMembersType;
+}
+
+/// Return the global value that must be emitted together with the user \p U:
+/// the function containing an instruction, or the global itself.
+static const GlobalValue *getOwner(const User *U) {
+  if (auto *I = dyn_cast<Instruction>(U))
+    return I->getParent()->getParent();
+  return dyn_cast<GlobalValue>(U);
+}
+
+/// Put \p GV in the same cluster as every global value that uses \p V, looking
+/// through constant expressions. Appending globals are split separately, so
+/// their uses do not tie anything together.
+static void addAllGlobalValueUsers(ClusterMapType &GVtoClusterMap,
+                                   const GlobalValue *GV, const Value *V) {
+  SmallVector<const User *, 8> Worklist(V->user_begin(), V->user_end());
+  while (!Worklist.empty()) {
+    const User *U = Worklist.pop_back_val();
+    if (isa<Constant>(U) && !isa<GlobalValue>(U)) {
+      Worklist.append(U->user_begin(), U->user_end());
+      continue;
+    }
+    const GlobalValue *Owner = getOwner(U);
+    if (Owner && !Owner->hasAppendingLinkage())
+      GVtoClusterMap.unionSets(GV, Owner);
+  }
+}
+
+/// Return true if \p GV is a definition that belongs to exactly one partition.
+static bool isPartitioned(const GlobalValue &GV) {
+  return !GV.isDeclaration() && !GV.hasAppendingLinkage();
+}
+
+static void addClusterConstraints(ClusterMapType &GVtoClusterMap,
+                                  ComdatMembersType &ComdatMembers,
+                                  const GlobalValue &GV) {
+  if (!isPartitioned(GV))
+    return;
+  GVtoClusterMap.insert(&GV);
+
+  // Comdat members must stay together.
+  if (auto *GO = dyn_cast<GlobalObject>(&GV))
+    if (const Comdat *C = GO->getComdat()) {
+      auto Inserted = ComdatMembers.insert(std::make_pair(C, &GV));
+      if (!Inserted.second)
+        GVtoClusterMap.unionSets(&GV, Inserted.first->second);
+    }
+
+  // An alias must be defined in the same module as its aliasee.
+  if (auto *GA = dyn_cast<GlobalAlias>(&GV))
+    if (const GlobalObject *Base = GA->getBaseObject())
+      if (isPartitioned(*Base))
+        GVtoClusterMap.unionSets(&GV, Base);
+
+  // Local symbols cannot be referenced from another partition.
+  if (GV.hasLocalLinkage())
+    addAllGlobalValueUsers(GVtoClusterMap, &GV, &GV);
+
+  // Neither can the addresses of a function's basic blocks.
+  if (auto *F = dyn_cast<Function>(&GV))
+    for (const User *U : F->users())
+      if (auto *BA = dyn_cast<BlockAddress>(U))
+        addAllGlobalValueUsers(GVtoClusterMap, &GV, BA);
+}
+
+/// Return a rough measure of the code generation cost of \p GV.
+static unsigned getSize(const GlobalValue &GV) {
+  unsigned Size = 1;
+  if (auto *F = dyn_cast<Function>(&GV))
+    for (const BasicBlock &BB : *F)
+      Size += BB.size();
+  return Size;
+}
+
+/// Assign every partitioned global value of \p M to one of \p N partitions.
+static void findPartitions(const Module &M, unsigned N,
+                           DenseMap<const GlobalValue *, unsigned> &PartitionOf) {
+  ClusterMapType GVtoClusterMap;
+  ComdatMembersType ComdatMembers;
+  SmallVector<const GlobalValue *, 64> Globals;
+  for (const GlobalVariable &GV : M.globals())
+    Globals.push_back(&GV);
+  for (const Function &F : M)
+    Globals.push_back(&F);
+  for (const GlobalAlias &GA : M.aliases())
+    Globals.push_back(&GA);
+
+  for (const GlobalValue *GV : Globals)
+    addClusterConstraints(GVtoClusterMap, ComdatMembers, *GV);
+
+  // Number the clusters in module order so that the result is deterministic.
+  DenseMap<const GlobalValue *, unsigned> ClusterIDs;
+  std::vector<unsigned> ClusterSizes;
+  SmallVector<std::pair<const GlobalValue *, unsigned>, 64> Members;
+  for (const GlobalValue *GV : Globals) {
+    if (!isPartitioned(*GV))
+      continue;
+    const GlobalValue *Leader = GVtoClusterMap.getLeaderValue(GV);
+    auto Inserted = ClusterIDs.insert(
+        std::make_pair(Leader, static_cast<unsigned>(ClusterSizes.size())));
+    if (Inserted.second)
+      ClusterSizes.push_back(0);
+    unsigned ID = Inserted.first->second;
+    ClusterSizes[ID] += getSize(*GV);
+    Members.push_back(std::make_pair(GV, ID));
+  }
+
+  // Hand out the clusters, largest first, to the least loaded partition.
+  std::vector<unsigned> Order(ClusterSizes.size());
+  for (unsigned I = 0, E = Order.size(); I != E; ++I)
+    Order[I] = I;
+  std::stable_sort(Order.begin(), Order.end(), [&](unsigned A, unsigned B) {
+    return ClusterSizes[A] > ClusterSizes[B];
+  });
+  std::vector<unsigned> PartitionSizes(N, 0);
+  std::vector<unsigned> ClusterPartition(ClusterSizes.size());
+  for (unsigned ID : Order) {
+    unsigned Smallest =
+        std::min_element(PartitionSizes.begin(), PartitionSizes.end()) -
+        PartitionSizes.begin();
+    ClusterPartition[ID] = Smallest;
+    PartitionSizes[Smallest] += ClusterSizes[ID];
+  }
+
+  for (const auto &Member : Members)
+    PartitionOf[Member.first] = ClusterPartition[Member.second];
+}
+
+/// Return the global value an element of an appending global refers to, e.g.
+/// the constructor of an llvm.global_ctors entry.
+static const GlobalValue *getAppendingElementTarget(const Constant *Elt) {
+  if (auto *CS = dyn_cast<ConstantStruct>(Elt))
+    Elt = CS->getNumOperands() > 1 ? CS->getOperand(1) : nullptr;
+  if (!Elt)
+    return nullptr;
+  return dyn_cast<GlobalValue>(Elt->stripPointerCasts());
+}
+
+/// Keep only the elements of the appending global \p NewGV, a clone of \p GV,
+/// that refer to values defined in partition \p I or outside the module.
+static void splitAppendingGlobal(
+    const GlobalVariable &GV, GlobalVariable &NewGV, unsigned I,
+    const DenseMap<const GlobalValue *, unsigned> &PartitionOf) {
+  auto *Init = dyn_cast_or_null<ConstantArray>(GV.getInitializer());
+  auto *NewInit = dyn_cast_or_null<ConstantArray>(NewGV.getInitializer());
+  if (!Init || !NewInit || !NewGV.use_empty())
+    return;
+
+  SmallVector<Constant *, 16> Kept;
+  for (unsigned Op = 0, E = Init->getNumOperands(); Op != E; ++Op) {
+    const GlobalValue *Target = getAppendingElementTarget(Init->getOperand(Op));
+    auto It = Target ? PartitionOf.find(Target) : PartitionOf.end();
+    if (It == PartitionOf.end() ? I == 0 : It->second == I)
+      Kept.push_back(NewInit->getOperand(Op));
+  }
+  if (Kept.size() == NewInit->getNumOperands())
+    return;
+
+  if (Kept.empty()) {
+    NewGV.eraseFromParent();
+    return;
+  }
+  ArrayType *ATy = ArrayType::get(NewInit->getType()->getElementType(),
+                                  Kept.size());
+  auto *Replacement = new GlobalVariable(
+      *NewGV.getParent(), ATy, NewGV.isConstant(), NewGV.getLinkage(),
+      ConstantArray::get(ATy, Kept), "", &NewGV, NewGV.getThreadLocalMode());
+  Replacement->copyAttributesFrom(&NewGV);
+  Replacement->takeName(&NewGV);
+  NewGV.eraseFromParent();
+}
+
+void llvm::SplitModule(
+    const Module &M, unsigned N,
+    std::function<void(std::unique_ptr<Module> MPart)> ModuleCallback) {
+  DenseMap<const GlobalValue *, unsigned> PartitionOf;
+  findPartitions(M, N, PartitionOf);
+
+  for (unsigned I = 0; I < N; ++I) {
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> MPart(
+        CloneModule(&M, VMap, [&](const GlobalValue *GV) {
+          auto It = PartitionOf.find(GV);
+          return It == PartitionOf.end() || It->second == I;
+        }));
+
+    for (const GlobalVariable &GV : M.globals())
+      if (GV.hasAppendingLinkage())
+        splitAppendingGlobal(GV, *cast<GlobalVariable>(VMap[&GV]), I,
+                             PartitionOf);
+
+    // Symbols defined in module-level asm must only be defined once.
+    if (I != 0)
+      MPart->setModuleInlineAsm("");
+
+    ModuleCallback(std::move(MPart));
+  }
+}
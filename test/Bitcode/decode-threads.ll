@@ -0,0 +1,39 @@
+; RUN: llvm-as -preserve-bc-uselistorder < %s > %t.bc
+; RUN: opt -S %t.bc > %t.serial.ll
+; RUN: opt -S -bitcode-decode-threads=4 %t.bc > %t.threads.ll
+; RUN: diff %t.serial.ll %t.threads.ll
+; RUN: FileCheck %s < %t.threads.ll
+; Check that decoding the function blocks ahead on other threads reads the
+; same module: constants, symbol tables, metadata attachments and use-lists in
+; function blocks, and a block address of a function that comes later.
+
+@g = global i32 0
+
+; CHECK-LABEL: define i8* @before()
+; CHECK-NEXT: ret i8* blockaddress(@after, %bb)
+define i8* @before() {
+  ret i8* blockaddress(@after, %bb)
+}
+
+; CHECK-LABEL: define i32 @after(i32 %x)
+; CHECK: %sum = add i32 %x, 42, !foo ![[NODE:[0-9]+]]
+define i32 @after(i32 %x) {
+entry:
+  %sum = add i32 %x, 42, !foo !0
+  store i32 %sum, i32* @g
+  br label %bb
+bb:
+  %v = load i32, i32* @g
+  %w = mul i32 %v, %sum
+  ret i32 %w
+}
+
+; CHECK-LABEL: define double @fp(double %d)
+; CHECK-NEXT: %r = fadd double %d, 1.500000e+00
+define double @fp(double %d) {
+  %r = fadd double %d, 1.5
+  ret double %r
+}
+
+; CHECK: ![[NODE]] = !{!"node"}
+!0 = !{!"node"}
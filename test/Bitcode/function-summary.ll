@@ -0,0 +1,24 @@
+; RUN: llvm-as -function-summary < %s | llvm-bcanalyzer -dump | FileCheck %s --check-prefix=BC
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s --check-prefix=NOSUMMARY
+; RUN: llvm-as -function-summary < %s | llvm-dis | FileCheck %s
+
+; The summary block comes before the function bodies.
+; BC: <FUNCTION_SUMMARY_BLOCK
+; BC: <NAME abbrevid={{[0-9]+}} op0=102 op1=111 op2=111/>
+; BC: <NAME abbrevid={{[0-9]+}} op0=98 op1=97 op2=114/>
+; BC: <ENTRY
+; BC: </FUNCTION_SUMMARY_BLOCK>
+; BC: <FUNCTION_BLOCK
+
+; NOSUMMARY-NOT: FUNCTION_SUMMARY_BLOCK
+
+; The summary does not change the module read back.
+; CHECK: define void @foo()
+; CHECK: call void @bar()
+
+define void @foo() {
+  call void @bar()
+  ret void
+}
+
+declare void @bar()
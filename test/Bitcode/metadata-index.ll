@@ -0,0 +1,27 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
+; The module-level metadata block starts with its strings and the offset of an
+; index of its other records, which comes before the named metadata.
+
+; BC: <METADATA_BLOCK
+; BC-NOT: <METADATA_NODE
+; BC: <METADATA_STRINGS
+; BC-NEXT: <METADATA_INDEX_OFFSET
+; BC: <METADATA_INDEX op
+; BC-NEXT: <METADATA_NAME
+; BC: </METADATA_BLOCK>
+
+; RUN: llvm-as < %s | llvm-dis | FileCheck %s
+; Check that this round-trips correctly.
+
+define void @f() {
+  ret void, !foo !0
+}
+
+; CHECK: ret void, !foo ![[NODE:[0-9]+]]
+; CHECK: !named = !{![[NODE]]}
+; CHECK: ![[NODE]] = !{![[STR:[0-9]+]]}
+; CHECK: ![[STR]] = !{!"string"}
+
+!named = !{!0}
+!0 = !{!1}
+!1 = !{!"string"}
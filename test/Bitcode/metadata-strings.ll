@@ -0,0 +1,26 @@
+; RUN: llvm-as < %s | llvm-bcanalyzer -dump | FileCheck %s -check-prefix=BC
+; All the MDStrings of the module-level metadata block are emitted as one
+; record, ahead of the index of the other records.
+
+; BC: <METADATA_BLOCK
+; BC-NOT: <METADATA_STRING op
+; BC: <METADATA_STRINGS {{.*}}op0=3 op1=4/> blob data = unprintable, 35 bytes.
+; BC-NEXT: <METADATA_INDEX_OFFSET
+; BC-NOT: <METADATA_STRING op
+; BC: </METADATA_BLOCK>
+
+; RUN: llvm-as < %s | llvm-dis | FileCheck %s
+; RUN: llvm-as < %s > %t.bc
+; RUN: opt -S %t.bc | FileCheck %s
+; Check that this round-trips correctly, through both the streamed reader used
+; by llvm-dis and the in-memory reader.
+
+; CHECK: !named = !{![[A:[0-9]+]], ![[B:[0-9]+]], ![[C:[0-9]+]]}
+; CHECK: ![[A]] = !{!"a"}
+; CHECK: ![[B]] = !{!"", !"a"}
+; CHECK: ![[C]] = !{!"a longer string with a \22quote\22"}
+
+!named = !{!0, !1, !2}
+!0 = !{!"a"}
+!1 = !{!"", !"a"}
+!2 = !{!"a longer string with a \22quote\22"}
@@ -0,0 +1,35 @@
+; RUN: llc -j2 -o %t.s %s
+; RUN: FileCheck --check-prefix=CHECK0 %s < %t.s.0
+; RUN: FileCheck --check-prefix=CHECK1 %s < %t.s.1
+; RUN: llc -j2 -filetype=obj -o %t.o %s
+; RUN: llvm-nm %t.o.0 | FileCheck --check-prefix=NM0 %s
+; RUN: llvm-nm %t.o.1 | FileCheck --check-prefix=NM1 %s
+; RUN: not llc -j2 -o - %s 2>&1 | FileCheck --check-prefix=STDOUT %s
+
+; With -j, llc splits the module and writes partition I to <output>.I.
+
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK0-NOT: bar:
+; CHECK0: foo:
+; CHECK0: callq bar
+; CHECK0-NOT: bar:
+; NM0: U bar
+; NM0: T foo
+define void @foo() {
+  call void @bar()
+  ret void
+}
+
+; CHECK1-NOT: foo:
+; CHECK1: bar:
+; CHECK1: callq foo
+; CHECK1-NOT: foo:
+; NM1: T bar
+; NM1: U foo
+define void @bar() {
+  call void @foo()
+  ret void
+}
+
+; STDOUT: -j cannot write to standard output
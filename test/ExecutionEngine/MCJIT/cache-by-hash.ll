@@ -0,0 +1,15 @@
+; REQUIRES: asserts
+; RUN: rm -rf %t.cachedir
+; RUN: %lli -enable-cache-manager -cache-by-hash -object-cache-dir=%t.cachedir -debug-only=file-object-cache %s 2>&1 | FileCheck %s -check-prefix=MISS
+; RUN: %lli -enable-cache-manager -cache-by-hash -object-cache-dir=%t.cachedir -debug-only=file-object-cache %s 2>&1 | FileCheck %s -check-prefix=HIT
+; RUN: %lli -O0 -enable-cache-manager -cache-by-hash -object-cache-dir=%t.cachedir -debug-only=file-object-cache %s 2>&1 | FileCheck %s -check-prefix=MISS
+; The objects are cached under a hash of the IR and of the target
+; configuration, so a second run loads them and a run at another optimization
+; level does not.
+
+; MISS: Cache miss for
+; HIT: Cache hit for
+
+define i32 @main() {
+  ret i32 0
+}
@@ -0,0 +1,31 @@
+; RUN: %lli -jit-stats-file=%t.json %s
+; RUN: FileCheck %s -check-prefix=JSON < %t.json
+; RUN: %lli -jit-stats-file=%t.csv -jit-stats-format=csv %s
+; RUN: FileCheck %s -check-prefix=CSV < %t.csv
+; RUN: rm -rf %t.cachedir
+; RUN: %lli -enable-cache-manager -cache-by-hash -object-cache-dir=%t.cachedir %s
+; RUN: %lli -enable-cache-manager -cache-by-hash -object-cache-dir=%t.cachedir -jit-stats-file=%t.cached.json %s
+; RUN: FileCheck %s -check-prefix=CACHED < %t.cached.json
+
+; JSON: {"module":"{{.*}}jit-compile-stats.ll","cached":false,"object_write_time":{{[0-9.]+}},"load_time":{{[0-9.]+}},"functions":[
+; JSON-SAME: {"name":"{{_?}}add","ir_time":{{[0-9.]+}},"isel_time":{{[0-9.]+}},"regalloc_time":{{[0-9.]+}},"post_ra_time":{{[0-9.]+}},"emission_time":{{[0-9.]+}},"code_size":{{[1-9][0-9]*}}},
+; JSON-SAME: {"name":"{{_?}}main",{{.*}}"code_size":{{[1-9][0-9]*}}}]}
+
+; CSV: module,function,ir_time,isel_time,regalloc_time,post_ra_time,emission_time,object_write_time,load_time,code_size
+; CSV-NEXT: {{.*}}jit-compile-stats.ll,{{_?}}add,{{[0-9.]+}},{{[0-9.]+}},{{[0-9.]+}},{{[0-9.]+}},{{[0-9.]+}},,,{{[1-9][0-9]*}}
+; CSV-NEXT: {{.*}}jit-compile-stats.ll,{{_?}}main,{{[0-9.,]+}},,,{{[1-9][0-9]*}}
+; CSV-NEXT: {{.*}}jit-compile-stats.ll,,,,,,,{{[0-9.]+}},{{[0-9.]+}},{{$}}
+
+; An object loaded from the cache has no code generation times, but its code
+; sizes are still reported.
+; CACHED: "cached":true,{{.*}}"functions":[{"name":"{{_?}}add","ir_time":0.000000,{{.*}}"code_size":{{[1-9][0-9]*}}},
+
+define i32 @add(i32 %a, i32 %b) {
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+define i32 @main() {
+  %r = call i32 @add(i32 0, i32 0)
+  ret i32 %r
+}
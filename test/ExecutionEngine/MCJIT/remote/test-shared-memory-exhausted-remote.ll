@@ -0,0 +1,12 @@
+; RUN: not %lli -remote-mcjit -remote-shared-memory=1 -mcjit-remote-process=lli-child-target%exeext %s 2>&1 | FileCheck %s
+
+; CHECK: shared memory exhausted
+
+@big = global [8192 x i8] zeroinitializer, align 16
+
+define i32 @main() nounwind {
+  %p = getelementptr inbounds [8192 x i8], [8192 x i8]* @big, i32 0, i32 0
+  %c = load i8, i8* %p, align 16
+  %r = zext i8 %c to i32
+  ret i32 %r
+}
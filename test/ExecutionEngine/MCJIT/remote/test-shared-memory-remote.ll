@@ -0,0 +1,26 @@
+; RUN: %lli -remote-mcjit -remote-shared-memory=1024 -O0 -mcjit-remote-process=lli-child-target%exeext %s
+
+; Code and data are relocated in place in memory shared with the child.
+
+@.str = private unnamed_addr constant [6 x i8] c"data1\00", align 1
+@ptr = global i8* getelementptr inbounds ([6 x i8], [6 x i8]* @.str, i32 0, i32 0), align 4
+@count = global i32 3, align 4
+
+define i32 @dec(i32 %x) nounwind {
+entry:
+  %r = sub i32 %x, 1
+  ret i32 %r
+}
+
+define i32 @main() nounwind {
+entry:
+  %0 = load i8*, i8** @ptr, align 4
+  %c = load i8, i8* %0, align 1
+  %isd = icmp eq i8 %c, 100
+  %1 = load i32, i32* @count, align 4
+  %2 = call i32 @dec(i32 %1)
+  %3 = call i32 @dec(i32 %2)
+  %4 = call i32 @dec(i32 %3)
+  %bad = select i1 %isd, i32 %4, i32 1
+  ret i32 %bad
+}
@@ -0,0 +1,43 @@
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-background-compile -orc-lazy-debug=funcs-to-stdout %s | FileCheck %s
+;
+; Check that each function is compiled once whether the background thread or
+; the caller gets to it first, and that functions the profile says are never
+; called are not compiled speculatively.
+;
+; CHECK: [ main ]
+; CHECK: [ foo ]
+; CHECK: [ bar ]
+; CHECK-NOT: [
+
+define i32 @bar(i32 %x) {
+entry:
+  %y = sub i32 %x, 1
+  ret i32 %y
+}
+
+define i32 @cold(i32 %x) !prof !0 {
+entry:
+  ret i32 %x
+}
+
+define i32 @foo(i32 %x) {
+entry:
+  %c = icmp eq i32 %x, 42
+  br i1 %c, label %unlikely, label %likely
+
+unlikely:
+  %r1 = call i32 @cold(i32 %x)
+  ret i32 %r1
+
+likely:
+  %r2 = call i32 @bar(i32 %x)
+  ret i32 %r2
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  %r = call i32 @foo(i32 1)
+  ret i32 %r
+}
+
+!0 = !{!"function_entry_count", i64 0}
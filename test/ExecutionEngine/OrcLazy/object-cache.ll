@@ -0,0 +1,25 @@
+; REQUIRES: asserts
+; RUN: rm -rf %t.cachedir
+; RUN: lli -jit-kind=orc-lazy -enable-cache-manager -object-cache-dir=%t.cachedir -debug-only=file-object-cache %s 2>&1 | FileCheck %s -check-prefix=MISS
+; RUN: lli -jit-kind=orc-lazy -enable-cache-manager -object-cache-dir=%t.cachedir -debug-only=file-object-cache %s 2>&1 | FileCheck %s -check-prefix=HIT
+;
+; Check that the functions compiled by a run are loaded from the cache by the
+; next one.
+;
+; MISS-DAG: Cache miss for {{.*}}.main (
+; MISS-DAG: Cache miss for {{.*}}.foo (
+; MISS-NOT: Cache hit
+; HIT-DAG: Cache hit for {{.*}}.main (
+; HIT-DAG: Cache hit for {{.*}}.foo (
+; HIT-NOT: Cache miss
+
+define i32 @foo() {
+entry:
+  ret i32 0
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  %r = call i32 @foo()
+  ret i32 %r
+}
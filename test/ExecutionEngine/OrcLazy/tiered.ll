@@ -0,0 +1,37 @@
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-tiered -orc-lazy-tier-up-threshold=100 -orc-lazy-debug=funcs-to-stdout %s | FileCheck %s
+;
+; Check that functions are first compiled at the baseline tier, that both a
+; function called often and one with a hot loop are compiled again once their
+; counters reach the threshold, and that the program still computes the right
+; result while the stubs are switched over.
+;
+; CHECK: [ main ]
+; CHECK: [ hot ]
+; CHECK-DAG: [ main ]
+; CHECK-DAG: [ hot ]
+
+define i32 @hot(i32 %x) {
+entry:
+  %y = mul i32 %x, 3
+  %z = add i32 %y, 1
+  ret i32 %z
+}
+
+define i32 @main(i32 %argc, i8** nocapture readnone %argv) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %h = call i32 @hot(i32 %i)
+  %acc.next = add i32 %acc, %h
+  %i.next = add i32 %i, 1
+  %done = icmp eq i32 %i.next, 1000
+  br i1 %done, label %exit, label %loop
+
+exit:
+  %ok = icmp eq i32 %acc.next, 1499500
+  %r = select i1 %ok, i32 0, i32 1
+  ret i32 %r
+}
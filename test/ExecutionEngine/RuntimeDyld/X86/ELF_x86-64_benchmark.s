@@ -0,0 +1,37 @@
+# RUN: llvm-mc -triple=x86_64-pc-linux -filetype=obj -o %t.o %s
+# RUN: llvm-rtdyld -benchmark -benchmark-copies=20 -benchmark-rounds=0 %t.o | FileCheck %s
+# RUN: llvm-rtdyld -benchmark -benchmark-copies=20 -benchmark-rounds=0 -benchmark-memory-manager=section %t.o | FileCheck %s -check-prefix=SECTION
+# Check that many copies of an object are packed in one slab of code and one
+# of data by the slab memory manager.
+
+# CHECK: copies: 20
+# CHECK-NEXT: slabs: 2
+# CHECK-NEXT: load:
+# CHECK-NEXT: finalize:
+# CHECK-NEXT: calls:
+# CHECK-NEXT: free:
+
+# SECTION: copies: 20
+# SECTION-NOT: slabs
+# SECTION: finalize:
+
+        .text
+        .globl  bench
+        .align  16, 0x90
+        .type   bench,@function
+bench:
+        movq    value(%rip), %rax
+        movq    %rax, counter(%rip)
+        retq
+.Lbench_end:
+        .size   bench, .Lbench_end-bench
+
+        .section        .rodata,"a",@progbits
+        .align  8
+value:
+        .quad   42
+
+        .data
+        .align  8
+counter:
+        .quad   0
@@ -0,0 +1,254 @@
+# RUN: llvm-mc -triple=x86_64-pc-linux -filetype=obj -o %T/test_ELF_lazy_symtab_x86-64.o %s
+# RUN: llvm-rtdyld -triple=x86_64-pc-linux -lazy-symbol-tables -verify -check=%s %T/test_ELF_lazy_symtab_x86-64.o
+
+# Look up more symbols than a lazy symbol table answers with a linear scan,
+# so that later lookups go through the sorted table.
+
+	.text
+	.globl	main
+	.align	16, 0x90
+	.type	main,@function
+main:
+# rtdyld-check: decode_operand(insn0, 0) = f0 - next_pc(insn0)
+insn0:
+	callq	f0
+# rtdyld-check: decode_operand(insn1, 0) = f1 - next_pc(insn1)
+insn1:
+	callq	f1
+# rtdyld-check: decode_operand(insn2, 0) = f2 - next_pc(insn2)
+insn2:
+	callq	f2
+# rtdyld-check: decode_operand(insn3, 0) = f3 - next_pc(insn3)
+insn3:
+	callq	f3
+# rtdyld-check: decode_operand(insn4, 0) = f4 - next_pc(insn4)
+insn4:
+	callq	f4
+# rtdyld-check: decode_operand(insn5, 0) = f5 - next_pc(insn5)
+insn5:
+	callq	f5
+# rtdyld-check: decode_operand(insn6, 0) = f6 - next_pc(insn6)
+insn6:
+	callq	f6
+# rtdyld-check: decode_operand(insn7, 0) = f7 - next_pc(insn7)
+insn7:
+	callq	f7
+# rtdyld-check: decode_operand(insn8, 0) = f8 - next_pc(insn8)
+insn8:
+	callq	f8
+# rtdyld-check: decode_operand(insn9, 0) = f9 - next_pc(insn9)
+insn9:
+	callq	f9
+# rtdyld-check: decode_operand(insn10, 0) = f10 - next_pc(insn10)
+insn10:
+	callq	f10
+# rtdyld-check: decode_operand(insn11, 0) = f11 - next_pc(insn11)
+insn11:
+	callq	f11
+# rtdyld-check: decode_operand(insn12, 0) = f12 - next_pc(insn12)
+insn12:
+	callq	f12
+# rtdyld-check: decode_operand(insn13, 0) = f13 - next_pc(insn13)
+insn13:
+	callq	f13
+# rtdyld-check: decode_operand(insn14, 0) = f14 - next_pc(insn14)
+insn14:
+	callq	f14
+# rtdyld-check: decode_operand(insn15, 0) = f15 - next_pc(insn15)
+insn15:
+	callq	f15
+# rtdyld-check: decode_operand(insn16, 0) = f16 - next_pc(insn16)
+insn16:
+	callq	f16
+# rtdyld-check: decode_operand(insn17, 0) = f17 - next_pc(insn17)
+insn17:
+	callq	f17
+# rtdyld-check: decode_operand(insn18, 0) = f18 - next_pc(insn18)
+insn18:
+	callq	f18
+# rtdyld-check: decode_operand(insn19, 0) = f19 - next_pc(insn19)
+insn19:
+	callq	f19
+# rtdyld-check: decode_operand(insn20, 0) = f20 - next_pc(insn20)
+insn20:
+	callq	f20
+# rtdyld-check: decode_operand(insn21, 0) = f21 - next_pc(insn21)
+insn21:
+	callq	f21
+# rtdyld-check: decode_operand(insn22, 0) = f22 - next_pc(insn22)
+insn22:
+	callq	f22
+# rtdyld-check: decode_operand(insn23, 0) = f23 - next_pc(insn23)
+insn23:
+	callq	f23
+	xorl	%eax, %eax
+	retq
+	.size	main, .-main
+
+	.globl	f0
+	.type	f0,@function
+f0:
+	movl	$0, %eax
+	retq
+	.size	f0, .-f0
+
+	.globl	f1
+	.type	f1,@function
+f1:
+	movl	$1, %eax
+	retq
+	.size	f1, .-f1
+
+	.globl	f2
+	.type	f2,@function
+f2:
+	movl	$2, %eax
+	retq
+	.size	f2, .-f2
+
+	.globl	f3
+	.type	f3,@function
+f3:
+	movl	$3, %eax
+	retq
+	.size	f3, .-f3
+
+	.globl	f4
+	.type	f4,@function
+f4:
+	movl	$4, %eax
+	retq
+	.size	f4, .-f4
+
+	.globl	f5
+	.type	f5,@function
+f5:
+	movl	$5, %eax
+	retq
+	.size	f5, .-f5
+
+	.globl	f6
+	.type	f6,@function
+f6:
+	movl	$6, %eax
+	retq
+	.size	f6, .-f6
+
+	.globl	f7
+	.type	f7,@function
+f7:
+	movl	$7, %eax
+	retq
+	.size	f7, .-f7
+
+	.globl	f8
+	.type	f8,@function
+f8:
+	movl	$8, %eax
+	retq
+	.size	f8, .-f8
+
+	.globl	f9
+	.type	f9,@function
+f9:
+	movl	$9, %eax
+	retq
+	.size	f9, .-f9
+
+	.globl	f10
+	.type	f10,@function
+f10:
+	movl	$10, %eax
+	retq
+	.size	f10, .-f10
+
+	.globl	f11
+	.type	f11,@function
+f11:
+	movl	$11, %eax
+	retq
+	.size	f11, .-f11
+
+	.globl	f12
+	.type	f12,@function
+f12:
+	movl	$12, %eax
+	retq
+	.size	f12, .-f12
+
+	.globl	f13
+	.type	f13,@function
+f13:
+	movl	$13, %eax
+	retq
+	.size	f13, .-f13
+
+	.globl	f14
+	.type	f14,@function
+f14:
+	movl	$14, %eax
+	retq
+	.size	f14, .-f14
+
+	.globl	f15
+	.type	f15,@function
+f15:
+	movl	$15, %eax
+	retq
+	.size	f15, .-f15
+
+	.globl	f16
+	.type	f16,@function
+f16:
+	movl	$16, %eax
+	retq
+	.size	f16, .-f16
+
+	.globl	f17
+	.type	f17,@function
+f17:
+	movl	$17, %eax
+	retq
+	.size	f17, .-f17
+
+	.globl	f18
+	.type	f18,@function
+f18:
+	movl	$18, %eax
+	retq
+	.size	f18, .-f18
+
+	.globl	f19
+	.type	f19,@function
+f19:
+	movl	$19, %eax
+	retq
+	.size	f19, .-f19
+
+	.globl	f20
+	.type	f20,@function
+f20:
+	movl	$20, %eax
+	retq
+	.size	f20, .-f20
+
+	.globl	f21
+	.type	f21,@function
+f21:
+	movl	$21, %eax
+	retq
+	.size	f21, .-f21
+
+	.globl	f22
+	.type	f22,@function
+f22:
+	movl	$22, %eax
+	retq
+	.size	f22, .-f22
+
+	.globl	f23
+	.type	f23,@function
+f23:
+	movl	$23, %eax
+	retq
+	.size	f23, .-f23
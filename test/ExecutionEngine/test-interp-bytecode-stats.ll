@@ -0,0 +1,26 @@
+; RUN: %lli -force-interpreter -stats %s 2>&1 | FileCheck %s
+; REQUIRES: asserts
+
+; @scalar only uses values that fit in a register and is translated to
+; bytecode. @vector is not, and is interpreted as IR; the two call each other.
+
+; CHECK: 2 interpreter - Number of functions run as bytecode
+
+define i32 @scalar(i32 %x) {
+  %y = mul i32 %x, 3
+  ret i32 %y
+}
+
+define i32 @vector(i32 %x) {
+  %v = insertelement <2 x i32> undef, i32 %x, i32 0
+  %w = add <2 x i32> %v, %v
+  %e = extractelement <2 x i32> %w, i32 0
+  %r = call i32 @scalar(i32 %e)
+  ret i32 %r
+}
+
+define i32 @main() {
+  %a = call i32 @vector(i32 1)
+  %b = sub i32 %a, 6
+  ret i32 %b
+}
@@ -0,0 +1,221 @@
+; RUN: %lli -force-interpreter %s | FileCheck %s
+; RUN: %lli -force-interpreter -interpreter-disable-bytecode %s | FileCheck %s
+
+; Check that functions translated to bytecode compute the same values as the
+; IR interpreter, including odd integer widths, wrapping signed division, NaN
+; comparisons, PHI nodes that swap values, switches and indirect calls.
+
+; CHECK: 4
+; CHECK-NEXT: 4
+; CHECK-NEXT: 4294967293
+; CHECK-NEXT: -128
+; CHECK-NEXT: -1
+; CHECK-NEXT: 1431655763
+; CHECK-NEXT: -9223372036854775808
+; CHECK-NEXT: -13
+; CHECK-NEXT: 1
+; CHECK-NEXT: 0
+; CHECK-NEXT: 1
+; CHECK-NEXT: 0
+; CHECK-NEXT: 1
+; CHECK-NEXT: 3.75
+; CHECK-NEXT: 1.5
+; CHECK-NEXT: -3
+; CHECK-NEXT: 65533
+; CHECK-NEXT: -3
+; CHECK-NEXT: 1065353216
+; CHECK-NEXT: 2
+; CHECK-NEXT: 0.1
+; CHECK-NEXT: -3
+; CHECK-NEXT: 4294967291
+; CHECK-NEXT: -7
+; CHECK-NEXT: 2.5
+; CHECK-NEXT: 1
+; CHECK-NEXT: 1
+; CHECK-NEXT: 8
+; CHECK-NEXT: 100
+; CHECK-NEXT: 2
+; CHECK-NEXT: 100
+; CHECK-NEXT: 42
+; CHECK-NEXT: 6765
+; CHECK-NEXT: 11
+
+@fmt = private constant [6 x i8] c"%lld\0A\00"
+@ffmt = private constant [4 x i8] c"%g\0A\00"
+@g16 = global i16 -3
+@arr = global [4 x i32] [i32 10, i32 20, i32 30, i32 40]
+%S = type { i8, i64, double }
+@s = global %S { i8 1, i64 -7, double 2.5 }
+@fp = global i64 (i64)* @twice
+
+declare i32 @printf(i8*, ...)
+
+define i64 @twice(i64 %x) {
+  %r = shl i64 %x, 1
+  ret i64 %r
+}
+
+define void @p(i64 %v) {
+  %f = getelementptr [6 x i8], [6 x i8]* @fmt, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %f, i64 %v)
+  ret void
+}
+
+define void @pf(double %v) {
+  %f = getelementptr [4 x i8], [4 x i8]* @ffmt, i32 0, i32 0
+  call i32 (i8*, ...) @printf(i8* %f, double %v)
+  ret void
+}
+
+define i64 @fib(i64 %n) {
+  %c = icmp slt i64 %n, 2
+  br i1 %c, label %base, label %rec
+base:
+  ret i64 %n
+rec:
+  %a = sub i64 %n, 1
+  %b = sub i64 %n, 2
+  %fa = call i64 @fib(i64 %a)
+  %fb = call i64 @fib(i64 %b)
+  %s = add i64 %fa, %fb
+  ret i64 %s
+}
+
+define i32 @main() {
+entry:
+  ; odd widths
+  %a = add i17 131071, 5
+  %a64 = zext i17 %a to i64
+  call void @p(i64 %a64)
+  %b = sext i17 %a to i64
+  call void @p(i64 %b)
+  %c = mul i33 4294967295, 3
+  %c64 = sext i33 %c to i64
+  call void @p(i64 %c64)
+  ; signed division edge cases
+  %d = sdiv i8 -128, -1
+  %d64 = sext i8 %d to i64
+  call void @p(i64 %d64)
+  %e = srem i32 -7, 3
+  %e64 = sext i32 %e to i64
+  call void @p(i64 %e64)
+  %e2 = udiv i32 -7, 3
+  %e2z = zext i32 %e2 to i64
+  call void @p(i64 %e2z)
+  %e3 = sdiv i64 -9223372036854775808, -1
+  call void @p(i64 %e3)
+  ; shifts
+  %sh4 = ashr i64 -100, 3
+  call void @p(i64 %sh4)
+  ; comparisons
+  %c1 = icmp slt i8 -1, 1
+  %c1z = zext i1 %c1 to i64
+  call void @p(i64 %c1z)
+  %c2 = icmp ult i8 -1, 1
+  %c2z = zext i1 %c2 to i64
+  call void @p(i64 %c2z)
+  %nan = fdiv double 0.0, 0.0
+  %c3 = fcmp uno double %nan, 1.0
+  %c3z = zext i1 %c3 to i64
+  call void @p(i64 %c3z)
+  %c4 = fcmp one double %nan, 1.0
+  %c4z = zext i1 %c4 to i64
+  call void @p(i64 %c4z)
+  %c5 = fcmp ueq double %nan, 1.0
+  %c5z = zext i1 %c5 to i64
+  call void @p(i64 %c5z)
+  ; fp
+  %f1 = fadd float 1.5, 2.25
+  %f1d = fpext float %f1 to double
+  call void @pf(double %f1d)
+  %f2 = frem double 7.5, 2.0
+  call void @pf(double %f2)
+  %f3 = sitofp i16 -3 to double
+  call void @pf(double %f3)
+  %f4 = uitofp i16 -3 to float
+  %f4d = fpext float %f4 to double
+  call void @pf(double %f4d)
+  %f5 = fptosi double -3.75 to i32
+  %f5s = sext i32 %f5 to i64
+  call void @p(i64 %f5s)
+  %f6 = bitcast float 1.0 to i32
+  %f6z = zext i32 %f6 to i64
+  call void @p(i64 %f6z)
+  %f7 = bitcast i64 4611686018427387904 to double
+  call void @pf(double %f7)
+  %f8 = fptrunc double 0.1 to float
+  %f8d = fpext float %f8 to double
+  call void @pf(double %f8d)
+  ; memory
+  %l16 = load i16, i16* @g16
+  %l16s = sext i16 %l16 to i64
+  call void @p(i64 %l16s)
+  %ai = alloca i32, i32 3
+  %ai2 = getelementptr i32, i32* %ai, i32 2
+  store i32 -5, i32* %ai2
+  %ai2l = load i32, i32* %ai2
+  %ai2z = zext i32 %ai2l to i64
+  call void @p(i64 %ai2z)
+  %sf = getelementptr %S, %S* @s, i32 0, i32 1
+  %sv = load i64, i64* %sf
+  call void @p(i64 %sv)
+  %sd = getelementptr %S, %S* @s, i32 0, i32 2
+  %sdv = load double, double* %sd
+  call void @pf(double %sdv)
+  %b1 = alloca i1
+  store i1 true, i1* %b1
+  %b1l = load i1, i1* %b1
+  %b1z = zext i1 %b1l to i64
+  call void @p(i64 %b1z)
+  %pp = alloca i32*
+  store i32* %ai, i32** %pp
+  %ppl = load i32*, i32** %pp
+  %eq = icmp eq i32* %ppl, %ai
+  %eqz = zext i1 %eq to i64
+  call void @p(i64 %eqz)
+  %pi = ptrtoint i32* %ai2 to i64
+  %pi0 = ptrtoint i32* %ai to i64
+  %pd = sub i64 %pi, %pi0
+  call void @p(i64 %pd)
+  ; loop with phis over array and a phi swap
+  br label %loop
+loop:
+  %i = phi i32 [ 0, %entry ], [ %inext, %loop ]
+  %sum = phi i32 [ 0, %entry ], [ %sum2, %loop ]
+  %x = phi i64 [ 1, %entry ], [ %y, %loop ]
+  %y = phi i64 [ 2, %entry ], [ %x, %loop ]
+  %ep = getelementptr [4 x i32], [4 x i32]* @arr, i32 0, i32 %i
+  %ev = load i32, i32* %ep
+  %sum2 = add i32 %sum, %ev
+  %inext = add i32 %i, 1
+  %done = icmp eq i32 %inext, 4
+  br i1 %done, label %out, label %loop
+out:
+  %sumz = zext i32 %sum2 to i64
+  call void @p(i64 %sumz)
+  call void @p(i64 %x)
+  ; switch
+  %sw = trunc i64 %sumz to i8
+  switch i8 %sw, label %def [ i8 100, label %hundred
+                              i8 7, label %seven ]
+hundred:
+  %ph = phi i64 [ 100, %out ]
+  call void @p(i64 %ph)
+  br label %after
+seven:
+  call void @p(i64 7)
+  br label %after
+def:
+  call void @p(i64 -1)
+  br label %after
+after:
+  ; indirect call and recursion
+  %fpl = load i64 (i64)*, i64 (i64)** @fp
+  %tw = call i64 %fpl(i64 21)
+  call void @p(i64 %tw)
+  %fb = call i64 @fib(i64 20)
+  call void @p(i64 %fb)
+  %sel = select i1 %c1, i64 11, i64 22
+  call void @p(i64 %sel)
+  ret i32 0
+}
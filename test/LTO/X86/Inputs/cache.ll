@@ -0,0 +1,6 @@
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @callee(i32 %x) {
+  %y = add i32 %x, 41
+  ret i32 %y
+}
@@ -0,0 +1,15 @@
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @callee(i32 %x) {
+  %y = add i32 %x, 41
+  ret i32 %y
+}
+
+define i32 @uses_local() {
+  %r = call i32 @local()
+  ret i32 %r
+}
+
+define internal i32 @local() {
+  ret i32 7
+}
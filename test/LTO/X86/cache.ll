@@ -0,0 +1,45 @@
+; REQUIRES: asserts
+; RUN: rm -rf %t.cache %t.thincache
+; RUN: llvm-as -function-summary -o %t1.bc %s
+; RUN: llvm-as -function-summary -o %t2.bc %p/Inputs/cache.ll
+
+; The first link populates the cache; relinking takes the object from it.
+; RUN: llvm-lto -exported-symbol=main -cache-dir=%t.cache -o %t.o %t1.bc %t2.bc \
+; RUN:   -debug-only=lto-object-cache 2>&1 | FileCheck --check-prefix=MISS %s
+; RUN: llvm-lto -exported-symbol=main -cache-dir=%t.cache -o %t2.o %t1.bc %t2.bc \
+; RUN:   -debug-only=lto-object-cache 2>&1 | FileCheck --check-prefix=HIT %s
+; RUN: cmp %t.o %t2.o
+; RUN: ls %t.cache | FileCheck --check-prefix=ENTRIES %s
+
+; Different options produce a different entry.
+; RUN: llvm-lto -exported-symbol=main -cache-dir=%t.cache -O1 -o %t3.o \
+; RUN:   %t1.bc %t2.bc -debug-only=lto-object-cache 2>&1 \
+; RUN:   | FileCheck --check-prefix=MISS %s
+
+; In thin mode, each module has its own entry.
+; RUN: llvm-lto -thinlto -cache-dir=%t.thincache -o %t4.o %t1.bc %t2.bc \
+; RUN:   -debug-only=lto-object-cache 2>&1 | FileCheck --check-prefix=MISS %s
+; RUN: llvm-lto -thinlto -cache-dir=%t.thincache -o %t5.o %t1.bc %t2.bc \
+; RUN:   -debug-only=lto-object-cache 2>&1 \
+; RUN:   | FileCheck --check-prefix=HIT --check-prefix=HIT2 %s
+; RUN: cmp %t4.o.0 %t5.o.0
+; RUN: cmp %t4.o.1 %t5.o.1
+
+; MISS-NOT: Cache hit
+; MISS: Cache miss for
+; MISS-NOT: Cache hit
+; HIT-NOT: Cache miss
+; HIT: Cache hit for
+; HIT2: Cache hit for
+; HIT-NOT: Cache miss
+; ENTRIES: llvmcache-{{[0-9a-f]+$}}
+; ENTRIES: llvmcache.timestamp
+
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @main() {
+  %r = call i32 @callee(i32 1)
+  ret i32 %r
+}
+
+declare i32 @callee(i32)
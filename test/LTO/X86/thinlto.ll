@@ -0,0 +1,42 @@
+; Check that summary-based LTO compiles each module into its own object file.
+; Importing itself is tested in test/Transforms/FunctionImport.
+; RUN: llvm-as -function-summary -o %t1.bc %s
+; RUN: llvm-as -function-summary -o %t2.bc %p/Inputs/thinlto.ll
+; RUN: llvm-lto -thinlto -j2 -o %t.o %t1.bc %t2.bc
+; RUN: llvm-nm %t.o.0 | FileCheck --check-prefix=NM0 %s
+; RUN: llvm-nm %t.o.1 | FileCheck --check-prefix=NM1 %s
+
+; Modules without a summary have one computed for them.
+; RUN: llvm-as -o %t3.bc %p/Inputs/thinlto.ll
+; RUN: llvm-lto -thinlto -o %t4.o %t1.bc %t3.bc
+; RUN: llvm-nm %t4.o.0 | FileCheck --check-prefix=NM0 %s
+
+; The thin link alone writes the combined index.
+; RUN: llvm-lto -thinlto-index-only -o %t.thinlto.bc %t1.bc %t2.bc
+; RUN: llvm-bcanalyzer -dump %t.thinlto.bc | FileCheck --check-prefix=INDEX %s
+
+target triple = "x86_64-unknown-linux-gnu"
+
+; Imported definitions are not emitted again.
+; NM0-NOT: T callee
+; NM0: T main
+; NM0: U uses_local
+; NM0-NOT: T callee
+define i32 @main() {
+  %a = call i32 @callee(i32 1)
+  %b = call i32 @uses_local()
+  %c = add i32 %a, %b
+  ret i32 %c
+}
+
+declare i32 @callee(i32)
+declare i32 @uses_local()
+
+; NM1: T callee
+; NM1: T uses_local
+
+; INDEX: <MODULE_STRTAB_BLOCK
+; INDEX-NEXT: <ENTRY op0=0 {{.*}}/>
+; INDEX-NEXT: <ENTRY op0=1 {{.*}}/>
+; INDEX-NEXT: </MODULE_STRTAB_BLOCK>
+; INDEX: <FUNCTION_SUMMARY_BLOCK
@@ -0,0 +1,27 @@
+// RUN: llvm-mc -filetype=obj -triple x86_64-pc-linux-gnu %s -o - | llvm-readobj -s -sd | FileCheck %s
+
+// The .uleb128 is laid out before the jump in the section created after it is
+// relaxed. Relaxing the jump moves the labels apart, so the .uleb128 has to be
+// looked at again and grows to two bytes.
+
+// CHECK:      Name: .data
+// CHECK:      Size: 3
+// CHECK:      SectionData (
+// CHECK-NEXT:   0000: 8101FF
+// CHECK-NEXT: )
+
+// CHECK:      Name: .text.foo
+// CHECK:      Size: 134
+
+	.data
+	.uleb128 .Lend - .Lstart
+	.byte 0xff
+
+	.section .text.foo,"ax",@progbits
+.Lstart:
+	jmp .Ltarget
+	.fill 124, 1, 0x90
+.Lend:
+	.fill 4, 1, 0x90
+.Ltarget:
+	ret
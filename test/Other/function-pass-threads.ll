@@ -0,0 +1,61 @@
+; RUN: opt < %s -O1 -S > %t.serial
+; RUN: opt < %s -O1 -function-pass-threads=4 -S > %t.parallel
+; RUN: diff %t.serial %t.parallel
+; RUN: FileCheck %s < %t.parallel
+
+; The function passes run on each partition see through the constants that
+; another partition defines, and the layout of the module is preserved.
+
+; CHECK: @table = constant [2 x i32] [i32 7, i32 9]
+; CHECK: @llvm.global_ctors = appending global [2 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @ctor1, i8* null }, { i32, void ()*, i8* } { i32 65535, void ()* @ctor0, i8* null }]
+@table = constant [2 x i32] [i32 7, i32 9]
+@llvm.global_ctors = appending global [2 x { i32, void ()*, i8* }] [{ i32, void ()*, i8* } { i32 65535, void ()* @ctor1, i8* null }, { i32, void ()*, i8* } { i32 65535, void ()* @ctor0, i8* null }]
+declare void @init(i32)
+
+; CHECK-LABEL: define void @ctor0()
+define void @ctor0() {
+  call void @init(i32 1)
+  ret void
+}
+
+; CHECK-LABEL: define void @ctor1()
+define void @ctor1() {
+  call void @init(i32 2)
+  ret void
+}
+
+; CHECK-LABEL: define internal fastcc i32 @helper(i32 %x)
+; CHECK-NEXT: %r = add i32 %x, 1
+define internal i32 @helper(i32 %x) noinline {
+  %p = alloca i32
+  store i32 %x, i32* %p
+  %v = load i32, i32* %p
+  %r = add i32 %v, 1
+  ret i32 %r
+}
+
+; CHECK-LABEL: define i32 @f(i32 %x)
+; CHECK-NEXT: call fastcc i32 @helper(i32 %x)
+define i32 @f(i32 %x) {
+  %p = alloca i32
+  store i32 %x, i32* %p
+  %v = load i32, i32* %p
+  %h = call i32 @helper(i32 %v)
+  ret i32 %h
+}
+
+; CHECK-LABEL: define i32 @g1()
+; CHECK-NEXT: ret i32 9
+define i32 @g1() {
+  %t = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 1
+  %v = load i32, i32* %t
+  ret i32 %v
+}
+
+; CHECK-LABEL: define i32 @g2()
+; CHECK-NEXT: ret i32 7
+define i32 @g2() {
+  %t = getelementptr [2 x i32], [2 x i32]* @table, i32 0, i32 0
+  %v = load i32, i32* %t
+  ret i32 %v
+}
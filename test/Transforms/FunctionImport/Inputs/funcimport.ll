@@ -0,0 +1,33 @@
+@gv = global i32 42
+
+define void @importable() {
+  call void @importable_callee()
+  ret void
+}
+
+define linkonce_odr void @importable_callee() {
+  store i32 1, i32* @gv
+  ret void
+}
+
+define void @refs_local() {
+  call void @local()
+  ret void
+}
+
+define internal void @local() {
+  ret void
+}
+
+define weak void @weak_func() {
+  ret void
+}
+
+define void @large() {
+  call void @importable()
+  call void @importable()
+  call void @importable()
+  call void @importable()
+  call void @importable()
+  ret void
+}
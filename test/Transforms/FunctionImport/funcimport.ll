@@ -0,0 +1,32 @@
+; RUN: llvm-as -function-summary %s -o %t.bc
+; RUN: llvm-as -function-summary %p/Inputs/funcimport.ll -o %t2.bc
+; RUN: llvm-lto -thinlto-index-only -o %t3.thinlto.bc %t.bc %t2.bc
+; RUN: opt -function-import -summary-file %t3.thinlto.bc %t.bc -S | FileCheck %s
+; RUN: opt -function-import -summary-file %t3.thinlto.bc -import-instr-limit=5 %t.bc -S | FileCheck %s --check-prefix=LIMIT
+
+define void @main() {
+  call void @importable()
+  call void @refs_local()
+  call void @weak_func()
+  call void @large()
+  ret void
+}
+
+declare void @importable()
+declare void @refs_local()
+declare void @weak_func()
+declare void @large()
+
+; Imported functions are available_externally, and functions they call are
+; imported as well.
+; CHECK-DAG: define available_externally void @importable()
+; CHECK-DAG: define available_externally void @importable_callee()
+; CHECK-DAG: @gv = external global i32
+
+; Functions referring to locals of their module and functions that may be
+; overridden at link time are not imported.
+; CHECK-DAG: declare void @refs_local()
+; CHECK-DAG: declare void @weak_func()
+
+; LIMIT-DAG: define available_externally void @importable()
+; LIMIT-DAG: declare void @large()
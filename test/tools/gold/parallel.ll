@@ -0,0 +1,23 @@
+; RUN: llvm-as -o %t.bc %s
+; RUN: %gold -plugin %llvmshlibdir/LLVMgold.so -u foo -u bar \
+; RUN:    -plugin-opt=jobs=2 -plugin-opt=obj-path=%t.o -r -o %t2.o %t.bc
+; RUN: llvm-nm %t.o | FileCheck --check-prefix=CHECK0 %s
+; RUN: llvm-nm %t.o.1 | FileCheck --check-prefix=CHECK1 %s
+
+target triple = "x86_64-unknown-linux-gnu"
+
+; CHECK0-NOT: T bar
+; CHECK0: T foo
+; CHECK0-NOT: T bar
+define void @foo() {
+  call void @bar()
+  ret void
+}
+
+; CHECK1-NOT: T foo
+; CHECK1: T bar
+; CHECK1-NOT: T foo
+define void @bar() {
+  call void @foo()
+  ret void
+}
@@ -14,20 +14,24 @@
 
 #include "llvm/Config/config.h" // plugin-api.h requires HAVE_STDINT_H
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/Analysis.h"
 #include "llvm/CodeGen/CommandFlags.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/IRObjectFile.h"
@@ -92,6 +96,17 @@ namespace options {
   static bool generate_api_file = false;
   static OutputType TheOutputType = OT_NORMAL;
   static unsigned OptLevel = 2;
+  // Number of threads, and of object files, used for code generation.
+  static unsigned Parallelism = 1;
+  // Use summary-based LTO: compile each module separately after importing
+  // functions from the others, instead of linking them all together.
+  static bool thinlto = false;
+  // Directory caching the objects produced in thinlto mode, and its pruning
+  // policy: see ThinLTOCodeGenerator.
+  static std::string cache_dir;
+  static unsigned cache_pruning_interval = 1200;
+  static unsigned cache_entry_expiration = 7 * 24 * 3600;
+  static uint64_t cache_max_size = 0;
   static std::string obj_path;
   static std::string extra_library_path;
   static std::string triple;
@@ -129,6 +144,29 @@ namespace options {
       if (opt[1] < '0' || opt[1] > '3')
         report_fatal_error("Optimization level must be between 0 and 3");
       OptLevel = opt[1] - '0';
+    } else if (opt == "thinlto") {
+      thinlto = true;
+    } else if (opt.startswith("cache-dir=")) {
+      cache_dir = opt.substr(strlen("cache-dir="));
+    } else if (opt.startswith("cache-pruning-interval=")) {
+      if (opt.substr(strlen("cache-pruning-interval="))
+              .getAsInteger(10, cache_pruning_interval))
+        message(LDPL_FATAL, "Invalid cache pruning interval: %s",
+                opt_ + strlen("cache-pruning-interval="));
+    } else if (opt.startswith("cache-entry-expiration=")) {
+      if (opt.substr(strlen("cache-entry-expiration="))
+              .getAsInteger(10, cache_entry_expiration))
+        message(LDPL_FATAL, "Invalid cache entry expiration: %s",
+                opt_ + strlen("cache-entry-expiration="));
+    } else if (opt.startswith("cache-max-size=")) {
+      if (opt.substr(strlen("cache-max-size=")).getAsInteger(10, cache_max_size))
+        message(LDPL_FATAL, "Invalid cache size: %s",
+                opt_ + strlen("cache-max-size="));
+    } else if (opt.startswith("jobs=")) {
+      if (opt.substr(strlen("jobs=")).getAsInteger(10, Parallelism) ||
+          Parallelism == 0)
+        message(LDPL_FATAL, "Invalid parallelism level: %s",
+                opt_ + strlen("jobs="));
     } else {
       // Save this option to pass to the code generator.
       // ParseCommandLineOptions() expects argv[0] to be program name. Lazily
@@ -784,45 +822,152 @@ static void codegen(Module &M) {
   if (options::TheOutputType == options::OT_SAVE_TEMPS)
     saveBCFile(output_name + ".opt.bc", M);
 
-  legacy::PassManager CodeGenPasses;
-
-  SmallString<128> Filename;
+  std::string BaseFilename;
   if (!options::obj_path.empty())
-    Filename = options::obj_path;
+    BaseFilename = options::obj_path;
   else if (options::TheOutputType == options::OT_SAVE_TEMPS)
-    Filename = output_name + ".o";
+    BaseFilename = output_name + ".o";
+  bool TempOutFile = BaseFilename.empty();
+
+  // With jobs=N the module is split into N partitions, each code generated on
+  // its own thread into its own object file. Partition I > 0 of a named output
+  // is written to <name>.I.
+  std::vector<std::string> Filenames;
+  {
+    std::list<raw_fd_ostream> OSs;
+    std::vector<raw_pwrite_stream *> OSPtrs;
+    for (unsigned I = 0; I != options::Parallelism; ++I) {
+      SmallString<128> Filename;
+      int FD;
+      if (TempOutFile) {
+        std::error_code EC =
+            sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+        if (EC)
+          message(LDPL_FATAL, "Could not create temporary file: %s",
+                  EC.message().c_str());
+      } else {
+        Filename = BaseFilename;
+        if (I != 0)
+          Filename += "." + utostr(I);
+        std::error_code EC =
+            sys::fs::openFileForWrite(Filename.c_str(), FD, sys::fs::F_None);
+        if (EC)
+          message(LDPL_FATAL, "Could not open file: %s",
+                  EC.message().c_str());
+      }
+      Filenames.push_back(Filename.str());
+      OSs.emplace_back(FD, true);
+      OSPtrs.push_back(&OSs.back());
+    }
+
+    if (!splitCodeGen(M, OSPtrs, options::mcpu, Features.getString(), Options,
+                      RelocationModel, CodeModel::Default, CGOptLevel,
+                      TargetMachine::CGFT_ObjectFile, ErrMsg))
+      message(LDPL_FATAL, "Failed to setup codegen: %s", ErrMsg.c_str());
+  }
+
+  for (const std::string &Filename : Filenames) {
+    if (add_input_file(Filename.c_str()) != LDPS_OK)
+      message(LDPL_FATAL,
+              "Unable to add .o file to the link. File left behind in: %s",
+              Filename.c_str());
+
+    if (TempOutFile)
+      Cleanup.push_back(Filename);
+  }
+}
+
+/// Compile the claimed files with summary-based LTO. Every module is imported
+/// into, optimized and code generated on its own, jobs=N at a time, and each
+/// resulting object file is added to the link. Since the modules are never
+/// linked together, nothing is internalized: the objects are resolved by the
+/// linker like any other.
+static void thinLTOLink() {
+  if (unsigned NumOpts = options::extra.size())
+    cl::ParseCommandLineOptions(NumOpts, &options::extra[0]);
+
+  SubtargetFeatures Features;
+  for (const std::string &A : MAttrs)
+    Features.AddFeature(A);
+
+  ThinLTOCodeGenerator CodeGen;
+  CodeGen.setTargetOptions(InitTargetOptionsFromCodeGenFlags());
+  CodeGen.setCpu(options::mcpu);
+  CodeGen.setAttr(Features.getString());
+  CodeGen.setCodePICModel(RelocationModel);
+  CodeGen.setOptLevel(options::OptLevel);
+  CodeGen.setParallelism(options::Parallelism);
+  CodeGen.setCacheDir(options::cache_dir);
+  CodeGen.setCachePruningInterval(options::cache_pruning_interval);
+  CodeGen.setCacheEntryExpiration(options::cache_entry_expiration);
+  CodeGen.setMaxCacheSize(options::cache_max_size);
+
+  for (claimed_file &F : Modules) {
+    ld_plugin_input_file File;
+    if (get_input_file(F.handle, &File) != LDPS_OK)
+      message(LDPL_FATAL, "Failed to get file information");
+    const void *View;
+    if (get_view(F.handle, &View) != LDPS_OK)
+      message(LDPL_FATAL, "Failed to get a view of file");
+    CodeGen.addModule(File.name, StringRef((const char *)View, File.filesize));
+  }
 
-  int FD;
-  bool TempOutFile = Filename.empty();
-  if (TempOutFile) {
-    std::error_code EC =
-        sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+  std::string ErrMsg;
+  if (options::TheOutputType == options::OT_SAVE_TEMPS) {
+    std::unique_ptr<FunctionInfoIndex> Index =
+        CodeGen.linkCombinedIndex(ErrMsg);
+    if (!Index)
+      message(LDPL_FATAL, "Failed to link function summaries: %s",
+              ErrMsg.c_str());
+    std::error_code EC;
+    raw_fd_ostream OS(output_name + ".thinlto.bc", EC, sys::fs::F_None);
     if (EC)
-      message(LDPL_FATAL, "Could not create temporary file: %s",
+      message(LDPL_FATAL, "Failed to write the combined index: %s",
               EC.message().c_str());
-  } else {
-    std::error_code EC =
-        sys::fs::openFileForWrite(Filename.c_str(), FD, sys::fs::F_None);
-    if (EC)
-      message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
+    WriteFunctionSummaryToFile(*Index, OS);
   }
 
-  {
-    raw_fd_ostream OS(FD, true);
+  if (!CodeGen.run(ErrMsg))
+    message(LDPL_FATAL, "ThinLTO compilation failed: %s", ErrMsg.c_str());
 
-    if (TM->addPassesToEmitFile(CodeGenPasses, OS,
-                                TargetMachine::CGFT_ObjectFile))
-      message(LDPL_FATAL, "Failed to setup codegen");
-    CodeGenPasses.run(M);
-  }
+  for (claimed_file &F : Modules)
+    if (release_input_file(F.handle) != LDPS_OK)
+      message(LDPL_FATAL, "Failed to release file information");
 
-  if (add_input_file(Filename.c_str()) != LDPS_OK)
-    message(LDPL_FATAL,
-            "Unable to add .o file to the link. File left behind in: %s",
-            Filename.c_str());
+  std::string BaseFilename;
+  if (!options::obj_path.empty())
+    BaseFilename = options::obj_path;
+  else if (options::TheOutputType == options::OT_SAVE_TEMPS)
+    BaseFilename = output_name + ".o";
+  bool TempOutFile = BaseFilename.empty();
+
+  // The object of module I is written to <name>.I.
+  std::vector<std::unique_ptr<MemoryBuffer>> &Objects =
+      CodeGen.getProducedBinaries();
+  for (unsigned I = 0, E = Objects.size(); I != E; ++I) {
+    SmallString<128> Filename;
+    int FD;
+    std::error_code EC;
+    if (TempOutFile) {
+      EC = sys::fs::createTemporaryFile("lto-llvm", "o", FD, Filename);
+    } else {
+      Filename = BaseFilename + "." + utostr(I);
+      EC = sys::fs::openFileForWrite(Filename.c_str(), FD, sys::fs::F_None);
+    }
+    if (EC)
+      message(LDPL_FATAL, "Could not open file: %s", EC.message().c_str());
+    {
+      raw_fd_ostream OS(FD, true);
+      OS << Objects[I]->getBuffer();
+    }
 
-  if (TempOutFile)
-    Cleanup.push_back(Filename.c_str());
+    if (add_input_file(Filename.c_str()) != LDPS_OK)
+      message(LDPL_FATAL,
+              "Unable to add .o file to the link. File left behind in: %s",
+              Filename.c_str());
+    if (TempOutFile)
+      Cleanup.push_back(Filename.str());
+  }
 }
 
 /// gold informs us that all symbols have been read. At this point, we use
@@ -832,6 +977,16 @@ static ld_plugin_status allSymbolsReadHook(raw_fd_ostream *ApiFile) {
   if (Modules.empty())
     return LDPS_OK;
 
+  if (options::thinlto) {
+    if (options::TheOutputType == options::OT_DISABLE)
+      return LDPS_OK;
+    thinLTOLink();
+    if (!options::extra_library_path.empty() &&
+        set_extra_library_path(options::extra_library_path.c_str()) != LDPS_OK)
+      message(LDPL_FATAL, "Unable to set the extra library path.");
+    return LDPS_OK;
+  }
+
   LLVMContext Context;
   Context.setDiagnosticHandler(diagnosticHandler, nullptr, true);
 
@@ -15,12 +15,14 @@
 
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/Triple.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/LinkAllAsmWriterComponents.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
 #include "llvm/CodeGen/MIRParser/MIRParser.h"
+#include "llvm/CodeGen/ParallelCG.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
@@ -96,11 +98,17 @@ static cl::opt<bool> AsmVerbose("asm-verbose",
                                 cl::desc("Add comments to directives."),
                                 cl::init(true));
 
+static cl::opt<unsigned>
+Parallelism("j", cl::Prefix, cl::init(1),
+            cl::desc("Split the module and code generate the partitions on "
+                     "this many threads, writing partition I to "
+                     "<output>.I"));
+
 static int compileModule(char **, LLVMContext &);
 
 static std::unique_ptr<tool_output_file>
 GetOutputStream(const char *TargetName, Triple::OSType OS,
-                const char *ProgName) {
+                const char *ProgName, StringRef Suffix = "") {
   // If we don't yet have an output filename, make one.
   if (OutputFilename.empty()) {
     if (InputFilename == "-")
@@ -156,8 +164,8 @@ GetOutputStream(const char *TargetName, Triple::OSType OS,
   sys::fs::OpenFlags OpenFlags = sys::fs::F_None;
   if (!Binary)
     OpenFlags |= sys::fs::F_Text;
-  auto FDOut = llvm::make_unique<tool_output_file>(OutputFilename, EC,
-                                                   OpenFlags);
+  std::string Filename = (OutputFilename + Suffix).str();
+  auto FDOut = llvm::make_unique<tool_output_file>(Filename, EC, OpenFlags);
   if (EC) {
     errs() << EC.message() << '\n';
     return nullptr;
@@ -206,6 +214,55 @@ int main(int argc, char **argv) {
   return 0;
 }
 
+// Split M into Parallelism partitions, code generate each of them on its own
+// thread, and write partition I to <OutputFilename>.I.
+static int compileModuleInParallel(char **argv, Module &M,
+                                   const Target *TheTarget,
+                                   const Triple &TheTriple, StringRef CPUStr,
+                                   StringRef FeaturesStr,
+                                   const TargetOptions &Options,
+                                   CodeGenOpt::Level OLvl) {
+  if (StringRef(InputFilename).endswith_lower(".mir") || !StartAfter.empty() ||
+      !StopAfter.empty() || DisableSimplifyLibCalls) {
+    errs() << argv[0] << ": -j cannot be used with MIR input, -start-after, "
+           << "-stop-after or -disable-simplify-libcalls\n";
+    return 1;
+  }
+  if (OutputFilename == "-" ||
+      (OutputFilename.empty() && InputFilename == "-")) {
+    errs() << argv[0] << ": -j cannot write to standard output\n";
+    return 1;
+  }
+
+  // The partitions are code generated for the module's triple, so it has to
+  // include any -march override.
+  M.setTargetTriple(TheTriple.getTriple());
+
+  std::vector<std::unique_ptr<tool_output_file>> Outs;
+  std::vector<raw_pwrite_stream *> OSPtrs;
+  for (unsigned I = 0; I != Parallelism; ++I) {
+    Outs.push_back(GetOutputStream(TheTarget->getName(), TheTriple.getOS(),
+                                   argv[0], "." + utostr(I)));
+    if (!Outs.back())
+      return 1;
+    OSPtrs.push_back(&Outs.back()->os());
+  }
+
+  // Before executing passes, print the final values of the LLVM options.
+  cl::PrintOptionValues();
+
+  std::string ErrMsg;
+  if (!splitCodeGen(M, OSPtrs, CPUStr, FeaturesStr, Options, RelocModel,
+                    CMModel, OLvl, FileType, ErrMsg)) {
+    errs() << argv[0] << ": " << ErrMsg << "\n";
+    return 1;
+  }
+
+  for (auto &Out : Outs)
+    Out->keep();
+  return 0;
+}
+
 static int compileModule(char **argv, LLVMContext &Context) {
   // Load the module to be compiled...
   SMDiagnostic Err;
@@ -295,6 +352,14 @@ static int compileModule(char **argv, LLVMContext &Context) {
   if (FloatABIForCalls != FloatABI::Default)
     Options.FloatABIType = FloatABIForCalls;
 
+  if (Parallelism > 1) {
+    if (const DataLayout *DL = Target->getDataLayout())
+      M->setDataLayout(*DL);
+    setFunctionAttributes(CPUStr, FeaturesStr, *M);
+    return compileModuleInParallel(argv, *M, TheTarget, TheTriple, CPUStr,
+                                   FeaturesStr, Options, OLvl);
+  }
+
   // Figure out where we are going to send the output.
   std::unique_ptr<tool_output_file> Out =
       GetOutputStream(TheTarget->getName(), TheTriple.getOS(), argv[0]);
@@ -24,6 +24,8 @@ private:
   void handleAllocateSpace();
   void handleLoadSection(bool IsCode);
   void handleExecute();
+  void handleMapSharedMemory();
+  void handleFinalizeSections();
 
   // Outgoing message handlers
   void sendChildActive();
@@ -85,6 +87,12 @@ void LLIChildTarget::handleMessage(LLIMessageType messageType) {
     case LLI_Execute:
       handleExecute();
       break;
+    case LLI_MapSharedMemory:
+      handleMapSharedMemory();
+      break;
+    case LLI_FinalizeSections:
+      handleFinalizeSections();
+      break;
     case LLI_Terminate:
       RT->stop();
       break;
@@ -169,6 +177,66 @@ void LLIChildTarget::handleExecute() {
   sendExecutionComplete(Result);
 }
 
+void LLIChildTarget::handleMapSharedMemory() {
+  // Read and verify the message data size.
+  uint32_t DataSize = 0;
+  int rc = ReadBytes(&DataSize, 4);
+  (void)rc;
+  assert(rc == 4);
+  assert(DataSize == 16);
+
+  // Read the handle and size of the region the parent created.
+  uint64_t Handle = 0;
+  uint64_t Size = 0;
+  rc = ReadBytes(&Handle, 8);
+  assert(rc == 8);
+  rc = ReadBytes(&Size, 8);
+  assert(rc == 8);
+
+  // Map it, reporting a null address on failure.
+  uint64_t Addr = 0;
+  if (RPC.mapSharedMemory(Handle, Size))
+    Addr = (uint64_t)RPC.SharedMemory;
+
+  // Send AllocationResult message.
+  sendAllocationResult(Addr);
+}
+
+void LLIChildTarget::handleFinalizeSections() {
+  // Read the message data size.
+  uint32_t DataSize = 0;
+  int rc = ReadBytes(&DataSize, 4);
+  (void)rc;
+  assert(rc == 4);
+
+  // Read the number of code ranges that follow.
+  uint32_t Count = 0;
+  rc = ReadBytes(&Count, 4);
+  assert(rc == 4);
+  if (DataSize != 4 + 16 * Count)
+    return sendLoadStatus(LLI_Status_IncompleteMsg);
+
+  // The parent wrote and relocated the code in place; all that is left is to
+  // check that it lies within the shared region and flush the icache.
+  uint64_t Base = (uint64_t)RPC.SharedMemory;
+  uint64_t End = Base + RPC.SharedMemorySize;
+  uint32_t Status = LLI_Status_Success;
+  for (uint32_t I = 0; I != Count; ++I) {
+    uint64_t Range[2];
+    rc = ReadBytes(Range, 16);
+    if (rc != 16)
+      return sendLoadStatus(LLI_Status_IncompleteMsg);
+    if (!RPC.SharedMemory || Range[0] < Base || Range[0] + Range[1] > End) {
+      Status = LLI_Status_NotAllocated;
+      continue;
+    }
+    sys::Memory::InvalidateInstructionCache((void *)Range[0], Range[1]);
+  }
+
+  // Send LoadResult message.
+  sendLoadStatus(Status);
+}
+
 // Outgoing message handlers
 void LLIChildTarget::sendChildActive() {
   // Write the message type.
@@ -8,9 +8,16 @@
 //===----------------------------------------------------------------------===//
 
 #include "OrcLazyJIT.h"
+#include "llvm/Analysis/CFG.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/ExecutionEngine/Orc/OrcTargetSupport.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include <cstdio>
 #include <system_error>
 
@@ -39,6 +46,24 @@ namespace {
                                              "working directory. (WARNING: "
                                              "will overwrite existing files)."),
                                   clEnumValEnd));
+
+  cl::opt<bool> OrcTiered(
+      "orc-lazy-tiered",
+      cl::desc("Compile functions without optimization first, and again with "
+               "optimization once they are hot."),
+      cl::init(false));
+
+  cl::opt<unsigned> OrcTierUpThreshold(
+      "orc-lazy-tier-up-threshold",
+      cl::desc("Number of calls or loop iterations after which a function is "
+               "optimized in tiered mode."),
+      cl::init(1000));
+
+  cl::opt<bool> OrcBackgroundCompile(
+      "orc-lazy-background-compile",
+      cl::desc("Speculatively compile the callees of each function compiled "
+               "by the orc-lazy JIT on a background thread."),
+      cl::init(false));
 }
 
 OrcLazyJIT::CallbackManagerBuilder
@@ -108,8 +133,176 @@ OrcLazyJIT::TransformFtor OrcLazyJIT::createDebugDumper() {
   llvm_unreachable("Unknown DumpKind");
 }
 
+/// Add a counter of the calls and loop iterations of each function of \p M,
+/// which asks for the function to be optimized when it reaches the threshold.
+/// The IR of the module is kept beforehand, to optimize the functions from.
+OrcLazyJIT::TieredModule *OrcLazyJIT::addTieredModule(Module &M) {
+  // The counters and the optimized code are matched up with the functions by
+  // name, so make sure they all have one and that the names stay the same.
+  orc::makeAllSymbolsExternallyAccessible(M);
+
+  // Aliases are not split out by the compile-on-demand layer, so there is no
+  // stub to swap for them: leave such modules alone.
+  if (!M.alias_empty())
+    return nullptr;
+
+  std::lock_guard<std::mutex> Lock(TierMutex);
+  TieredModules.emplace_back();
+  TieredModule &Tiered = TieredModules.back();
+  {
+    raw_string_ostream OS(Tiered.Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+
+  LLVMContext &Context = M.getContext();
+  Type *Int32Ty = Type::getInt32Ty(Context);
+  Type *Int64Ty = Type::getInt64Ty(Context);
+  Type *Int8PtrTy = Type::getInt8PtrTy(Context);
+  FunctionType *HookTy = FunctionType::get(Type::getVoidTy(Context),
+                                           {Int8PtrTy, Int64Ty}, false);
+  Constant *Hook = orc::createIRTypedAddress(
+      *HookTy, static_cast<orc::TargetAddress>(
+                   reinterpret_cast<uintptr_t>(&OrcLazyJIT::requestTierUp)));
+  Constant *JIT = ConstantExpr::getIntToPtr(
+      ConstantInt::get(Int64Ty, reinterpret_cast<uintptr_t>(this)), Int8PtrTy);
+
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    uint64_t ID = TieredFunctions.size();
+    TieredFunctions.push_back({&Tiered, F.getName(), 0, false});
+    Constant *Counter = ConstantExpr::getIntToPtr(
+        ConstantInt::get(Int64Ty,
+                         reinterpret_cast<uintptr_t>(
+                             &TieredFunctions.back().Count)),
+        Int32Ty->getPointerTo());
+
+    // Count the calls at the entry, after the static allocas, and the loop
+    // iterations at the targets of the back edges.
+    std::vector<Instruction *> CountPoints;
+    BasicBlock::iterator EntryI = F.getEntryBlock().begin();
+    while (isa<AllocaInst>(EntryI))
+      ++EntryI;
+    CountPoints.push_back(EntryI);
+    SmallVector<std::pair<const BasicBlock *, const BasicBlock *>, 8> BackEdges;
+    FindFunctionBackedges(F, BackEdges);
+    SmallPtrSet<const BasicBlock *, 8> Headers;
+    for (auto &BackEdge : BackEdges)
+      if (Headers.insert(BackEdge.second).second)
+        CountPoints.push_back(
+            const_cast<BasicBlock *>(BackEdge.second)->getFirstInsertionPt());
+
+    for (Instruction *I : CountPoints) {
+      IRBuilder<> B(I);
+      Value *Count = B.CreateAdd(B.CreateLoad(Counter), B.getInt32(1));
+      B.CreateStore(Count, Counter);
+      Value *IsHot = B.CreateICmpEQ(Count, B.getInt32(TierUpThreshold));
+      B.SetInsertPoint(SplitBlockAndInsertIfThen(IsHot, I, false));
+      B.CreateCall(Hook, {JIT, B.getInt64(ID)});
+    }
+  }
+
+  return &Tiered;
+}
+
+/// Called by the code of a function when it gets hot: queue the function for
+/// the optimizing tier.
+void OrcLazyJIT::requestTierUp(OrcLazyJIT *J, uint64_t ID) {
+  std::lock_guard<std::mutex> Lock(J->TierMutex);
+  TieredFunction &F = J->TieredFunctions[ID];
+  if (F.TierUpRequested)
+    return;
+  F.TierUpRequested = true;
+  J->TierUpThread->async([J, ID]() { J->tierUp(ID); });
+}
+
+/// Optimize and compile the function \p ID again, and swap its stub over to
+/// the new code.  The function is read back from the IR kept for its module
+/// into a context of its own, so that this can run while the program keeps
+/// running, and compiling, on other threads.  If anything goes wrong, the
+/// function simply keeps its unoptimized code.
+void OrcLazyJIT::tierUp(unsigned ID) {
+  TieredModule *Tiered;
+  std::string Name;
+  {
+    std::lock_guard<std::mutex> Lock(TierMutex);
+    Tiered = TieredFunctions[ID].Parent;
+    Name = TieredFunctions[ID].Name;
+  }
+
+  LLVMContext Context;
+  auto MOrErr = getLazyBitcodeModule(
+      MemoryBuffer::getMemBuffer(Tiered->Bitcode, "", false), Context);
+  if (!MOrErr)
+    return;
+  std::unique_ptr<Module> M = std::move(*MOrErr);
+  Function *F = M->getFunction(Name);
+  if (!F || F->materialize())
+    return;
+
+  // Keep the function alone: everything else it refers to is already in the
+  // JIT, including the globals, which must not be defined twice.
+  for (auto &G : *M) {
+    if (&G == F || (G.isDeclaration() && !G.isMaterializable()))
+      continue;
+    G.setIsMaterializable(false);
+    G.deleteBody();
+    G.setComdat(nullptr);
+  }
+  for (auto &GV : M->globals()) {
+    if (GV.isDeclaration())
+      continue;
+    GV.setInitializer(nullptr);
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+    GV.setComdat(nullptr);
+  }
+  F->setComdat(nullptr);
+  if (M->materializeAllPermanently())
+    return;
+
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptTM->getOptLevel() == CodeGenOpt::Aggressive ? 3 : 2;
+  legacy::PassManager PM;
+  PM.add(createTargetTransformInfoWrapperPass(OptTM->getTargetIRAnalysis()));
+  Builder.populateModulePassManager(PM);
+  PM.run(*M);
+
+  // The function refers to the rest of its module, stubs included, through
+  // the module's handle first, as the symbols made hidden are only visible
+  // from there.
+  ModuleHandleT H = Tiered->Handle;
+  auto Fallback = createResolver();
+  auto Resolver = orc::createLambdaResolver(
+      [this, H, Fallback](const std::string &Name) {
+        if (auto Sym = CODLayer.findSymbolIn(H, Name, false))
+          return RuntimeDyld::SymbolInfo(Sym.getAddress(), Sym.getFlags());
+        return Fallback->findSymbol(Name);
+      },
+      [](const std::string &Name) {
+        return RuntimeDyld::SymbolInfo(nullptr);
+      });
+
+  std::vector<std::unique_ptr<Module>> S;
+  S.push_back(std::move(M));
+  auto OptH =
+      OptIRDumpLayer->addModuleSet(std::move(S),
+                                   llvm::make_unique<SectionMemoryManager>(),
+                                   std::move(Resolver));
+  auto Sym = OptIRDumpLayer->findSymbolIn(OptH, mangle(Name), false);
+  auto ImplPtr = CODLayer.findSymbolIn(H, mangle(Name + "$orc_addr"), false);
+  if (!Sym || !ImplPtr)
+    return;
+
+  // The stub may be in use on other threads: store the new address in one go.
+  uintptr_t Addr = Sym.getAddress();
+  fromTargetAddress<std::atomic<uintptr_t> *>(ImplPtr.getAddress())
+      ->store(Addr);
+}
+
 // Defined in lli.cpp.
 CodeGenOpt::Level getOptLevel();
+std::string getHashedObjectCacheDir();
 
 int llvm::runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]) {
   // Add the program's symbols into the JIT's search space.
@@ -122,6 +315,13 @@ int llvm::runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]) {
   // target-specific Orc callback manager.
   EngineBuilder EB;
   EB.setOptLevel(getOptLevel());
+  std::unique_ptr<TargetMachine> OptTM;
+  if (OrcTiered) {
+    // Optimize the hot functions at the requested level, and compile all of
+    // them as fast as possible at first.
+    OptTM.reset(EB.selectTarget());
+    EB.setOptLevel(CodeGenOpt::None);
+  }
   auto TM = std::unique_ptr<TargetMachine>(EB.selectTarget());
   auto &Context = getGlobalContext();
   auto CallbackMgrBuilder =
@@ -136,7 +336,11 @@ int llvm::runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]) {
   }
 
   // Everything looks good. Build the JIT.
-  OrcLazyJIT J(std::move(TM), Context, CallbackMgrBuilder);
+  OrcLazyJIT J(std::move(TM), Context, CallbackMgrBuilder,
+               OrcBackgroundCompile, std::move(OptTM), OrcTierUpThreshold);
+  std::string ObjectCacheDir = getHashedObjectCacheDir();
+  if (!ObjectCacheDir.empty())
+    J.setObjectCacheDir(ObjectCacheDir);
 
   // Add the module, look up main and run it.
   auto MainHandle = J.addModule(std::move(M));
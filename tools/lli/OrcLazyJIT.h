@@ -22,8 +22,12 @@
 #include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
 #include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
 #include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/ThreadPool.h"
+#include <deque>
+#include <mutex>
 
 namespace llvm {
 
@@ -47,18 +51,38 @@ public:
 
   static CallbackManagerBuilder createCallbackManagerBuilder(Triple T);
 
+  /// Construct a JIT compiling functions on first call with \p TM.  If
+  /// \p OptTM is given, the functions are compiled again with it, optimized,
+  /// once they have been called or have looped TierUpThreshold times.
   OrcLazyJIT(std::unique_ptr<TargetMachine> TM, LLVMContext &Context,
-             CallbackManagerBuilder &BuildCallbackMgr)
-    : TM(std::move(TM)),
+             CallbackManagerBuilder &BuildCallbackMgr,
+             bool CompileInBackground = false,
+             std::unique_ptr<TargetMachine> OptTM = nullptr,
+             unsigned TierUpThreshold = 0)
+    : TM(std::move(TM)), OptTM(std::move(OptTM)),
+      TierUpThreshold(TierUpThreshold),
       Mang(this->TM->getDataLayout()),
       ObjectLayer(),
       CompileLayer(ObjectLayer, orc::SimpleCompiler(*this->TM)),
       IRDumpLayer(CompileLayer, createDebugDumper()),
       CCMgr(BuildCallbackMgr(IRDumpLayer, CCMgrMemMgr, Context)),
-      CODLayer(IRDumpLayer, *CCMgr, false),
-      CXXRuntimeOverrides([this](const std::string &S) { return mangle(S); }) {}
+      CODLayer(IRDumpLayer, *CCMgr, false, CompileInBackground),
+      CXXRuntimeOverrides([this](const std::string &S) { return mangle(S); }) {
+    if (this->OptTM) {
+      OptObjectLayer = llvm::make_unique<ObjLayerT>();
+      OptCompileLayer = llvm::make_unique<CompileLayerT>(
+          *OptObjectLayer, orc::SimpleCompiler(*this->OptTM));
+      OptIRDumpLayer = llvm::make_unique<IRDumpLayerT>(*OptCompileLayer,
+                                                       createDebugDumper());
+      TierUpThread = llvm::make_unique<ThreadPool>(1);
+    }
+  }
 
   ~OrcLazyJIT() {
+    // Let the functions already sent to the optimizing tier get there, so
+    // that the work done is the same from one run to the next.
+    if (TierUpThread)
+      TierUpThread->wait();
     // Run any destructors registered with __cxa_atexit.
     CXXRuntimeOverrides.runDestructors();
     // Run any IR destructors.
@@ -66,6 +90,19 @@ public:
       DtorRunner.runViaLayer(CODLayer);
   }
 
+  /// Cache the compiled functions in the directory \p Dir. In tiered mode,
+  /// the counters of the baseline code refer to this JIT, so only the
+  /// optimized code is cached.
+  void setObjectCacheDir(StringRef Dir) {
+    if (OptTM) {
+      OptObjCache = llvm::make_unique<PartitionObjectCache>(Dir, *OptTM);
+      OptCompileLayer->setObjectCache(OptObjCache.get());
+      return;
+    }
+    ObjCache = llvm::make_unique<PartitionObjectCache>(Dir, *TM);
+    CompileLayer.setObjectCache(ObjCache.get());
+  }
+
   template <typename PtrTy>
   static PtrTy fromTargetAddress(orc::TargetAddress Addr) {
     return reinterpret_cast<PtrTy>(static_cast<uintptr_t>(Addr));
@@ -84,34 +121,18 @@ public:
     for (auto Dtor : orc::getDestructors(*M))
       DtorNames.push_back(mangle(Dtor.Func->getName()));
 
-    // Symbol resolution order:
-    //   1) Search the JIT symbols.
-    //   2) Check for C++ runtime overrides.
-    //   3) Search the host process (LLI)'s symbol table.
-    std::shared_ptr<RuntimeDyld::SymbolResolver> Resolver =
-      orc::createLambdaResolver(
-        [this](const std::string &Name) {
-          if (auto Sym = CODLayer.findSymbol(Name, true))
-            return RuntimeDyld::SymbolInfo(Sym.getAddress(),
-                                           Sym.getFlags());
-          if (auto Sym = CXXRuntimeOverrides.searchOverrides(Name))
-            return Sym;
-
-          if (auto Addr =
-              RTDyldMemoryManager::getSymbolAddressInProcess(Name))
-            return RuntimeDyld::SymbolInfo(Addr, JITSymbolFlags::Exported);
-
-          return RuntimeDyld::SymbolInfo(nullptr);
-        },
-        [](const std::string &Name) {
-          return RuntimeDyld::SymbolInfo(nullptr);
-        }
-      );
+    // Count the calls and loop iterations of each function, to send the hot
+    // ones to the optimizing tier.
+    TieredModule *Tiered = nullptr;
+    if (OptTM)
+      Tiered = addTieredModule(*M);
 
     // Add the module to the JIT.
     std::vector<std::unique_ptr<Module>> S;
     S.push_back(std::move(M));
-    auto H = CODLayer.addModuleSet(std::move(S), nullptr, std::move(Resolver));
+    auto H = CODLayer.addModuleSet(std::move(S), nullptr, createResolver());
+    if (Tiered)
+      Tiered->Handle = H;
 
     // Run the static constructors, and save the static destructor runner for
     // execution when the JIT is torn down.
@@ -133,6 +154,49 @@ public:
 
 private:
 
+  /// The IR of a module in its state before counters were added, from which
+  /// its hot functions are optimized.
+  struct TieredModule {
+    std::string Bitcode;
+    ModuleHandleT Handle;
+  };
+
+  /// A function of a tiered module, with the counter of its calls and loop
+  /// iterations.
+  struct TieredFunction {
+    TieredModule *Parent;
+    std::string Name;
+    uint32_t Count;
+    bool TierUpRequested;
+  };
+
+  // Symbol resolution order:
+  //   1) Search the JIT symbols.
+  //   2) Check for C++ runtime overrides.
+  //   3) Search the host process (LLI)'s symbol table.
+  std::shared_ptr<RuntimeDyld::SymbolResolver> createResolver() {
+    return orc::createLambdaResolver(
+        [this](const std::string &Name) {
+          if (auto Sym = CODLayer.findSymbol(Name, true))
+            return RuntimeDyld::SymbolInfo(Sym.getAddress(), Sym.getFlags());
+          if (auto Sym = CXXRuntimeOverrides.searchOverrides(Name))
+            return Sym;
+
+          if (auto Addr =
+              RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+            return RuntimeDyld::SymbolInfo(Addr, JITSymbolFlags::Exported);
+
+          return RuntimeDyld::SymbolInfo(nullptr);
+        },
+        [](const std::string &Name) {
+          return RuntimeDyld::SymbolInfo(nullptr);
+        });
+  }
+
+  TieredModule *addTieredModule(Module &M);
+  static void requestTierUp(OrcLazyJIT *J, uint64_t ID);
+  void tierUp(unsigned ID);
+
   std::string mangle(const std::string &Name) {
     std::string MangledName;
     {
@@ -144,9 +208,37 @@ private:
 
   static TransformFtor createDebugDumper();
 
+  // The globals-and-stubs modules of the CompileOnDemandLayer hold the
+  // addresses of this process's compile callbacks: never look them up or
+  // store them, as they cannot be reused.
+  class PartitionObjectCache : public FileObjectCache {
+  public:
+    PartitionObjectCache(StringRef Dir, const TargetMachine &TM)
+      : FileObjectCache(Dir, TM) {}
+
+    void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override {
+      if (!isStubsModule(*M))
+        FileObjectCache::notifyObjectCompiled(M, Obj);
+    }
+
+    std::unique_ptr<MemoryBuffer> getObject(const Module *M) override {
+      if (isStubsModule(*M))
+        return nullptr;
+      return FileObjectCache::getObject(M);
+    }
+
+  private:
+    static bool isStubsModule(const Module &M) {
+      return StringRef(M.getModuleIdentifier()).endswith(".globals_and_stubs");
+    }
+  };
+
   std::unique_ptr<TargetMachine> TM;
+  std::unique_ptr<TargetMachine> OptTM;
+  unsigned TierUpThreshold;
   Mangler Mang;
   SectionMemoryManager CCMgrMemMgr;
+  std::unique_ptr<PartitionObjectCache> ObjCache, OptObjCache;
 
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
@@ -156,6 +248,15 @@ private:
 
   orc::LocalCXXRuntimeOverrides CXXRuntimeOverrides;
   std::vector<orc::CtorDtorRunner<CODLayerT>> IRStaticDestructorRunners;
+
+  // The optimizing tier. Its layers are only used by the tier-up thread.
+  std::unique_ptr<ObjLayerT> OptObjectLayer;
+  std::unique_ptr<CompileLayerT> OptCompileLayer;
+  std::unique_ptr<IRDumpLayerT> OptIRDumpLayer;
+  std::mutex TierMutex;
+  std::deque<TieredModule> TieredModules;
+  std::deque<TieredFunction> TieredFunctions;
+  std::unique_ptr<ThreadPool> TierUpThread;
 };
 
 int runOrcLazyJIT(std::unique_ptr<Module> M, int ArgC, char* ArgV[]);
@@ -15,6 +15,7 @@
 #ifndef LLVM_TOOLS_LLI_RPCCHANNEL_H
 #define LLVM_TOOLS_LLI_RPCCHANNEL_H
 
+#include "llvm/Support/DataTypes.h"
 #include <stdlib.h>
 #include <string>
 
@@ -24,7 +25,9 @@ class RPCChannel {
 public:
   std::string ChildName;
 
-  RPCChannel() {}
+  RPCChannel()
+      : ConnectionData(nullptr), SharedMemory(nullptr), SharedMemorySize(0),
+        SharedMemoryHandle(0) {}
   ~RPCChannel();
 
   /// Start the remote process.
@@ -35,9 +38,29 @@ public:
 
   bool createClient();
 
+  /// Create a region of memory that the child process can map with
+  /// mapSharedMemory(). This must be called before createServer() so that
+  /// the child inherits the region.
+  ///
+  /// @param      Size      Size of the region, in bytes.
+  ///
+  /// @returns True on success, in which case SharedMemory, SharedMemorySize
+  ///          and SharedMemoryHandle describe the region.
+  bool createSharedMemory(size_t Size);
+
+  /// Map the region identified by Handle, which was created by the server's
+  /// createSharedMemory(), into this process. The mapping is executable.
+  bool mapSharedMemory(uint64_t Handle, size_t Size);
+
   // This will get filled in as a point to an OS-specific structure.
   void *ConnectionData;
 
+  // The local mapping of the memory region shared with the other process, if
+  // any, and the OS-specific handle the child uses to map it.
+  void *SharedMemory;
+  size_t SharedMemorySize;
+  uint64_t SharedMemoryHandle;
+
   bool WriteBytes(const void *Data, size_t Size);
   bool ReadBytes(void *Data, size_t Size);
 
@@ -32,6 +32,9 @@ RemoteMemoryManager::~RemoteMemoryManager() {
 uint8_t *RemoteMemoryManager::
 allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned SectionID,
                     StringRef SectionName) {
+  if (Target && Target->hasSharedMemory())
+    return allocateSharedSection(Size, Alignment, true);
+
   // The recording memory manager is just a local copy of the remote target.
   // The alignment requirement is just stored here for later use. Regular
   // heap storage is sufficient here, but we're using mapped memory to work
@@ -48,6 +51,9 @@ uint8_t *RemoteMemoryManager::
 allocateDataSection(uintptr_t Size, unsigned Alignment,
                     unsigned SectionID, StringRef SectionName,
                     bool IsReadOnly) {
+  if (Target && Target->hasSharedMemory())
+    return allocateSharedSection(Size, Alignment, false);
+
   // The recording memory manager is just a local copy of the remote target.
   // The alignment requirement is just stored here for later use. Regular
   // heap storage is sufficient here, but we're using mapped memory to work
@@ -77,6 +83,21 @@ sys::MemoryBlock RemoteMemoryManager::allocateSection(uintptr_t Size) {
   return MB;
 }
 
+uint8_t *RemoteMemoryManager::allocateSharedSection(uintptr_t Size,
+                                                    unsigned Alignment,
+                                                    bool IsCode) {
+  // Sections in shared memory are written and relocated in place, so there
+  // is no local copy and nothing to transfer when memory is finalized.
+  uint8_t *LocalAddr;
+  uint64_t RemoteAddr;
+  if (!Target->allocateSharedSpace(Size, Alignment, LocalAddr, RemoteAddr))
+    report_fatal_error(Target->getErrorMsg());
+  UnmappedSharedSections.push_back(std::make_pair(
+      Allocation(sys::MemoryBlock(LocalAddr, Size), Alignment, IsCode),
+      RemoteAddr));
+  return LocalAddr;
+}
+
 void RemoteMemoryManager::notifyObjectLoaded(ExecutionEngine *EE,
                                              const object::ObjectFile &Obj) {
   // The client should have called setRemoteTarget() before triggering any
@@ -87,6 +108,20 @@ void RemoteMemoryManager::notifyObjectLoaded(ExecutionEngine *EE,
 
   // FIXME: Make this function thread safe.
 
+  // Shared sections already live at their remote address; just tell the
+  // ExecutionEngine where that is so relocations are resolved against it.
+  for (const auto &S : UnmappedSharedSections) {
+    EE->mapSectionAddress(S.first.MB.base(), S.second);
+    DEBUG(dbgs() << "  Mapping shared: " << S.first.MB.base()
+                 << " to remote: 0x" << format("%llx", S.second) << "\n");
+    if (S.first.IsCode)
+      PendingSharedCode.push_back(std::make_pair(S.second, S.first.MB.size()));
+  }
+  UnmappedSharedSections.clear();
+
+  if (Target->hasSharedMemory())
+    return;
+
   // Lay out our sections in order, with all the code sections first, then
   // all the data sections.
   uint64_t CurOffset = 0;
@@ -150,6 +185,12 @@ void RemoteMemoryManager::notifyObjectLoaded(ExecutionEngine *EE,
 
 bool RemoteMemoryManager::finalizeMemory(std::string *ErrMsg) {
   // FIXME: Make this function thread safe.
+  if (!PendingSharedCode.empty()) {
+    if (!Target->finalizeSharedSections(PendingSharedCode))
+      report_fatal_error(Target->getErrorMsg());
+    PendingSharedCode.clear();
+  }
+
   for (DenseMap<uint64_t, Allocation>::iterator
          I = MappedSections.begin(), E = MappedSections.end();
        I != E; ++I) {
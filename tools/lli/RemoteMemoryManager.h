@@ -54,6 +54,16 @@ private:
   // but have not yet copied to the target.
   DenseMap<uint64_t, Allocation>  MappedSections;
 
+  // When the target shares memory with us, sections are allocated directly
+  // in the shared region and already have their final remote address. These
+  // are owned by the target. The first list holds sections not yet mapped
+  // with the ExecutionEngine, the second the remote code ranges to hand to
+  // the target in one batch when memory is finalized.
+  SmallVector<std::pair<Allocation, uint64_t>, 2> UnmappedSharedSections;
+  SmallVector<std::pair<uint64_t, uint64_t>, 2> PendingSharedCode;
+  uint8_t *allocateSharedSection(uintptr_t Size, unsigned Alignment,
+                                 bool IsCode);
+
   // FIXME: This is part of a work around to keep sections near one another
   // when MCJIT performs relocations after code emission but before
   // the generated code is moved to the remote target.
@@ -55,6 +55,19 @@ bool RemoteTarget::loadCode(uint64_t Address, const void *Data, size_t Size) {
   return true;
 }
 
+bool RemoteTarget::allocateSharedSpace(size_t Size, unsigned Alignment,
+                                       uint8_t *&LocalAddress,
+                                       uint64_t &RemoteAddress) {
+  ErrorMsg = "target does not share memory with the host";
+  return false;
+}
+
+bool RemoteTarget::finalizeSharedSections(
+    ArrayRef<std::pair<uint64_t, uint64_t>> CodeRanges) {
+  ErrorMsg = "target does not share memory with the host";
+  return false;
+}
+
 bool RemoteTarget::executeCode(uint64_t Address, int &RetVal) {
   int (*fn)(void) = (int(*)(void))Address;
   RetVal = fn();
@@ -15,6 +15,7 @@
 #ifndef LLVM_TOOLS_LLI_REMOTETARGET_H
 #define LLVM_TOOLS_LLI_REMOTETARGET_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/DataTypes.h"
@@ -84,6 +85,34 @@ public:
                         const void *Data,
                         size_t Size);
 
+  /// Whether the target shares a memory region with this process, so that
+  /// sections can be allocated with allocateSharedSpace() and written in
+  /// place rather than copied with loadCode() and loadData().
+  virtual bool hasSharedMemory() const { return false; }
+
+  /// Allocate space in the memory region shared with the target.
+  ///
+  /// @param      Size          Amount of space, in bytes, to allocate.
+  /// @param      Alignment     Required minimum alignment for allocated space.
+  /// @param[out] LocalAddress  Address of the space in the host process.
+  /// @param[out] RemoteAddress Address of the same space in the target.
+  ///
+  /// @returns True on success. On failure, ErrorMsg is updated with
+  ///          descriptive text of the encountered error.
+  virtual bool allocateSharedSpace(size_t Size, unsigned Alignment,
+                                   uint8_t *&LocalAddress,
+                                   uint64_t &RemoteAddress);
+
+  /// Prepare code written into shared memory for execution.
+  ///
+  /// @param      CodeRanges  (Address, Size) pairs in the target address
+  ///                         space, all sent to the target in one message.
+  ///
+  /// @returns True on success. On failure, ErrorMsg is updated with
+  ///          descriptive text of the encountered error.
+  virtual bool
+  finalizeSharedSections(ArrayRef<std::pair<uint64_t, uint64_t>> CodeRanges);
+
   /// Execute code in the target process. The called function is required
   /// to be of signature int "(*)(void)".
   ///
@@ -19,6 +19,7 @@
 #include "llvm/Support/DataTypes.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Memory.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/raw_ostream.h"
@@ -97,6 +98,78 @@ bool RemoteTargetExternal::loadCode(uint64_t Address, const void *Data, size_t S
   return true;
 }
 
+bool RemoteTargetExternal::allocateSharedSpace(size_t Size, unsigned Alignment,
+                                               uint8_t *&LocalAddress,
+                                               uint64_t &RemoteAddress) {
+  assert(hasSharedMemory() && "No memory shared with the child process");
+  // Both mappings are page aligned, so aligning the offset aligns the
+  // address on either side.
+  size_t Offset =
+      RoundUpToAlignment(SharedMemoryUsed, Alignment ? Alignment : 1);
+  if (Offset + Size > SharedMemorySize) {
+    ErrorMsg = "shared memory exhausted, (RemoteTargetExternal::"
+               "allocateSharedSpace)";
+    return false;
+  }
+  SharedMemoryUsed = Offset + Size;
+  LocalAddress = static_cast<uint8_t *>(RPC.SharedMemory) + Offset;
+  RemoteAddress = RemoteSharedMemory + Offset;
+  DEBUG(dbgs() << "Shared allocation size: " << Size << ", align: "
+               << Alignment << ", remote addr: 0x"
+               << format("%llx", RemoteAddress) << "\n");
+  return true;
+}
+
+bool RemoteTargetExternal::finalizeSharedSections(
+    ArrayRef<std::pair<uint64_t, uint64_t>> CodeRanges) {
+  DEBUG(dbgs() << "Message [finalize sections] count: " << CodeRanges.size()
+               << "\n");
+  if (!SendFinalizeSections(CodeRanges)) {
+    ErrorMsg += ", (RemoteTargetExternal::finalizeSharedSections)";
+    return false;
+  }
+  int Status = LLI_Status_Success;
+  if (!Receive(LLI_LoadResult, Status)) {
+    ErrorMsg += ", (RemoteTargetExternal::finalizeSharedSections)";
+    return false;
+  }
+  if (Status == LLI_Status_IncompleteMsg) {
+    ErrorMsg += "incomplete section list, "
+                "(RemoteTargetExternal::finalizeSharedSections)";
+    return false;
+  }
+  if (Status == LLI_Status_NotAllocated) {
+    ErrorMsg += "code not in shared memory, "
+                "(RemoteTargetExternal::finalizeSharedSections)";
+    return false;
+  }
+  DEBUG(dbgs() << "Message [finalize sections] complete\n");
+  return true;
+}
+
+bool RemoteTargetExternal::mapSharedMemory() {
+  DEBUG(dbgs() << "Message [map shared memory] size: " << SharedMemorySize
+               << "\n");
+  if (!SendMapSharedMemory(RPC.SharedMemoryHandle, SharedMemorySize)) {
+    ErrorMsg += ", (RemoteTargetExternal::mapSharedMemory)";
+    return false;
+  }
+  uint64_t Address = 0;
+  if (!Receive(LLI_AllocationResult, Address)) {
+    ErrorMsg += ", (RemoteTargetExternal::mapSharedMemory)";
+    return false;
+  }
+  if (Address == 0) {
+    ErrorMsg += "child failed to map shared memory, "
+                "(RemoteTargetExternal::mapSharedMemory)";
+    return false;
+  }
+  RemoteSharedMemory = Address;
+  DEBUG(dbgs() << "Message [map shared memory] addr: 0x"
+               << format("%llx", Address) << "\n");
+  return true;
+}
+
 bool RemoteTargetExternal::executeCode(uint64_t Address, int32_t &RetVal) {
   DEBUG(dbgs() << "Message [exectue code] addr: " << Address << "\n");
   if (!SendExecute(Address)) {
@@ -167,6 +240,46 @@ bool RemoteTargetExternal::SendExecute(uint64_t Addr) {
   return true;
 }
 
+bool RemoteTargetExternal::SendMapSharedMemory(uint64_t Handle,
+                                               uint64_t Size) {
+  if (!SendHeader(LLI_MapSharedMemory)) {
+    ErrorMsg += ", (RemoteTargetExternal::SendMapSharedMemory)";
+    return false;
+  }
+
+  AppendWrite((const void *)&Handle, 8);
+  AppendWrite((const void *)&Size, 8);
+
+  if (!SendPayload()) {
+    ErrorMsg += ", (RemoteTargetExternal::SendMapSharedMemory)";
+    return false;
+  }
+  return true;
+}
+
+bool RemoteTargetExternal::SendFinalizeSections(
+    ArrayRef<std::pair<uint64_t, uint64_t>> Ranges) {
+  if (!SendHeader(LLI_FinalizeSections)) {
+    ErrorMsg += ", (RemoteTargetExternal::SendFinalizeSections)";
+    return false;
+  }
+
+  uint32_t Count = Ranges.size();
+  SmallVector<uint64_t, 8> Data;
+  for (const auto &R : Ranges) {
+    Data.push_back(R.first);
+    Data.push_back(R.second);
+  }
+  AppendWrite((const void *)&Count, 4);
+  AppendWrite((const void *)Data.data(), Data.size() * 8);
+
+  if (!SendPayload()) {
+    ErrorMsg += ", (RemoteTargetExternal::SendFinalizeSections)";
+    return false;
+  }
+  return true;
+}
+
 bool RemoteTargetExternal::SendTerminate() {
   return SendHeader(LLI_Terminate);
   // No data or data size is sent with Terminate
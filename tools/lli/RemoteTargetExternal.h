@@ -69,6 +69,19 @@ public:
   ///          descriptive text of the encountered error.
   bool loadCode(uint64_t Address, const void *Data, size_t Size) override;
 
+  bool hasSharedMemory() const override { return RemoteSharedMemory != 0; }
+
+  /// Allocate space in the memory region shared with the target. This is a
+  /// simple bump allocation and involves no communication with the target.
+  bool allocateSharedSpace(size_t Size, unsigned Alignment,
+                           uint8_t *&LocalAddress,
+                           uint64_t &RemoteAddress) override;
+
+  /// Send all code ranges written into shared memory to the target in a
+  /// single message so that its instruction cache can be invalidated.
+  bool finalizeSharedSections(
+      ArrayRef<std::pair<uint64_t, uint64_t>> CodeRanges) override;
+
   /// Execute code in the target process. The called function is required
   /// to be of signature int "(*)(void)".
   ///
@@ -89,6 +102,10 @@ public:
 
   bool create() override {
     RPC.ChildName = ChildName;
+    if (SharedMemorySize && !RPC.createSharedMemory(SharedMemorySize)) {
+      ErrorMsg = "unable to create shared memory, (RPCChannel::create)";
+      return false;
+    }
     if (!RPC.createServer())
       return true;
 
@@ -99,24 +116,46 @@ public:
       return false;
     }
 
+    if (SharedMemorySize && !mapSharedMemory()) {
+      ErrorMsg += ", (RPCChannel::create) - Stopping process!";
+      stop();
+      return false;
+    }
+
     return true;
   }
 
   /// Terminate the remote process.
   void stop() override;
 
-  RemoteTargetExternal(std::string &Name) : RemoteTarget(), ChildName(Name) {}
+  /// @param      Name              Path of the child executable.
+  /// @param      SharedMemorySize  Size in bytes of a region to share with the
+  ///                               child, or zero to copy every section over
+  ///                               the pipe.
+  RemoteTargetExternal(std::string &Name, size_t SharedMemorySize = 0)
+      : RemoteTarget(), ChildName(Name), SharedMemorySize(SharedMemorySize),
+        RemoteSharedMemory(0), SharedMemoryUsed(0) {}
   ~RemoteTargetExternal() override {}
 
 private:
   std::string ChildName;
 
+  // The size of the shared region, its address in the child once mapped, and
+  // the number of bytes handed out by allocateSharedSpace().
+  size_t SharedMemorySize;
+  uint64_t RemoteSharedMemory;
+  size_t SharedMemoryUsed;
+
+  bool mapSharedMemory();
+
   bool SendAllocateSpace(uint32_t Alignment, uint32_t Size);
   bool SendLoadSection(uint64_t Addr,
                        const void *Data,
                        uint32_t Size,
                        bool IsCode);
   bool SendExecute(uint64_t Addr);
+  bool SendMapSharedMemory(uint64_t Handle, uint64_t Size);
+  bool SendFinalizeSections(ArrayRef<std::pair<uint64_t, uint64_t>> Ranges);
   bool SendTerminate();
 
   // High-level wrappers for receiving data
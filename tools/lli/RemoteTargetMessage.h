@@ -36,7 +36,7 @@ namespace llvm {
 // and the size has to be the sum of them all. Each end is responsible for
 // reading/writing the correct number of items with the correct sizes.
 //
-// The current four known exchanges are:
+// The current known exchanges are:
 //
 //  * Allocate Space:
 //   Parent: { LLI_AllocateSpace, 8, Alignment, Size }
@@ -54,6 +54,19 @@ namespace llvm {
 //   Parent: { LLI_Execute, 8, Address }
 //    Child: { LLI_ExecutionResult, 4, Result }
 //
+//  * Map Shared Memory:
+//   Parent: { LLI_MapSharedMemory, 16, Handle, Size }
+//    Child: { LLI_AllocationResult, 8, Address }
+//
+//  * Finalize Sections:
+//   Parent: { LLI_FinalizeSections, 4+16*Count, Count, { Address, Size }* }
+//    Child: { LLI_LoadResult, 4, StatusCode }
+//
+// When the parent has asked the child to map a shared memory region, sections
+// are written into that region directly and relocated in place, so the only
+// traffic on the pipe per object is a single Finalize Sections message listing
+// the code ranges whose instruction cache must be invalidated.
+//
 // It is the responsibility of either side to check for correct headers,
 // sizes and payloads, since any inconsistency would misalign the pipe, and
 // result in data corruption.
@@ -71,6 +84,10 @@ enum LLIMessageType {
   LLI_Execute,                // Data = uint64_t Address
   LLI_ExecutionResult,        // Data = uint32_t Result
 
+  LLI_MapSharedMemory,        // Data = uint64_t Handle, uint64_t Size
+  LLI_FinalizeSections,       // Data = uint32_t Count, { uint64_t Address,
+                              //                          uint64_t Size }*
+
   LLI_Terminate               // Data = not used
 };
 
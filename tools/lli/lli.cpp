@@ -21,6 +21,7 @@
 #include "llvm/ADT/Triple.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/LinkAllCodegenComponents.h"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/ExecutionEngine/Interpreter.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
@@ -112,6 +113,16 @@ namespace {
                          "\n\tremote execution will be simulated in-process."),
                 cl::value_desc("filename"), cl::init(""));
 
+  // Share a memory region with the child process so that code and data are
+  // written and relocated directly in the child's address space, instead of
+  // being copied over the pipe one section at a time.
+  cl::opt<unsigned>
+  RemoteSharedMemory("remote-shared-memory",
+                     cl::desc("Size in KiB of a memory region to share with "
+                              "the remote MCJIT process (default = 0, copy "
+                              "sections over the pipe)"),
+                     cl::value_desc("KiB"), cl::init(0));
+
   // Determine optimization level.
   cl::opt<char>
   OptLevel("O",
@@ -173,6 +184,31 @@ namespace {
                            "(must be user writable)"),
                   cl::init(""));
 
+  cl::opt<bool>
+  CacheByHash("cache-by-hash",
+              cl::desc("Key the objects saved by the cache manager by a hash "
+                       "of their IR and of the target configuration rather "
+                       "than by module name (always done by the orc-lazy "
+                       "JIT)"),
+              cl::init(false));
+
+  cl::opt<std::string>
+  JITStatsFile("jit-stats-file",
+               cl::desc("Write the compile times and code size of each "
+                        "JIT'd function to this file"),
+               cl::value_desc("filename"), cl::init(""));
+
+  cl::opt<JITEventListener::CompileStatsFormat>
+  JITStatsFormat("jit-stats-format",
+                 cl::desc("Choose the format of -jit-stats-file:"),
+                 cl::init(JITEventListener::CSF_JSON),
+                 cl::values(
+                   clEnumValN(JITEventListener::CSF_JSON, "json",
+                              "One JSON object per module and line"),
+                   clEnumValN(JITEventListener::CSF_CSV, "csv",
+                              "One CSV row per function and module"),
+                   clEnumValEnd));
+
   cl::opt<std::string>
   FakeArgv0("fake-argv0",
             cl::desc("Override the 'argv[0]' value passed into the executing"
@@ -314,7 +350,9 @@ private:
 };
 
 static ExecutionEngine *EE = nullptr;
-static LLIObjectCache *CacheManager = nullptr;
+static ObjectCache *CacheManager = nullptr;
+static JITEventListener *StatsListener = nullptr;
+static raw_fd_ostream *StatsStream = nullptr;
 
 static void do_shutdown() {
   // Cygwin-1.5 invokes DLL's dtors before atexit handler.
@@ -322,6 +360,8 @@ static void do_shutdown() {
   delete EE;
   if (CacheManager)
     delete CacheManager;
+  delete StatsListener;
+  delete StatsStream;
   llvm_shutdown();
 #endif
 }
@@ -379,6 +419,16 @@ CodeGenOpt::Level getOptLevel() {
   llvm_unreachable("Unrecognized opt level.");
 }
 
+std::string getHashedObjectCacheDir() {
+  if (!EnableCacheManager)
+    return "";
+  if (ObjectCacheDir.empty()) {
+    errs() << "lli: -object-cache-dir is required to cache objects by hash.\n";
+    exit(1);
+  }
+  return ObjectCacheDir;
+}
+
 //===----------------------------------------------------------------------===//
 // main Driver function
 //
@@ -482,7 +532,10 @@ int main(int argc, char **argv, char * const *envp) {
   }
 
   if (EnableCacheManager) {
-    CacheManager = new LLIObjectCache(ObjectCacheDir);
+    if (!CacheByHash)
+      CacheManager = new LLIObjectCache(ObjectCacheDir);
+    else if (TargetMachine *TM = EE->getTargetMachine())
+      CacheManager = new FileObjectCache(getHashedObjectCacheDir(), *TM);
     EE->setObjectCache(CacheManager);
   }
 
@@ -547,6 +600,20 @@ int main(int argc, char **argv, char * const *envp) {
   EE->RegisterJITEventListener(
                 JITEventListener::createIntelJITEventListener());
 
+  if (!JITStatsFile.empty()) {
+    std::error_code EC;
+    StatsStream = new raw_fd_ostream(JITStatsFile, EC, sys::fs::F_Text);
+    if (EC) {
+      errs() << argv[0] << ": error opening '" << JITStatsFile
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    StatsListener =
+        JITEventListener::createCompileStatsListener(*StatsStream,
+                                                     JITStatsFormat);
+    EE->RegisterJITEventListener(StatsListener);
+  }
+
   if (!NoLazyCompilation && RemoteMCJIT) {
     errs() << "warning: remote mcjit does not support lazy compilation\n";
     NoLazyCompilation = true;
@@ -650,7 +717,8 @@ int main(int argc, char **argv, char * const *envp) {
                << "'\n";
         return -1;
       }
-      Target.reset(new RemoteTargetExternal(ChildExecPath));
+      Target.reset(new RemoteTargetExternal(ChildExecPath,
+                                            (size_t)RemoteSharedMemory * 1024));
 #endif
     } else {
       // No child process name provided, use simulated remote execution.
@@ -12,17 +12,23 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/CodeGen/CommandFlags.h"
+#include "llvm/IR/FunctionInfo.h"
 #include "llvm/LTO/LTOCodeGenerator.h"
 #include "llvm/LTO/LTOModule.h"
+#include "llvm/LTO/ThinLTOCodeGenerator.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
+#include <list>
 
 using namespace llvm;
 
@@ -46,6 +52,10 @@ static cl::opt<bool>
 DisableLTOVectorization("disable-lto-vectorization", cl::init(false),
   cl::desc("Do not run loop or slp vectorization during LTO"));
 
+static cl::opt<unsigned>
+Parallelism("j", cl::Prefix, cl::init(1),
+  cl::desc("Number of threads (and object files) used for code generation"));
+
 static cl::opt<bool>
 UseDiagnosticHandler("use-diagnostic-handler", cl::init(false),
   cl::desc("Use a diagnostic handler to test the handler interface"));
@@ -77,6 +87,33 @@ static cl::opt<bool> SetMergedModule(
     "set-merged-module", cl::init(false),
     cl::desc("Use the first input module as the merged module"));
 
+static cl::opt<bool> ThinLTO(
+    "thinlto", cl::init(false),
+    cl::desc("Perform summary-based LTO: import functions across modules, "
+             "then optimize and generate code for each module separately"));
+
+static cl::opt<bool> ThinLTOIndexOnly(
+    "thinlto-index-only", cl::init(false),
+    cl::desc("Only perform the thin link, writing the combined function "
+             "index to the output file"));
+
+static cl::opt<std::string>
+    CacheDir("cache-dir", cl::value_desc("directory"),
+             cl::desc("Cache the native objects in this directory"));
+
+static cl::opt<unsigned> CachePruningInterval(
+    "cache-pruning-interval", cl::init(1200),
+    cl::desc("Minimum time between two prunings of the cache, in seconds"));
+
+static cl::opt<unsigned> CacheEntryExpiration(
+    "cache-entry-expiration", cl::init(7 * 24 * 3600),
+    cl::desc("Remove cache entries unused for this long, in seconds"));
+
+static cl::opt<unsigned long long> CacheMaxSize(
+    "cache-max-size", cl::init(0),
+    cl::desc("Remove the least recently used cache entries above this size, "
+             "in bytes"));
+
 namespace {
 struct ModuleInfo {
   std::vector<bool> CanBeHidden;
@@ -142,6 +179,82 @@ static int listSymbols(StringRef Command, const TargetOptions &Options) {
   return 0;
 }
 
+/// \brief Perform summary-based LTO on the input files.
+///
+/// Module I is compiled to <OutputFilename>.I; with -thinlto-index-only, the
+/// combined function index is written to OutputFilename instead.
+static int thinLTO(StringRef Command, const TargetOptions &Options) {
+  if (OutputFilename.empty()) {
+    errs() << Command << ": -thinlto requires an output file\n";
+    return 1;
+  }
+
+  ThinLTOCodeGenerator CodeGen;
+  CodeGen.setTargetOptions(Options);
+  CodeGen.setCpu(MCPU);
+  CodeGen.setAttr(getFeaturesStr());
+  CodeGen.setCodePICModel(RelocModel);
+  CodeGen.setOptLevel(OptLevel - '0');
+  CodeGen.setParallelism(Parallelism);
+  CodeGen.setCacheDir(CacheDir);
+  CodeGen.setCachePruningInterval(CachePruningInterval);
+  CodeGen.setCacheEntryExpiration(CacheEntryExpiration);
+  CodeGen.setMaxCacheSize(CacheMaxSize);
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  for (auto &Filename : InputFilenames) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+        MemoryBuffer::getFile(Filename);
+    if (std::error_code EC = BufferOrErr.getError()) {
+      errs() << Command << ": error loading file '" << Filename
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    Buffers.push_back(std::move(*BufferOrErr));
+    CodeGen.addModule(Filename, Buffers.back()->getBuffer());
+  }
+
+  std::string ErrorInfo;
+  if (ThinLTOIndexOnly) {
+    std::unique_ptr<FunctionInfoIndex> Index =
+        CodeGen.linkCombinedIndex(ErrorInfo);
+    if (!Index) {
+      errs() << Command << ": error linking function summaries: "
+             << ErrorInfo << "\n";
+      return 1;
+    }
+    std::error_code EC;
+    raw_fd_ostream OS(OutputFilename, EC, sys::fs::F_None);
+    if (EC) {
+      errs() << Command << ": error opening the file '" << OutputFilename
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    WriteFunctionSummaryToFile(*Index, OS);
+    return 0;
+  }
+
+  if (!CodeGen.run(ErrorInfo)) {
+    errs() << Command << ": error compiling the code: " << ErrorInfo << "\n";
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<MemoryBuffer>> &Objects =
+      CodeGen.getProducedBinaries();
+  for (unsigned I = 0, E = Objects.size(); I != E; ++I) {
+    std::string PartFilename = OutputFilename + "." + utostr(I);
+    std::error_code EC;
+    raw_fd_ostream OS(PartFilename, EC, sys::fs::F_None);
+    if (EC) {
+      errs() << Command << ": error opening the file '" << PartFilename
+             << "': " << EC.message() << "\n";
+      return 1;
+    }
+    OS << Objects[I]->getBuffer();
+  }
+  return 0;
+}
+
 int main(int argc, char **argv) {
   // Print a stack trace if we signal out.
   sys::PrintStackTraceOnErrorSignal();
@@ -167,6 +280,9 @@ int main(int argc, char **argv) {
   if (ListSymbolsOnly)
     return listSymbols(argv[0], Options);
 
+  if (ThinLTO || ThinLTOIndexOnly)
+    return thinLTO(argv[0], Options);
+
   unsigned BaseArg = 0;
 
   LTOCodeGenerator CodeGen;
@@ -252,7 +368,56 @@ int main(int argc, char **argv) {
   if (!attrs.empty())
     CodeGen.setAttr(attrs.c_str());
 
-  if (!OutputFilename.empty()) {
+  CodeGen.setCacheDir(CacheDir);
+  CodeGen.setCachePruningPolicy(CachePruningInterval, CacheEntryExpiration,
+                                CacheMaxSize);
+
+  if (Parallelism > 1) {
+    std::string ErrorInfo;
+    if (!CodeGen.optimize(DisableInline, DisableGVNLoadPRE,
+                          DisableLTOVectorization, ErrorInfo)) {
+      errs() << argv[0]
+             << ": error optimizing the code: " << ErrorInfo << "\n";
+      return 1;
+    }
+
+    if (OutputFilename.empty()) {
+      CodeGen.setParallelism(Parallelism);
+      std::vector<const char *> OutputNames;
+      if (!CodeGen.compileOptimizedToFiles(OutputNames, ErrorInfo)) {
+        errs() << argv[0]
+               << ": error compiling the code: " << ErrorInfo << "\n";
+        return 1;
+      }
+      for (const char *OutputName : OutputNames)
+        outs() << "Wrote native object file '" << OutputName << "'\n";
+      return 0;
+    }
+
+    // Partition I is written to <OutputFilename>.I.
+    std::list<tool_output_file> OSs;
+    std::vector<raw_pwrite_stream *> OSPtrs;
+    for (unsigned I = 0; I != Parallelism; ++I) {
+      std::string PartFilename = OutputFilename + "." + utostr(I);
+      std::error_code EC;
+      OSs.emplace_back(PartFilename, EC, sys::fs::F_None);
+      if (EC) {
+        errs() << argv[0] << ": error opening the file '" << PartFilename
+               << "': " << EC.message() << "\n";
+        return 1;
+      }
+      OSPtrs.push_back(&OSs.back().os());
+    }
+
+    if (!CodeGen.compileOptimized(OSPtrs, ErrorInfo)) {
+      errs() << argv[0]
+             << ": error compiling the code: " << ErrorInfo << "\n";
+      return 1;
+    }
+
+    for (tool_output_file &OS : OSs)
+      OS.keep();
+  } else if (!OutputFilename.empty()) {
     std::string ErrorInfo;
     std::unique_ptr<MemoryBuffer> Code = CodeGen.compile(
         DisableInline, DisableGVNLoadPRE, DisableLTOVectorization, ErrorInfo);
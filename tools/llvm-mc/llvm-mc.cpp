@@ -39,6 +39,7 @@
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Support/raw_mapped_file_ostream.h"
 using namespace llvm;
 
 static cl::opt<std::string>
@@ -468,6 +469,7 @@ int main(int argc, char **argv) {
     return 1;
 
   std::unique_ptr<buffer_ostream> BOS;
+  std::unique_ptr<raw_mapped_file_ostream> MOS;
   raw_pwrite_stream *OS = &Out->os();
   std::unique_ptr<MCStreamer> Str;
 
@@ -503,6 +505,11 @@ int main(int argc, char **argv) {
     if (!Out->os().supportsSeeking()) {
       BOS = make_unique<buffer_ostream>(Out->os());
       OS = BOS.get();
+    } else if (Action == AC_Assemble) {
+      // Write the object straight into a mapping of the output file.  Out
+      // still owns the path, so that it is removed if anything goes wrong.
+      MOS = make_unique<raw_mapped_file_ostream>(OutputFilename);
+      OS = MOS.get();
     }
 
     MCCodeEmitter *CE = TheTarget->createMCCodeEmitter(*MCII, *MRI, Ctx);
@@ -537,6 +544,15 @@ int main(int argc, char **argv) {
     Res = Disassembler::disassemble(*TheTarget, TripleName, *STI, *Str,
                                     *Buffer, SrcMgr, Out->os());
 
+  if (Res == 0 && MOS) {
+    Str.reset();
+    if (std::error_code EC = MOS->commit()) {
+      errs() << ProgName << ": " << OutputFilename << ": " << EC.message()
+             << '\n';
+      Res = 1;
+    }
+  }
+
   // Keep output if no errors.
   if (Res == 0) Out->keep();
   return Res;
@@ -11,6 +11,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/ProfileData/InstrProfReader.h"
@@ -20,12 +21,16 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/LineIterator.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <thread>
 
 using namespace llvm;
 
@@ -41,52 +46,127 @@ namespace {
 enum ProfileKinds { instr, sample };
 }
 
-static void mergeInstrProfile(const cl::list<std::string> &Inputs,
-                              StringRef OutputFilename) {
-  if (OutputFilename.compare("-") == 0)
-    exitWithError("Cannot write indexed profdata format to stdout.");
+/// The state of one thread of a merge: the profiles it has merged so far, and
+/// the diagnostics to print once all the threads are done, in input order.
+template <typename ProfileT> struct MergeContext {
+  ProfileT Profile;
+  std::string Warnings;
+  std::error_code Err;
+  std::string ErrWhence;
+
+  void error(std::error_code EC, StringRef Whence) {
+    Err = EC;
+    ErrWhence = Whence;
+  }
+};
+
+/// Merge \p Inputs into the first of \p Contexts: each context loads a
+/// contiguous chunk of the inputs with \p Load, on a thread of its own, and
+/// then the contexts are reduced pairwise with \p Merge, keeping the order of
+/// the inputs.  The contexts only keep merged profiles, so the memory in use
+/// depends on the number of threads and not on the number of inputs.
+template <typename ContextT>
+static void mergeInParallel(
+    ArrayRef<std::string> Inputs, std::vector<ContextT> &Contexts,
+    function_ref<void(ArrayRef<std::string> Inputs, ContextT &Ctx)> Load,
+    function_ref<void(ContextT &Dst, ContextT &Src)> Merge) {
+  auto reportAndClear = [](ContextT &Ctx) {
+    errs() << Ctx.Warnings;
+    Ctx.Warnings.clear();
+    if (Ctx.Err)
+      exitWithError(Ctx.Err.message(), Ctx.ErrWhence);
+  };
+
+  unsigned NumChunks = Contexts.size();
+  if (NumChunks == 1) {
+    Load(Inputs, Contexts[0]);
+    reportAndClear(Contexts[0]);
+    return;
+  }
 
-  std::error_code EC;
-  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
-  if (EC)
-    exitWithError(EC.message(), OutputFilename);
+  ThreadPool Pool(NumChunks);
+  for (unsigned I = 0; I != NumChunks; ++I) {
+    size_t Begin = I * Inputs.size() / NumChunks;
+    size_t End = (I + 1) * Inputs.size() / NumChunks;
+    Pool.async([=, &Contexts] {
+      Load(Inputs.slice(Begin, End - Begin), Contexts[I]);
+    });
+  }
+  Pool.wait();
+  for (ContextT &Ctx : Contexts)
+    reportAndClear(Ctx);
+
+  for (unsigned Step = 1; Step < NumChunks; Step *= 2) {
+    for (unsigned I = 0; I + Step < NumChunks; I += 2 * Step)
+      Pool.async([=, &Contexts] { Merge(Contexts[I], Contexts[I + Step]); });
+    Pool.wait();
+    for (unsigned I = 0; I + Step < NumChunks; I += 2 * Step)
+      reportAndClear(Contexts[I]);
+  }
+}
+
+typedef MergeContext<InstrProfWriter> InstrProfMergeContext;
 
-  InstrProfWriter Writer;
+static void loadInstrProfiles(ArrayRef<std::string> Inputs,
+                              InstrProfMergeContext &Ctx) {
+  raw_string_ostream Warnings(Ctx.Warnings);
   for (const auto &Filename : Inputs) {
     auto ReaderOrErr = InstrProfReader::create(Filename);
     if (std::error_code ec = ReaderOrErr.getError())
-      exitWithError(ec.message(), Filename);
+      return Ctx.error(ec, Filename);
 
     auto Reader = std::move(ReaderOrErr.get());
     for (const auto &I : *Reader)
       if (std::error_code EC =
-              Writer.addFunctionCounts(I.Name, I.Hash, I.Counts))
-        errs() << Filename << ": " << I.Name << ": " << EC.message() << "\n";
+              Ctx.Profile.addFunctionCounts(I.Name, I.Hash, I.Counts))
+        Warnings << Filename << ": " << I.Name << ": " << EC.message() << "\n";
     if (Reader->hasError())
-      exitWithError(Reader->getError().message(), Filename);
+      return Ctx.error(Reader->getError(), Filename);
   }
-  Writer.write(Output);
 }
 
-static void mergeSampleProfile(const cl::list<std::string> &Inputs,
-                               StringRef OutputFilename,
-                               sampleprof::SampleProfileFormat OutputFormat) {
-  using namespace sampleprof;
-  auto WriterOrErr = SampleProfileWriter::create(OutputFilename, OutputFormat);
-  if (std::error_code EC = WriterOrErr.getError())
+static void mergeInstrProfiles(InstrProfMergeContext &Dst,
+                               InstrProfMergeContext &Src) {
+  raw_string_ostream Warnings(Dst.Warnings);
+  Dst.Profile.mergeRecordsFromWriter(
+      std::move(Src.Profile), [&](StringRef Name, std::error_code EC) {
+        Warnings << Name << ": " << EC.message() << "\n";
+      });
+}
+
+static void mergeInstrProfile(ArrayRef<std::string> Inputs,
+                              StringRef OutputFilename, unsigned NumThreads) {
+  if (OutputFilename.compare("-") == 0)
+    exitWithError("Cannot write indexed profdata format to stdout.");
+
+  std::error_code EC;
+  raw_fd_ostream Output(OutputFilename.data(), EC, sys::fs::F_None);
+  if (EC)
     exitWithError(EC.message(), OutputFilename);
 
-  auto Writer = std::move(WriterOrErr.get());
-  StringMap<FunctionSamples> ProfileMap;
+  std::vector<InstrProfMergeContext> Contexts(NumThreads);
+  mergeInParallel<InstrProfMergeContext>(Inputs, Contexts, loadInstrProfiles,
+                                         mergeInstrProfiles);
+  Contexts[0].Profile.write(Output);
+}
+
+typedef MergeContext<StringMap<sampleprof::FunctionSamples>>
+    SampleProfMergeContext;
+
+static void loadSampleProfiles(ArrayRef<std::string> Inputs,
+                               SampleProfMergeContext &Ctx) {
+  using namespace sampleprof;
+  // The readers report their diagnostics through a context of their own, as
+  // they may run on several threads.
+  LLVMContext Context;
   for (const auto &Filename : Inputs) {
-    auto ReaderOrErr =
-        SampleProfileReader::create(Filename, getGlobalContext());
+    auto ReaderOrErr = SampleProfileReader::create(Filename, Context);
     if (std::error_code EC = ReaderOrErr.getError())
-      exitWithError(EC.message(), Filename);
+      return Ctx.error(EC, Filename);
 
     auto Reader = std::move(ReaderOrErr.get());
     if (std::error_code EC = Reader->read())
-      exitWithError(EC.message(), Filename);
+      return Ctx.error(EC, Filename);
 
     StringMap<FunctionSamples> &Profiles = Reader->getProfiles();
     for (StringMap<FunctionSamples>::iterator I = Profiles.begin(),
@@ -94,15 +174,57 @@ static void mergeSampleProfile(const cl::list<std::string> &Inputs,
          I != E; ++I) {
       StringRef FName = I->first();
       FunctionSamples &Samples = I->second;
-      ProfileMap[FName].merge(Samples);
+      Ctx.Profile[FName].merge(Samples);
     }
   }
-  Writer->write(ProfileMap);
+}
+
+static void mergeSampleProfiles(SampleProfMergeContext &Dst,
+                                SampleProfMergeContext &Src) {
+  for (auto &I : Src.Profile)
+    Dst.Profile[I.first()].merge(I.second);
+  Src.Profile.clear();
+}
+
+static void mergeSampleProfile(ArrayRef<std::string> Inputs,
+                               StringRef OutputFilename,
+                               sampleprof::SampleProfileFormat OutputFormat,
+                               unsigned NumThreads) {
+  using namespace sampleprof;
+  auto WriterOrErr = SampleProfileWriter::create(OutputFilename, OutputFormat);
+  if (std::error_code EC = WriterOrErr.getError())
+    exitWithError(EC.message(), OutputFilename);
+
+  auto Writer = std::move(WriterOrErr.get());
+  std::vector<SampleProfMergeContext> Contexts(NumThreads);
+  mergeInParallel<SampleProfMergeContext>(Inputs, Contexts, loadSampleProfiles,
+                                          mergeSampleProfiles);
+  Writer->write(Contexts[0].Profile);
+}
+
+/// Add the names of the files listed in \p InputFilenamesFile, one per line,
+/// to \p Inputs.
+static void addInputFilenames(StringRef InputFilenamesFile,
+                              std::vector<std::string> &Inputs) {
+  auto BufOrError = MemoryBuffer::getFileOrSTDIN(InputFilenamesFile);
+  if (std::error_code EC = BufOrError.getError())
+    exitWithError(EC.message(), InputFilenamesFile);
+
+  // Skip blank lines and comments.
+  for (line_iterator I(*BufOrError.get(), /*SkipBlanks=*/true, '#'), E; I != E;
+       ++I)
+    Inputs.push_back(I->trim());
 }
 
 static int merge_main(int argc, const char *argv[]) {
-  cl::list<std::string> Inputs(cl::Positional, cl::Required, cl::OneOrMore,
-                               cl::desc("<filenames...>"));
+  cl::list<std::string> InputFilenames(cl::Positional, cl::ZeroOrMore,
+                                       cl::desc("<filenames...>"));
+  cl::opt<std::string> InputFilenamesFile(
+      "input-files", cl::init(""), cl::value_desc("file"),
+      cl::desc("Path to a file containing the names of the input profiles, "
+               "one per line"));
+  cl::alias InputFilenamesFileA("f", cl::desc("Alias for --input-files"),
+                                cl::aliasopt(InputFilenamesFile));
 
   cl::opt<std::string> OutputFilename("output", cl::value_desc("output"),
                                       cl::init("-"), cl::Required,
@@ -123,12 +245,31 @@ static int merge_main(int argc, const char *argv[]) {
                  clEnumValN(sampleprof::SPF_GCC, "gcc", "GCC encoding"),
                  clEnumValEnd));
 
+  cl::opt<unsigned> NumThreads(
+      "num-threads", cl::init(0), cl::value_desc("N"),
+      cl::desc("Number of merge threads to use (default: autodetect)"));
+  cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
+                        cl::aliasopt(NumThreads));
+
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
+  std::vector<std::string> Inputs(InputFilenames.begin(),
+                                  InputFilenames.end());
+  if (!InputFilenamesFile.empty())
+    addInputFilenames(InputFilenamesFile, Inputs);
+  if (Inputs.empty())
+    exitWithError("No input files specified. See " +
+                  sys::path::filename(argv[0]) + " -help");
+
+  // There is no point in more threads than inputs.
+  if (NumThreads == 0)
+    NumThreads = std::max(1U, std::thread::hardware_concurrency());
+  NumThreads = std::min<size_t>(NumThreads, Inputs.size());
+
   if (ProfileKind == instr)
-    mergeInstrProfile(Inputs, OutputFilename);
+    mergeInstrProfile(Inputs, OutputFilename, NumThreads);
   else
-    mergeSampleProfile(Inputs, OutputFilename, OutputFormat);
+    mergeSampleProfile(Inputs, OutputFilename, OutputFormat, NumThreads);
 
   return 0;
 }
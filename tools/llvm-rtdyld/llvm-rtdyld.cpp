@@ -17,6 +17,8 @@
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/ExecutionEngine/RuntimeDyldChecker.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
 #include "llvm/MC/MCAsmInfo.h"
 #include "llvm/MC/MCContext.h"
 #include "llvm/MC/MCDisassembler.h"
@@ -27,6 +29,7 @@
 #include "llvm/Object/MachO.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Memory.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -34,6 +37,7 @@
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <list>
 #include <system_error>
@@ -50,7 +54,8 @@ enum ActionType {
   AC_PrintObjectLineInfo,
   AC_PrintLineInfo,
   AC_PrintDebugLineInfo,
-  AC_Verify
+  AC_Verify,
+  AC_Benchmark
 };
 
 static cl::opt<ActionType>
@@ -66,6 +71,8 @@ Action(cl::desc("Action to perform:"),
                              "Like -printlineinfo but does not load the object first"),
                   clEnumValN(AC_Verify, "verify",
                              "Load, link and verify the resulting memory image."),
+                  clEnumValN(AC_Benchmark, "benchmark",
+                             "Load many copies of the inputs, run them and report the time spent."),
                   clEnumValEnd));
 
 static cl::opt<std::string>
@@ -111,6 +118,49 @@ SpecificSectionMappings("map-section",
                         cl::desc("Map a section to a specific address."),
                         cl::ZeroOrMore);
 
+static cl::opt<bool>
+LazySymbolTables("lazy-symbol-tables",
+                 cl::desc("Build the symbol table of each object on demand."),
+                 cl::init(false));
+
+static cl::opt<unsigned>
+RelocationThreads("relocation-threads",
+                  cl::desc("Number of threads to apply relocations with."),
+                  cl::init(0));
+
+static cl::opt<unsigned>
+BenchmarkCopies("benchmark-copies",
+                cl::desc("For -benchmark only: number of copies of the inputs "
+                         "to load."),
+                cl::init(1000));
+
+static cl::opt<unsigned>
+BenchmarkRounds("benchmark-rounds",
+                cl::desc("For -benchmark only: number of times the entry "
+                         "point of each copy is called, in turn. Run under a "
+                         "profiler (e.g. perf stat -e iTLB-load-misses) to "
+                         "measure the cost of spreading the code."),
+                cl::init(100));
+
+enum MemoryManagerKind { MM_Section, MM_Slab };
+
+static cl::opt<MemoryManagerKind>
+BenchmarkMemMgr("benchmark-memory-manager",
+                cl::desc("For -benchmark only: memory manager to use."),
+                cl::init(MM_Slab),
+                cl::values(clEnumValN(MM_Section, "section",
+                                      "SectionMemoryManager"),
+                           clEnumValN(MM_Slab, "slab",
+                                      "SlabMemoryManager, all the copies "
+                                      "sharing an arena"),
+                           clEnumValEnd));
+
+static cl::opt<bool>
+BenchmarkHugePages("benchmark-huge-pages",
+                   cl::desc("For -benchmark only: back the slabs of the slab "
+                            "memory manager with huge pages."),
+                   cl::init(false));
+
 /* *** */
 
 // A trivial memory manager that doesn't do anything fancy, just uses the
@@ -213,6 +263,8 @@ static int printLineInfoForInput(bool LoadObjects, bool UseDebugObj) {
     // Instantiate a dynamic linker.
     TrivialMemoryManager MemMgr;
     RuntimeDyld Dyld(MemMgr, MemMgr);
+    Dyld.setLazySymbolTables(LazySymbolTables);
+    Dyld.setRelocationThreadCount(RelocationThreads);
 
     // Load the input memory buffer.
 
@@ -346,6 +398,8 @@ static int executeInput() {
   // Instantiate a dynamic linker.
   TrivialMemoryManager MemMgr;
   RuntimeDyld Dyld(MemMgr, MemMgr);
+  Dyld.setLazySymbolTables(LazySymbolTables);
+  Dyld.setRelocationThreadCount(RelocationThreads);
 
   // FIXME: Preserve buffers until resolveRelocations time to work around a bug
   //        in RuntimeDyldELF.
@@ -411,6 +465,93 @@ static int executeInput() {
   return Main(1, Argv);
 }
 
+static int benchmarkInputs() {
+  // Load any dylibs requested on the command line.
+  loadDylibs();
+
+  // If we don't have any input files, read from stdin.
+  if (!InputFileList.size())
+    InputFileList.push_back("-");
+  std::vector<std::unique_ptr<MemoryBuffer>> InputBuffers;
+  std::vector<std::unique_ptr<ObjectFile>> Objects;
+  for (auto &File : InputFileList) {
+    ErrorOr<std::unique_ptr<MemoryBuffer>> InputBuffer =
+        MemoryBuffer::getFileOrSTDIN(File);
+    if (std::error_code EC = InputBuffer.getError())
+      return Error("unable to read input: '" + EC.message() + "'");
+    ErrorOr<std::unique_ptr<ObjectFile>> MaybeObj(
+      ObjectFile::createObjectFile((*InputBuffer)->getMemBufferRef()));
+
+    if (std::error_code EC = MaybeObj.getError())
+      return Error("unable to create object file: '" + EC.message() + "'");
+
+    InputBuffers.push_back(std::move(*InputBuffer));
+    Objects.push_back(std::move(*MaybeObj));
+  }
+
+  struct LoadedCopy {
+    std::unique_ptr<RTDyldMemoryManager> MemMgr;
+    std::unique_ptr<RuntimeDyld> Dyld;
+    void (*Entry)();
+  };
+  // The arena must outlive the memory managers of the copies, including when
+  // returning early on an error.
+  JITMemoryArena Arena(JITMemoryArena::HugePageSize, BenchmarkHugePages);
+  std::vector<LoadedCopy> Copies(BenchmarkCopies);
+
+  auto Now = []() { return TimeRecord::getCurrentTime().getWallTime(); };
+  double LoadTime = 0, FinalizeTime = 0, CallTime = 0, FreeTime = 0;
+
+  for (LoadedCopy &Copy : Copies) {
+    double Start = Now();
+    if (BenchmarkMemMgr == MM_Slab)
+      Copy.MemMgr = llvm::make_unique<SlabMemoryManager>(Arena);
+    else
+      Copy.MemMgr = llvm::make_unique<SectionMemoryManager>();
+    Copy.Dyld = llvm::make_unique<RuntimeDyld>(*Copy.MemMgr, *Copy.MemMgr);
+    Copy.Dyld->setLazySymbolTables(LazySymbolTables);
+    Copy.Dyld->setRelocationThreadCount(RelocationThreads);
+    for (auto &Obj : Objects) {
+      Copy.Dyld->loadObject(*Obj);
+      if (Copy.Dyld->hasError())
+        return Error(Copy.Dyld->getErrorString());
+    }
+    Copy.Dyld->resolveRelocations();
+    Copy.Entry = reinterpret_cast<void (*)()>(
+        Copy.Dyld->getSymbolLocalAddress(EntryPoint));
+    if (BenchmarkRounds && !Copy.Entry)
+      return Error("no definition for '" + EntryPoint + "'");
+    double Loaded = Now();
+    LoadTime += Loaded - Start;
+
+    std::string ErrMsg;
+    if (Copy.MemMgr->finalizeMemory(&ErrMsg))
+      return Error("unable to finalize memory: '" + ErrMsg + "'");
+    FinalizeTime += Now() - Loaded;
+  }
+
+  // Go round the copies, so that the code of all of them is live at once.
+  double Start = Now();
+  for (unsigned Round = 0; Round != BenchmarkRounds; ++Round)
+    for (LoadedCopy &Copy : Copies)
+      Copy.Entry();
+  CallTime = Now() - Start;
+
+  unsigned NumSlabs = Arena.getNumSlabs();
+  Start = Now();
+  Copies.clear();
+  FreeTime = Now() - Start;
+
+  outs() << "copies: " << BenchmarkCopies << "\n";
+  if (BenchmarkMemMgr == MM_Slab)
+    outs() << "slabs: " << NumSlabs << "\n";
+  outs() << format("load: %.6fs\n", LoadTime)
+         << format("finalize: %.6fs\n", FinalizeTime)
+         << format("calls: %.6fs\n", CallTime)
+         << format("free: %.6fs\n", FreeTime);
+  return 0;
+}
+
 static int checkAllExpressions(RuntimeDyldChecker &Checker) {
   for (const auto& CheckerFileName : CheckFiles) {
     ErrorOr<std::unique_ptr<MemoryBuffer>> CheckerFileBuf =
@@ -601,6 +742,8 @@ static int linkAndVerify() {
   // Instantiate a dynamic linker.
   TrivialMemoryManager MemMgr;
   RuntimeDyld Dyld(MemMgr, MemMgr);
+  Dyld.setLazySymbolTables(LazySymbolTables);
+  Dyld.setRelocationThreadCount(RelocationThreads);
   Dyld.setProcessAllSections(true);
   RuntimeDyldChecker Checker(Dyld, Disassembler.get(), InstPrinter.get(),
                              llvm::dbgs());
@@ -680,5 +823,7 @@ int main(int argc, char **argv) {
     return printLineInfoForInput(/* LoadObjects */false,/* UseDebugObj */false);
   case AC_Verify:
     return linkAndVerify();
+  case AC_Benchmark:
+    return benchmarkInputs();
   }
 }
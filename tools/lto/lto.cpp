@@ -84,6 +84,7 @@ struct LibLTOCodeGenerator : LTOCodeGenerator {
       : LTOCodeGenerator(std::move(Context)) {}
 
   std::unique_ptr<MemoryBuffer> NativeObjectFile;
+  std::vector<const char *> NativeObjectFileNames;
 };
 
 }
@@ -344,6 +345,23 @@ const void *lto_codegen_compile_optimized(lto_code_gen_t cg, size_t *length) {
   return CG->NativeObjectFile->getBufferStart();
 }
 
+void lto_codegen_set_parallelism(lto_code_gen_t cg, unsigned int parallelism) {
+  unwrap(cg)->setParallelism(parallelism);
+}
+
+bool lto_codegen_compile_optimized_to_files(lto_code_gen_t cg,
+                                            const char ***names,
+                                            unsigned int *num_files) {
+  maybeParseOptions(cg);
+  LibLTOCodeGenerator *CG = unwrap(cg);
+  if (!CG->compileOptimizedToFiles(CG->NativeObjectFileNames,
+                                   sLastErrorString))
+    return true;
+  *names = CG->NativeObjectFileNames.data();
+  *num_files = CG->NativeObjectFileNames.size();
+  return false;
+}
+
 bool lto_codegen_compile_to_file(lto_code_gen_t cg, const char **name) {
   maybeParseOptions(cg);
   return !unwrap(cg)->compile_to_file(
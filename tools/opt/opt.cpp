@@ -50,6 +50,7 @@
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/IPO/ParallelFunctionPasses.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 #include <algorithm>
 #include <memory>
@@ -185,6 +186,15 @@ static cl::opt<bool> PreserveBitcodeUseListOrder(
     cl::desc("Preserve use-list order when writing LLVM bitcode."),
     cl::init(true), cl::Hidden);
 
+static cl::opt<bool> EmitFunctionSummary(
+    "function-summary",
+    cl::desc("Emit function summary index for summary-based LTO."),
+    cl::init(false));
+
+static cl::opt<unsigned> FunctionPassThreads(
+    "function-pass-threads", cl::init(1), cl::value_desc("N"),
+    cl::desc("Run the function simplification passes of -O<n> on N threads"));
+
 static cl::opt<bool> PreserveAssemblyUseListOrder(
     "preserve-ll-uselistorder",
     cl::desc("Preserve use-list order when writing LLVM assembly."),
@@ -199,6 +209,23 @@ static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
     PM.add(createVerifierPass());
 }
 
+/// The optimization and size levels the function pass manager was populated
+/// for, in order, to populate the ones of -function-pass-threads the same way.
+static std::vector<std::pair<unsigned, unsigned>> FunctionPassLevels;
+
+/// This routine adds the function simplification passes of the selected
+/// optimization level to FPM.
+static void AddFunctionOptimizationPasses(legacy::FunctionPassManager &FPM,
+                                          unsigned OptLevel,
+                                          unsigned SizeLevel) {
+  FPM.add(createVerifierPass()); // Verify that input is correct
+
+  PassManagerBuilder Builder;
+  Builder.OptLevel = OptLevel;
+  Builder.SizeLevel = SizeLevel;
+  Builder.populateFunctionPassManager(FPM);
+}
+
 /// This routine adds optimization passes based on selected optimization level,
 /// OptLevel.
 ///
@@ -206,7 +233,8 @@ static inline void addPass(legacy::PassManagerBase &PM, Pass *P) {
 static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
                                   legacy::FunctionPassManager &FPM,
                                   unsigned OptLevel, unsigned SizeLevel) {
-  FPM.add(createVerifierPass()); // Verify that input is correct
+  AddFunctionOptimizationPasses(FPM, OptLevel, SizeLevel);
+  FunctionPassLevels.push_back(std::make_pair(OptLevel, SizeLevel));
 
   PassManagerBuilder Builder;
   Builder.OptLevel = OptLevel;
@@ -234,7 +262,6 @@ static void AddOptimizationPasses(legacy::PassManagerBase &MPM,
   Builder.SLPVectorize =
       DisableSLPVectorization ? false : OptLevel > 1 && SizeLevel < 2;
 
-  Builder.populateFunctionPassManager(FPM);
   Builder.populateModulePassManager(MPM);
 }
 
@@ -571,7 +598,28 @@ int main(int argc, char **argv) {
   if (OptLevelO3)
     AddOptimizationPasses(Passes, *FPasses, 3, 0);
 
-  if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) {
+  if ((OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz || OptLevelO3) &&
+      FunctionPassThreads > 1) {
+    // Every thread needs passes and a TargetMachine of its own.
+    FPasses.reset();
+    M = runFunctionPassesInParallel(
+        std::move(M), FunctionPassThreads,
+        [&](legacy::FunctionPassManager &FPM) {
+          std::shared_ptr<TargetMachine> ThreadTM;
+          if (TM)
+            ThreadTM.reset(
+                GetTargetMachine(ModuleTriple, CPUStr, FeaturesStr, Options));
+          TargetIRAnalysis TIRA;
+          if (ThreadTM)
+            TIRA = TargetIRAnalysis([ThreadTM](Function &F) {
+              return ThreadTM->getTargetIRAnalysis().run(F);
+            });
+          FPM.add(createTargetTransformInfoWrapperPass(std::move(TIRA)));
+          for (const auto &Levels : FunctionPassLevels)
+            AddFunctionOptimizationPasses(FPM, Levels.first, Levels.second);
+        });
+  } else if (OptLevelO1 || OptLevelO2 || OptLevelOs || OptLevelOz ||
+             OptLevelO3) {
     FPasses->doInitialization();
     for (Function &F : *M)
       FPasses->run(F);
@@ -588,8 +636,8 @@ int main(int argc, char **argv) {
       Passes.add(
           createPrintModulePass(Out->os(), "", PreserveAssemblyUseListOrder));
     else
-      Passes.add(
-          createBitcodeWriterPass(Out->os(), PreserveBitcodeUseListOrder));
+      Passes.add(createBitcodeWriterPass(
+          Out->os(), PreserveBitcodeUseListOrder, EmitFunctionSummary));
   }
 
   // Before executing passes, print the final values of the LLVM options.
@@ -13,6 +13,7 @@
 #include "llvm/Bitcode/BitstreamWriter.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
@@ -49,14 +50,15 @@ static void writeModuleToBuffer(std::unique_ptr<Module> Mod,
   WriteBitcodeToFile(Mod.get(), OS);
 }
 
-static std::unique_ptr<Module> getLazyModuleFromAssembly(LLVMContext &Context,
-                                                         SmallString<1024> &Mem,
-                                                         const char *Assembly) {
+static std::unique_ptr<Module>
+getLazyModuleFromAssembly(LLVMContext &Context, SmallString<1024> &Mem,
+                          const char *Assembly,
+                          bool ShouldLazyLoadMetadata = false) {
   writeModuleToBuffer(parseAssembly(Assembly), Mem);
   std::unique_ptr<MemoryBuffer> Buffer =
       MemoryBuffer::getMemBuffer(Mem.str(), "test", false);
-  ErrorOr<std::unique_ptr<Module>> ModuleOrErr =
-      getLazyBitcodeModule(std::move(Buffer), Context);
+  ErrorOr<std::unique_ptr<Module>> ModuleOrErr = getLazyBitcodeModule(
+      std::move(Buffer), Context, nullptr, ShouldLazyLoadMetadata);
   return std::move(ModuleOrErr.get());
 }
 
@@ -273,4 +275,78 @@ TEST(BitReaderTest, MaterializeFunctionsForBlockAddrInFunctionAfter) {
   EXPECT_FALSE(verifyModule(*M, &dbgs()));
 }
 
+const char *MetadataAssembly = "define void @f() {\n"
+                               "  ret void, !foo !0, !bar !2\n"
+                               "}\n"
+                               "define void @g() {\n"
+                               "  ret void, !foo !1\n"
+                               "}\n"
+                               "!named = !{!3}\n"
+                               "!0 = distinct !{!0, !4}\n"
+                               "!1 = !{!\"only-g\"}\n"
+                               "!2 = !GenericDINode(tag: DW_TAG_entry_point, "
+                               "header: \"f-header\")\n"
+                               "!3 = !{!4, !\"named\"}\n"
+                               "!4 = !{!\"only-f\"}\n";
+
+// Tests that materializing a function only loads the metadata it refers to.
+TEST(BitReaderTest, MaterializeFunctionLoadsOnlyItsMetadata) {
+  SmallString<1024> Mem;
+  LLVMContext Context;
+  std::unique_ptr<Module> M = getLazyModuleFromAssembly(
+      Context, Mem, MetadataAssembly, /*ShouldLazyLoadMetadata=*/true);
+  MDString *OnlyF = MDString::get(Context, "only-f");
+  MDString *OnlyG = MDString::get(Context, "only-g");
+
+  Function *F = M->getFunction("f");
+  EXPECT_FALSE(F->materialize());
+  MDTuple *FNode = MDTuple::getIfExists(Context, OnlyF);
+  ASSERT_TRUE(FNode);
+  EXPECT_FALSE(MDTuple::getIfExists(Context, OnlyG));
+  EXPECT_FALSE(M->getNamedMetadata("named"));
+
+  Instruction &FRet = F->front().front();
+  auto *Self = cast<MDNode>(FRet.getMetadata("foo"));
+  EXPECT_TRUE(Self->isResolved());
+  EXPECT_EQ(Self, Self->getOperand(0));
+  EXPECT_EQ(FNode, Self->getOperand(1));
+  EXPECT_EQ("f-header",
+            cast<GenericDINode>(FRet.getMetadata("bar"))->getHeader());
+
+  Function *G = M->getFunction("g");
+  EXPECT_FALSE(G->materialize());
+  MDTuple *GNode = MDTuple::getIfExists(Context, OnlyG);
+  ASSERT_TRUE(GNode);
+  EXPECT_EQ(GNode, G->front().front().getMetadata("foo"));
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+}
+
+// Tests that the whole metadata block can still be loaded after some of it
+// was loaded on demand.
+TEST(BitReaderTest, MaterializeMetadataAfterFunction) {
+  SmallString<1024> Mem;
+  LLVMContext Context;
+  std::unique_ptr<Module> M = getLazyModuleFromAssembly(
+      Context, Mem, MetadataAssembly, /*ShouldLazyLoadMetadata=*/true);
+
+  EXPECT_FALSE(M->getFunction("f")->materialize());
+  EXPECT_FALSE(M->materializeAll());
+  NamedMDNode *Named = M->getNamedMetadata("named");
+  ASSERT_TRUE(Named);
+  MDNode *Node = Named->getOperand(0);
+  EXPECT_EQ(MDTuple::getIfExists(Context, MDString::get(Context, "only-f")),
+            Node->getOperand(0));
+  EXPECT_EQ(MDString::get(Context, "named"), Node->getOperand(1));
+  EXPECT_FALSE(verifyModule(*M, &dbgs()));
+
+  // The result is the same as reading the module eagerly.
+  std::string Lazy, Eager;
+  raw_string_ostream LazyOS(Lazy), EagerOS(Eager);
+  M->print(LazyOS, nullptr);
+  std::unique_ptr<Module> Expected = parseAssembly(MetadataAssembly);
+  Expected->setModuleIdentifier(M->getModuleIdentifier());
+  Expected->print(EagerOS, nullptr);
+  EXPECT_EQ(EagerOS.str(), LazyOS.str());
+}
+
 } // end namespace
@@ -11,9 +11,11 @@
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
 #include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/Support/FileSystem.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -76,6 +78,36 @@ private:
   bool                            DuplicateInserted;
 };
 
+class CountingFileObjectCache : public FileObjectCache {
+public:
+  CountingFileObjectCache(StringRef CacheDir, const TargetMachine &TM)
+      : FileObjectCache(CacheDir, TM), NumCompiled(0) {}
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override {
+    ++NumCompiled;
+    FileObjectCache::notifyObjectCompiled(M, Obj);
+  }
+
+  unsigned NumCompiled;
+};
+
+unsigned countEntries(StringRef Dir) {
+  unsigned NumEntries = 0;
+  std::error_code EC;
+  for (sys::fs::directory_iterator File(Dir, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC))
+    ++NumEntries;
+  return NumEntries;
+}
+
+void removeDir(StringRef Dir) {
+  std::error_code EC;
+  for (sys::fs::directory_iterator File(Dir, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC))
+    sys::fs::remove(File->path());
+  sys::fs::remove(Dir);
+}
+
 class MCJITObjectCacheTest : public testing::Test, public MCJITTestBase {
 protected:
 
@@ -228,5 +260,60 @@ TEST_F(MCJITObjectCacheTest, VerifyNonLoadFromCache) {
   EXPECT_FALSE(Cache->wereDuplicatesInserted());
 }
 
+TEST_F(MCJITObjectCacheTest, FileObjectCache) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  SmallString<64> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("FileObjectCacheTestDir", Dir));
+
+  // Compile this module and save it.
+  createJIT(std::move(M));
+  std::unique_ptr<CountingFileObjectCache> Cache(
+      new CountingFileObjectCache(Dir, *TheJIT->getTargetMachine()));
+  TheJIT->setObjectCache(Cache.get());
+  compileAndRun();
+  EXPECT_EQ(1u, Cache->NumCompiled);
+  EXPECT_EQ(1u, countEntries(Dir));
+  TheJIT.reset();
+
+  // A module with the same IR under another name is loaded from the cache by
+  // another cache using the same directory, as after a restart.
+  MM.reset(new SectionMemoryManager());
+  M.reset(createEmptyModule("<same-as-main>"));
+  Main = insertMainFunction(M.get(), OriginalRC);
+  createJIT(std::move(M));
+  Cache.reset(new CountingFileObjectCache(Dir, *TheJIT->getTargetMachine()));
+  TheJIT->setObjectCache(Cache.get());
+  compileAndRun();
+  EXPECT_EQ(0u, Cache->NumCompiled);
+  EXPECT_EQ(1u, countEntries(Dir));
+  TheJIT.reset();
+
+  // A module with different IR is compiled.
+  MM.reset(new SectionMemoryManager());
+  M.reset(createEmptyModule("<main>"));
+  Main = insertMainFunction(M.get(), ReplacementRC);
+  createJIT(std::move(M));
+  TheJIT->setObjectCache(Cache.get());
+  compileAndRun(ReplacementRC);
+  EXPECT_EQ(1u, Cache->NumCompiled);
+  EXPECT_EQ(2u, countEntries(Dir));
+  TheJIT.reset();
+
+  removeDir(Dir);
+}
+
+TEST(FileObjectCacheTest, KeyDependsOnConfig) {
+  LLVMContext Context;
+  Module M("<main>", Context);
+  std::string Key = FileObjectCache::computeKey(M, "opt=0;");
+  EXPECT_EQ(Key, FileObjectCache::computeKey(M, "opt=0;"));
+  EXPECT_NE(Key, FileObjectCache::computeKey(M, "opt=2;"));
+
+  // The module identifier does not matter.
+  M.setModuleIdentifier("<other>");
+  EXPECT_EQ(Key, FileObjectCache::computeKey(M, "opt=0;"));
+}
+
 } // Namespace
 
@@ -0,0 +1,331 @@
+//===- ConcurrencyTest.cpp - Unit tests for the Orc layers on many threads ===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/IRCompileLayer.h"
+#include "llvm/ExecutionEngine/Orc/LazyEmittingLayer.h"
+#include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/Orc/OrcTargetSupport.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Mangler.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace llvm;
+using namespace llvm::orc;
+
+namespace {
+
+#if LLVM_ENABLE_THREADS
+
+class DummyCallbackManager : public JITCompileCallbackManagerBase {
+public:
+  DummyCallbackManager()
+      : JITCompileCallbackManagerBase(/*ErrorHandlerAddress=*/1, 1),
+        NextTrampolineAddr(0x1000) {}
+
+  CompileCallbackInfo getCompileCallback(LLVMContext &Context) override {
+    std::lock_guard<std::mutex> Lock(TrampolinesMutex);
+    TargetAddress TrampolineAddr = NextTrampolineAddr++;
+    return CompileCallbackInfo(TrampolineAddr,
+                               ActiveTrampolines[TrampolineAddr]);
+  }
+
+private:
+  TargetAddress NextTrampolineAddr;
+};
+
+TEST(OrcConcurrencyTest, CompileCallbackRunsOnce) {
+  LLVMContext Context;
+  DummyCallbackManager CCMgr;
+  std::atomic<unsigned> NumCompiles(0);
+
+  auto CCInfo = CCMgr.getCompileCallback(Context);
+  TargetAddress TrampolineAddr = CCInfo.getAddress();
+  CCInfo.setCompileAction([&NumCompiles]() -> TargetAddress {
+    ++NumCompiles;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return 0x2000;
+  });
+
+  std::vector<std::thread> Threads;
+  std::vector<TargetAddress> Results(8);
+  for (unsigned I = 0; I < Results.size(); ++I)
+    Threads.emplace_back([&CCMgr, &Results, TrampolineAddr, I]() {
+      Results[I] = CCMgr.executeCompileCallback(TrampolineAddr);
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+
+  EXPECT_EQ(1u, NumCompiles);
+  for (TargetAddress Addr : Results)
+    EXPECT_EQ(0x2000u, Addr);
+
+  // Late callers still get the compiled address.
+  EXPECT_EQ(0x2000u, CCMgr.executeCompileCallback(TrampolineAddr));
+}
+
+// Builds the target machines of the tests below, or nothing if the host is
+// not supported.
+class OrcConcurrencyJITTest : public testing::Test {
+protected:
+  void SetUp() override {
+    T = nullptr;
+    // The callback manager's resolver block is written in inline asm.
+    if (InitializeNativeTarget() || InitializeNativeTargetAsmPrinter() ||
+        InitializeNativeTargetAsmParser())
+      return;
+    TT = sys::getProcessTriple();
+    // The callback trampolines are only available on x86-64.
+    if (Triple(TT).getArch() != Triple::x86_64)
+      return;
+    std::string Error;
+    T = TargetRegistry::lookupTarget(TT, Error);
+    if (T)
+      DLTM = buildTM();
+  }
+
+  std::unique_ptr<TargetMachine> buildTM() const {
+    return std::unique_ptr<TargetMachine>(
+        T->createTargetMachine(TT, "", "", TargetOptions(), Reloc::Default,
+                               CodeModel::JITDefault));
+  }
+
+  std::string mangle(StringRef Name) const {
+    std::string MangledName;
+    {
+      raw_string_ostream MangledNameStream(MangledName);
+      Mangler(DLTM->getDataLayout()).getNameWithPrefix(MangledNameStream,
+                                                        Name);
+    }
+    return MangledName;
+  }
+
+  std::unique_ptr<Module> createModule(LLVMContext &Context, StringRef Name) {
+    auto M = llvm::make_unique<Module>(Name, Context);
+    M->setDataLayout(*DLTM->getDataLayout());
+    return M;
+  }
+
+  // Declare "int Name()", or "int Name(int)" if HasArg is set.
+  static Function *declareFunction(Module &M, StringRef Name,
+                                   bool HasArg = false) {
+    Type *Int32Ty = Type::getInt32Ty(M.getContext());
+    FunctionType *FTy = HasArg ? FunctionType::get(Int32Ty, Int32Ty, false)
+                               : FunctionType::get(Int32Ty, false);
+    return Function::Create(FTy, GlobalValue::ExternalLinkage, Name, &M);
+  }
+
+  std::string TT;
+  const Target *T;
+  std::unique_ptr<TargetMachine> DLTM;
+};
+
+TEST_F(OrcConcurrencyJITTest, LazyEmittingLayer) {
+  if (!DLTM)
+    return;
+
+  typedef ObjectLinkingLayer<> ObjLayerT;
+  typedef IRCompileLayer<ObjLayerT> CompileLayerT;
+  typedef LazyEmittingLayer<CompileLayerT> LazyEmitLayerT;
+
+  const unsigned NumThreads = 8;
+  LLVMContext SharedContext;
+  std::vector<std::unique_ptr<LLVMContext>> Contexts;
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Contexts.push_back(llvm::make_unique<LLVMContext>());
+
+  std::atomic<unsigned> NumCompiles(0), NumSharedCompiles(0);
+  ConcurrentIRCompiler Compile([this]() { return buildTM(); });
+  ObjLayerT ObjectLayer;
+  CompileLayerT CompileLayer(ObjectLayer, [&](Module &M) {
+    ++NumCompiles;
+    if (M.getName() == "shared")
+      ++NumSharedCompiles;
+    return Compile(M);
+  });
+  LazyEmitLayerT LazyEmitLayer(CompileLayer);
+
+  auto createResolver = [&LazyEmitLayer]() {
+    return createLambdaResolver(
+        [&LazyEmitLayer](const std::string &Name) {
+          if (auto Sym = LazyEmitLayer.findSymbol(Name, false))
+            return RuntimeDyld::SymbolInfo(Sym.getAddress(), Sym.getFlags());
+          return RuntimeDyld::SymbolInfo(nullptr);
+        },
+        [](const std::string &Name) {
+          return RuntimeDyld::SymbolInfo(nullptr);
+        });
+  };
+
+  // int shared(int X) { return X + 1000; }
+  {
+    auto M = createModule(SharedContext, "shared");
+    Function *F = declareFunction(*M, "shared", true);
+    IRBuilder<> B(BasicBlock::Create(SharedContext, "entry", F));
+    B.CreateRet(B.CreateAdd(&*F->arg_begin(), B.getInt32(1000)));
+    std::vector<std::unique_ptr<Module>> S;
+    S.push_back(std::move(M));
+    LazyEmitLayer.addModuleSet(std::move(S),
+                               llvm::make_unique<SectionMemoryManager>(),
+                               createResolver());
+  }
+
+  // Each thread adds a module calling the shared one, and calls it. The
+  // shared module is emitted by whichever thread gets there first.
+  std::vector<std::thread> Threads;
+  std::vector<int> Results(NumThreads);
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Threads.emplace_back([&, I]() {
+      // int f<I>() { return shared(I); }
+      std::string Name = "f" + utostr(I);
+      auto M = createModule(*Contexts[I], Name);
+      Function *Shared = declareFunction(*M, "shared", true);
+      Function *F = declareFunction(*M, Name);
+      IRBuilder<> B(BasicBlock::Create(*Contexts[I], "entry", F));
+      B.CreateRet(B.CreateCall(Shared, B.getInt32(I)));
+      std::vector<std::unique_ptr<Module>> S;
+      S.push_back(std::move(M));
+      auto H = LazyEmitLayer.addModuleSet(
+          std::move(S), llvm::make_unique<SectionMemoryManager>(),
+          createResolver());
+      auto Sym = LazyEmitLayer.findSymbolIn(H, mangle(Name), false);
+      ASSERT_TRUE(!!Sym);
+      int (*FPtr)() = reinterpret_cast<int (*)()>(
+          static_cast<uintptr_t>(Sym.getAddress()));
+      Results[I] = FPtr();
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+
+  for (unsigned I = 0; I < NumThreads; ++I)
+    EXPECT_EQ(static_cast<int>(I) + 1000, Results[I]);
+  EXPECT_EQ(1u, NumSharedCompiles);
+  EXPECT_EQ(NumThreads + 1, NumCompiles);
+}
+
+TEST_F(OrcConcurrencyJITTest, CompileOnDemandLayer) {
+  if (!DLTM)
+    return;
+
+  typedef ObjectLinkingLayer<> ObjLayerT;
+  typedef IRCompileLayer<ObjLayerT> CompileLayerT;
+  typedef JITCompileCallbackManager<CompileLayerT, OrcX86_64> CCMgrT;
+  typedef CompileOnDemandLayer<CompileLayerT, CCMgrT> CODLayerT;
+
+  const unsigned NumThreads = 8;
+  LLVMContext Context;
+  std::vector<std::unique_ptr<LLVMContext>> Contexts;
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Contexts.push_back(llvm::make_unique<LLVMContext>());
+
+  std::mutex CompiledMutex;
+  std::vector<std::string> Compiled;
+  ConcurrentIRCompiler Compile([this]() { return buildTM(); });
+  ObjLayerT ObjectLayer;
+  CompileLayerT CompileLayer(ObjectLayer, [&](Module &M) {
+    {
+      std::lock_guard<std::mutex> Lock(CompiledMutex);
+      Compiled.push_back(M.getName());
+    }
+    return Compile(M);
+  });
+  SectionMemoryManager CCMgrMemMgr;
+  CCMgrT CCMgr(CompileLayer, CCMgrMemMgr, Context, 0, 64);
+  CODLayerT CODLayer(CompileLayer, CCMgr, false);
+
+  std::shared_ptr<RuntimeDyld::SymbolResolver> Resolver =
+    createLambdaResolver(
+        [&CODLayer](const std::string &Name) {
+          if (auto Sym = CODLayer.findSymbol(Name, false))
+            return RuntimeDyld::SymbolInfo(Sym.getAddress(), Sym.getFlags());
+          return RuntimeDyld::SymbolInfo(nullptr);
+        },
+        [](const std::string &Name) {
+          return RuntimeDyld::SymbolInfo(nullptr);
+        });
+
+  // int g<I>() { return I; }
+  // int sum() { return g0() + ... + g<NumThreads - 1>(); }
+  {
+    auto M = createModule(Context, "common");
+    Function *Sum = declareFunction(*M, "sum");
+    IRBuilder<> B(BasicBlock::Create(Context, "entry", Sum));
+    Value *Result = B.getInt32(0);
+    for (unsigned I = 0; I < NumThreads; ++I) {
+      Function *G = declareFunction(*M, "g" + utostr(I));
+      IRBuilder<>(BasicBlock::Create(Context, "entry", G))
+        .CreateRet(B.getInt32(I));
+      Result = B.CreateAdd(Result, B.CreateCall(G, {}));
+    }
+    B.CreateRet(Result);
+    std::vector<std::unique_ptr<Module>> S;
+    S.push_back(std::move(M));
+    CODLayer.addModuleSet(std::move(S), nullptr, Resolver);
+  }
+
+  // All threads call sum through its stub at once, then each adds a module of
+  // its own, in its own context, calling one of the g functions.
+  std::vector<std::thread> Threads;
+  std::vector<int> Sums(NumThreads), Results(NumThreads);
+  for (unsigned I = 0; I < NumThreads; ++I)
+    Threads.emplace_back([&, I]() {
+      auto SumSym = CODLayer.findSymbol(mangle("sum"), true);
+      ASSERT_TRUE(!!SumSym);
+      int (*SumF)() = reinterpret_cast<int (*)()>(
+          static_cast<uintptr_t>(SumSym.getAddress()));
+      Sums[I] = SumF();
+
+      // int h<I>() { return g<I>() + 100; }
+      std::string Name = "h" + utostr(I);
+      auto M = createModule(*Contexts[I], Name);
+      Function *G = declareFunction(*M, "g" + utostr(I));
+      Function *H = declareFunction(*M, Name);
+      IRBuilder<> B(BasicBlock::Create(*Contexts[I], "entry", H));
+      B.CreateRet(B.CreateAdd(B.CreateCall(G, {}), B.getInt32(100)));
+      std::vector<std::unique_ptr<Module>> S;
+      S.push_back(std::move(M));
+      CODLayer.addModuleSet(std::move(S), nullptr, Resolver);
+
+      auto Sym = CODLayer.findSymbol(mangle(Name), true);
+      ASSERT_TRUE(!!Sym);
+      int (*F)() = reinterpret_cast<int (*)()>(
+          static_cast<uintptr_t>(Sym.getAddress()));
+      Results[I] = F();
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+
+  for (unsigned I = 0; I < NumThreads; ++I) {
+    EXPECT_EQ(static_cast<int>(NumThreads * (NumThreads - 1) / 2), Sums[I]);
+    EXPECT_EQ(static_cast<int>(I) + 100, Results[I]);
+  }
+
+  // Each function was compiled once.
+  std::sort(Compiled.begin(), Compiled.end());
+  EXPECT_TRUE(std::adjacent_find(Compiled.begin(), Compiled.end()) ==
+              Compiled.end());
+  EXPECT_EQ(1, std::count(Compiled.begin(), Compiled.end(), "common.sum"));
+}
+
+#endif
+
+}
@@ -0,0 +1,205 @@
+//===- SlabMemoryManagerTest.cpp - Unit tests for the slab memory manager -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/SlabMemoryManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "gtest/gtest.h"
+#include <thread>
+
+using namespace llvm;
+
+namespace {
+
+uintptr_t toInt(const void *P) { return reinterpret_cast<uintptr_t>(P); }
+
+TEST(SlabMemoryManagerTest, BasicAllocations) {
+  JITMemoryArena Arena;
+  SlabMemoryManager MemMgr(Arena);
+
+  uint8_t *code1 = MemMgr.allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr.allocateDataSection(256, 0, 2, "", true);
+  uint8_t *code2 = MemMgr.allocateCodeSection(256, 0, 3, "");
+  uint8_t *data2 = MemMgr.allocateDataSection(256, 0, 4, "", false);
+  uint8_t *code3 = MemMgr.allocateCodeSection(256, 256, 5, "");
+
+  ASSERT_NE((uint8_t*)nullptr, code1);
+  ASSERT_NE((uint8_t*)nullptr, code2);
+  ASSERT_NE((uint8_t*)nullptr, code3);
+  ASSERT_NE((uint8_t*)nullptr, data1);
+  ASSERT_NE((uint8_t*)nullptr, data2);
+  EXPECT_EQ(0u, toInt(code3) % 256);
+
+  // Initialize the data
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    code2[i] = 2;
+    code3[i] = 3;
+    data1[i] = 4;
+    data2[i] = 5;
+  }
+
+  // Verify the data (this is checking for overlaps in the addresses)
+  for (unsigned i = 0; i < 256; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, code2[i]);
+    EXPECT_EQ(3, code3[i]);
+    EXPECT_EQ(4, data1[i]);
+    EXPECT_EQ(5, data2[i]);
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr.finalizeMemory(&Error));
+
+  // Read-write data stays writable.
+  data2[0] = 6;
+  EXPECT_EQ(6, data2[0]);
+}
+
+TEST(SlabMemoryManagerTest, PacksObjects) {
+  JITMemoryArena Arena;
+  size_t PageSize = Arena.getPageSize();
+
+  // The code of objects loaded one after the other is allocated in
+  // consecutive pages of a single slab.
+  std::vector<std::unique_ptr<SlabMemoryManager>> MemMgrs;
+  std::vector<uint8_t *> Code;
+  for (unsigned i = 0; i < 8; ++i) {
+    MemMgrs.push_back(llvm::make_unique<SlabMemoryManager>(Arena));
+    MemMgrs.back()->reserveAllocationSpace(3 * PageSize, 0, 0);
+    Code.push_back(MemMgrs.back()->allocateCodeSection(100, 16, 1, ""));
+    ASSERT_NE((uint8_t*)nullptr, Code.back());
+    EXPECT_FALSE(MemMgrs.back()->finalizeMemory());
+  }
+  for (unsigned i = 1; i < 8; ++i)
+    EXPECT_EQ(toInt(Code[i - 1]) + PageSize, toInt(Code[i]));
+  EXPECT_EQ(1u, Arena.getNumSlabs());
+  EXPECT_EQ(8 * PageSize, Arena.getAllocatedSize());
+
+  // Freeing an object makes its memory available to the next ones.
+  MemMgrs[3].reset();
+  EXPECT_EQ(7 * PageSize, Arena.getAllocatedSize());
+  SlabMemoryManager MemMgr(Arena);
+  EXPECT_EQ(Code[3], MemMgr.allocateCodeSection(100, 16, 1, ""));
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+
+  MemMgrs.clear();
+  EXPECT_EQ(PageSize, Arena.getAllocatedSize());
+}
+
+TEST(SlabMemoryManagerTest, NoWritesToFinalizedPages) {
+  JITMemoryArena Arena;
+  size_t PageSize = Arena.getPageSize();
+  SlabMemoryManager MemMgr(Arena);
+
+  uint8_t *Code1 = MemMgr.allocateCodeSection(100, 16, 1, "");
+  uint8_t *RO1 = MemMgr.allocateDataSection(100, 16, 2, "", true);
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+
+  // Sections allocated after finalization never share a page with the
+  // finalized ones.
+  uint8_t *Code2 = MemMgr.allocateCodeSection(100, 16, 3, "");
+  uint8_t *RO2 = MemMgr.allocateDataSection(100, 16, 4, "", true);
+  EXPECT_NE(toInt(Code1) / PageSize, toInt(Code2) / PageSize);
+  EXPECT_NE(toInt(RO1) / PageSize, toInt(RO2) / PageSize);
+  Code2[0] = 1;
+  RO2[0] = 2;
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+}
+
+TEST(SlabMemoryManagerTest, LargeAllocations) {
+  JITMemoryArena Arena(1 << 16);
+  SlabMemoryManager MemMgr(Arena);
+
+  uint8_t *code1 = MemMgr.allocateCodeSection(0x100000, 0, 1, "");
+  uint8_t *data1 = MemMgr.allocateDataSection(0x100000, 0, 2, "", true);
+  uint8_t *code2 = MemMgr.allocateCodeSection(0x100000, 0, 3, "");
+  uint8_t *data2 = MemMgr.allocateDataSection(0x100000, 0, 4, "", false);
+
+  ASSERT_NE((uint8_t*)nullptr, code1);
+  ASSERT_NE((uint8_t*)nullptr, code2);
+  ASSERT_NE((uint8_t*)nullptr, data1);
+  ASSERT_NE((uint8_t*)nullptr, data2);
+
+  // Initialize the data
+  for (unsigned i = 0; i < 0x100000; ++i) {
+    code1[i] = 1;
+    code2[i] = 2;
+    data1[i] = 3;
+    data2[i] = 4;
+  }
+
+  // Verify the data (this is checking for overlaps in the addresses)
+  for (unsigned i = 0; i < 0x100000; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, code2[i]);
+    EXPECT_EQ(3, data1[i]);
+    EXPECT_EQ(4, data2[i]);
+  }
+
+  std::string Error;
+  EXPECT_FALSE(MemMgr.finalizeMemory(&Error));
+}
+
+TEST(SlabMemoryManagerTest, HugePages) {
+  JITMemoryArena Arena(1, /*UseHugePages=*/true);
+  SlabMemoryManager MemMgr(Arena);
+
+  // The slabs are aligned to the size of huge pages, and the first allocation
+  // comes from the start of a slab.
+  uint8_t *Code = MemMgr.allocateCodeSection(100, 0, 1, "");
+  ASSERT_NE((uint8_t*)nullptr, Code);
+  EXPECT_EQ(0u, toInt(Code) % JITMemoryArena::HugePageSize);
+  EXPECT_FALSE(MemMgr.finalizeMemory());
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TEST(SlabMemoryManagerTest, ExecuteCode) {
+  JITMemoryArena Arena;
+  SlabMemoryManager MemMgr(Arena);
+
+  // mov $42, %eax; ret
+  const uint8_t Ret42[] = {0xB8, 0x2A, 0x00, 0x00, 0x00, 0xC3};
+  uint8_t *Code = MemMgr.allocateCodeSection(sizeof(Ret42), 16, 1, "");
+  ASSERT_NE((uint8_t*)nullptr, Code);
+  std::copy(std::begin(Ret42), std::end(Ret42), Code);
+  ASSERT_FALSE(MemMgr.finalizeMemory());
+
+  int (*F)() = reinterpret_cast<int (*)()>(Code);
+  EXPECT_EQ(42, F());
+}
+#endif
+
+#if LLVM_ENABLE_THREADS
+TEST(SlabMemoryManagerTest, SharedBetweenThreads) {
+  JITMemoryArena Arena(1 << 16);
+
+  std::vector<std::thread> Threads;
+  for (unsigned T = 0; T < 4; ++T)
+    Threads.emplace_back([&Arena, T]() {
+      for (unsigned i = 0; i < 100; ++i) {
+        SlabMemoryManager MemMgr(Arena);
+        uint8_t *Code = MemMgr.allocateCodeSection(1000, 16, 1, "");
+        uint8_t *Data = MemMgr.allocateDataSection(5000, 16, 2, "", false);
+        ASSERT_NE((uint8_t*)nullptr, Code);
+        ASSERT_NE((uint8_t*)nullptr, Data);
+        std::fill(Code, Code + 1000, T);
+        std::fill(Data, Data + 5000, T);
+        ASSERT_FALSE(MemMgr.finalizeMemory());
+        EXPECT_EQ(T, Code[999]);
+        EXPECT_EQ(T, Data[4999]);
+      }
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+
+  EXPECT_EQ(0u, Arena.getAllocatedSize());
+}
+#endif
+
+} // end anonymous namespace
@@ -0,0 +1,139 @@
+//===- llvm/unittest/IR/ConcurrentUniquingTest.cpp - Concurrent uniquing --===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+const unsigned NumKeys = 4096;
+
+/// Create the values of key \p I through every table that supports
+/// concurrent uniquing.
+void getValues(LLVMContext &C, const std::vector<std::string> &Strings,
+               unsigned I, std::vector<const void *> &Values) {
+  Values.push_back(ConstantInt::get(Type::getInt64Ty(C), I));
+  Values.push_back(ConstantInt::get(IntegerType::get(C, 17 + I % 7), I % 31));
+  Values.push_back(ConstantFP::get(Type::getDoubleTy(C), I * 0.5));
+  Values.push_back(MDString::get(C, Strings[I]));
+  Type *ArrayTy = ArrayType::get(Type::getInt8Ty(C), I % 64);
+  Values.push_back(PointerType::get(ArrayTy, I % 3));
+  Values.push_back(StructType::get(C, {ArrayTy, Type::getInt32Ty(C)}));
+  Values.push_back(
+      FunctionType::get(Type::getVoidTy(C), {ArrayTy->getPointerTo()}, false));
+}
+
+std::vector<std::string> makeStrings() {
+  std::vector<std::string> Strings;
+  for (unsigned I = 0; I != NumKeys; ++I)
+    Strings.push_back("string" + std::to_string(I));
+  return Strings;
+}
+
+TEST(ConcurrentUniquingTest, SameValuesOnAllThreads) {
+  LLVMContext C;
+  std::vector<std::string> Strings = makeStrings();
+
+  // Some values exist before the mode is switched on.
+  std::vector<const void *> Before;
+  for (unsigned I = 0; I < NumKeys; I += 2)
+    getValues(C, Strings, I, Before);
+
+  C.setConcurrentUniquing(true);
+  EXPECT_TRUE(C.hasConcurrentUniquing());
+
+  const unsigned NumThreads = 8;
+  std::vector<std::vector<const void *>> Results(NumThreads);
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned T = 0; T != NumThreads; ++T)
+      Pool.async([&, T] {
+        // Walk the keys in a different order on every thread.
+        for (unsigned I = 0; I != NumKeys; ++I)
+          getValues(C, Strings, (I * 7 + T * 509) % NumKeys, Results[T]);
+      });
+  }
+
+  C.setConcurrentUniquing(false);
+  EXPECT_FALSE(C.hasConcurrentUniquing());
+  std::vector<const void *> Expected;
+  for (unsigned I = 0; I != NumKeys; ++I)
+    getValues(C, Strings, I, Expected);
+
+  for (unsigned T = 0; T != NumThreads; ++T) {
+    std::vector<const void *> Sorted(Expected.size());
+    for (unsigned I = 0; I != NumKeys; ++I) {
+      unsigned Key = (I * 7 + T * 509) % NumKeys;
+      std::copy(Results[T].begin() + I * 7, Results[T].begin() + I * 7 + 7,
+                Sorted.begin() + Key * 7);
+    }
+    EXPECT_EQ(Expected, Sorted);
+  }
+  for (unsigned I = 0; I < NumKeys; I += 2)
+    for (unsigned J = 0; J != 7; ++J)
+      EXPECT_EQ(Before[I / 2 * 7 + J], Expected[I * 7 + J]);
+  EXPECT_EQ("string42", cast<MDString>(static_cast<const Metadata *>(
+                                           Expected[42 * 7 + 3]))
+                            ->getString());
+}
+
+/// Time creating the values of every key \p Rounds times on \p NumThreads
+/// threads, and return the time per value in nanoseconds.
+double timeUniquing(LLVMContext &C, const std::vector<std::string> &Strings,
+                    unsigned NumThreads, unsigned Rounds) {
+  auto Start = std::chrono::steady_clock::now();
+  {
+    ThreadPool Pool(NumThreads);
+    for (unsigned T = 0; T != NumThreads; ++T)
+      Pool.async([&] {
+        std::vector<const void *> Values;
+        for (unsigned R = 0; R != Rounds / NumThreads; ++R) {
+          Values.clear();
+          for (unsigned I = 0; I != NumKeys; ++I)
+            getValues(C, Strings, I, Values);
+        }
+      });
+  }
+  std::chrono::duration<double, std::nano> Elapsed =
+      std::chrono::steady_clock::now() - Start;
+  return Elapsed.count() / (Rounds / NumThreads * NumThreads * NumKeys * 7);
+}
+
+// A microbenchmark: the single-threaded cost with and without concurrent
+// uniquing, and the throughput on several threads.
+TEST(ConcurrentUniquingTest, Benchmark) {
+  std::vector<std::string> Strings = makeStrings();
+  const unsigned Rounds = 16;
+
+  LLVMContext Serial;
+  timeUniquing(Serial, Strings, 1, 1);
+  outs() << "  serial: " << timeUniquing(Serial, Strings, 1, Rounds)
+         << " ns/value\n";
+
+  for (unsigned NumThreads : {1, 4, 8}) {
+    LLVMContext C;
+    C.setConcurrentUniquing(true);
+    timeUniquing(C, Strings, 1, 1);
+    outs() << "  concurrent, " << NumThreads
+           << " thread(s): " << timeUniquing(C, Strings, NumThreads, Rounds)
+           << " ns/value\n";
+  }
+}
+
+} // end anonymous namespace
@@ -0,0 +1,96 @@
+//===- llvm/unittest/IR/FunctionInfoTest.cpp - Function summary tests -----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/FunctionInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+std::unique_ptr<Module> parseIR(LLVMContext &C, const char *IR) {
+  SMDiagnostic Err;
+  std::unique_ptr<Module> M = parseAssemblyString(IR, Err, C);
+  if (!M)
+    Err.print("FunctionInfoTest", errs());
+  return M;
+}
+
+const char *ModuleIR =
+    "@g = global i32 0\n"
+    "define internal void @local() {\n"
+    "  ret void\n"
+    "}\n"
+    "declare void @ext()\n"
+    "define i32 @f() {\n"
+    "  call void @ext()\n"
+    "  call void @ext()\n"
+    "  call void @local()\n"
+    "  %v = load i32, i32* @g\n"
+    "  ret i32 %v\n"
+    "}\n"
+    "define i32 @leaf(i32 %x) {\n"
+    "  ret i32 %x\n"
+    "}\n";
+
+TEST(FunctionInfoTest, ComputeSummary) {
+  LLVMContext C;
+  std::unique_ptr<Module> M = parseIR(C, ModuleIR);
+  ASSERT_TRUE(M != nullptr);
+
+  std::unique_ptr<FunctionSummary> S =
+      FunctionSummary::compute(*M->getFunction("f"));
+  EXPECT_EQ(GlobalValue::ExternalLinkage, S->getLinkage());
+  EXPECT_EQ(5u, S->getInstCount());
+  EXPECT_EQ(0u, S->getEntryCount());
+
+  ASSERT_EQ(2u, S->calls().size());
+  EXPECT_EQ("ext", S->calls()[0].Name);
+  EXPECT_FALSE(S->calls()[0].IsLocal);
+  EXPECT_EQ(2u, S->calls()[0].CallsiteCount);
+  EXPECT_EQ("local", S->calls()[1].Name);
+  EXPECT_TRUE(S->calls()[1].IsLocal);
+
+  ASSERT_EQ(1u, S->refs().size());
+  EXPECT_EQ("g", S->refs()[0].Name);
+  EXPECT_TRUE(S->hasLocalRefs());
+
+  EXPECT_FALSE(FunctionSummary::compute(*M->getFunction("leaf"))
+                   ->hasLocalRefs());
+}
+
+TEST(FunctionInfoTest, MergeQualifiesLocals) {
+  LLVMContext C;
+  std::unique_ptr<Module> M = parseIR(C, ModuleIR);
+  ASSERT_TRUE(M != nullptr);
+
+  std::unique_ptr<FunctionInfoIndex> PerModule = FunctionInfoIndex::build(*M);
+  EXPECT_EQ(3u, PerModule->size());
+
+  FunctionInfoIndex Combined;
+  Combined.mergeFrom(std::move(PerModule), "a.bc", 7);
+  EXPECT_EQ(7u, Combined.modulePaths().lookup("a.bc"));
+  EXPECT_TRUE(Combined.findFunctionSummaries("local") == nullptr);
+  ASSERT_TRUE(Combined.findFunctionSummaries("a.bc:local") != nullptr);
+
+  const FunctionInfoIndex::FunctionSummaryList *F =
+      Combined.findFunctionSummaries("f");
+  ASSERT_TRUE(F != nullptr);
+  ASSERT_EQ(1u, F->size());
+  const FunctionSummary &S = *F->front();
+  EXPECT_EQ("a.bc", S.modulePath());
+  EXPECT_EQ("ext", S.calls()[0].Name);
+  EXPECT_EQ("a.bc:local", S.calls()[1].Name);
+}
+
+} // end anonymous namespace
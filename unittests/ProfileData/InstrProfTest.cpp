@@ -95,4 +95,44 @@ TEST_F(InstrProfTest, get_max_function_count) {
   ASSERT_EQ(1ULL << 63, Reader->getMaximumFunctionCount());
 }
 
+TEST_F(InstrProfTest, merge_records_from_writer) {
+  Writer.addFunctionCounts("foo", 0x1234, {1, 2});
+  Writer.addFunctionCounts("bar", 0, {3});
+
+  InstrProfWriter Writer2;
+  Writer2.addFunctionCounts("foo", 0x1234, {4, 8});
+  Writer2.addFunctionCounts("foo", 0x5678, {5});
+  Writer2.addFunctionCounts("bar", 0, {1, 1});
+  Writer2.addFunctionCounts("baz", 0, {16});
+
+  std::vector<std::pair<std::string, std::error_code>> Warnings;
+  Writer.mergeRecordsFromWriter(std::move(Writer2),
+                                [&](StringRef Name, std::error_code EC) {
+                                  Warnings.push_back({Name, EC});
+                                });
+  ASSERT_EQ(1U, Warnings.size());
+  ASSERT_EQ("bar", Warnings[0].first);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::count_mismatch,
+                          Warnings[0].second));
+
+  auto Profile = Writer.writeBuffer();
+  readProfile(std::move(Profile));
+
+  std::vector<uint64_t> Counts;
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(5U, Counts[0]);
+  ASSERT_EQ(10U, Counts[1]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("foo", 0x5678, Counts)));
+  ASSERT_EQ(1U, Counts.size());
+  ASSERT_EQ(5U, Counts[0]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("bar", 0, Counts)));
+  ASSERT_EQ(1U, Counts.size());
+  ASSERT_EQ(3U, Counts[0]);
+  ASSERT_TRUE(NoError(Reader->getFunctionCounts("baz", 0, Counts)));
+  ASSERT_EQ(1U, Counts.size());
+  ASSERT_EQ(16U, Counts[0]);
+  ASSERT_EQ(16U, Reader->getMaximumFunctionCount());
+}
+
 } // end anonymous namespace
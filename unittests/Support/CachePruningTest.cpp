@@ -0,0 +1,104 @@
+//===- unittests/Support/CachePruningTest.cpp - CachePruning tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TimeValue.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+/// Create the file \p Name of \p Size bytes in \p Dir, last used \p Age
+/// seconds ago.
+void createEntry(StringRef Dir, StringRef Name, unsigned Size, unsigned Age) {
+  SmallString<64> Path(Dir);
+  sys::path::append(Path, Name);
+  int FD;
+  ASSERT_FALSE(sys::fs::openFileForWrite(Path, FD, sys::fs::F_None));
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/false);
+    OS << std::string(Size, 'x');
+  }
+  sys::TimeValue Time = sys::TimeValue::now() -
+                        sys::TimeValue(sys::TimeValue::SecondsType(Age));
+  ASSERT_FALSE(sys::fs::setLastModificationAndAccessTime(FD, Time));
+  sys::Process::SafelyCloseFileDescriptor(FD);
+}
+
+bool entryExists(StringRef Dir, StringRef Name) {
+  SmallString<64> Path(Dir);
+  sys::path::append(Path, Name);
+  return sys::fs::exists(Path);
+}
+
+void removeDir(StringRef Dir) {
+  std::error_code EC;
+  for (sys::fs::directory_iterator File(Dir, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC))
+    sys::fs::remove(File->path());
+  sys::fs::remove(Dir);
+}
+
+TEST(CachePruningTest, Expiration) {
+  SmallString<64> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("CachePruningTestDir", Dir));
+  createEntry(Dir, "llvmcache-old", 10, 3600);
+  createEntry(Dir, "llvmcache-new", 10, 0);
+  createEntry(Dir, "not-an-entry", 10, 3600);
+  createEntry(Dir, "llvmcache-old.lock", 10, 3600);
+
+  EXPECT_TRUE(CachePruning(Dir).setEntryExpiration(60).prune());
+  EXPECT_FALSE(entryExists(Dir, "llvmcache-old"));
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-new"));
+  EXPECT_TRUE(entryExists(Dir, "not-an-entry"));
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-old.lock"));
+
+  // The timestamp file written by the first pruning prevents another one
+  // within the pruning interval.
+  createEntry(Dir, "llvmcache-old", 10, 3600);
+  EXPECT_FALSE(CachePruning(Dir).setEntryExpiration(60).prune());
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-old"));
+
+  removeDir(Dir);
+}
+
+TEST(CachePruningTest, MaxSize) {
+  SmallString<64> Dir;
+  ASSERT_FALSE(sys::fs::createUniqueDirectory("CachePruningTestDir", Dir));
+  createEntry(Dir, "llvmcache-a", 100, 30);
+  createEntry(Dir, "llvmcache-b", 100, 20);
+  createEntry(Dir, "llvmcache-c", 100, 10);
+
+  // The least recently used entries go first.
+  EXPECT_TRUE(CachePruning(Dir)
+                  .setPruningInterval(0)
+                  .setEntryExpiration(0)
+                  .setMaxSize(250)
+                  .prune());
+  EXPECT_FALSE(entryExists(Dir, "llvmcache-a"));
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-b"));
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-c"));
+
+  EXPECT_TRUE(CachePruning(Dir)
+                  .setPruningInterval(0)
+                  .setEntryExpiration(0)
+                  .setMaxSize(100)
+                  .prune());
+  EXPECT_FALSE(entryExists(Dir, "llvmcache-b"));
+  EXPECT_TRUE(entryExists(Dir, "llvmcache-c"));
+
+  removeDir(Dir);
+}
+
+} // end anonymous namespace
@@ -0,0 +1,98 @@
+//===- llvm/unittest/Support/ThreadPoolTest.cpp - ThreadPool tests --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "gtest/gtest.h"
+#include <atomic>
+
+using namespace llvm;
+
+namespace {
+
+TEST(ThreadPoolTest, AsyncBarrier) {
+  std::atomic<int> Count(0);
+  {
+    ThreadPool Pool(4);
+    for (int I = 0; I < 100; ++I)
+      Pool.async([&Count] { ++Count; });
+    Pool.wait();
+    EXPECT_EQ(100, Count);
+  }
+  EXPECT_EQ(100, Count);
+}
+
+TEST(ThreadPoolTest, AsyncWithArgs) {
+  std::atomic<int> Sum(0);
+  ThreadPool Pool(2);
+  for (int I = 1; I <= 10; ++I)
+    Pool.async([&Sum](int X) { Sum += X; }, I);
+  Pool.wait();
+  EXPECT_EQ(55, Sum);
+}
+
+TEST(ThreadPoolTest, Futures) {
+  ThreadPool Pool(3);
+  std::vector<std::shared_future<int>> Results;
+  for (int I = 0; I < 20; ++I)
+    Results.push_back(Pool.async([I] { return I * I; }));
+  for (int I = 0; I < 20; ++I)
+    EXPECT_EQ(I * I, Results[I].get());
+}
+
+TEST(ThreadPoolTest, DestructorWaits) {
+  std::atomic<int> Count(0);
+  {
+    ThreadPool Pool(2);
+    for (int I = 0; I < 50; ++I)
+      Pool.async([&Count] { ++Count; });
+  }
+  EXPECT_EQ(50, Count);
+}
+
+TEST(ThreadPoolTest, TaskGroup) {
+  ThreadPool Pool(4);
+  std::atomic<int> Count(0);
+  TaskGroup Group(Pool);
+  for (int I = 0; I < 64; ++I)
+    Group.spawn([&Count] { ++Count; });
+  Group.wait();
+  EXPECT_EQ(64, Count);
+}
+
+TEST(ThreadPoolTest, NestedTaskGroups) {
+  // Every worker blocks on a nested group; this only terminates because
+  // waiting workers run the nested tasks themselves.
+  ThreadPool Pool(2);
+  std::atomic<int> Count(0);
+  TaskGroup Outer(Pool);
+  for (int I = 0; I < 8; ++I)
+    Outer.spawn([&Pool, &Count] {
+      TaskGroup Inner(Pool);
+      for (int J = 0; J < 8; ++J)
+        Inner.spawn([&Count] { ++Count; });
+      Inner.wait();
+    });
+  Outer.wait();
+  EXPECT_EQ(64, Count);
+}
+
+TEST(ThreadPoolTest, DefaultParallelism) {
+  EXPECT_GE(getDefaultParallelism(), 1u);
+  setDefaultParallelism(3);
+  if (llvm_is_multithreaded()) {
+    EXPECT_EQ(3u, getDefaultParallelism());
+    ThreadPool Pool;
+    EXPECT_EQ(3u, Pool.getThreadCount());
+  }
+  setDefaultParallelism(0);
+  EXPECT_GE(getDefaultParallelism(), 1u);
+}
+
+} // end anonymous namespace
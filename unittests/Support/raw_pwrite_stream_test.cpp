@@ -10,6 +10,8 @@
 #include "gtest/gtest.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_mapped_file_ostream.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -50,6 +52,56 @@ TEST(raw_pwrite_ostreamTest, TestFD) {
 #endif
 }
 
+static std::string readFile(StringRef Path) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf = MemoryBuffer::getFile(Path);
+  EXPECT_TRUE(bool(Buf));
+  return Buf ? (*Buf)->getBuffer().str() : std::string();
+}
+
+TEST(raw_pwrite_ostreamTest, TestMappedFile) {
+  SmallString<64> Path;
+  ASSERT_FALSE(sys::fs::createTemporaryFile("mapped", "o", Path));
+
+  // Exactly as much as was reserved goes into the mapping.
+  {
+    raw_mapped_file_ostream OS(Path);
+    OS << "ab";
+    OS.reserveExtraSpace(6);
+    OS << "cd";
+    OS.pwrite("AB", 2, 0);
+    OS << "ef";
+    OS.pwrite("CD", 2, 2);
+    OS << "gh";
+    EXPECT_EQ(8u, OS.tell());
+    EXPECT_FALSE(OS.commit());
+  }
+  EXPECT_EQ("ABCDefgh", readFile(Path));
+
+  // Writing more or less than was reserved still writes the right file.
+  {
+    raw_mapped_file_ostream OS(Path);
+    OS.reserveExtraSpace(2);
+    OS << "abcd";
+    EXPECT_FALSE(OS.commit());
+  }
+  EXPECT_EQ("abcd", readFile(Path));
+  {
+    raw_mapped_file_ostream OS(Path);
+    OS.reserveExtraSpace(100);
+    OS << "xyz";
+    EXPECT_FALSE(OS.commit());
+  }
+  EXPECT_EQ("xyz", readFile(Path));
+
+  // Nothing is written without a commit.
+  {
+    raw_mapped_file_ostream OS(Path);
+    OS.reserveExtraSpace(4);
+    OS << "1234";
+  }
+  EXPECT_FALSE(sys::fs::exists(Twine(Path)));
+}
+
 #ifdef LLVM_ON_UNIX
 TEST(raw_pwrite_ostreamTest, TestDevNull) {
   int FD;
@@ -0,0 +1,138 @@
+//===- ParallelFunctionPasses.cpp - Unit tests for parallel function passes ===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/IPO/ParallelFunctionPasses.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Scalar.h"
+#include "gtest/gtest.h"
+#include <chrono>
+
+using namespace llvm;
+
+namespace {
+
+/// Build the IR of a module with \p NumFunctions functions worth simplifying:
+/// locals kept in allocas, redundant arithmetic, calls to internal helpers,
+/// loads from a constant table and static constructors out of order.
+std::string makeModuleIR(unsigned NumFunctions) {
+  std::string IR;
+  raw_string_ostream OS(IR);
+  OS << "@table = constant [4 x i32] [i32 1, i32 2, i32 3, i32 4]\n"
+        "@counter = global i32 0\n"
+        "@llvm.global_ctors = appending global [3 x { i32, void ()*, i8* }] ["
+        "{ i32, void ()*, i8* } { i32 65535, void ()* @init2, i8* null }, "
+        "{ i32, void ()*, i8* } { i32 65535, void ()* @init0, i8* null }, "
+        "{ i32, void ()*, i8* } { i32 65535, void ()* @init1, i8* null }]\n";
+  for (unsigned I = 0; I != 3; ++I)
+    OS << "define void @init" << I << "() {\n"
+       << "  store i32 " << I << ", i32* @counter\n"
+       << "  ret void\n"
+       << "}\n";
+  for (unsigned I = 0; I != NumFunctions; ++I) {
+    OS << "define internal i32 @helper" << I << "(i32 %x) {\n"
+       << "  %p = alloca i32\n"
+       << "  store i32 %x, i32* %p\n"
+       << "  %v = load i32, i32* %p\n"
+       << "  %a = add i32 %v, " << I << "\n"
+       << "  %b = add i32 %v, " << I << "\n"
+       << "  %c = mul i32 %a, %b\n"
+       << "  ret i32 %c\n"
+       << "}\n"
+       << "define i32 @f" << I << "(i32 %x, i1 %c) {\n"
+       << "entry:\n"
+       << "  %p = alloca i32\n"
+       << "  store i32 %x, i32* %p\n"
+       << "  br i1 %c, label %then, label %else\n"
+       << "then:\n"
+       << "  %t = getelementptr [4 x i32], [4 x i32]* @table, i32 0, i32 "
+       << I % 4 << "\n"
+       << "  %tv = load i32, i32* %t\n"
+       << "  store i32 %tv, i32* %p\n"
+       << "  br label %else\n"
+       << "else:\n"
+       << "  %v = load i32, i32* %p\n"
+       << "  %h = call i32 @helper" << I << "(i32 %v)\n"
+       << "  %s = sub i32 %h, 0\n"
+       << "  ret i32 %s\n"
+       << "}\n";
+  }
+  return OS.str();
+}
+
+std::unique_ptr<Module> parseIR(LLVMContext &Context, StringRef IR) {
+  SMDiagnostic Err;
+  return parseAssemblyString(IR, Err, Context);
+}
+
+void addPasses(legacy::FunctionPassManager &FPM) {
+  FPM.add(createSROAPass());
+  FPM.add(createEarlyCSEPass());
+  FPM.add(createInstructionCombiningPass());
+  FPM.add(createCFGSimplificationPass());
+}
+
+std::string printModule(const Module &M) {
+  std::string Str;
+  raw_string_ostream OS(Str);
+  M.print(OS, nullptr);
+  return OS.str();
+}
+
+TEST(ParallelFunctionPasses, MatchesSerial) {
+  std::string IR = makeModuleIR(400);
+  std::string Expected;
+  for (unsigned Threads : {1, 4, 16}) {
+    LLVMContext Context;
+    std::unique_ptr<Module> M = parseIR(Context, IR);
+    ASSERT_TRUE(M != nullptr);
+
+    auto Start = std::chrono::steady_clock::now();
+    M = runFunctionPassesInParallel(std::move(M), Threads, addPasses);
+    auto Elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - Start);
+    outs() << "  " << Threads << " thread(s): " << Elapsed.count() << " ms\n";
+
+    ASSERT_TRUE(M != nullptr);
+    EXPECT_EQ(&Context, &M->getContext());
+    EXPECT_FALSE(verifyModule(*M, &errs()));
+    std::string Result = printModule(*M);
+    if (Threads == 1)
+      Expected = Result;
+    else
+      EXPECT_EQ(Expected, Result);
+  }
+
+  // The passes did run: the allocas are gone and the constant table was
+  // folded even in the partitions that only declare it.
+  EXPECT_EQ(std::string::npos, Expected.find("alloca"));
+  EXPECT_EQ(std::string::npos, Expected.find("load i32, i32* getelementptr"));
+}
+
+TEST(ParallelFunctionPasses, Deterministic) {
+  std::string IR = makeModuleIR(64);
+  std::string Expected;
+  for (unsigned Run = 0; Run != 4; ++Run) {
+    LLVMContext Context;
+    std::unique_ptr<Module> M =
+        runFunctionPassesInParallel(parseIR(Context, IR), 8, addPasses);
+    std::string Result = printModule(*M);
+    if (Run == 0)
+      Expected = Result;
+    else
+      EXPECT_EQ(Expected, Result);
+  }
+}
+
+} // end anonymous namespace
@@ -0,0 +1,147 @@
+//===- SplitModule.cpp - Unit tests for SplitModule -----------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Transforms/Utils/SplitModule.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/SourceMgr.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class SplitModuleTest : public ::testing::Test {
+protected:
+  void parse(const char *Assembly) {
+    SMDiagnostic Error;
+    M = parseAssemblyString(Assembly, Error, Context);
+    ASSERT_TRUE(M != nullptr) << Error.getMessage().str();
+  }
+
+  void split(unsigned N) {
+    SplitModule(*M, N, [&](std::unique_ptr<Module> MPart) {
+      EXPECT_FALSE(verifyModule(*MPart, &errs()));
+      Parts.push_back(std::move(MPart));
+    });
+  }
+
+  /// Return the index of the only partition defining \p Name, or -1.
+  int definingPartition(StringRef Name) {
+    int Found = -1;
+    for (unsigned I = 0, E = Parts.size(); I != E; ++I) {
+      GlobalValue *GV = Parts[I]->getNamedValue(Name);
+      if (!GV || GV->isDeclaration())
+        continue;
+      EXPECT_EQ(-1, Found) << Name.str() << " defined more than once";
+      Found = I;
+    }
+    return Found;
+  }
+
+  LLVMContext Context;
+  std::unique_ptr<Module> M;
+  std::vector<std::unique_ptr<Module>> Parts;
+};
+
+TEST_F(SplitModuleTest, DistinctFunctions) {
+  parse("define void @a() {\n"
+        "  call void @b()\n"
+        "  ret void\n"
+        "}\n"
+        "define void @b() {\n"
+        "  call void @a()\n"
+        "  ret void\n"
+        "}\n");
+  split(2);
+  ASSERT_EQ(2u, Parts.size());
+  EXPECT_EQ(0, definingPartition("a"));
+  EXPECT_EQ(1, definingPartition("b"));
+  EXPECT_TRUE(Parts[0]->getFunction("b")->isDeclaration());
+  EXPECT_TRUE(Parts[1]->getFunction("a")->isDeclaration());
+}
+
+TEST_F(SplitModuleTest, LocalsStayWithTheirUsers) {
+  parse("@counter = internal global i32 0\n"
+        "define internal void @helper() {\n"
+        "  store i32 1, i32* @counter\n"
+        "  ret void\n"
+        "}\n"
+        "define void @a() {\n"
+        "  call void @helper()\n"
+        "  ret void\n"
+        "}\n"
+        "define void @b() {\n"
+        "  %v = load i32, i32* @counter\n"
+        "  ret void\n"
+        "}\n"
+        "define void @c() {\n"
+        "  ret void\n"
+        "}\n");
+  split(2);
+  int Partition = definingPartition("helper");
+  ASSERT_NE(-1, Partition);
+  EXPECT_EQ(Partition, definingPartition("counter"));
+  EXPECT_EQ(Partition, definingPartition("a"));
+  EXPECT_EQ(Partition, definingPartition("b"));
+  EXPECT_EQ(1 - Partition, definingPartition("c"));
+  EXPECT_TRUE(Parts[Partition]->getFunction("helper")->hasInternalLinkage());
+}
+
+TEST_F(SplitModuleTest, ComdatsAndAliases) {
+  parse("$group = comdat any\n"
+        "define linkonce_odr void @x() comdat($group) {\n"
+        "  ret void\n"
+        "}\n"
+        "define linkonce_odr void @y() comdat($group) {\n"
+        "  ret void\n"
+        "}\n"
+        "define void @z() {\n"
+        "  ret void\n"
+        "}\n"
+        "@alias = alias void ()* @z\n"
+        "define void @w() {\n"
+        "  ret void\n"
+        "}\n");
+  split(3);
+  int Partition = definingPartition("x");
+  ASSERT_NE(-1, Partition);
+  EXPECT_EQ(Partition, definingPartition("y"));
+  Function *X = Parts[Partition]->getFunction("x");
+  ASSERT_TRUE(X->hasComdat());
+  EXPECT_EQ("group", X->getComdat()->getName());
+  EXPECT_EQ(Parts[Partition].get(), X->getParent());
+  EXPECT_EQ(definingPartition("z"), definingPartition("alias"));
+}
+
+TEST_F(SplitModuleTest, GlobalCtors) {
+  parse("@llvm.global_ctors = appending global [2 x { i32, void ()*, i8* }] "
+        "[{ i32, void ()*, i8* } { i32 65535, void ()* @ctor1, i8* null }, "
+        "{ i32, void ()*, i8* } { i32 65535, void ()* @ctor2, i8* null }]\n"
+        "define internal void @ctor1() {\n"
+        "  ret void\n"
+        "}\n"
+        "define internal void @ctor2() {\n"
+        "  ret void\n"
+        "}\n");
+  split(2);
+  for (unsigned I = 0; I != 2; ++I) {
+    GlobalVariable *Ctors = Parts[I]->getNamedGlobal("llvm.global_ctors");
+    ASSERT_TRUE(Ctors);
+    auto *Init = cast<ConstantArray>(Ctors->getInitializer());
+    ASSERT_EQ(1u, Init->getNumOperands());
+    auto *Ctor = cast<Function>(Init->getOperand(0)->getOperand(1));
+    EXPECT_FALSE(Ctor->isDeclaration());
+  }
+}
+
+} // end anonymous namespace
@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+"""A vector kernel creation program.
+
+This is a python program that creates LLVM IR for a single function made of
+one large basic block of vector arithmetic, shuffles, compares and selects,
+loads and stores.  Blocks like this are where SelectionDAG spends most of its
+time on real vector code: the DAG for the block is large, the DAG combiner
+runs over it several times, and most of the nodes are CSE'd at least once.
+
+It is meant for measuring the compile time of the code generator, e.g.
+
+  create_vector_kernel.py 20000 > kernel.ll
+  llc -O2 -mattr=+avx2 -time-passes kernel.ll -o /dev/null
+
+For a given Python version the output only depends on the arguments, so runs
+can be compared.
+"""
+
+import argparse
+import random
+import sys
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument('ops', type=int,
+                      help='Number of vector operations in the kernel')
+  parser.add_argument('--width', type=int, default=8, choices=[4, 8, 16],
+                      help='Number of elements per vector')
+  parser.add_argument('--seed', default='kernel',
+                      help='A string used to seed the RNG')
+  args = parser.parse_args()
+
+  random.seed(args.seed)
+  out = sys.stdout.write
+  n = args.width
+  fvec = '<%d x float>' % n
+  ivec = '<%d x i32>' % n
+  bvec = '<%d x i1>' % n
+
+  out('define void @kernel(%s* %%src, %s* %%dst, %s* %%isrc) {\n' %
+      (fvec, fvec, ivec))
+  out('entry:\n')
+
+  # Keep a window of live values of each type, so that the DAG is wide
+  # rather than one long chain.
+  fvals = []
+  ivals = []
+  for i in range(8):
+    out('  %%fp%d = getelementptr %s, %s* %%src, i64 %d\n' % (i, fvec, fvec, i))
+    out('  %%f%d = load %s, %s* %%fp%d, align 4\n' % (i, fvec, fvec, i))
+    fvals.append('%%f%d' % i)
+    out('  %%ip%d = getelementptr %s, %s* %%isrc, i64 %d\n' % (i, ivec, ivec, i))
+    out('  %%i%d = load %s, %s* %%ip%d, align 4\n' % (i, ivec, ivec, i))
+    ivals.append('%%i%d' % i)
+
+  stores = 0
+  for v in range(args.ops):
+    name = '%%v%d' % v
+    kind = random.randrange(10)
+    a = random.choice(fvals)
+    b = random.choice(fvals)
+    x = random.choice(ivals)
+    y = random.choice(ivals)
+    if kind < 3:
+      op = random.choice(['fadd', 'fsub', 'fmul'])
+      out('  %s = %s %s %s, %s\n' % (name, op, fvec, a, b))
+      fvals.append(name)
+    elif kind < 6:
+      op = random.choice(['add', 'sub', 'mul', 'and', 'or', 'xor'])
+      out('  %s = %s %s %s, %s\n' % (name, op, ivec, x, y))
+      ivals.append(name)
+    elif kind == 6:
+      mask = ', '.join('i32 %d' % random.randrange(2 * n) for _ in range(n))
+      out('  %s = shufflevector %s %s, %s %s, <%d x i32> <%s>\n' %
+          (name, fvec, a, fvec, b, n, mask))
+      fvals.append(name)
+    elif kind == 7:
+      out('  %s.c = fcmp olt %s %s, %s\n' % (name, fvec, a, b))
+      out('  %s = select %s %s.c, %s %s, %s %s\n' %
+          (name, bvec, name, ivec, x, ivec, y))
+      ivals.append(name)
+    elif kind == 8:
+      out('  %s = sitofp %s %s to %s\n' % (name, ivec, x, fvec))
+      fvals.append(name)
+    else:
+      out('  %s.p = getelementptr %s, %s* %%dst, i64 %d\n' %
+          (name, fvec, fvec, stores))
+      out('  store %s %s, %s* %s.p, align 4\n' % (fvec, a, fvec, name))
+      stores += 1
+    fvals = fvals[-16:]
+    ivals = ivals[-16:]
+
+  out('  store %s %s, %s* %%dst, align 4\n' % (fvec, fvals[-1], fvec))
+  out('  ret void\n')
+  out('}\n')
+
+if __name__ == '__main__':
+  main()